@@ -0,0 +1,217 @@
+/*
+ * AsyncAppender.cpp
+ *
+ * Copyright 2017, Log4cpp Project. All rights reserved.
+ *
+ * See the COPYING file for the terms of usage and distribution.
+ */
+
+#include "PortabilityImpl.hh"
+#include <log4cpp/AsyncAppender.hh>
+#include <log4cpp/HierarchyMaintainer.hh>
+#include <log4cpp/PassThroughLayout.hh>
+#include <algorithm>
+#include <chrono>
+#include <set>
+#include <stdexcept>
+#include <stdint.h>
+
+namespace log4cpp {
+
+    namespace {
+        const size_t SLOT_RESERVE = 256;        // bytes a slot holds before its text allocates
+        const size_t MAX_BATCH = 64 * 1024;     // bytes written to the sink in one event
+
+        const std::string EMPTY;
+
+        // never destroyed: the default HierarchyMaintainer, made before them, calls
+        // closeAsyncAppenders() from its destructor at exit
+        std::mutex& openAppendersMutex() {
+            static std::mutex* mutex = new std::mutex();
+            return *mutex;
+        }
+
+        std::set<AsyncAppender*>& openAppenders() {
+            static std::set<AsyncAppender*>* appenders = new std::set<AsyncAppender*>();
+            return *appenders;
+        }
+
+        // registered with the default HierarchyMaintainer, so that Category::shutdown()
+        // writes out what the appenders still hold
+        void closeAsyncAppenders() {
+            std::set<AsyncAppender*> appenders;
+            {
+                std::lock_guard<std::mutex> lock(openAppendersMutex());
+                appenders.swap(openAppenders());
+            }
+            for(std::set<AsyncAppender*>::iterator i = appenders.begin(); i != appenders.end(); ++i)
+                (*i)->close();
+        }
+
+        size_t roundUp(size_t bufferSize) {
+            size_t capacity = 2;
+            while (capacity < bufferSize)
+                capacity <<= 1;
+            return capacity;
+        }
+    }
+
+    AsyncAppender::AsyncAppender(const std::string& name, Appender& sink, size_t bufferSize,
+                                 OverflowPolicy overflow) :
+        LayoutAppender(name),
+        _sink(sink),
+        _overflow(overflow),
+        _slots(new Slot[roundUp(bufferSize)]),
+        _mask(roundUp(bufferSize) - 1),
+        _enqueue(0),
+        _dropped(0),
+        _closed(false),
+        _appending(0),
+        _stopping(false),
+        _writerWaiting(false) {
+        for (size_t i = 0; i <= _mask; ++i) {
+            _slots[i].sequence.store(i, std::memory_order_relaxed);
+            _slots[i].text.reserve(SLOT_RESERVE);
+        }
+        if (_sink.requiresLayout())
+            _sink.setLayout(new PassThroughLayout());
+        // the events given to the sink stand for many, so it filters none of them
+        setThreshold(_sink.getThreshold());
+        _sink.setThreshold(Priority::NOTSET);
+
+        {
+            static bool registered = false;
+            std::lock_guard<std::mutex> lock(openAppendersMutex());
+            if (!registered) {
+                HierarchyMaintainer::getDefaultMaintainer().register_shutdown_handler(&closeAsyncAppenders);
+                registered = true;
+            }
+            openAppenders().insert(this);
+        }
+        _writer = std::thread(&AsyncAppender::_run, this);
+    }
+
+    AsyncAppender::~AsyncAppender() {
+        close();
+        delete[] _slots;
+    }
+
+    bool AsyncAppender::reopen() {
+        return _sink.reopen();
+    }
+
+    void AsyncAppender::close() {
+        {
+            std::lock_guard<std::mutex> lock(openAppendersMutex());
+            openAppenders().erase(this);
+        }
+        bool closed = false;
+        if (!_closed.compare_exchange_strong(closed, true))
+            return;
+
+        // the threads that got past the check of _closed fill their slots before the
+        // writer is told to finish, or the events they log would be lost
+        while (_appending.load(std::memory_order_seq_cst) != 0)
+            std::this_thread::yield();
+        _stopping.store(true, std::memory_order_release);
+        _wakeWriter();
+        if (_writer.joinable())
+            _writer.join();
+        _sink.close();
+    }
+
+    AsyncAppender::OverflowPolicy AsyncAppender::getOverflowPolicy(const std::string& name) {
+        std::string policy(name);
+        std::transform(policy.begin(), policy.end(), policy.begin(), ::tolower);
+        if (policy == "block")
+            return BLOCK;
+        if (policy == "drop")
+            return DROP;
+        throw std::invalid_argument("unknown overflow policy: " + name);
+    }
+
+    void AsyncAppender::_append(const LoggingEvent& event) {
+        // seq_cst against close(), so that either it waits for this thread or this
+        // thread sees it closed
+        _appending.fetch_add(1, std::memory_order_seq_cst);
+        if (_closed.load(std::memory_order_seq_cst)) {
+            _appending.fetch_sub(1, std::memory_order_release);
+            _dropped.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+        // formatted into a buffer of the thread's own, which keeps its capacity
+        static thread_local std::string text;
+        text.clear();
+        _getLayout().appendFormatted(event, text);
+
+        size_t position = _enqueue.load(std::memory_order_relaxed);
+        for (;;) {
+            Slot& slot = _slots[position & _mask];
+            size_t sequence = slot.sequence.load(std::memory_order_acquire);
+            intptr_t lag = (intptr_t)sequence - (intptr_t)position;
+            if (lag == 0) {
+                if (_enqueue.compare_exchange_weak(position, position + 1, std::memory_order_relaxed)) {
+                    slot.text.assign(text);
+                    // seq_cst against the writer's _writerWaiting, so that it is either seen
+                    // waiting here or sees this slot before it waits
+                    slot.sequence.store(position + 1, std::memory_order_seq_cst);
+                    if (_writerWaiting.load(std::memory_order_seq_cst))
+                        _wakeWriter();
+                    _appending.fetch_sub(1, std::memory_order_release);
+                    return;
+                }
+            } else if (lag < 0) {
+                // a lap ahead of the writer: the ring is full
+                if (_overflow == DROP) {
+                    _appending.fetch_sub(1, std::memory_order_release);
+                    _dropped.fetch_add(1, std::memory_order_relaxed);
+                    return;
+                }
+                _wakeWriter();
+                std::this_thread::yield();
+                position = _enqueue.load(std::memory_order_relaxed);
+            } else {
+                position = _enqueue.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    void AsyncAppender::_wakeWriter() {
+        std::lock_guard<std::mutex> lock(_wakeMutex);
+        _wake.notify_one();
+    }
+
+    void AsyncAppender::_run() {
+        std::string batch;
+        batch.reserve(MAX_BATCH + SLOT_RESERVE);
+        size_t position = 0;
+        for (;;) {
+            // read before the slots, so that a slot filled before close() stopped the
+            // writer is written in this pass
+            bool stopping = _stopping.load(std::memory_order_acquire);
+            batch.clear();
+            while (batch.size() < MAX_BATCH) {
+                Slot& slot = _slots[position & _mask];
+                if (slot.sequence.load(std::memory_order_acquire) != position + 1)
+                    break;
+                batch += slot.text;
+                slot.sequence.store(position + _mask + 1, std::memory_order_release);
+                ++position;
+            }
+            if (!batch.empty()) {
+                LoggingEvent event(EMPTY, batch, EMPTY, Priority::NOTSET);
+                _sink.doAppend(event);
+                continue;
+            }
+            if (stopping)
+                break;
+
+            std::unique_lock<std::mutex> lock(_wakeMutex);
+            _writerWaiting.store(true, std::memory_order_seq_cst);
+            if (_slots[position & _mask].sequence.load(std::memory_order_seq_cst) != position + 1
+                    && !_stopping.load(std::memory_order_acquire))
+                _wake.wait_for(lock, std::chrono::milliseconds(100));
+            _writerWaiting.store(false, std::memory_order_relaxed);
+        }
+    }
+}
@@ -60,6 +60,7 @@ namespace log4cpp {
         _parent(parent),
         _priority(priority),
         _isAdditive(true) {
+        _updateChainedPriority();
     }
 
     Category::~Category() {
@@ -77,6 +78,9 @@ namespace log4cpp {
     void Category::setPriority(Priority::Value priority) {
         if ((priority < Priority::NOTSET) || (getParent() != NULL)) {
             _priority = priority;
+            _updateChainedPriority();
+            // the categories below this one may have taken their priority from it
+            HierarchyMaintainer::getDefaultMaintainer()._updateChainedPriorities();
         } else {
             /* caller tried to set NOTSET priority to root Category. 
                Bad caller!
@@ -86,14 +90,17 @@ namespace log4cpp {
     }
     
     Priority::Value Category::getChainedPriority() const throw() {
+        return _chainedPriority.load(std::memory_order_relaxed);
+    }
+
+    void Category::_updateChainedPriority() throw() {
         // REQUIRE(rootCategory->getPriority() != Priority::NOTSET)
-        
-        const Category* c = this;
-        while(c->getPriority() >= Priority::NOTSET) { 
-            c = c->getParent();
+
+        Priority::Value priority = _priority;
+        if (priority >= Priority::NOTSET && _parent != NULL) {
+            priority = _parent->_chainedPriority.load(std::memory_order_relaxed);
         }
-        
-        return c->getPriority();
+        _chainedPriority.store(priority, std::memory_order_relaxed);
     }
     
     void Category::addAppender(Appender* appender) {
@@ -265,7 +272,7 @@ namespace log4cpp {
     }
     
     bool Category::isPriorityEnabled(Priority::Value priority) const throw() {
-        return(getChainedPriority() >= priority);
+        return(_chainedPriority.load(std::memory_order_relaxed) >= priority);
     }
 
     void Category::log(Priority::Value priority, 
@@ -14,6 +14,7 @@
  *    Ian Craggs - initial API and implementation and/or initial documentation
  *    Ian Craggs - add SSL support
  *    Ian Craggs - fix for bug 413429 - connectionLost not called
+ *    adaptive in-flight window
  *******************************************************************************/
 
 #if !defined(CLIENTS_H)
@@ -29,6 +30,7 @@
 #include "MQTTClient.h"
 #include "LinkedList.h"
 #include "MQTTClientPersistence.h"
+#include "MQTTInflight.h"
 /*BE
 include "LinkedList"
 BE*/
@@ -88,6 +90,7 @@ typedef struct
 	time_t lastTouch;		/**> used for retry and expiry */
 	char nextMessageType;	/**> PUBREC, PUBREL, PUBCOMP */
 	int len;				/**> length of the whole structure+data */
+	int64_t sent;			/**> when sent, for the round trip time; 0 once retried */
 } Messages;
 
 
@@ -184,6 +187,7 @@ typedef struct
 	MQTTClient_persistence* persistence; /* a persistence implementation */
 	void* context; /* calling context - used when calling disconnect_internal */
 	int MQTTVersion;
+	MQTTInflight inflight;	/**< window and pacing for QoS 1 and 2 publishes */
 #if defined(OPENSSL)
 	MQTTClient_SSLOptions *sslopts;
 	SSL_SESSION* session;    /***< SSL session pointer for fast handhake */
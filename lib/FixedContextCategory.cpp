@@ -43,6 +43,10 @@ namespace log4cpp {
 
         return result;
     }
+
+    bool FixedContextCategory::isPriorityEnabled(Priority::Value priority) const throw() {
+        return(getChainedPriority() >= priority);
+    }
     
     void FixedContextCategory::addAppender(Appender* appender) throw() {
         // XXX do nothing for now
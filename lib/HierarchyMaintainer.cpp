@@ -17,6 +17,7 @@
 #endif
 
 #include <cstdio>
+#include <functional>
 #include <log4cpp/HierarchyMaintainer.hh>
 #include <log4cpp/FileAppender.hh>
 
@@ -29,6 +30,9 @@ namespace log4cpp {
     }
 
     HierarchyMaintainer::HierarchyMaintainer() {
+        for(size_t i = 0; i < PUBLISHED_BUCKETS; i++) {
+            _published[i].store(NULL, std::memory_order_relaxed);
+        }
     }
 
     HierarchyMaintainer::~HierarchyMaintainer() {
@@ -37,6 +41,11 @@ namespace log4cpp {
     }
 
     Category* HierarchyMaintainer::getExistingInstance(const std::string& name) {
+        Category* result = _findPublished(name, std::hash<std::string>()(name));
+        if (NULL != result) {
+            return result;
+        }
+
         threading::ScopedLock lock(_categoryMutex);
         return _getExistingInstance(name);
     }
@@ -53,6 +62,11 @@ namespace log4cpp {
     }
 
     Category& HierarchyMaintainer::getInstance(const std::string& name) {
+        Category* result = _findPublished(name, std::hash<std::string>()(name));
+        if (NULL != result) {
+            return *result;
+        }
+
         threading::ScopedLock lock(_categoryMutex);
         return _getInstance(name);
     }
@@ -77,10 +91,42 @@ namespace log4cpp {
                 result = new Category(name, &parent, Priority::NOTSET);
             }	  
             _categoryMap[name] = result; 
+            _publish(result, std::hash<std::string>()(name));
         }
         return *result;
     }
 
+    Category* HierarchyMaintainer::_findPublished(const std::string& name, size_t hash) const {
+        const Published* entry = _published[hash % PUBLISHED_BUCKETS].load(std::memory_order_acquire);
+        for(; entry != NULL; entry = entry->next) {
+            if ((entry->hash == hash) && (entry->category->getName() == name)) {
+                return entry->category;
+            }
+        }
+        return NULL;
+    }
+
+    /* assume lock is held */
+    void HierarchyMaintainer::_publish(Category* category, size_t hash) {
+        std::atomic<Published*>& bucket = _published[hash % PUBLISHED_BUCKETS];
+        Published* entry = new Published;
+        entry->hash = hash;
+        entry->category = category;
+        entry->next = bucket.load(std::memory_order_relaxed);
+        bucket.store(entry, std::memory_order_release);
+    }
+
+    void HierarchyMaintainer::_updateChainedPriorities() {
+        threading::ScopedLock lock(_categoryMutex);
+        {
+            // a name sorts after that of its parent, so each category is
+            // updated after the one it takes its priority from
+            for(CategoryMap::const_iterator i = _categoryMap.begin(); i != _categoryMap.end(); i++) {
+                ((*i).second)->_updateChainedPriority();
+            }
+        }
+    }
+
     std::vector<Category*>* HierarchyMaintainer::getCurrentCategories() const {
         std::vector<Category*>* categories = new std::vector<Category*>;
 
@@ -121,6 +167,14 @@ namespace log4cpp {
     void HierarchyMaintainer::deleteAllCategories() {
         threading::ScopedLock lock(_categoryMutex);
         {
+            for(size_t i = 0; i < PUBLISHED_BUCKETS; i++) {
+                Published* entry = _published[i].exchange(NULL, std::memory_order_acq_rel);
+                while (entry != NULL) {
+                    Published* next = entry->next;
+                    delete entry;
+                    entry = next;
+                }
+            }
             for(CategoryMap::const_iterator i = _categoryMap.begin(); i != _categoryMap.end(); i++) {
                 delete ((*i).second);
             }
@@ -30,6 +30,10 @@
  *    Ian Craggs - automatic reconnect and offline buffering (send while disconnected)
  *    Ian Craggs - fix for bug 472250
  *    Ian Craggs - fix for bug 486548
+ *    streaming restore of persisted commands
+ *    adaptive in-flight window and publish pacing
+ *    priority lanes for queued commands
+ *    latest-value coalescing of queued publishes
  *******************************************************************************/
 
 /**
@@ -54,6 +58,7 @@
 #include "Thread.h"
 #include "SocketBuffer.h"
 #include "StackTrace.h"
+#include "Tree.h"
 #include "Heap.h"
 
 #define URI_TCP "tcp://"
@@ -165,10 +170,29 @@ void MQTTAsync_init()
 #define WINAPI
 #endif
 
+/* number of persisted commands restored in one go; the first batch is restored when the client
+   is created, the rest by the send thread */
+#define RESTORE_BATCH_SIZE 1000
+
 static volatile int initialized = 0;
 static List* handles = NULL;
 static int tostop = 0;
 static List* commands = NULL;
+/* microseconds until pacing lets the next publish go, when that is all the send thread waits for */
+static int64_t pacing_wait = 0;
+
+/* the normal and bulk lanes take turns, each sending up to the bytes in its deficit, which
+   grows by the lane's quantum on each turn: normal priority commands get four times the share
+   of the connection that bulk publishes do when both are queued */
+#define PRIORITY_LANES 3
+#define PRIORITY_NORMAL_QUANTUM 4096
+#define PRIORITY_BULK_QUANTUM 1024
+/* what a command other than a publish costs a lane, roughly a small packet */
+#define PRIORITY_COMMAND_COST 64
+static int lane_deficit[PRIORITY_LANES] = {0, 0, 0};
+static int lane_turn = MQTTASYNC_PRIORITY_NORMAL;
+/* commands in the queue on each lane, so the search for the next command stops early */
+static int lane_queued[PRIORITY_LANES] = {0, 0, 0};
 
 MQTTPacket* MQTTAsync_cycle(int* sock, unsigned long timeout, int* rc);
 int MQTTAsync_cleanSession(Clients* client);
@@ -247,6 +271,8 @@ typedef struct
 	MQTTAsync_token token;
 	void* context;
 	START_TIME_TYPE start_time;
+	int priority;  /* MQTTASYNC_PRIORITY_NORMAL, _HIGH or _BULK */
+	int coalesce;  /* a queued publish, indexed by topic in coalesced until it is taken off the queue */
 	union
 	{
 		struct
@@ -325,6 +351,15 @@ typedef struct MQTTAsync_struct
 	int retrying;
 	int reconnectNow;
 
+#if !defined(NO_PERSISTENCE)
+	/* persisted commands not yet restored to the command queue, in sequence number order */
+	MQTTPersistence_key* restore_keys;
+	int restore_count;
+	int restore_next;
+#endif
+
+	/* queued publishes that a later one to the same topic replaces, by topic */
+	Tree* coalesced;
 } MQTTAsyncs;
 
 
@@ -335,11 +370,24 @@ typedef struct
 	unsigned int seqno; /* only used on restore */
 } MQTTAsync_queuedCommand;
 
+/* connects and disconnects go ahead of everything else a client has queued */
+#define MQTTAsync_commandLane(cmd) (((cmd)->command.type == CONNECT || (cmd)->command.type == DISCONNECT) ? \
+	MQTTASYNC_PRIORITY_HIGH : (cmd)->command.priority)
+
+/* coalesced publishes are indexed by topic: b is a queued command when adding, a topic when finding */
+static int MQTTAsync_coalesceCompare(void* a, void* b, int content)
+{
+	return strcmp(((MQTTAsync_queuedCommand*)a)->command.details.pub.destinationName,
+		content ? ((MQTTAsync_queuedCommand*)b)->command.details.pub.destinationName : (char*)b);
+}
+
 void MQTTAsync_freeCommand(MQTTAsync_queuedCommand *command);
 void MQTTAsync_freeCommand1(MQTTAsync_queuedCommand *command);
 int MQTTAsync_deliverMessage(MQTTAsyncs* m, char* topicName, size_t topicLen, MQTTAsync_message* mm);
 #if !defined(NO_PERSISTENCE)
-int MQTTAsync_restoreCommands(MQTTAsyncs* client);
+int MQTTAsync_restoreCommands(MQTTAsyncs* client, MQTTPersistence_key* keys, int nkeys);
+int MQTTAsync_restoreDeferredCommands(void);
+void MQTTAsync_freeRestoreKeys(MQTTAsyncs* client);
 #endif
 
 void MQTTAsync_sleep(long milliseconds)
@@ -456,6 +504,7 @@ int MQTTAsync_createWithOptions(MQTTAsync* handle, const char* serverURI, const
 #endif
 	m->serverURI = MQTTStrdup(serverURI);
 	m->responses = ListInitialize();
+	m->coalesced = TreeInitialize(MQTTAsync_coalesceCompare);
 	ListAppend(handles, m, sizeof(MQTTAsyncs));
 
 	m->c = malloc(sizeof(Clients));
@@ -477,12 +526,14 @@ int MQTTAsync_createWithOptions(MQTTAsync* handle, const char* serverURI, const
 	rc = MQTTPersistence_create(&(m->c->persistence), persistence_type, persistence_context);
 	if (rc == 0)
 	{
-		rc = MQTTPersistence_initialize(m->c, m->serverURI);
+		MQTTPersistence_key* keys = NULL;
+		int nkeys = 0;
+
+		/* the store's keys are read once, and handed on to the command restore */
+		rc = MQTTPersistence_initialize(m->c, m->serverURI, &keys, &nkeys);
 		if (rc == 0)
-		{
-			MQTTAsync_restoreCommands(m);
-			MQTTPersistence_restoreMessageQueue(m->c);
-		}
+			MQTTPersistence_restoreMessageQueue(m->c, keys, nkeys);
+		MQTTAsync_restoreCommands(m, keys, nkeys);
 	}
 #endif
 	ListAppend(bstate->clients, m->c, sizeof(Clients) + 3*sizeof(List));
@@ -514,6 +565,7 @@ void MQTTAsync_terminate(void)
 		while (ListNextElement(commands, &elem))
 			MQTTAsync_freeCommand1((MQTTAsync_queuedCommand*)(elem->content));
 		ListFree(commands);
+		memset(lane_queued, '\0', sizeof(lane_queued));
 		handles = NULL;
 		Socket_outTerminate();
 #if defined(OPENSSL)
@@ -751,56 +803,223 @@ void MQTTAsync_insertInOrder(List* list, void* content, int size)
 }
 
 
-int MQTTAsync_restoreCommands(MQTTAsyncs* client)
+/**
+ * Restores the next batch of persisted commands for a client.  Commands queued since the client
+ * was created have higher sequence numbers, so the batch goes in front of them.  Must be called
+ * with mqttasync_mutex held.
+ * @param client the client
+ * @param count the maximum number of commands to restore
+ * @return the number of persisted commands consumed
+ */
+static int MQTTAsync_restoreCommandBatch(MQTTAsyncs* client, int count)
 {
-	int rc = 0;
-	char **msgkeys;
-	int nkeys;
-	int i = 0;
 	Clients* c = client->c;
-	int commands_restored = 0;
+	ListElement* index = NULL;
+	ListElement* current = NULL;
+	int consumed = 0, restored = 0;
+	unsigned int first = client->restore_keys[client->restore_next].number;
 
 	FUNC_ENTRY;
-	if (c->persistence && (rc = c->persistence->pkeys(c->phandle, &msgkeys, &nkeys)) == 0)
+	MQTTAsync_lock_mutex(mqttcommand_mutex);
+	/* walk back from the tail to the last command restored earlier: only commands queued since,
+	   usually few, are visited.  Connects and internal disconnects at the head are left alone. */
+	current = commands->last;
+	while (current)
 	{
-		while (rc == 0 && i < nkeys)
+		MQTTAsync_queuedCommand* cmd = (MQTTAsync_queuedCommand*)(current->content);
+
+		if (cmd->client == client && !(cmd->command.type == CONNECT ||
+			(cmd->command.type == DISCONNECT && cmd->command.details.dis.internal)))
 		{
-			char *buffer = NULL;
-			int buflen;
-					
-			if (strncmp(msgkeys[i], PERSISTENCE_COMMAND_KEY, strlen(PERSISTENCE_COMMAND_KEY)) != 0)
-				;
-			else if ((rc = c->persistence->pget(c->phandle, msgkeys[i], &buffer, &buflen)) == 0)
+			if (cmd->seqno != 0 && cmd->seqno < first)
+				break;
+			index = current;
+		}
+		current = current->prev;
+	}
+
+	while (consumed < count && client->restore_next < client->restore_count)
+	{
+		MQTTPersistence_key* key = &client->restore_keys[client->restore_next++];
+		char *buffer = NULL;
+		int buflen;
+
+		++consumed;
+		if (c->persistence->pget(c->phandle, key->key, &buffer, &buflen) == 0)
+		{
+			MQTTAsync_queuedCommand* cmd = MQTTAsync_restoreCommand(buffer, buflen);
+
+			if (cmd)
 			{
-				MQTTAsync_queuedCommand* cmd = MQTTAsync_restoreCommand(buffer, buflen);
-				
-				if (cmd)
-				{
-					cmd->client = client;	
-					cmd->seqno = atoi(msgkeys[i]+2);
-					MQTTPersistence_insertInOrder(commands, cmd, sizeof(MQTTAsync_queuedCommand));
-					free(buffer);
-					client->command_seqno = max(client->command_seqno, cmd->seqno);
-					commands_restored++;
-				}
+				cmd->client = client;
+				cmd->seqno = key->number;
+				ListInsert(commands, cmd, sizeof(MQTTAsync_queuedCommand), index);
+				++lane_queued[MQTTAsync_commandLane(cmd)];
+				restored++;
 			}
-			if (msgkeys[i])
-				free(msgkeys[i]);
-			i++;
+			free(buffer);
 		}
-		if (msgkeys != NULL)
-			free(msgkeys);
+		free(key->key);
+		key->key = NULL;
+	}
+	MQTTAsync_unlock_mutex(mqttcommand_mutex);
+	Log(TRACE_MINIMUM, -1, "%d commands restored for client %s", restored, c->clientID);
+
+	if (client->restore_next >= client->restore_count)
+		MQTTAsync_freeRestoreKeys(client);
+	FUNC_EXIT_RC(consumed);
+	return consumed;
+}
+
+
+/**
+ * Restores the persisted commands of a client.  Only the first batch is restored here, so that
+ * creating the client does not wait for a long backlog: the send thread restores the rest.
+ * @param client the client
+ * @param keys the keys of the store, as returned by MQTTPersistence_keys.  They are owned by
+ * the client from here on.
+ * @param nkeys the number of keys.
+ * @return 0 if success
+ */
+int MQTTAsync_restoreCommands(MQTTAsyncs* client, MQTTPersistence_key* keys, int nkeys)
+{
+	int rc = 0;
+	int i = 0;
+	Clients* c = client->c;
+	int count = 0;
+
+	FUNC_ENTRY;
+	/* keep the command keys, which are sorted by sequence number */
+	for (i = 0; i < nkeys; ++i)
+	{
+		if (strncmp(keys[i].key, PERSISTENCE_COMMAND_KEY, strlen(PERSISTENCE_COMMAND_KEY)) == 0)
+			keys[count++] = keys[i];
+		else
+			free(keys[i].key);
+	}
+	if (count == 0)
+		MQTTPersistence_freeKeys(keys, 0);
+	else
+	{
+		client->restore_keys = keys;
+		client->restore_count = count;
+		client->restore_next = 0;
+		client->command_seqno = max(client->command_seqno, (unsigned int)keys[count - 1].number);
+		MQTTAsync_restoreCommandBatch(client, RESTORE_BATCH_SIZE);
 	}
-	Log(TRACE_MINIMUM, -1, "%d commands restored for client %s", commands_restored, c->clientID);
+	Log(TRACE_MINIMUM, -1, "%d commands persisted for client %s", count, c->clientID);
 	FUNC_EXIT_RC(rc);
 	return rc;
 }
+
+
+/**
+ * Restores a batch of persisted commands for each client that still has some to restore.
+ * @return the number of persisted commands consumed
+ */
+int MQTTAsync_restoreDeferredCommands(void)
+{
+	ListElement* current = NULL;
+	int consumed = 0;
+
+	FUNC_ENTRY;
+	MQTTAsync_lock_mutex(mqttasync_mutex);
+	while (handles && ListNextElement(handles, &current))
+	{
+		MQTTAsyncs* m = (MQTTAsyncs*)(current->content);
+
+		if (m->restore_keys)
+			consumed += MQTTAsync_restoreCommandBatch(m, RESTORE_BATCH_SIZE);
+	}
+	MQTTAsync_unlock_mutex(mqttasync_mutex);
+	FUNC_EXIT_RC(consumed);
+	return consumed;
+}
+
+
+void MQTTAsync_freeRestoreKeys(MQTTAsyncs* client)
+{
+	FUNC_ENTRY;
+	if (client->restore_keys)
+	{
+		int i;
+
+		for (i = client->restore_next; i < client->restore_count; ++i)
+			free(client->restore_keys[i].key);
+		free(client->restore_keys);
+	}
+	client->restore_keys = NULL;
+	client->restore_count = client->restore_next = 0;
+	FUNC_EXIT;
+}
+#endif
+
+
+/**
+ * The lane a command is queued on, from the response options given with it.
+ */
+static int MQTTAsync_commandPriority(MQTTAsync_responseOptions* response)
+{
+	if (response->struct_version >= 1 && (response->priority == MQTTASYNC_PRIORITY_HIGH ||
+		response->priority == MQTTASYNC_PRIORITY_BULK))
+		return response->priority;
+	return MQTTASYNC_PRIORITY_NORMAL;
+}
+
+
+/**
+ * Whether a publish queued with coalesce is waiting to be sent on a topic, so that a
+ * later one would replace it rather than add to the buffered messages.
+ */
+static int MQTTAsync_coalescePending(MQTTAsyncs* m, const char* topicName)
+{
+	int rc = 0;
+
+	MQTTAsync_lock_mutex(mqttcommand_mutex);
+	rc = TreeFind(m->coalesced, (void*)topicName) != NULL;
+	MQTTAsync_unlock_mutex(mqttcommand_mutex);
+	return rc;
+}
+
+
+/**
+ * Put a coalesced publish in the place of the one queued on its topic, if there is one.
+ * The new command is left holding the one it replaced, to be failed and freed by the
+ * caller once the command mutex is released.
+ * @return 1 if a queued publish was replaced, 0 if there is none
+ */
+static int MQTTAsync_coalesceCommand(MQTTAsync_queuedCommand* command)
+{
+	Node* found = TreeFind(command->client->coalesced, command->command.details.pub.destinationName);
+	MQTTAsync_queuedCommand* queued = NULL;
+	MQTTAsync_command superseded;
+
+	if (found == NULL)
+		return 0;
+	queued = (MQTTAsync_queuedCommand*)(found->content);
+	--lane_queued[MQTTAsync_commandLane(queued)];
+#if !defined(NO_PERSISTENCE)
+	if (queued->client->c->persistence)
+		MQTTAsync_unpersistCommand(queued);
+#endif
+	/* the tree is keyed on the topic, which is the same in both */
+	superseded = queued->command;
+	queued->command = command->command;
+	queued->command.start_time = superseded.start_time;
+	command->command = superseded;
+	++lane_queued[MQTTAsync_commandLane(queued)];
+#if !defined(NO_PERSISTENCE)
+	if (queued->client->c->persistence)
+		MQTTAsync_persistCommand(queued);
 #endif
+	return 1;
+}
 
 
 int MQTTAsync_addCommand(MQTTAsync_queuedCommand* command, int command_size)
 {
 	int rc = 0;
+	int superseded = 0;
 	
 	FUNC_ENTRY;
 	MQTTAsync_lock_mutex(mqttcommand_mutex);
@@ -816,17 +1035,39 @@ int MQTTAsync_addCommand(MQTTAsync_queuedCommand* command, int command_size)
 		if (head != NULL && head->client == command->client && head->command.type == command->command.type)
 			MQTTAsync_freeCommand(command); /* ignore duplicate connect or disconnect command */
 		else
+		{
 			ListInsert(commands, command, command_size, commands->first); /* add to the head of the list */
+			++lane_queued[MQTTASYNC_PRIORITY_HIGH];
+		}
 	}
+	else if (command->command.coalesce && MQTTAsync_coalesceCommand(command))
+		superseded = 1;
 	else
 	{
 		ListAppend(commands, command, command_size);
+		++lane_queued[MQTTAsync_commandLane(command)];
+		if (command->command.coalesce)
+			TreeAdd(command->client->coalesced, command, sizeof(MQTTAsync_queuedCommand));
 #if !defined(NO_PERSISTENCE)
 		if (command->client->c->persistence)
 			MQTTAsync_persistCommand(command);
 #endif
 	}
 	MQTTAsync_unlock_mutex(mqttcommand_mutex);
+	if (superseded)
+	{
+		if (command->command.onFailure)
+		{
+			MQTTAsync_failureData data;
+
+			data.token = command->command.token;
+			data.code = MQTTASYNC_SUPERSEDED;
+			data.message = NULL;
+			Log(TRACE_MIN, -1, "Calling publish failure for client %s: superseded", command->client->c->clientID);
+			(*(command->command.onFailure))(command->command.context, &data);
+		}
+		MQTTAsync_freeCommand(command);
+	}
 #if !defined(WIN32) && !defined(WIN64)
 	rc = Thread_signal_cond(send_cond);
 	if (rc != 0)
@@ -1055,49 +1296,142 @@ void MQTTAsync_writeComplete(int socket)
 }
 			
 
+/**
+ * The bytes a command takes from its lane's deficit.
+ */
+static int MQTTAsync_commandCost(MQTTAsync_queuedCommand* command)
+{
+	if (command->command.type == PUBLISH)
+		return command->command.details.pub.payloadlen + (int)strlen(command->command.details.pub.destinationName);
+	return PRIORITY_COMMAND_COST;
+}
+
+
+/**
+ * Deficit round robin between the first commands that can go on the normal and bulk lanes.
+ */
+static MQTTAsync_queuedCommand* MQTTAsync_shareLanes(MQTTAsync_queuedCommand** candidates)
+{
+	MQTTAsync_queuedCommand* command = NULL;
+
+	if (candidates[MQTTASYNC_PRIORITY_NORMAL] == NULL || candidates[MQTTASYNC_PRIORITY_BULK] == NULL)
+	{
+		/* a lane with nothing to send builds up no credit */
+		lane_deficit[MQTTASYNC_PRIORITY_NORMAL] = lane_deficit[MQTTASYNC_PRIORITY_BULK] = 0;
+		command = candidates[MQTTASYNC_PRIORITY_NORMAL] ? candidates[MQTTASYNC_PRIORITY_NORMAL] :
+			candidates[MQTTASYNC_PRIORITY_BULK];
+	}
+	else
+	{
+		while (command == NULL)
+		{
+			int cost = MQTTAsync_commandCost(candidates[lane_turn]);
+
+			if (lane_deficit[lane_turn] >= cost)
+			{
+				lane_deficit[lane_turn] -= cost;
+				command = candidates[lane_turn];
+			}
+			else if (lane_turn == MQTTASYNC_PRIORITY_NORMAL)
+			{
+				lane_turn = MQTTASYNC_PRIORITY_BULK;
+				lane_deficit[lane_turn] += PRIORITY_BULK_QUANTUM;
+			}
+			else
+			{
+				lane_turn = MQTTASYNC_PRIORITY_NORMAL;
+				lane_deficit[lane_turn] += PRIORITY_NORMAL_QUANTUM;
+			}
+		}
+	}
+	return command;
+}
+
+
 int MQTTAsync_processCommand()
 {
 	int rc = 0;
 	MQTTAsync_queuedCommand* command = NULL;
+	MQTTAsync_queuedCommand* candidates[PRIORITY_LANES] = {NULL, NULL, NULL};
 	ListElement* cur_command = NULL;
-	List* ignored_clients = NULL;
+	List* ignored_clients[PRIORITY_LANES];
+	List* queued_clients = NULL;
+	int64_t now = MQTTInflight_now(), wait = 0;
+	int seen[PRIORITY_LANES] = {0, 0, 0};
+	int lane;
 	
 	FUNC_ENTRY;
 	MQTTAsync_lock_mutex(mqttasync_mutex);
 	MQTTAsync_lock_mutex(mqttcommand_mutex);
+	pacing_wait = 0;
 	
-	/* only the first command in the list must be processed for any particular client, so if we skip
-	   a command for a client, we must skip all following commands for that client.  Use a list of 
-	   ignored clients to keep track
+	/* only the first command on a lane must be processed for any particular client, so if we skip
+	   a command for a client, we must skip all following commands for that client on that lane.  Use
+	   a list of ignored clients per lane to keep track.  Connects and disconnects go on the high
+	   lane, but a disconnect also waits for every command of the client queued before it
 	*/
-	ignored_clients = ListInitialize();
+	for (lane = 0; lane < PRIORITY_LANES; ++lane)
+		ignored_clients[lane] = ListInitialize();
+	queued_clients = ListInitialize();
 	
 	/* don't try a command until there isn't a pending write for that client, and we are not connecting */
 	while (ListNextElement(commands, &cur_command))
 	{
 		MQTTAsync_queuedCommand* cmd = (MQTTAsync_queuedCommand*)(cur_command->content);
+		int waiting = 0;
 		
-		if (ListFind(ignored_clients, cmd->client))
-			continue;
-		
-		if (cmd->command.type == CONNECT || cmd->command.type == DISCONNECT || (cmd->client->c->connected && 
+		lane = MQTTAsync_commandLane(cmd);
+		++seen[lane];
+		if (candidates[lane] || ListFind(ignored_clients[lane], cmd->client))
+			waiting = 1;
+		else if (cmd->command.type == DISCONNECT && !cmd->command.details.dis.internal &&
+			ListFind(queued_clients, cmd->client))
+			; /* commands queued before the disconnect go first */
+		else if (cmd->command.type == CONNECT || cmd->command.type == DISCONNECT || (cmd->client->c->connected && 
 			cmd->client->c->connect_state == 0 && Socket_noPendingWrites(cmd->client->c->net.socket)))
 		{
 			if ((cmd->command.type == PUBLISH || cmd->command.type == SUBSCRIBE || cmd->command.type == UNSUBSCRIBE) &&
 				cmd->client->c->outboundMsgs->count >= MAX_MSG_ID - 1)
 				; /* no more message ids available */
-			else
+			else if (cmd->command.type == PUBLISH && cmd->command.details.pub.qos > 0 &&
+				(wait = MQTTInflight_wait(&cmd->client->c->inflight, cmd->client->c->outboundMsgs->count, now)) != 0 &&
+				(wait < 0 || lane != MQTTASYNC_PRIORITY_HIGH))
 			{
-				command = cmd;
-				break;
+				/* the in-flight window is full, or pacing holds the publish back a little */
+				if (wait > 0 && (pacing_wait == 0 || wait < pacing_wait))
+					pacing_wait = wait;
 			}
+			else
+				candidates[lane] = cmd;
 		}
-		ListAppend(ignored_clients, cmd->client, sizeof(cmd->client));
-	}
-	ListFreeNoContent(ignored_clients);
+		if (candidates[lane] != cmd && !waiting)
+			ListAppend(ignored_clients[lane], cmd->client, sizeof(cmd->client));
+		if (!ListFind(queued_clients, cmd->client))
+			ListAppend(queued_clients, cmd->client, sizeof(cmd->client));
+
+		if (candidates[MQTTASYNC_PRIORITY_HIGH])
+			break;  /* nothing goes ahead of it */
+		for (lane = 0; lane < PRIORITY_LANES; ++lane)
+		{
+			if (candidates[lane] == NULL && seen[lane] < lane_queued[lane] && ignored_clients[lane]->count < handles->count)
+				break;
+		}
+		if (lane == PRIORITY_LANES)
+			break;  /* every lane has a command to send, or none further down, or all its clients are waiting */
+	}
+	for (lane = 0; lane < PRIORITY_LANES; ++lane)
+		ListFreeNoContent(ignored_clients[lane]);
+	ListFreeNoContent(queued_clients);
+	if (candidates[MQTTASYNC_PRIORITY_HIGH])
+		command = candidates[MQTTASYNC_PRIORITY_HIGH];
+	else
+		command = MQTTAsync_shareLanes(candidates);
 	if (command)
 	{
 		ListDetach(commands, command);
+		--lane_queued[MQTTAsync_commandLane(command)];
+		if (command->command.coalesce)
+			TreeRemove(command->client->coalesced, command);
 #if !defined(NO_PERSISTENCE)
 		if (command->client->c->persistence)
 			MQTTAsync_unpersistCommand(command);
@@ -1208,6 +1542,9 @@ int MQTTAsync_processCommand()
 		p->msgId = command->command.token;
 
 		rc = MQTTProtocol_startPublish(command->client->c, p, command->command.details.pub.qos, command->command.details.pub.retained, &msg);
+		/* paced only for a packet written, or queued to finish writing */
+		if (command->command.details.pub.qos > 0 && (rc == TCPSOCKET_COMPLETE || rc == TCPSOCKET_INTERRUPTED))
+			MQTTInflight_sent(&command->client->c->inflight, now);
 		
 		if (command->command.details.pub.qos == 0)
 		{ 
@@ -1422,11 +1759,17 @@ thread_return_type WINAPI MQTTAsync_sendThread(void* n)
 			if (MQTTAsync_processCommand() == 0)
 				break;  /* no commands were processed, so go into a wait */
 		}
+#if !defined(NO_PERSISTENCE)
+		if (MQTTAsync_restoreDeferredCommands() > 0)
+			continue;  /* more of the persisted backlog is queued, so try to send it before waiting */
+#endif
+		if (pacing_wait > 0)  /* a publish is due sooner than the wait below would notice */
+			MQTTAsync_sleep((long)((pacing_wait + 999) / 1000));
 #if !defined(WIN32) && !defined(WIN64)
-		if ((rc = Thread_wait_cond(send_cond, 1)) != 0 && rc != ETIMEDOUT)
+		else if ((rc = Thread_wait_cond(send_cond, 1)) != 0 && rc != ETIMEDOUT)
 			Log(LOG_ERROR, -1, "Error %d waiting for condition variable", rc);
 #else
-		if ((rc = Thread_wait_sem(send_sem, 1000)) != 0 && rc != ETIMEDOUT)
+		else if ((rc = Thread_wait_sem(send_sem, 1000)) != 0 && rc != ETIMEDOUT)
 			Log(LOG_ERROR, -1, "Error %d waiting for semaphore", rc);
 #endif
 			
@@ -1508,6 +1851,9 @@ void MQTTAsync_removeResponsesAndCommands(MQTTAsyncs* m)
 		if (command->client == m)
 		{
 			ListDetach(commands, command);
+			--lane_queued[MQTTAsync_commandLane(command)];
+			if (command->command.coalesce)
+				TreeRemove(m->coalesced, command);
 
 			if (command->command.onFailure)
 			{
@@ -1528,6 +1874,9 @@ void MQTTAsync_removeResponsesAndCommands(MQTTAsyncs* m)
 		current = next;
 		ListNextElement(commands, &next);
 	}
+#if !defined(NO_PERSISTENCE)
+	MQTTAsync_freeRestoreKeys(m); /* left in the store */
+#endif
 	Log(TRACE_MINIMUM, -1, "%d commands removed for client %s", count, m->c->clientID);
 	FUNC_EXIT;
 }
@@ -1545,6 +1894,7 @@ void MQTTAsync_destroy(MQTTAsync* handle)
 
 	MQTTAsync_removeResponsesAndCommands(m);
 	ListFree(m->responses);
+	TreeFree(m->coalesced);
 	
 	if (m->c)
 	{
@@ -1612,6 +1962,7 @@ int MQTTAsync_completeConnection(MQTTAsyncs* m, MQTTPacket* pack)
 			m->c->connected = 1;
 			m->c->good = 1;
 			m->c->connect_state = 0;
+			MQTTInflight_restart(&m->c->inflight);
 			if (m->c->cleansession)
 				rc = MQTTAsync_cleanSession(m->c);
 			if (m->c->outboundMsgs->count > 0)
@@ -2142,7 +2493,7 @@ int MQTTAsync_connect(MQTTAsync handle, const MQTTAsync_connectOptions* options)
 		goto exit;
 	}
 
-	if (strncmp(options->struct_id, "MQTC", 4) != 0 || options->struct_version < 0 || options->struct_version > 4)
+	if (strncmp(options->struct_id, "MQTC", 4) != 0 || options->struct_version < 0 || options->struct_version > 5)
 	{
 		rc = MQTTASYNC_BAD_STRUCTURE;
 		goto exit;
@@ -2199,6 +2550,8 @@ int MQTTAsync_connect(MQTTAsync handle, const MQTTAsync_connectOptions* options)
 	m->c->keepAliveInterval = options->keepAliveInterval;
 	m->c->cleansession = options->cleansession;
 	m->c->maxInflightMessages = options->maxInflight;
+	MQTTInflight_init(&m->c->inflight, (options->struct_version >= 5) ? options->inflightControl : INFLIGHT_NONE,
+			options->maxInflight);
 	if (options->struct_version >= 3)
 		m->c->MQTTVersion = options->MQTTVersion;
 	else
@@ -2476,6 +2829,7 @@ int MQTTAsync_subscribeMany(MQTTAsync handle, int count, char* const* topic, int
 		sub->command.onFailure = response->onFailure;
 		sub->command.context = response->context;
 		response->token = sub->command.token;
+		sub->command.priority = MQTTAsync_commandPriority(response);
 	}
 	sub->command.type = SUBSCRIBE;
 	sub->command.details.sub.count = count;
@@ -2550,6 +2904,7 @@ int MQTTAsync_unsubscribeMany(MQTTAsync handle, int count, char* const* topic, M
 		unsub->command.onFailure = response->onFailure;
 		unsub->command.context = response->context;
 		response->token = unsub->command.token;
+		unsub->command.priority = MQTTAsync_commandPriority(response);
 	}
 	unsub->command.details.unsub.count = count;
 	unsub->command.details.unsub.topics = malloc(sizeof(char*) * count);
@@ -2610,7 +2965,8 @@ int MQTTAsync_send(MQTTAsync handle, const char* destinationName, int payloadlen
 		rc = MQTTASYNC_BAD_QOS;
 	else if (qos > 0 && (msgid = MQTTAsync_assignMsgId(m)) == 0)
 		rc = MQTTASYNC_NO_MORE_MSGIDS;
-	else if (m->createOptions && (MQTTAsync_countBufferedMessages(m) >= m->createOptions->maxBufferedMessages))
+	else if (m->createOptions && (MQTTAsync_countBufferedMessages(m) >= m->createOptions->maxBufferedMessages) &&
+		!(response && response->struct_version >= 2 && response->coalesce && MQTTAsync_coalescePending(m, destinationName)))
 		rc = MQTTASYNC_MAX_BUFFERED_MESSAGES;
 
 	if (rc != MQTTASYNC_SUCCESS)
@@ -2628,6 +2984,8 @@ int MQTTAsync_send(MQTTAsync handle, const char* destinationName, int payloadlen
 		pub->command.onFailure = response->onFailure;
 		pub->command.context = response->context;
 		response->token = pub->command.token;
+		pub->command.priority = MQTTAsync_commandPriority(response);
+		pub->command.coalesce = response->struct_version >= 2 && response->coalesce;
 	}
 	pub->command.details.pub.destinationName = MQTTStrdup(destinationName);
 	pub->command.details.pub.payloadlen = payloadlen;
@@ -2896,6 +3254,17 @@ MQTTPacket* MQTTAsync_cycle(int* sock, unsigned long timeout, int* rc)
 				if (m)
 				{
 					ListElement* current = NULL;
+
+					if (m->c->inflight.mode != INFLIGHT_NONE)
+					{
+						/* the window has room again */
+#if !defined(WIN32) && !defined(WIN64)
+						Thread_signal_cond(send_cond);
+#else
+						if (!Thread_check_sem(send_sem))
+							Thread_post_sem(send_sem);
+#endif
+					}
 					
 					if (m->dc)
 					{
@@ -2955,6 +3324,43 @@ int pubCompare(void* a, void* b)
 }
 
 
+int MQTTAsync_getInflightStats(MQTTAsync handle, MQTTAsync_inflightStats* stats)
+{
+	int rc = MQTTASYNC_SUCCESS;
+	MQTTAsyncs* m = handle;
+	MQTTInflight* w = NULL;
+
+	FUNC_ENTRY;
+	MQTTAsync_lock_mutex(mqttasync_mutex);
+
+	if (m == NULL || m->c == NULL || stats == NULL)
+	{
+		rc = MQTTASYNC_FAILURE;
+		goto exit;
+	}
+	if (strncmp(stats->struct_id, "MQIS", 4) != 0 || stats->struct_version != 0)
+	{
+		rc = MQTTASYNC_BAD_STRUCTURE;
+		goto exit;
+	}
+	w = &m->c->inflight;
+	stats->inflight = m->c->outboundMsgs->count;
+	stats->window = MQTTInflight_limit(w);
+	stats->rtt = (int)w->srtt;
+	stats->rttVariation = (int)w->rttvar;
+	stats->minRtt = (int)w->min_rtt;
+	stats->pacingRate = (w->mode == INFLIGHT_ADAPTIVE && w->interval > 0) ? (int)(1000000 / w->interval) : 0;
+	stats->acks = w->acks;
+	stats->losses = w->losses;
+	stats->delays = w->delays;
+
+exit:
+	MQTTAsync_unlock_mutex(mqttasync_mutex);
+	FUNC_EXIT_RC(rc);
+	return rc;
+}
+
+
 int MQTTAsync_getPendingTokens(MQTTAsync handle, MQTTAsync_token **tokens)
 {
 	int rc = MQTTASYNC_SUCCESS;
@@ -17,6 +17,8 @@
  *    Ian Craggs - MQTT 3.1.1 support
  *    Ian Craggs - fix for bug 444103 - success/failure callbacks not invoked
  *    Ian Craggs - automatic reconnect and offline buffering (send while disconnected)
+ *    priority lanes for queued commands
+ *    latest-value coalescing of queued publishes
  *******************************************************************************/
 
 /********************************************************************/
@@ -159,6 +161,16 @@
  * Return code: no more messages can be buffered
  */
 #define MQTTASYNC_MAX_BUFFERED_MESSAGES -12
+/**
+ * Return code: a queued publish was replaced by a later one to the same topic
+ * before it was sent, see MQTTAsync_responseOptions.coalesce
+ */
+#define MQTTASYNC_SUPERSEDED -13
+/**
+ * Return code: a publish was dropped by the application before it was queued,
+ * such as an event over its rate limit
+ */
+#define MQTTASYNC_DROPPED -14
 
 /**
  * Default MQTT version to connect with.  Use 3.1.1 then fall back to 3.1
@@ -402,11 +414,20 @@ typedef void MQTTAsync_onSuccess(void* context, MQTTAsync_successData* response)
  */
 typedef void MQTTAsync_onFailure(void* context,  MQTTAsync_failureData* response);
 
+/** Commands sent in order, the default */
+#define MQTTASYNC_PRIORITY_NORMAL 0
+/** Commands that go ahead of all others, such as device management replies */
+#define MQTTASYNC_PRIORITY_HIGH 1
+/** High volume publishes, such as telemetry, which share the connection with normal
+    priority commands rather than hold them up */
+#define MQTTASYNC_PRIORITY_BULK 2
+
 typedef struct
 {
 	/** The eyecatcher for this structure.  Must be MQTR */
 	char struct_id[4];
-	/** The version number of this structure.  Must be 0 */
+	/** The version number of this structure.  Must be 0, 1 or 2.
+	  * 0 signifies no priority, 1 no coalesce */
 	int struct_version;	
 	/** 
     * A pointer to a callback function to be called if the API call successfully
@@ -427,9 +448,26 @@ typedef struct
     */
 	void* context; 
 	MQTTAsync_token token;   /* output */
+	/**
+	  * The lane the publish, subscribe or unsubscribe is queued on:
+	  * ::MQTTASYNC_PRIORITY_HIGH commands are sent before any other,
+	  * ::MQTTASYNC_PRIORITY_NORMAL and ::MQTTASYNC_PRIORITY_BULK commands share
+	  * the connection in proportion to their weights.  Commands of one client on
+	  * the same lane are sent in the order they were queued.  Not persisted:
+	  * restored commands are normal priority.
+	  */
+	int priority;
+	/**
+	  * For state-style publishes, where only the latest value matters: if a
+	  * publish to the same topic, queued with coalesce set, is still waiting to be
+	  * sent, it is replaced in place by this one and never sent.  The replaced
+	  * publish completes with ::MQTTASYNC_SUPERSEDED.  Not persisted: restored
+	  * publishes are not replaced.
+	  */
+	int coalesce;
 } MQTTAsync_responseOptions;
 
-#define MQTTAsync_responseOptions_initializer { {'M', 'Q', 'T', 'R'}, 0, NULL, NULL, 0, 0 }
+#define MQTTAsync_responseOptions_initializer { {'M', 'Q', 'T', 'R'}, 2, NULL, NULL, 0, 0, MQTTASYNC_PRIORITY_NORMAL, 0 }
 
 
 /**
@@ -523,13 +561,25 @@ DLLExport int MQTTAsync_reconnect(MQTTAsync handle);
  * implementation. Using this type of persistence gives control of the 
  * persistence mechanism to the application. The application has to implement
  * the MQTTClient_persistence interface.
+ * <br>
+ * ::MQTTCLIENT_PERSISTENCE_LOG: Like ::MQTTCLIENT_PERSISTENCE_DEFAULT, but
+ * in-flight messages are appended to memory mapped segment files instead of
+ * being written to a file each, and synced in groups.
+ * <br>
+ * ::MQTTCLIENT_PERSISTENCE_MEMORY: In-flight messages are kept in memory and
+ * written to a snapshot file periodically, so a crash loses the messages of
+ * the last interval.
  * @param persistence_context If the application uses 
  * ::MQTTCLIENT_PERSISTENCE_NONE persistence, this argument is unused and should
- * be set to NULL. For ::MQTTCLIENT_PERSISTENCE_DEFAULT persistence, it
+ * be set to NULL. For ::MQTTCLIENT_PERSISTENCE_DEFAULT and
+ * ::MQTTCLIENT_PERSISTENCE_LOG persistence, it
  * should be set to the location of the persistence directory (if set 
  * to NULL, the persistence directory used is the working directory).
  * Applications that use ::MQTTCLIENT_PERSISTENCE_USER persistence set this
  * argument to point to a valid MQTTClient_persistence structure.
+ * Applications that use ::MQTTCLIENT_PERSISTENCE_MEMORY persistence set it
+ * to point to an MQTTClient_memoryPersistenceOptions structure, or to NULL
+ * for the defaults.
  * @return ::MQTTASYNC_SUCCESS if the client is successfully created, otherwise
  * an error code is returned.
  */
@@ -691,6 +741,7 @@ typedef struct
 	int cleansession;
 	/** 
       * This controls how many messages can be in-flight simultaneously. 
+      * It is only enforced when <i>inflightControl</i> is set.
 	  */
 	int maxInflight;		
 	/** 
@@ -774,11 +825,25 @@ typedef struct
 	  * Maximum retry interval in seconds.  The doubling stops here on failed retries.
 	  */
 	int maxRetryInterval;
+	/**
+	  * How the number of QoS 1 and 2 messages in flight is limited, struct_version 5 on:
+	  * ::MQTTASYNC_INFLIGHT_NONE (0) = no limit, <i>maxInflight</i> is ignored
+	  * ::MQTTASYNC_INFLIGHT_FIXED (1) = at most <i>maxInflight</i>
+	  * ::MQTTASYNC_INFLIGHT_ADAPTIVE (2) = a window between 1 and <i>maxInflight</i>,
+	  * grown while the PUBACK round trip time stays low and cut when it rises or a
+	  * message has to be retried.  Publishes are paced over the round trip rather than
+	  * sent in bursts.  See MQTTAsync_getInflightStats().
+	  */
+	int inflightControl;
 } MQTTAsync_connectOptions;
 
 
-#define MQTTAsync_connectOptions_initializer { {'M', 'Q', 'T', 'C'}, 4, 60, 1, 10, NULL, NULL, NULL, 30, 0,\
-NULL, NULL, NULL, NULL, 0, NULL, 0, 0, 1, 60}
+#define MQTTASYNC_INFLIGHT_NONE 0
+#define MQTTASYNC_INFLIGHT_FIXED 1
+#define MQTTASYNC_INFLIGHT_ADAPTIVE 2
+
+#define MQTTAsync_connectOptions_initializer { {'M', 'Q', 'T', 'C'}, 5, 60, 1, 10, NULL, NULL, NULL, 30, 0,\
+NULL, NULL, NULL, NULL, 0, NULL, 0, 0, 1, 60, MQTTASYNC_INFLIGHT_NONE}
 
 /**
   * This function attempts to connect a previously-created client (see
@@ -993,6 +1058,48 @@ DLLExport int MQTTAsync_sendMessage(MQTTAsync handle, const char* destinationNam
   */
 DLLExport int MQTTAsync_getPendingTokens(MQTTAsync handle, MQTTAsync_token **tokens);
 
+/**
+ * The state of the in-flight window of a client, see <i>inflightControl</i> in
+ * ::MQTTAsync_connectOptions.  Times are in microseconds.
+ */
+typedef struct
+{
+	/** The eyecatcher for this structure.  must be MQIS. */
+	char struct_id[4];
+	/** The version number of this structure.  Must be 0 */
+	int struct_version;
+	/** QoS 1 and 2 messages in flight */
+	int inflight;
+	/** Messages allowed in flight, 0 for no limit */
+	int window;
+	/** Smoothed PUBACK round trip time */
+	int rtt;
+	/** Variation of the round trip time */
+	int rttVariation;
+	/** Lowest recent round trip time */
+	int minRtt;
+	/** Publishes per second the pacing allows, 0 when not paced */
+	int pacingRate;
+	/** Round trip samples taken */
+	unsigned int acks;
+	/** Window cuts for retried messages */
+	unsigned int losses;
+	/** Window cuts for rising round trip times */
+	unsigned int delays;
+} MQTTAsync_inflightStats;
+
+#define MQTTAsync_inflightStats_initializer { {'M', 'Q', 'I', 'S'}, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0 }
+
+/**
+  * This function reports the in-flight window, round trip time estimate and pacing
+  * rate of a client.
+  * @param handle A valid client handle from a successful call to
+  * MQTTAsync_create().
+  * @param stats A pointer to an ::MQTTAsync_inflightStats structure to fill in.
+  * @return ::MQTTASYNC_SUCCESS if the function returns successfully.
+  */
+DLLExport int MQTTAsync_getInflightStats(MQTTAsync handle, MQTTAsync_inflightStats* stats);
+
 /**
  * Tests whether a request corresponding to a token is complete.
  *
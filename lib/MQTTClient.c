@@ -328,9 +328,13 @@ int MQTTClient_create(MQTTClient* handle, const char* serverURI, const char* cli
 	rc = MQTTPersistence_create(&(m->c->persistence), persistence_type, persistence_context);
 	if (rc == 0)
 	{
-		rc = MQTTPersistence_initialize(m->c, m->serverURI);
+		MQTTPersistence_key* keys = NULL;
+		int nkeys = 0;
+
+		rc = MQTTPersistence_initialize(m->c, m->serverURI, &keys, &nkeys);
 		if (rc == 0)
-			MQTTPersistence_restoreMessageQueue(m->c);
+			MQTTPersistence_restoreMessageQueue(m->c, keys, nkeys);
+		MQTTPersistence_freeKeys(keys, nkeys);
 	}
 #endif
 	ListAppend(bstate->clients, m->c, sizeof(Clients) + 3*sizeof(List));
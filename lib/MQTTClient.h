@@ -398,13 +398,25 @@ DLLExport int MQTTClient_setCallbacks(MQTTClient handle, void* context, MQTTClie
  * implementation. Using this type of persistence gives control of the 
  * persistence mechanism to the application. The application has to implement
  * the MQTTClient_persistence interface.
+ * <br>
+ * ::MQTTCLIENT_PERSISTENCE_LOG: Like ::MQTTCLIENT_PERSISTENCE_DEFAULT, but
+ * in-flight messages are appended to memory mapped segment files instead of
+ * being written to a file each, and synced in groups.
+ * <br>
+ * ::MQTTCLIENT_PERSISTENCE_MEMORY: In-flight messages are kept in memory and
+ * written to a snapshot file periodically, so a crash loses the messages of
+ * the last interval.
  * @param persistence_context If the application uses 
  * ::MQTTCLIENT_PERSISTENCE_NONE persistence, this argument is unused and should
- * be set to NULL. For ::MQTTCLIENT_PERSISTENCE_DEFAULT persistence, it
+ * be set to NULL. For ::MQTTCLIENT_PERSISTENCE_DEFAULT and
+ * ::MQTTCLIENT_PERSISTENCE_LOG persistence, it
  * should be set to the location of the persistence directory (if set 
  * to NULL, the persistence directory used is the working directory).
  * Applications that use ::MQTTCLIENT_PERSISTENCE_USER persistence set this
  * argument to point to a valid MQTTClient_persistence structure.
+ * Applications that use ::MQTTCLIENT_PERSISTENCE_MEMORY persistence set it
+ * to point to an MQTTClient_memoryPersistenceOptions structure, or to NULL
+ * for the defaults.
  * @return ::MQTTCLIENT_SUCCESS if the client is successfully created, otherwise
  * an error code is returned.
  */
@@ -73,6 +73,16 @@
   * persistence mechanism (see MQTTClient_create()).
   */
 #define MQTTCLIENT_PERSISTENCE_USER 2
+/**
+  * This <i>persistence_type</i> value specifies the log-structured file
+  * system-based persistence mechanism (see MQTTClient_create()).
+  */
+#define MQTTCLIENT_PERSISTENCE_LOG 3
+/**
+  * This <i>persistence_type</i> value specifies the in-memory persistence
+  * mechanism, written out to a snapshot file periodically (see MQTTClient_create()).
+  */
+#define MQTTCLIENT_PERSISTENCE_MEMORY 4
 
 /** 
   * Application-specific persistence functions must return this error code if 
@@ -247,4 +257,25 @@ typedef struct {
 	Persistence_containskey pcontainskey;
 } MQTTClient_persistence;
 
+/**
+  * @brief The <i>persistence_context</i> of ::MQTTCLIENT_PERSISTENCE_MEMORY.
+  *
+  * The messages in flight are kept in memory, and the changes to them are
+  * written to a file every <i>interval</i> milliseconds.  If the process dies,
+  * the changes made since the last write are lost.
+  */
+typedef struct
+{
+	/** The eyecatcher for this structure.  must be MQMP */
+	char struct_id[4];
+	/** The version number of this structure.  Must be 0 */
+	int struct_version;
+	/** The directory holding the snapshot file, NULL for the working directory */
+	const char* directory;
+	/** Milliseconds between writes to the snapshot file, 0 to write it only on close */
+	int interval;
+} MQTTClient_memoryPersistenceOptions;
+
+#define MQTTClient_memoryPersistenceOptions_initializer { {'M', 'Q', 'M', 'P'}, 0, NULL, 1000 }
+
 #endif
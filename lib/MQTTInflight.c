@@ -0,0 +1,251 @@
+/*******************************************************************************
+ * Copyright (c) 2017 IBM Corp.
+ *
+ * All rights reserved. This program and the accompanying materials
+ * are made available under the terms of the Eclipse Public License v1.0
+ * and Eclipse Distribution License v1.0 which accompany this distribution.
+ *
+ * The Eclipse Public License is available at
+ *    http://www.eclipse.org/legal/epl-v10.html
+ * and the Eclipse Distribution License is available at
+ *   http://www.eclipse.org/org/documents/edl-v10.php.
+ *
+ * Contributors:
+ *    adaptive in-flight window and publish pacing - initial implementation
+ *******************************************************************************/
+
+/**
+ * @file
+ * \brief In-flight window for QoS 1 and 2 publishes
+ *
+ * The adaptive window is AIMD, as TCP's is.  It doubles every round trip up to ssthresh,
+ * then grows by one message per round trip.  It is cut by INFLIGHT_LOSS_BETA when a message
+ * has to be retried, and by INFLIGHT_DELAY_BETA when an acknowledgement takes long enough
+ * that a queue must be building up on the path: longer than the lowest recent round trip
+ * plus twice the round trip variation, bounded to between a half and twice that round trip.
+ * A jittery cellular link so tolerates more delay than a steady one before backing off.
+ * Either cut happens at most once a round trip.
+ *
+ * Publishes are spread over the round trip at INFLIGHT_PACING_GAIN times window / srtt
+ * rather than sent in bursts when acknowledgements free the window.
+ */
+
+#include "MQTTInflight.h"
+#include "StackTrace.h"
+
+#if defined(WIN32) || defined(WIN64)
+#include <windows.h>
+#else
+#include <time.h>
+#endif
+
+#include "Heap.h"
+
+
+/**
+ * Monotonic time in microseconds
+ */
+int64_t MQTTInflight_now(void)
+{
+#if defined(WIN32) || defined(WIN64)
+	static LARGE_INTEGER frequency;
+	LARGE_INTEGER count;
+
+	if (frequency.QuadPart == 0)
+		QueryPerformanceFrequency(&frequency);
+	QueryPerformanceCounter(&count);
+	return (int64_t)(count.QuadPart * 1000000.0 / frequency.QuadPart);
+#else
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+#endif
+}
+
+
+/**
+ * Set up the flow control of a client on connect.
+ * @param w the flow control state
+ * @param mode INFLIGHT_NONE, INFLIGHT_FIXED or INFLIGHT_ADAPTIVE
+ * @param max the largest window, the maxInflight connect option
+ */
+void MQTTInflight_init(MQTTInflight* w, int mode, int max)
+{
+	FUNC_ENTRY;
+	w->mode = mode;
+	w->max = (max > 0) ? max : 1;
+	MQTTInflight_restart(w);
+	FUNC_EXIT;
+}
+
+
+/**
+ * Start measuring afresh, when a new connection is made: the path may have changed.
+ * @param w the flow control state
+ */
+void MQTTInflight_restart(MQTTInflight* w)
+{
+	FUNC_ENTRY;
+	if (w->mode == INFLIGHT_ADAPTIVE)
+		w->window = (w->max < INFLIGHT_INITIAL_WINDOW) ? w->max : INFLIGHT_INITIAL_WINDOW;
+	else
+		w->window = w->max;
+	w->ssthresh = w->max;
+	w->srtt = w->rttvar = w->min_rtt = w->min_rtt_stamp = 0;
+	w->recover_until = w->interval = w->next_send = 0;
+	FUNC_EXIT;
+}
+
+
+/**
+ * The number of messages allowed in flight now
+ * @param w the flow control state
+ * @return the window, or 0 for no limit
+ */
+int MQTTInflight_limit(MQTTInflight* w)
+{
+	if (w->mode == INFLIGHT_NONE)
+		return 0;
+	return (w->window < 1) ? 1 : (int)w->window;
+}
+
+
+/**
+ * Whether the next QoS 1 or 2 publish can be sent.
+ * @param w the flow control state
+ * @param inflight the number of messages in flight
+ * @param now the current time
+ * @return 0 to send now, -1 if the window is full, or the microseconds to wait for pacing
+ */
+int64_t MQTTInflight_wait(MQTTInflight* w, int inflight, int64_t now)
+{
+	if (w->mode == INFLIGHT_NONE)
+		return 0;
+	if (inflight >= MQTTInflight_limit(w))
+		return -1;
+	if (w->interval > 0 && now < w->next_send)
+		return w->next_send - now;
+	return 0;
+}
+
+
+/**
+ * Record the sending of a publish, for pacing.
+ * @param w the flow control state
+ * @param now the current time
+ */
+void MQTTInflight_sent(MQTTInflight* w, int64_t now)
+{
+	if (w->interval > 0)
+	{
+		/* little credit is built up while idle, so there is no burst after a pause */
+		int64_t slack = (w->interval > INFLIGHT_PACING_SLACK) ? w->interval : INFLIGHT_PACING_SLACK;
+
+		if (w->next_send < now - slack)
+			w->next_send = now - slack;
+		w->next_send += w->interval;
+	}
+}
+
+
+static void MQTTInflight_pace(MQTTInflight* w)
+{
+	if (w->srtt > 0)
+		w->interval = (int64_t)(w->srtt / (w->window * INFLIGHT_PACING_GAIN));
+}
+
+
+static void MQTTInflight_decrease(MQTTInflight* w, double beta, int64_t now)
+{
+	w->window *= beta;
+	if (w->window < 1)
+		w->window = 1;
+	w->ssthresh = w->window;
+	w->recover_until = now + w->srtt;
+	MQTTInflight_pace(w);
+}
+
+
+/**
+ * Take a round trip sample from an acknowledgement, and grow or cut the window.
+ * @param w the flow control state
+ * @param sent when the message was sent, or 0 if it was retried, which gives no sample
+ * @param now the current time
+ */
+void MQTTInflight_acked(MQTTInflight* w, int64_t sent, int64_t now)
+{
+	int64_t rtt, target;
+
+	FUNC_ENTRY;
+	if (w->mode != INFLIGHT_ADAPTIVE || sent == 0)
+		goto exit;
+	rtt = now - sent;
+	if (rtt <= 0)
+		rtt = 1;
+	++w->acks;
+
+	/* RFC 6298 estimators */
+	if (w->srtt == 0)
+	{
+		w->srtt = rtt;
+		w->rttvar = rtt / 2;
+	}
+	else
+	{
+		int64_t delta = (w->srtt > rtt) ? w->srtt - rtt : rtt - w->srtt;
+
+		w->rttvar = (3 * w->rttvar + delta) / 4;
+		w->srtt = (7 * w->srtt + rtt) / 8;
+	}
+	if (w->min_rtt == 0 || rtt <= w->min_rtt || now - w->min_rtt_stamp > INFLIGHT_MIN_RTT_LIFETIME)
+	{
+		w->min_rtt = rtt;
+		w->min_rtt_stamp = now;
+	}
+
+	target = 2 * w->rttvar;
+	if (target < w->min_rtt / 2)
+		target = w->min_rtt / 2;
+	else if (target > 2 * w->min_rtt)
+		target = 2 * w->min_rtt;
+	target += w->min_rtt;
+
+	if (rtt > target)
+	{
+		if (now >= w->recover_until)
+		{
+			++w->delays;
+			MQTTInflight_decrease(w, INFLIGHT_DELAY_BETA, now);
+		}
+	}
+	else
+	{
+		if (w->window < w->ssthresh)
+			w->window += 1;
+		else
+			w->window += 1 / w->window;
+		if (w->window > w->max)
+			w->window = w->max;
+		MQTTInflight_pace(w);
+	}
+exit:
+	FUNC_EXIT;
+}
+
+
+/**
+ * Cut the window for a message that had to be sent again.
+ * @param w the flow control state
+ * @param now the current time
+ */
+void MQTTInflight_lost(MQTTInflight* w, int64_t now)
+{
+	FUNC_ENTRY;
+	if (w->mode == INFLIGHT_ADAPTIVE && now >= w->recover_until)
+	{
+		++w->losses;
+		MQTTInflight_decrease(w, INFLIGHT_LOSS_BETA, now);
+	}
+	FUNC_EXIT;
+}
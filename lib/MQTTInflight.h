@@ -0,0 +1,73 @@
+/*******************************************************************************
+ * Copyright (c) 2017 IBM Corp.
+ *
+ * All rights reserved. This program and the accompanying materials
+ * are made available under the terms of the Eclipse Public License v1.0
+ * and Eclipse Distribution License v1.0 which accompany this distribution.
+ *
+ * The Eclipse Public License is available at
+ *    http://www.eclipse.org/legal/epl-v10.html
+ * and the Eclipse Distribution License is available at
+ *   http://www.eclipse.org/org/documents/edl-v10.php.
+ *
+ * Contributors:
+ *    adaptive in-flight window and publish pacing - initial implementation
+ *******************************************************************************/
+
+#if !defined(MQTTINFLIGHT_H)
+#define MQTTINFLIGHT_H
+
+#include <stdint.h>
+
+/** maxInflight is not enforced, as before */
+#define INFLIGHT_NONE 0
+/** at most maxInflight QoS 1 and 2 messages in flight */
+#define INFLIGHT_FIXED 1
+/** a window between 1 and maxInflight, sized from the acknowledgement round trip time */
+#define INFLIGHT_ADAPTIVE 2
+
+/** Window an adaptive client starts with, before any round trip is measured */
+#define INFLIGHT_INITIAL_WINDOW 4
+/** Publishes are paced at this multiple of window / round trip time, so the window can fill */
+#define INFLIGHT_PACING_GAIN 1.25
+/** Window kept after a retry, which means a message was lost */
+#define INFLIGHT_LOSS_BETA 0.5
+/** Window kept after a round trip long enough to mean a queue is building up */
+#define INFLIGHT_DELAY_BETA 0.7
+/** Microseconds of pacing credit kept while publishes are held up, so sleeps of a millisecond
+    do not cap the rate */
+#define INFLIGHT_PACING_SLACK 2000
+/** Microseconds for which the lowest round trip time is kept, so a path change is picked up */
+#define INFLIGHT_MIN_RTT_LIFETIME 10000000
+
+/**
+ * Flow control state of one client.  Times are in microseconds from MQTTInflight_now.
+ */
+typedef struct
+{
+	int mode;				/**< INFLIGHT_NONE, _FIXED or _ADAPTIVE */
+	int max;				/**< the maxInflight connect option */
+	double window;			/**< messages allowed in flight */
+	double ssthresh;		/**< window up to which it doubles each round trip */
+	int64_t srtt;			/**< smoothed round trip time */
+	int64_t rttvar;			/**< round trip time variation */
+	int64_t min_rtt;		/**< lowest recent round trip time, the path without queueing */
+	int64_t min_rtt_stamp;	/**< when min_rtt was measured */
+	int64_t recover_until;	/**< the window is not decreased again before this */
+	int64_t interval;		/**< pacing interval between publishes, 0 for none */
+	int64_t next_send;		/**< earliest time of the next publish */
+	unsigned int acks;		/**< round trip samples taken */
+	unsigned int losses;	/**< decreases for lost messages */
+	unsigned int delays;	/**< decreases for queueing delay */
+} MQTTInflight;
+
+int64_t MQTTInflight_now(void);
+void MQTTInflight_init(MQTTInflight* w, int mode, int max);
+void MQTTInflight_restart(MQTTInflight* w);
+int MQTTInflight_limit(MQTTInflight* w);
+int64_t MQTTInflight_wait(MQTTInflight* w, int inflight, int64_t now);
+void MQTTInflight_sent(MQTTInflight* w, int64_t now);
+void MQTTInflight_acked(MQTTInflight* w, int64_t sent, int64_t now);
+void MQTTInflight_lost(MQTTInflight* w, int64_t now);
+
+#endif
@@ -14,6 +14,9 @@
  *    Ian Craggs - initial API and implementation and/or initial documentation
  *    Ian Craggs - async client updates
  *    Ian Craggs - fix for bug 432903 - queue persistence
+ *    log-structured persistence type
+ *    restore from a sorted key set instead of ordered inserts
+ *    in-memory persistence type
  *******************************************************************************/
 
 /**
@@ -23,10 +26,13 @@
  */
 
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 
 #include "MQTTPersistence.h"
 #include "MQTTPersistenceDefault.h"
+#include "MQTTPersistenceLog.h"
+#include "MQTTPersistenceMemory.h"
 #include "MQTTProtocolClient.h"
 #include "Heap.h"
 
@@ -76,6 +82,65 @@ int MQTTPersistence_create(MQTTClient_persistence** persistence, int type, void*
 			else
 				rc = MQTTCLIENT_PERSISTENCE_ERROR;
 			break;
+#if !defined(WIN32) && !defined(WIN64)
+		case MQTTCLIENT_PERSISTENCE_LOG :
+			per = malloc(sizeof(MQTTClient_persistence));
+			if ( per != NULL )
+			{
+				if ( pcontext != NULL )
+				{
+					per->context = malloc(strlen(pcontext) + 1);
+					strcpy(per->context, pcontext);
+				}
+				else
+					per->context = ".";  /* working directory */
+				/* segment log functions */
+				per->popen        = plogopen;
+				per->pclose       = plogclose;
+				per->pput         = plogput;
+				per->pget         = plogget;
+				per->premove      = plogremove;
+				per->pkeys        = plogkeys;
+				per->pclear       = plogclear;
+				per->pcontainskey = plogcontainskey;
+			}
+			else
+				rc = MQTTCLIENT_PERSISTENCE_ERROR;
+			break;
+		case MQTTCLIENT_PERSISTENCE_MEMORY :
+			if ( pcontext != NULL && memcmp(((MQTTClient_memoryPersistenceOptions*)pcontext)->struct_id, "MQMP", 4) != 0 )
+			{
+				rc = MQTTCLIENT_PERSISTENCE_ERROR;
+				break;
+			}
+			per = malloc(sizeof(MQTTClient_persistence));
+			if ( per != NULL )
+			{
+				MQTTClient_memoryPersistenceOptions initial = MQTTClient_memoryPersistenceOptions_initializer;
+				MQTTClient_memoryPersistenceOptions* options = malloc(sizeof(MQTTClient_memoryPersistenceOptions));
+
+				*options = (pcontext != NULL) ? *(MQTTClient_memoryPersistenceOptions*)pcontext : initial;
+				if ( options->directory != NULL )
+				{
+					char* directory = malloc(strlen(options->directory) + 1);
+					strcpy(directory, options->directory);
+					options->directory = directory;
+				}
+				per->context = options;
+				/* hash table functions */
+				per->popen        = pmemopen;
+				per->pclose       = pmemclose;
+				per->pput         = pmemput;
+				per->pget         = pmemget;
+				per->premove      = pmemremove;
+				per->pkeys        = pmemkeys;
+				per->pclear       = pmemclear;
+				per->pcontainskey = pmemcontainskey;
+			}
+			else
+				rc = MQTTCLIENT_PERSISTENCE_ERROR;
+			break;
+#endif
 		case MQTTCLIENT_PERSISTENCE_USER :
 			per = (MQTTClient_persistence *)pcontext;
 			if ( per == NULL || (per != NULL && (per->context == NULL || per->pclear == NULL ||
@@ -100,18 +165,37 @@ int MQTTPersistence_create(MQTTClient_persistence** persistence, int type, void*
  * Open persistent store and restore any persisted messages.
  * @param client the client as ::Clients.
  * @param serverURI the URI of the remote end.
+ * @param keys if not NULL, returns the sorted keys of the store for the caller's own restores,
+ * to be freed with MQTTPersistence_freeKeys.
+ * @param nkeys returns the number of keys.
  * @return 0 if success, #MQTTCLIENT_PERSISTENCE_ERROR otherwise.
  */
-int MQTTPersistence_initialize(Clients *c, const char *serverURI)
+int MQTTPersistence_initialize(Clients *c, const char *serverURI, MQTTPersistence_key** keys, int* nkeys)
 {
 	int rc = 0;
+	MQTTPersistence_key* msgkeys = NULL;
+	int nmsgkeys = 0;
 
 	FUNC_ENTRY;
+	if (keys)
+	{
+		*keys = NULL;
+		*nkeys = 0;
+	}
 	if ( c->persistence != NULL )
 	{
 		rc = c->persistence->popen(&(c->phandle), c->clientID, serverURI, c->persistence->context);
-		if ( rc == 0 )
-			rc = MQTTPersistence_restore(c);
+		if ( rc == 0 && (rc = MQTTPersistence_keys(c, &msgkeys, &nmsgkeys)) == 0 )
+		{
+			rc = MQTTPersistence_restore(c, msgkeys, nmsgkeys);
+			if (keys)
+			{
+				*keys = msgkeys;
+				*nkeys = nmsgkeys;
+			}
+			else
+				MQTTPersistence_freeKeys(msgkeys, nmsgkeys);
+		}
 	}
 
 	FUNC_EXIT_RC(rc);
@@ -131,11 +215,26 @@ int MQTTPersistence_close(Clients *c)
 	FUNC_ENTRY;
 	if (c->persistence != NULL)
 	{
+		Persistence_open opener = c->persistence->popen;
+
 		rc = c->persistence->pclose(c->phandle);
 		c->phandle = NULL;
 #if !defined(NO_PERSISTENCE)
-		if ( c->persistence->popen == pstopen )
+		if ( opener == pstopen )
+			free(c->persistence);
+#if !defined(WIN32) && !defined(WIN64)
+		else if ( opener == plogopen )
+			free(c->persistence);
+		else if ( opener == pmemopen )
+		{
+			MQTTClient_memoryPersistenceOptions* options = c->persistence->context;
+
+			if ( options->directory != NULL )
+				free((char*)options->directory);
+			free(options);
 			free(c->persistence);
+		}
+#endif
 #endif
 		c->persistence = NULL;
 	}
@@ -166,33 +265,36 @@ int MQTTPersistence_clear(Clients *c)
  * Restores the persisted records to the outbound and inbound message queues of the
  * client.
  * @param client the client as ::Clients.
+ * @param keys the keys of the store, as returned by MQTTPersistence_keys.
+ * @param nkeys the number of keys.
  * @return 0 if success, #MQTTCLIENT_PERSISTENCE_ERROR otherwise.
  */
-int MQTTPersistence_restore(Clients *c)
+int MQTTPersistence_restore(Clients *c, MQTTPersistence_key* keys, int nkeys)
 {
 	int rc = 0;
-	char **msgkeys = NULL,
-		 *buffer = NULL;
-	int nkeys, buflen;
+	char *buffer = NULL;
+	int buflen;
 	int i = 0;
 	int msgs_sent = 0;
 	int msgs_rcvd = 0;
 
 	FUNC_ENTRY;
-	if (c->persistence && (rc = c->persistence->pkeys(c->phandle, &msgkeys, &nkeys)) == 0)
+	if (c->persistence)
 	{
 		while (rc == 0 && i < nkeys)
 		{
-			if (strncmp(msgkeys[i], PERSISTENCE_COMMAND_KEY, strlen(PERSISTENCE_COMMAND_KEY)) == 0)
+			char* msgkey = keys[i].key;
+
+			if (strncmp(msgkey, PERSISTENCE_COMMAND_KEY, strlen(PERSISTENCE_COMMAND_KEY)) == 0)
 				;
-			else if (strncmp(msgkeys[i], PERSISTENCE_QUEUE_KEY, strlen(PERSISTENCE_QUEUE_KEY)) == 0)
+			else if (strncmp(msgkey, PERSISTENCE_QUEUE_KEY, strlen(PERSISTENCE_QUEUE_KEY)) == 0)
 				;
-			else if ((rc = c->persistence->pget(c->phandle, msgkeys[i], &buffer, &buflen)) == 0)
+			else if ((rc = c->persistence->pget(c->phandle, msgkey, &buffer, &buflen)) == 0)
 			{
 				MQTTPacket* pack = MQTTPersistence_restorePacket(buffer, buflen);
 				if ( pack != NULL )
 				{
-					if ( strstr(msgkeys[i],PERSISTENCE_PUBLISH_RECEIVED) != NULL )
+					if ( strstr(msgkey,PERSISTENCE_PUBLISH_RECEIVED) != NULL )
 					{
 						Publish* publish = (Publish*)pack;
 						Messages* msg = NULL;
@@ -204,51 +306,42 @@ int MQTTPersistence_restore(Clients *c)
 						MQTTPacket_freePublish(publish);
 						msgs_rcvd++;
 					}
-					else if ( strstr(msgkeys[i],PERSISTENCE_PUBLISH_SENT) != NULL )
+					else if ( strstr(msgkey,PERSISTENCE_PUBLISH_SENT) != NULL )
 					{
 						Publish* publish = (Publish*)pack;
 						Messages* msg = NULL;
-						char *key = malloc(MESSAGE_FILENAME_LENGTH + 1);
-						sprintf(key, "%s%d", PERSISTENCE_PUBREL, publish->msgId);
 						msg = MQTTProtocol_createMessage(publish, &msg, publish->header.bits.qos, publish->header.bits.retain);
-						if ( c->persistence->pcontainskey(c->phandle, key) == 0 )
+						if ( MQTTPersistence_findKey(keys, nkeys, PERSISTENCE_PUBREL, publish->msgId) )
 							/* PUBLISH Qo2 and PUBREL sent */
 							msg->nextMessageType = PUBCOMP;
 						/* else: PUBLISH QoS1, or PUBLISH QoS2 and PUBREL not sent */
 						/* retry at the first opportunity */
 						msg->lastTouch = 0;
-						MQTTPersistence_insertInOrder(c->outboundMsgs, msg, msg->len);
+						/* the keys are in message ID order, so appending keeps the list ordered */
+						ListAppend(c->outboundMsgs, msg, msg->len);
 						publish->topic = NULL;
 						MQTTPacket_freePublish(publish);
-						free(key);
 						msgs_sent++;
 					}
-					else if ( strstr(msgkeys[i],PERSISTENCE_PUBREL) != NULL )
+					else if ( strstr(msgkey,PERSISTENCE_PUBREL) != NULL )
 					{
 						/* orphaned PUBRELs ? */
 						Pubrel* pubrel = (Pubrel*)pack;
-						char *key = malloc(MESSAGE_FILENAME_LENGTH + 1);
-						sprintf(key, "%s%d", PERSISTENCE_PUBLISH_SENT, pubrel->msgId);
-						if ( c->persistence->pcontainskey(c->phandle, key) != 0 )
-							rc = c->persistence->premove(c->phandle, msgkeys[i]);
+						if ( !MQTTPersistence_findKey(keys, nkeys, PERSISTENCE_PUBLISH_SENT, pubrel->msgId) )
+							rc = c->persistence->premove(c->phandle, msgkey);
 						free(pubrel);
-						free(key);
 					}
 				}
 				else  /* pack == NULL -> bad persisted record */
-					rc = c->persistence->premove(c->phandle, msgkeys[i]);
+					rc = c->persistence->premove(c->phandle, msgkey);
 			}
 			if (buffer)
 			{
 				free(buffer);
 				buffer = NULL;
 			}
-			if (msgkeys[i])
-				free(msgkeys[i]);
 			i++;
 		}
-		if (msgkeys)
-			free(msgkeys);
 	}
 	Log(TRACE_MINIMUM, -1, "%d sent messages and %d received messages restored for client %s\n", 
 		msgs_sent, msgs_rcvd, c->clientID);
@@ -319,6 +412,88 @@ void MQTTPersistence_insertInOrder(List* list, void* content, size_t size)
 }
 
 
+static int MQTTPersistence_compareKeys(const void* a, const void* b)
+{
+	const MQTTPersistence_key* ka = (const MQTTPersistence_key*)a;
+	const MQTTPersistence_key* kb = (const MQTTPersistence_key*)b;
+	int rc = memcmp(ka->key, kb->key, (ka->stemlen < kb->stemlen) ? ka->stemlen : kb->stemlen);
+
+	if (rc == 0)
+		rc = ka->stemlen - kb->stemlen;
+	if (rc == 0)
+		rc = (ka->number < kb->number) ? -1 : (ka->number > kb->number);
+	return rc;
+}
+
+
+/**
+ * Gets the keys of all the records in the persistent store, sorted by stem and then by the
+ * message ID or sequence number that follows the stem.  Restoring in this order lets the
+ * queues be built by appending, rather than by an ordered insert for each record.
+ * @param c the client as ::Clients.
+ * @param keys returns the array of keys, to be freed with MQTTPersistence_freeKeys.
+ * @param nkeys returns the number of keys.
+ * @return 0 if success, #MQTTCLIENT_PERSISTENCE_ERROR otherwise.
+ */
+int MQTTPersistence_keys(Clients* c, MQTTPersistence_key** keys, int* nkeys)
+{
+	int rc = 0;
+	char** msgkeys = NULL;
+	int i;
+
+	FUNC_ENTRY;
+	*keys = NULL;
+	*nkeys = 0;
+	if ((rc = c->persistence->pkeys(c->phandle, &msgkeys, nkeys)) == 0 && *nkeys > 0)
+	{
+		*keys = malloc(*nkeys * sizeof(MQTTPersistence_key));
+		for (i = 0; i < *nkeys; ++i)
+		{
+			(*keys)[i].key = msgkeys[i];
+			(*keys)[i].stemlen = (int)strcspn(msgkeys[i], "0123456789");
+			(*keys)[i].number = atoi(msgkeys[i] + (*keys)[i].stemlen);
+		}
+		qsort(*keys, *nkeys, sizeof(MQTTPersistence_key), MQTTPersistence_compareKeys);
+	}
+	if (msgkeys)
+		free(msgkeys);
+
+	FUNC_EXIT_RC(rc);
+	return rc;
+}
+
+
+/**
+ * Looks up a key in a sorted key set, without going back to the persistent store.
+ * @param keys the keys, as returned by MQTTPersistence_keys.
+ * @param nkeys the number of keys.
+ * @param stem the stem of the key, such as #PERSISTENCE_PUBREL.
+ * @param number the message ID or sequence number following the stem.
+ * @return 1 if the key is in the set, 0 otherwise.
+ */
+int MQTTPersistence_findKey(MQTTPersistence_key* keys, int nkeys, const char* stem, int number)
+{
+	MQTTPersistence_key target;
+
+	target.key = (char*)stem;
+	target.stemlen = (int)strlen(stem);
+	target.number = number;
+	return nkeys > 0 &&
+		bsearch(&target, keys, nkeys, sizeof(MQTTPersistence_key), MQTTPersistence_compareKeys) != NULL;
+}
+
+
+void MQTTPersistence_freeKeys(MQTTPersistence_key* keys, int nkeys)
+{
+	int i;
+
+	for (i = 0; i < nkeys; ++i)
+		free(keys[i].key);
+	if (keys)
+		free(keys);
+}
+
+
 /**
  * Adds a record to the persistent store. This function must not be called for QoS0
  * messages.
@@ -577,64 +752,45 @@ MQTTPersistence_qEntry* MQTTPersistence_restoreQueueEntry(char* buffer, size_t b
 }
 
 
-void MQTTPersistence_insertInSeqOrder(List* list, MQTTPersistence_qEntry* qEntry, size_t size)
-{
-	ListElement* index = NULL;
-	ListElement* current = NULL;
-
-	FUNC_ENTRY;
-	while (ListNextElement(list, &current) != NULL && index == NULL)
-	{
-		if (qEntry->seqno < ((MQTTPersistence_qEntry*)current->content)->seqno)
-			index = current;
-	}
-	ListInsert(list, qEntry, size, index);
-	FUNC_EXIT;
-}
-
-
 /**
  * Restores a queue of messages from persistence to memory
  * @param c the client as ::Clients - the client object to restore the messages to
+ * @param keys the keys of the store, as returned by MQTTPersistence_keys.
+ * @param nkeys the number of keys.
  * @return return code, 0 if successful
  */
-int MQTTPersistence_restoreMessageQueue(Clients* c)
+int MQTTPersistence_restoreMessageQueue(Clients* c, MQTTPersistence_key* keys, int nkeys)
 {
 	int rc = 0;
-	char **msgkeys;
-	int nkeys;
 	int i = 0;
 	int entries_restored = 0;
 
 	FUNC_ENTRY;
-	if (c->persistence && (rc = c->persistence->pkeys(c->phandle, &msgkeys, &nkeys)) == 0)
+	if (c->persistence)
 	{
 		while (rc == 0 && i < nkeys)
 		{
 			char *buffer = NULL;
 			int buflen;
 					
-			if (strncmp(msgkeys[i], PERSISTENCE_QUEUE_KEY, strlen(PERSISTENCE_QUEUE_KEY)) != 0)
+			if (strncmp(keys[i].key, PERSISTENCE_QUEUE_KEY, strlen(PERSISTENCE_QUEUE_KEY)) != 0)
 				;
-			else if ((rc = c->persistence->pget(c->phandle, msgkeys[i], &buffer, &buflen)) == 0)
+			else if ((rc = c->persistence->pget(c->phandle, keys[i].key, &buffer, &buflen)) == 0)
 			{
 				MQTTPersistence_qEntry* qe = MQTTPersistence_restoreQueueEntry(buffer, buflen);
 				
 				if (qe)
 				{	
-					qe->seqno = atoi(msgkeys[i]+2);
-					MQTTPersistence_insertInSeqOrder(c->messageQueue, qe, sizeof(MQTTPersistence_qEntry));
+					qe->seqno = keys[i].number;
+					/* the keys are in sequence number order */
+					ListAppend(c->messageQueue, qe, sizeof(MQTTPersistence_qEntry));
 					free(buffer);
 					c->qentry_seqno = max(c->qentry_seqno, qe->seqno);
 					entries_restored++;
 				}
 			}
-			if (msgkeys[i])
-				free(msgkeys[i]);
 			i++;
 		}
-		if (msgkeys != NULL)
-			free(msgkeys);
 	}
 	Log(TRACE_MINIMUM, -1, "%d queued messages restored for client %s", entries_restored, c->clientID);
 	FUNC_EXIT_RC(rc);
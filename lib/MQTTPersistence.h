@@ -14,6 +14,7 @@
  *    Ian Craggs - initial API and implementation and/or initial documentation
  *    Ian Craggs - async client updates
  *    Ian Craggs - fix for bug 432903 - queue persistence
+ *    sorted key sets for restore
  *******************************************************************************/
 
 #if defined(__cplusplus)
@@ -32,19 +33,31 @@
 #define PERSISTENCE_COMMAND_KEY "c-"
 /** Stem of the key for an async client message queue */
 #define PERSISTENCE_QUEUE_KEY "q-"
-#define PERSISTENCE_MAX_KEY_LENGTH 8
+/** Longest key: a stem and the ten digits of an unsigned sequence number */
+#define PERSISTENCE_MAX_KEY_LENGTH 12
+
+/** A persisted key, split into its stem and the message ID or sequence number following it */
+typedef struct
+{
+	char* key;
+	int stemlen;
+	int number;
+} MQTTPersistence_key;
 
 int MQTTPersistence_create(MQTTClient_persistence** per, int type, void* pcontext);
-int MQTTPersistence_initialize(Clients* c, const char* serverURI);
+int MQTTPersistence_initialize(Clients* c, const char* serverURI, MQTTPersistence_key** keys, int* nkeys);
 int MQTTPersistence_close(Clients* c);
 int MQTTPersistence_clear(Clients* c);
-int MQTTPersistence_restore(Clients* c);
+int MQTTPersistence_restore(Clients* c, MQTTPersistence_key* keys, int nkeys);
 void* MQTTPersistence_restorePacket(char* buffer, size_t buflen);
 void MQTTPersistence_insertInOrder(List* list, void* content, size_t size);
 int MQTTPersistence_put(int socket, char* buf0, size_t buf0len, int count, 
 								 char** buffers, size_t* buflens, int htype, int msgId, int scr);
 int MQTTPersistence_remove(Clients* c, char* type, int qos, int msgId);
 void MQTTPersistence_wrapMsgID(Clients *c);
+int MQTTPersistence_keys(Clients* c, MQTTPersistence_key** keys, int* nkeys);
+int MQTTPersistence_findKey(MQTTPersistence_key* keys, int nkeys, const char* stem, int number);
+void MQTTPersistence_freeKeys(MQTTPersistence_key* keys, int nkeys);
 
 typedef struct
 {
@@ -68,7 +81,7 @@ typedef struct
 
 int MQTTPersistence_unpersistQueueEntry(Clients* client, MQTTPersistence_qEntry* qe);
 int MQTTPersistence_persistQueueEntry(Clients* aclient, MQTTPersistence_qEntry* qe);
-int MQTTPersistence_restoreMessageQueue(Clients* c);
+int MQTTPersistence_restoreMessageQueue(Clients* c, MQTTPersistence_key* keys, int nkeys);
 #ifdef __cplusplus
      }
 #endif
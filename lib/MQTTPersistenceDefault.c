@@ -14,6 +14,7 @@
  *    Ian Craggs - initial API and implementation and/or initial documentation
  *    Ian Craggs - async client updates
  *    Ian Craggs - fix for bug 484496
+ *    create the client directory for absolute persistence paths
  *******************************************************************************/
 
 /**
@@ -93,13 +94,16 @@ int pstopen(void **handle, const char* clientID, const char* serverURI, void* co
 
 	pToken = strtok_r( pTokDirName, "\\/", &save_ptr );
 
-	strcpy( pCrtDirName, pToken );
+	/* keep the leading separator of an absolute path */
+	strcpy( pCrtDirName, (clientDir[0] == '/') ? "/" : "" );
+	strcat( pCrtDirName, pToken );
 	rc = pstmkdir( pCrtDirName );
 	pToken = strtok_r( NULL, "\\/", &save_ptr );
 	while ( (pToken != NULL) && (rc == 0) )
 	{
 		/* Append the next directory level and try to create it */
-		sprintf( pCrtDirName, "%s/%s", pCrtDirName, pToken );
+		strcat( pCrtDirName, "/" );
+		strcat( pCrtDirName, pToken );
 		rc = pstmkdir( pCrtDirName );
 		pToken = strtok_r( NULL, "\\/", &save_ptr );
 	}
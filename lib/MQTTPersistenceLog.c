@@ -0,0 +1,766 @@
+/*******************************************************************************
+ * Copyright (c) 2017 IBM Corp.
+ *
+ * All rights reserved. This program and the accompanying materials
+ * are made available under the terms of the Eclipse Public License v1.0
+ * and Eclipse Distribution License v1.0 which accompany this distribution.
+ *
+ * The Eclipse Public License is available at
+ *    http://www.eclipse.org/legal/epl-v10.html
+ * and the Eclipse Distribution License is available at
+ *   http://www.eclipse.org/org/documents/edl-v10.php.
+ *
+ * Contributors:
+ *    log-structured persistence - initial implementation
+ *******************************************************************************/
+
+/**
+ * @file
+ * \brief A log-structured persistence implementation.
+ *
+ * Instead of a file per message, records are appended to memory mapped segment files in
+ * the same client directory the default persistence uses.  An in-memory tree indexes the
+ * live record of each key.  Removing a key marks its record dead in place, and a segment
+ * is deleted once all of its records are dead.  A background thread syncs the segments
+ * written since the last commit, so puts made within one ::LOG_COMMIT_INTERVAL share a
+ * single fdatasync, and compacts sealed segments that are mostly dead by putting their
+ * remaining records again.
+ *
+ * Opening the store scans the segments in order; the newest record of a key wins and a
+ * torn record ends its segment.
+ */
+
+#if !defined(NO_PERSISTENCE) && !defined(WIN32) && !defined(WIN64)
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "MQTTClientPersistence.h"
+#include "MQTTPersistenceDefault.h"
+#include "MQTTPersistenceLog.h"
+#include "LinkedList.h"
+#include "Thread.h"
+#include "Tree.h"
+#include "StackTrace.h"
+#include "Heap.h"
+
+#define LOG_RECORD_LIVE 0x474f4c50 /* "PLOG" */
+#define LOG_RECORD_DEAD 0x44414544 /* "DEAD" */
+
+#define LOG_ALIGN(n) (((n) + 7) & ~((size_t)7))
+
+/** Header of a record, followed by the null terminated key and the data */
+typedef struct
+{
+	unsigned int magic;
+	unsigned int keylen; /**< including the terminating null */
+	unsigned int datalen;
+	unsigned int checksum; /**< FNV-1a of the key and data */
+} LogRecord;
+
+typedef struct
+{
+	unsigned int id;
+	int fd;
+	char* base;
+	size_t capacity;
+	size_t used; /**< end of the last record */
+	size_t live; /**< bytes of live records */
+	int dirty; /**< written since the last commit */
+} LogSegment;
+
+/** Index entry of a live record, the key points into the segment mapping */
+typedef struct
+{
+	char* key;
+	LogSegment* segment;
+	size_t offset;
+} LogEntry;
+
+typedef struct
+{
+	char* dir;
+	List* segments; /**< oldest first, records are appended to the last one */
+	Tree* index;
+	unsigned int next_id;
+	mutex_type mutex;
+	volatile int running;
+	volatile int stopped;
+} LogStore;
+
+
+static unsigned int LogStore_checksum(const char* data, size_t len, unsigned int hash)
+{
+	size_t i;
+
+	for (i = 0; i < len; ++i)
+	{
+		hash ^= (unsigned char)data[i];
+		hash *= 16777619u;
+	}
+	return hash;
+}
+
+
+static size_t LogStore_length(LogRecord* rec)
+{
+	return LOG_ALIGN(sizeof(LogRecord) + rec->keylen + rec->datalen);
+}
+
+
+static int LogStore_compare(void* a, void* b, int content)
+{
+	return strcmp(((LogEntry*)a)->key, content ? ((LogEntry*)b)->key : (char*)b);
+}
+
+
+static char* LogStore_path(LogStore* store, unsigned int id)
+{
+	char* path = malloc(strlen(store->dir) + strlen(LOG_SEGMENT_EXTENSION) + 11);
+
+	sprintf(path, "%s/%08x%s", store->dir, id, LOG_SEGMENT_EXTENSION);
+	return path;
+}
+
+
+static LogSegment* LogStore_active(LogStore* store)
+{
+	return (store->segments->last) ? (LogSegment*)store->segments->last->content : NULL;
+}
+
+
+/**
+ * Map a segment file and add it to the end of the segment list.
+ * @param capacity the size of a new segment, or 0 to open an existing one
+ */
+static LogSegment* LogStore_map(LogStore* store, unsigned int id, size_t capacity)
+{
+	LogSegment* seg = NULL;
+	char* path = LogStore_path(store, id);
+	struct stat st;
+	char* base;
+	int fd;
+
+	FUNC_ENTRY;
+	if ((fd = open(path, O_RDWR | O_CREAT, S_IRUSR | S_IWUSR)) < 0)
+		goto exit;
+	if (capacity > 0 && ftruncate(fd, capacity) != 0)
+		goto error;
+	if (capacity == 0)
+	{
+		if (fstat(fd, &st) != 0 || st.st_size == 0)
+			goto error;
+		capacity = st.st_size;
+	}
+	if ((base = mmap(NULL, capacity, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0)) == MAP_FAILED)
+		goto error;
+
+	seg = malloc(sizeof(LogSegment));
+	memset(seg, '\0', sizeof(LogSegment));
+	seg->id = id;
+	seg->fd = fd;
+	seg->base = base;
+	seg->capacity = capacity;
+	ListAppend(store->segments, seg, sizeof(LogSegment));
+	if (id >= store->next_id)
+		store->next_id = id + 1;
+	goto exit;
+error:
+	close(fd);
+exit:
+	free(path);
+	FUNC_EXIT;
+	return seg;
+}
+
+
+static void LogStore_unmap(LogStore* store, LogSegment* seg, int remove)
+{
+	munmap(seg->base, seg->capacity);
+	close(seg->fd);
+	if (remove)
+	{
+		char* path = LogStore_path(store, seg->id);
+
+		unlink(path);
+		free(path);
+	}
+	ListRemove(store->segments, seg);
+}
+
+
+/**
+ * Mark a record dead, deleting its segment when nothing else in it is live.
+ */
+static void LogStore_kill(LogStore* store, LogSegment* seg, size_t offset)
+{
+	LogRecord* rec = (LogRecord*)(seg->base + offset);
+
+	rec->magic = LOG_RECORD_DEAD;
+	seg->live -= LogStore_length(rec);
+	seg->dirty = 1;
+	if (seg->live == 0 && seg != LogStore_active(store))
+		LogStore_unmap(store, seg, 1);
+}
+
+
+/**
+ * Point the index entry of a key at a record, retiring the record it replaces.
+ */
+static void LogStore_index(LogStore* store, LogSegment* seg, size_t offset)
+{
+	LogRecord* rec = (LogRecord*)(seg->base + offset);
+	char* key = (char*)(rec + 1);
+	Node* node = TreeFind(store->index, key);
+	LogSegment* oldseg = NULL;
+	size_t oldoffset = 0;
+	LogEntry* entry;
+
+	if (node)
+	{
+		entry = node->content;
+		oldseg = entry->segment;
+		oldoffset = entry->offset;
+	}
+	else
+	{
+		entry = malloc(sizeof(LogEntry));
+		entry->key = key;
+		TreeAdd(store->index, entry, sizeof(LogEntry));
+	}
+	entry->key = key;
+	entry->segment = seg;
+	entry->offset = offset;
+	seg->live += LogStore_length(rec);
+	if (oldseg)
+		LogStore_kill(store, oldseg, oldoffset);
+}
+
+
+static int LogStore_append(LogStore* store, char* key, int bufcount, char* buffers[], int buflens[])
+{
+	int rc = 0;
+	size_t keylen = strlen(key) + 1, datalen = 0, reclen;
+	LogSegment* seg = LogStore_active(store);
+	LogRecord* rec;
+	char* ptr;
+	int i;
+
+	FUNC_ENTRY;
+	for (i = 0; i < bufcount; ++i)
+		datalen += buflens[i];
+	reclen = LOG_ALIGN(sizeof(LogRecord) + keylen + datalen);
+
+	if (seg == NULL || seg->used + reclen > seg->capacity)
+	{
+		if (seg && seg->live == 0)
+			LogStore_unmap(store, seg, 1);
+		if ((seg = LogStore_map(store, store->next_id, (reclen > LOG_SEGMENT_SIZE) ? reclen : LOG_SEGMENT_SIZE)) == NULL)
+		{
+			rc = MQTTCLIENT_PERSISTENCE_ERROR;
+			goto exit;
+		}
+	}
+
+	rec = (LogRecord*)(seg->base + seg->used);
+	ptr = (char*)(rec + 1);
+	memcpy(ptr, key, keylen);
+	ptr += keylen;
+	for (i = 0; i < bufcount; ++i)
+	{
+		memcpy(ptr, buffers[i], buflens[i]);
+		ptr += buflens[i];
+	}
+	rec->keylen = keylen;
+	rec->datalen = datalen;
+	rec->checksum = LogStore_checksum((char*)(rec + 1), keylen + datalen, 2166136261u);
+	rec->magic = LOG_RECORD_LIVE;
+
+	LogStore_index(store, seg, seg->used);
+	seg->used += reclen;
+	seg->dirty = 1;
+	if (LOG_COMMIT_INTERVAL == 0 && fdatasync(seg->fd) == 0)
+		seg->dirty = 0;
+exit:
+	FUNC_EXIT_RC(rc);
+	return rc;
+}
+
+
+/**
+ * Index the records of a segment, which has just been mapped and is the last one.
+ */
+static void LogStore_scan(LogStore* store, LogSegment* seg)
+{
+	size_t offset = 0;
+
+	FUNC_ENTRY;
+	while (offset + sizeof(LogRecord) <= seg->capacity)
+	{
+		LogRecord* rec = (LogRecord*)(seg->base + offset);
+		size_t reclen;
+
+		if (rec->magic != LOG_RECORD_LIVE && rec->magic != LOG_RECORD_DEAD)
+			break;
+		if (rec->keylen == 0 || (size_t)rec->keylen + rec->datalen > seg->capacity - offset - sizeof(LogRecord))
+			break;
+		reclen = LogStore_length(rec);
+		if (((char*)(rec + 1))[rec->keylen - 1] != '\0' ||
+				LogStore_checksum((char*)(rec + 1), rec->keylen + rec->datalen, 2166136261u) != rec->checksum)
+			break;
+		if (rec->magic == LOG_RECORD_LIVE)
+			LogStore_index(store, seg, offset);
+		offset += reclen;
+	}
+	seg->used = offset;
+	if (offset + sizeof(unsigned int) <= seg->capacity && *(unsigned int*)(seg->base + offset) != 0)
+	{
+		/* a torn record, clear it so the next append starts from zeros */
+		memset(seg->base + offset, '\0', seg->capacity - offset);
+		seg->dirty = 1;
+	}
+	FUNC_EXIT;
+}
+
+
+static int LogStore_idcompare(const void* a, const void* b)
+{
+	unsigned int x = *(const unsigned int*)a, y = *(const unsigned int*)b;
+
+	return (x > y) - (x < y);
+}
+
+
+static int LogStore_recover(LogStore* store)
+{
+	int rc = 0;
+	unsigned int* ids = NULL;
+	int count = 0, size = 0, i;
+	struct dirent* entry;
+	ListElement* current = NULL;
+	DIR* dp;
+
+	FUNC_ENTRY;
+	if ((dp = opendir(store->dir)) == NULL)
+	{
+		rc = MQTTCLIENT_PERSISTENCE_ERROR;
+		goto exit;
+	}
+	while ((entry = readdir(dp)) != NULL)
+	{
+		char* ext = strstr(entry->d_name, LOG_SEGMENT_EXTENSION);
+
+		if (ext == NULL || strcmp(ext, LOG_SEGMENT_EXTENSION) != 0 || ext == entry->d_name)
+			continue;
+		if (count == size)
+		{
+			size = (size == 0) ? 16 : size * 2;
+			ids = (ids) ? realloc(ids, size * sizeof(unsigned int)) : malloc(size * sizeof(unsigned int));
+		}
+		ids[count++] = (unsigned int)strtoul(entry->d_name, NULL, 16);
+	}
+	closedir(dp);
+	if (count > 0)
+		qsort(ids, count, sizeof(unsigned int), LogStore_idcompare);
+
+	for (i = 0; i < count; ++i)
+	{
+		LogSegment* seg = LogStore_map(store, ids[i], 0);
+
+		if (seg)
+			LogStore_scan(store, seg);
+		else
+		{
+			char* path = LogStore_path(store, ids[i]);
+
+			unlink(path);
+			free(path);
+		}
+	}
+
+	/* drop sealed segments that hold nothing live */
+	while (ListNextElement(store->segments, &current))
+	{
+		LogSegment* seg = current->content;
+
+		if (seg != LogStore_active(store) && seg->live == 0)
+		{
+			current = current->prev;
+			LogStore_unmap(store, seg, 1);
+		}
+	}
+exit:
+	if (ids)
+		free(ids);
+	FUNC_EXIT_RC(rc);
+	return rc;
+}
+
+
+/**
+ * Sync the segments written since the last commit.  The store lock is only held to collect
+ * them, so puts carry on while the data is written out.
+ */
+static void LogStore_commit(LogStore* store)
+{
+	ListElement* current = NULL;
+	int* fds = NULL;
+	int count = 0, i;
+
+	Thread_lock_mutex(store->mutex);
+	if (store->segments->count > 0)
+		fds = malloc(store->segments->count * sizeof(int));
+	while (ListNextElement(store->segments, &current))
+	{
+		LogSegment* seg = current->content;
+
+		if (seg->dirty && (fds[count] = dup(seg->fd)) >= 0)
+		{
+			seg->dirty = 0;
+			++count;
+		}
+	}
+	Thread_unlock_mutex(store->mutex);
+
+	for (i = 0; i < count; ++i)
+	{
+		fdatasync(fds[i]);
+		close(fds[i]);
+	}
+	if (fds)
+		free(fds);
+}
+
+
+/**
+ * Compact the oldest sealed segment that is mostly dead, by putting its live records again.
+ */
+static void LogStore_compact(LogStore* store)
+{
+	ListElement* current = NULL;
+	LogSegment* seg = NULL;
+	size_t offset, used, remaining;
+
+	while (ListNextElement(store->segments, &current))
+	{
+		LogSegment* candidate = current->content;
+
+		if (candidate != LogStore_active(store) && candidate->live * 100 < candidate->used * LOG_COMPACT_PERCENT)
+		{
+			seg = candidate;
+			break;
+		}
+	}
+	if (seg == NULL)
+		return;
+
+	used = seg->used;
+	remaining = seg->live;
+	/* the segment is deleted when its last live record is retired */
+	for (offset = 0; offset < used && remaining > 0; )
+	{
+		LogRecord* rec = (LogRecord*)(seg->base + offset);
+		size_t reclen = LogStore_length(rec);
+
+		if (rec->magic == LOG_RECORD_LIVE)
+		{
+			char* key = (char*)(rec + 1);
+			char* data = key + rec->keylen;
+			int datalen = rec->datalen;
+
+			remaining -= reclen;
+			if (LogStore_append(store, key, 1, &data, &datalen) != 0)
+				break;
+		}
+		offset += reclen;
+	}
+}
+
+
+static thread_return_type LogStore_committer(void* n)
+{
+	LogStore* store = n;
+
+	while (store->running)
+	{
+		usleep(((LOG_COMMIT_INTERVAL > 0) ? LOG_COMMIT_INTERVAL : 100) * 1000L);
+		LogStore_commit(store);
+		Thread_lock_mutex(store->mutex);
+		LogStore_compact(store);
+		Thread_unlock_mutex(store->mutex);
+	}
+	store->stopped = 1;
+	return 0;
+}
+
+
+static void LogStore_empty(LogStore* store)
+{
+	Node* node;
+
+	while ((node = TreeNextElement(store->index, NULL)) != NULL)
+		free(TreeRemove(store->index, node->content));
+}
+
+
+/** Open the segments in the client persistence directory: context/clientID-serverURI.
+ *  See ::Persistence_open
+ */
+int plogopen(void** handle, const char* clientID, const char* serverURI, void* context)
+{
+	int rc = 0;
+	LogStore* store = NULL;
+	char* dir = NULL;
+
+	FUNC_ENTRY;
+	if ((rc = pstopen((void**)&dir, clientID, serverURI, context)) != 0)
+	{
+		free(dir);
+		goto exit;
+	}
+
+	store = malloc(sizeof(LogStore));
+	memset(store, '\0', sizeof(LogStore));
+	store->dir = dir;
+	store->segments = ListInitialize();
+	store->index = TreeInitialize(LogStore_compare);
+	store->mutex = Thread_create_mutex();
+	if ((rc = LogStore_recover(store)) != 0)
+	{
+		plogclose(store);
+		goto exit;
+	}
+	store->running = 1;
+	Thread_start(LogStore_committer, store);
+	*handle = store;
+exit:
+	FUNC_EXIT_RC(rc);
+	return rc;
+}
+
+
+/** Sync and close the segments, deleting them and the client directory if nothing is live.
+ *  See ::Persistence_close
+ */
+int plogclose(void* handle)
+{
+	int rc = 0;
+	LogStore* store = handle;
+
+	FUNC_ENTRY;
+	if (store == NULL)
+	{
+		rc = MQTTCLIENT_PERSISTENCE_ERROR;
+		goto exit;
+	}
+
+	if (store->running)
+	{
+		store->running = 0;
+		while (!store->stopped)
+			usleep(1000L);
+	}
+	LogStore_commit(store);
+	LogStore_empty(store);
+	while (store->segments->count > 0)
+	{
+		LogSegment* seg = store->segments->first->content;
+
+		LogStore_unmap(store, seg, seg->live == 0);
+	}
+	TreeFree(store->index);
+	ListFree(store->segments);
+	Thread_destroy_mutex(store->mutex);
+	rc = pstclose(store->dir);
+	free(store);
+
+exit:
+	FUNC_EXIT_RC(rc);
+	return rc;
+}
+
+
+/** Append a record for the key, replacing any previous one.
+ *  See ::Persistence_put
+ */
+int plogput(void* handle, char* key, int bufcount, char* buffers[], int buflens[])
+{
+	int rc = 0;
+	LogStore* store = handle;
+
+	FUNC_ENTRY;
+	if (store == NULL)
+	{
+		rc = MQTTCLIENT_PERSISTENCE_ERROR;
+		goto exit;
+	}
+	Thread_lock_mutex(store->mutex);
+	rc = LogStore_append(store, key, bufcount, buffers, buflens);
+	Thread_unlock_mutex(store->mutex);
+
+exit:
+	FUNC_EXIT_RC(rc);
+	return rc;
+}
+
+
+/** Copy the data of a key out of its segment.
+ *  See ::Persistence_get
+ */
+int plogget(void* handle, char* key, char** buffer, int* buflen)
+{
+	int rc = 0;
+	LogStore* store = handle;
+	Node* node;
+
+	FUNC_ENTRY;
+	if (store == NULL)
+	{
+		rc = MQTTCLIENT_PERSISTENCE_ERROR;
+		goto exit;
+	}
+	Thread_lock_mutex(store->mutex);
+	if ((node = TreeFind(store->index, key)) == NULL)
+		rc = MQTTCLIENT_PERSISTENCE_ERROR;
+	else
+	{
+		LogEntry* entry = node->content;
+		LogRecord* rec = (LogRecord*)(entry->segment->base + entry->offset);
+
+		*buffer = malloc(rec->datalen);
+		memcpy(*buffer, entry->key + rec->keylen, rec->datalen);
+		*buflen = rec->datalen;
+	}
+	Thread_unlock_mutex(store->mutex);
+
+exit:
+	FUNC_EXIT_RC(rc);
+	return rc;
+}
+
+
+/** Mark the record of a key dead.
+ *  See ::Persistence_remove
+ */
+int plogremove(void* handle, char* key)
+{
+	int rc = 0;
+	LogStore* store = handle;
+	LogEntry* entry;
+
+	FUNC_ENTRY;
+	if (store == NULL)
+	{
+		rc = MQTTCLIENT_PERSISTENCE_ERROR;
+		goto exit;
+	}
+	Thread_lock_mutex(store->mutex);
+	if ((entry = TreeRemoveKey(store->index, key)) != NULL)
+	{
+		LogStore_kill(store, entry->segment, entry->offset);
+		free(entry);
+	}
+	Thread_unlock_mutex(store->mutex);
+
+exit:
+	FUNC_EXIT_RC(rc);
+	return rc;
+}
+
+
+/** Return the keys of the live records, from the index.
+ *  See ::Persistence_keys
+ */
+int plogkeys(void* handle, char*** keys, int* nkeys)
+{
+	int rc = 0;
+	LogStore* store = handle;
+	char** fkeys = NULL;
+	Node* node = NULL;
+	int i = 0;
+
+	FUNC_ENTRY;
+	if (store == NULL)
+	{
+		rc = MQTTCLIENT_PERSISTENCE_ERROR;
+		goto exit;
+	}
+	Thread_lock_mutex(store->mutex);
+	if (store->index->count > 0)
+		fkeys = malloc(store->index->count * sizeof(char*));
+	while ((node = TreeNextElement(store->index, node)) != NULL)
+	{
+		LogEntry* entry = node->content;
+
+		fkeys[i] = malloc(strlen(entry->key) + 1);
+		strcpy(fkeys[i++], entry->key);
+	}
+	Thread_unlock_mutex(store->mutex);
+	*keys = fkeys;
+	*nkeys = i;
+
+exit:
+	FUNC_EXIT_RC(rc);
+	return rc;
+}
+
+
+/** Delete all the records and their segments.
+ *  See ::Persistence_clear
+ */
+int plogclear(void* handle)
+{
+	int rc = 0;
+	LogStore* store = handle;
+
+	FUNC_ENTRY;
+	if (store == NULL)
+	{
+		rc = MQTTCLIENT_PERSISTENCE_ERROR;
+		goto exit;
+	}
+	Thread_lock_mutex(store->mutex);
+	LogStore_empty(store);
+	while (store->segments->count > 0)
+		LogStore_unmap(store, store->segments->first->content, 1);
+	Thread_unlock_mutex(store->mutex);
+
+exit:
+	FUNC_EXIT_RC(rc);
+	return rc;
+}
+
+
+/** Returns whether the key has a live record.
+ *  See ::Persistence_containskey
+ */
+int plogcontainskey(void* handle, char* key)
+{
+	int rc = 0;
+	LogStore* store = handle;
+
+	FUNC_ENTRY;
+	if (store == NULL)
+	{
+		rc = MQTTCLIENT_PERSISTENCE_ERROR;
+		goto exit;
+	}
+	Thread_lock_mutex(store->mutex);
+	if (TreeFind(store->index, key) == NULL)
+		rc = MQTTCLIENT_PERSISTENCE_ERROR;
+	Thread_unlock_mutex(store->mutex);
+
+exit:
+	FUNC_EXIT_RC(rc);
+	return rc;
+}
+
+#endif /* NO_PERSISTENCE */
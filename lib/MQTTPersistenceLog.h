@@ -0,0 +1,39 @@
+/*******************************************************************************
+ * Copyright (c) 2017 IBM Corp.
+ *
+ * All rights reserved. This program and the accompanying materials
+ * are made available under the terms of the Eclipse Public License v1.0
+ * and Eclipse Distribution License v1.0 which accompany this distribution.
+ *
+ * The Eclipse Public License is available at
+ *    http://www.eclipse.org/legal/epl-v10.html
+ * and the Eclipse Distribution License is available at
+ *   http://www.eclipse.org/org/documents/edl-v10.php.
+ *
+ * Contributors:
+ *    log-structured persistence - initial implementation
+ *******************************************************************************/
+
+#if !defined(MQTTPERSISTENCELOG_H)
+#define MQTTPERSISTENCELOG_H
+
+/** Extension of the segment files */
+#define LOG_SEGMENT_EXTENSION ".plog"
+/** Size of a segment file, records larger than this get a segment of their own */
+#define LOG_SEGMENT_SIZE (1024 * 1024)
+/** Milliseconds between group commits, 0 to sync in every put */
+#define LOG_COMMIT_INTERVAL 10
+/** Sealed segments with fewer live bytes than this percentage are compacted */
+#define LOG_COMPACT_PERCENT 25
+
+/* prototypes of the functions for the log-structured persistence */
+int plogopen(void** handle, const char* clientID, const char* serverURI, void* context);
+int plogclose(void* handle);
+int plogput(void* handle, char* key, int bufcount, char* buffers[], int buflens[]);
+int plogget(void* handle, char* key, char** buffer, int* buflen);
+int plogremove(void* handle, char* key);
+int plogkeys(void* handle, char*** keys, int* nkeys);
+int plogclear(void* handle);
+int plogcontainskey(void* handle, char* key);
+
+#endif
@@ -0,0 +1,783 @@
+/*******************************************************************************
+ * Copyright (c) 2017 IBM Corp.
+ *
+ * All rights reserved. This program and the accompanying materials
+ * are made available under the terms of the Eclipse Public License v1.0
+ * and Eclipse Distribution License v1.0 which accompany this distribution.
+ *
+ * The Eclipse Public License is available at
+ *    http://www.eclipse.org/legal/epl-v10.html
+ * and the Eclipse Distribution License is available at
+ *   http://www.eclipse.org/org/documents/edl-v10.php.
+ *
+ * Contributors:
+ *    in-memory persistence with snapshots - initial implementation
+ *******************************************************************************/
+
+/**
+ * @file
+ * \brief An in-memory persistence implementation, written out to a snapshot file periodically.
+ *
+ * The records live in a hash table.  Every interval a background thread appends the keys
+ * changed since its last pass to a single file in the client persistence directory: a put
+ * record for each key that is live, a remove record for each key the file holds that has gone.
+ * A key put and removed within one interval, like most QoS1 messages, never reaches the file.
+ * Once the file has grown to ::MEMORY_SNAPSHOT_RATIO times the size of the live records, it is
+ * replaced by a snapshot of just those.
+ *
+ * Opening the store replays the file, so a crash loses the changes of the last interval at
+ * most.  A torn record ends the file.
+ */
+
+#if !defined(NO_PERSISTENCE) && !defined(WIN32) && !defined(WIN64)
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "MQTTClientPersistence.h"
+#include "MQTTPersistenceDefault.h"
+#include "MQTTPersistenceMemory.h"
+#include "Log.h"
+#include "Thread.h"
+#include "StackTrace.h"
+#include "Heap.h"
+
+#define MEMORY_RECORD_PUT 0x54555050 /* "PPUT" */
+#define MEMORY_RECORD_REMOVE 0x4d455250 /* "PREM" */
+
+/** Header of a record in the file, followed by the null terminated key and the data */
+typedef struct
+{
+	unsigned int magic;
+	unsigned int keylen; /**< including the terminating null */
+	unsigned int datalen;
+	unsigned int checksum; /**< FNV-1a of the key and data */
+} MemoryRecord;
+
+typedef struct MemoryEntryStruct
+{
+	struct MemoryEntryStruct* next; /**< next in the hash chain */
+	struct MemoryEntryStruct* next_dirty; /**< changed since the last write */
+	struct MemoryEntryStruct* prev_dirty;
+	unsigned int hash;
+	char* key;
+	char* data;
+	int datalen;
+	int dirty;
+	int removed; /**< removed, kept until its remove record is written */
+	int written; /**< the file holds a put record of the key */
+} MemoryEntry;
+
+typedef struct
+{
+	char* dir;
+	char* path;
+	int fd;
+	MemoryEntry** buckets;
+	unsigned int nbuckets; /**< a power of two */
+	int count; /**< live keys */
+	int entries; /**< live and removed keys */
+	MemoryEntry* dirty;
+	size_t live_bytes; /**< size of the live keys as file records */
+	size_t file_bytes;
+	int resnapshot; /**< a write failed, so the file can't be appended to */
+	int interval;
+	mutex_type mutex; /**< the table */
+	mutex_type file_mutex; /**< the file, held across a write */
+	volatile int running;
+	volatile int stopped;
+} MemoryStore;
+
+
+static unsigned int MemoryStore_checksum(const char* data, size_t len, unsigned int hash)
+{
+	size_t i;
+
+	for (i = 0; i < len; ++i)
+	{
+		hash ^= (unsigned char)data[i];
+		hash *= 16777619u;
+	}
+	return hash;
+}
+
+
+static size_t MemoryStore_length(MemoryEntry* entry)
+{
+	return sizeof(MemoryRecord) + strlen(entry->key) + 1 + entry->datalen;
+}
+
+
+static MemoryEntry* MemoryStore_find(MemoryStore* store, const char* key, unsigned int hash)
+{
+	MemoryEntry* entry = store->buckets[hash & (store->nbuckets - 1)];
+
+	while (entry && (entry->hash != hash || strcmp(entry->key, key) != 0))
+		entry = entry->next;
+	return entry;
+}
+
+
+static void MemoryStore_grow(MemoryStore* store)
+{
+	unsigned int nbuckets = store->nbuckets * 2, i;
+	MemoryEntry** buckets = malloc(nbuckets * sizeof(MemoryEntry*));
+
+	memset(buckets, '\0', nbuckets * sizeof(MemoryEntry*));
+	for (i = 0; i < store->nbuckets; ++i)
+	{
+		MemoryEntry* entry = store->buckets[i];
+
+		while (entry)
+		{
+			MemoryEntry* next = entry->next;
+
+			entry->next = buckets[entry->hash & (nbuckets - 1)];
+			buckets[entry->hash & (nbuckets - 1)] = entry;
+			entry = next;
+		}
+	}
+	free(store->buckets);
+	store->buckets = buckets;
+	store->nbuckets = nbuckets;
+}
+
+
+static void MemoryStore_setDirty(MemoryStore* store, MemoryEntry* entry, int dirty)
+{
+	if (entry->dirty == dirty)
+		return;
+	if (dirty)
+	{
+		entry->prev_dirty = NULL;
+		entry->next_dirty = store->dirty;
+		if (store->dirty)
+			store->dirty->prev_dirty = entry;
+		store->dirty = entry;
+	}
+	else
+	{
+		if (entry->prev_dirty)
+			entry->prev_dirty->next_dirty = entry->next_dirty;
+		else
+			store->dirty = entry->next_dirty;
+		if (entry->next_dirty)
+			entry->next_dirty->prev_dirty = entry->prev_dirty;
+		entry->next_dirty = entry->prev_dirty = NULL;
+	}
+	entry->dirty = dirty;
+}
+
+
+/** Take an entry out of the table and free it */
+static void MemoryStore_delete(MemoryStore* store, MemoryEntry* entry)
+{
+	MemoryEntry** link = &store->buckets[entry->hash & (store->nbuckets - 1)];
+
+	while (*link != entry)
+		link = &(*link)->next;
+	*link = entry->next;
+	MemoryStore_setDirty(store, entry, 0);
+	if (!entry->removed)
+	{
+		store->live_bytes -= MemoryStore_length(entry);
+		--store->count;
+	}
+	--store->entries;
+	free(entry->key);
+	if (entry->data)
+		free(entry->data);
+	free(entry);
+}
+
+
+/** Set the data of a key, which the store takes ownership of */
+static MemoryEntry* MemoryStore_set(MemoryStore* store, const char* key, char* data, int datalen)
+{
+	unsigned int hash = MemoryStore_checksum(key, strlen(key), 2166136261u);
+	MemoryEntry* entry = MemoryStore_find(store, key, hash);
+
+	if (entry == NULL)
+	{
+		entry = malloc(sizeof(MemoryEntry));
+		memset(entry, '\0', sizeof(MemoryEntry));
+		entry->hash = hash;
+		entry->key = malloc(strlen(key) + 1);
+		strcpy(entry->key, key);
+		entry->next = store->buckets[hash & (store->nbuckets - 1)];
+		store->buckets[hash & (store->nbuckets - 1)] = entry;
+		++store->count;
+		if (++store->entries > (int)store->nbuckets)
+			MemoryStore_grow(store);
+	}
+	else if (entry->removed)
+	{
+		entry->removed = 0;
+		++store->count;
+	}
+	else
+	{
+		store->live_bytes -= MemoryStore_length(entry);
+		free(entry->data);
+	}
+	entry->data = data;
+	entry->datalen = datalen;
+	store->live_bytes += MemoryStore_length(entry);
+	return entry;
+}
+
+
+static void MemoryStore_empty(MemoryStore* store)
+{
+	unsigned int i;
+
+	for (i = 0; i < store->nbuckets; ++i)
+	{
+		while (store->buckets[i])
+			MemoryStore_delete(store, store->buckets[i]);
+	}
+}
+
+
+static char* MemoryStore_record(char* ptr, unsigned int magic, MemoryEntry* entry)
+{
+	MemoryRecord rec;
+
+	rec.magic = magic;
+	rec.keylen = (unsigned int)strlen(entry->key) + 1;
+	rec.datalen = (magic == MEMORY_RECORD_PUT) ? entry->datalen : 0;
+	memcpy(ptr + sizeof(MemoryRecord), entry->key, rec.keylen);
+	if (rec.datalen > 0)
+		memcpy(ptr + sizeof(MemoryRecord) + rec.keylen, entry->data, rec.datalen);
+	rec.checksum = MemoryStore_checksum(ptr + sizeof(MemoryRecord), rec.keylen + rec.datalen, 2166136261u);
+	memcpy(ptr, &rec, sizeof(MemoryRecord));
+	return ptr + sizeof(MemoryRecord) + rec.keylen + rec.datalen;
+}
+
+
+static int MemoryStore_writeAll(int fd, const char* buffer, size_t len)
+{
+	while (len > 0)
+	{
+		ssize_t written = write(fd, buffer, len);
+
+		if (written < 0)
+		{
+			if (errno == EINTR)
+				continue;
+			return -1;
+		}
+		buffer += written;
+		len -= written;
+	}
+	return 0;
+}
+
+
+/**
+ * Write the keys changed since the last write to the file, or replace the file with a snapshot
+ * of all the live keys once it has grown too large.  The table is only locked while the records
+ * are copied out, so puts carry on while they are written.
+ */
+static int MemoryStore_write(MemoryStore* store)
+{
+	int rc = 0, snapshot;
+	size_t size = 0, limit;
+	char* buffer = NULL;
+	char* ptr;
+	MemoryEntry* entry;
+
+	Thread_lock_mutex(store->file_mutex);
+	Thread_lock_mutex(store->mutex);
+	for (entry = store->dirty; entry; entry = entry->next_dirty)
+	{
+		if (!entry->removed)
+			size += MemoryStore_length(entry);
+		else if (entry->written)
+			size += sizeof(MemoryRecord) + strlen(entry->key) + 1;
+	}
+	limit = store->live_bytes * MEMORY_SNAPSHOT_RATIO;
+	snapshot = store->resnapshot ||
+		(store->file_bytes + size > ((limit > MEMORY_SNAPSHOT_MIN_BYTES) ? limit : MEMORY_SNAPSHOT_MIN_BYTES));
+	if (snapshot)
+		size = store->live_bytes;
+	if (store->dirty == NULL && !snapshot)
+	{
+		Thread_unlock_mutex(store->mutex);
+		goto exit;
+	}
+
+	if (size > 0)
+		buffer = malloc(size);
+	ptr = buffer;
+	while ((entry = store->dirty) != NULL)
+	{
+		if (!entry->removed)
+		{
+			if (!snapshot)
+				ptr = MemoryStore_record(ptr, MEMORY_RECORD_PUT, entry);
+			entry->written = 1;
+			MemoryStore_setDirty(store, entry, 0);
+		}
+		else
+		{
+			if (!snapshot && entry->written)
+				ptr = MemoryStore_record(ptr, MEMORY_RECORD_REMOVE, entry);
+			MemoryStore_delete(store, entry);
+		}
+	}
+	if (snapshot)
+	{
+		unsigned int i;
+
+		for (i = 0; i < store->nbuckets; ++i)
+		{
+			for (entry = store->buckets[i]; entry; entry = entry->next)
+				ptr = MemoryStore_record(ptr, MEMORY_RECORD_PUT, entry);
+		}
+		store->file_bytes = size;
+	}
+	else
+		store->file_bytes += size;
+	store->resnapshot = 0;
+	Thread_unlock_mutex(store->mutex);
+
+	if (snapshot)
+	{
+		char* tmppath = malloc(strlen(store->path) + 5);
+		int fd;
+
+		sprintf(tmppath, "%s.tmp", store->path);
+		if ((fd = open(tmppath, O_WRONLY | O_CREAT | O_TRUNC, S_IRUSR | S_IWUSR)) < 0)
+			rc = MQTTCLIENT_PERSISTENCE_ERROR;
+		else
+		{
+			if (MemoryStore_writeAll(fd, buffer, size) != 0 || fdatasync(fd) != 0 || rename(tmppath, store->path) != 0)
+			{
+				rc = MQTTCLIENT_PERSISTENCE_ERROR;
+				close(fd);
+				unlink(tmppath);
+			}
+			else
+			{
+				/* the snapshot is written through the new descriptor from here on */
+				close(store->fd);
+				store->fd = fd;
+				lseek(fd, 0, SEEK_END);
+			}
+		}
+		free(tmppath);
+	}
+	else if (MemoryStore_writeAll(store->fd, buffer, size) != 0 || fdatasync(store->fd) != 0)
+		rc = MQTTCLIENT_PERSISTENCE_ERROR;
+
+	if (rc != 0)
+	{
+		Log(LOG_ERROR, 0, "Error %d writing the snapshot file %s", errno, store->path);
+		Thread_lock_mutex(store->mutex);
+		store->resnapshot = 1;
+		Thread_unlock_mutex(store->mutex);
+	}
+	if (buffer)
+		free(buffer);
+exit:
+	Thread_unlock_mutex(store->file_mutex);
+	return rc;
+}
+
+
+/**
+ * Replay the file into the table.  A record that is short or fails its checksum was torn by a
+ * crash, so it and anything after it are cut off.
+ */
+static int MemoryStore_recover(MemoryStore* store)
+{
+	int rc = 0;
+	struct stat st;
+	char* buffer = NULL;
+	size_t offset = 0, size, got = 0;
+
+	FUNC_ENTRY;
+	if ((store->fd = open(store->path, O_RDWR | O_CREAT, S_IRUSR | S_IWUSR)) < 0 || fstat(store->fd, &st) != 0)
+	{
+		rc = MQTTCLIENT_PERSISTENCE_ERROR;
+		goto exit;
+	}
+	size = st.st_size;
+	if (size > 0)
+	{
+		buffer = malloc(size);
+		while (got < size)
+		{
+			ssize_t n = read(store->fd, buffer + got, size - got);
+
+			if (n <= 0)
+				break;
+			got += n;
+		}
+		size = got;
+	}
+
+	while (size - offset >= sizeof(MemoryRecord))
+	{
+		MemoryRecord rec;
+		char* key = buffer + offset + sizeof(MemoryRecord);
+
+		memcpy(&rec, buffer + offset, sizeof(MemoryRecord));
+		if ((rec.magic != MEMORY_RECORD_PUT && rec.magic != MEMORY_RECORD_REMOVE) || rec.keylen == 0 ||
+				(size_t)rec.keylen + rec.datalen > size - offset - sizeof(MemoryRecord) ||
+				key[rec.keylen - 1] != '\0' ||
+				MemoryStore_checksum(key, rec.keylen + rec.datalen, 2166136261u) != rec.checksum)
+			break;
+		if (rec.magic == MEMORY_RECORD_PUT)
+		{
+			char* data = malloc(rec.datalen);
+
+			memcpy(data, key + rec.keylen, rec.datalen);
+			MemoryStore_set(store, key, data, rec.datalen)->written = 1;
+		}
+		else
+		{
+			MemoryEntry* entry = MemoryStore_find(store, key, MemoryStore_checksum(key, rec.keylen - 1, 2166136261u));
+
+			if (entry)
+				MemoryStore_delete(store, entry);
+		}
+		offset += sizeof(MemoryRecord) + rec.keylen + rec.datalen;
+	}
+	if (offset < (size_t)st.st_size && ftruncate(store->fd, offset) != 0)
+		rc = MQTTCLIENT_PERSISTENCE_ERROR;
+	lseek(store->fd, offset, SEEK_SET);
+	store->file_bytes = offset;
+	if (buffer)
+		free(buffer);
+exit:
+	FUNC_EXIT_RC(rc);
+	return rc;
+}
+
+
+static thread_return_type MemoryStore_writer(void* n)
+{
+	MemoryStore* store = n;
+	int elapsed = 0;
+
+	while (store->running)
+	{
+		usleep(10 * 1000L);
+		if ((elapsed += 10) >= store->interval)
+		{
+			MemoryStore_write(store);
+			elapsed = 0;
+		}
+	}
+	store->stopped = 1;
+	return 0;
+}
+
+
+/** Replay the snapshot file in the client persistence directory: context/clientID-serverURI.
+ *  The context is an ::MQTTClient_memoryPersistenceOptions, or NULL for the defaults.
+ *  See ::Persistence_open
+ */
+int pmemopen(void** handle, const char* clientID, const char* serverURI, void* context)
+{
+	int rc = 0;
+	MQTTClient_memoryPersistenceOptions* options = context;
+	MemoryStore* store = NULL;
+	char* dir = NULL;
+
+	FUNC_ENTRY;
+	if ((rc = pstopen((void**)&dir, clientID, serverURI,
+			(options && options->directory) ? (void*)options->directory : ".")) != 0)
+	{
+		free(dir);
+		goto exit;
+	}
+
+	store = malloc(sizeof(MemoryStore));
+	memset(store, '\0', sizeof(MemoryStore));
+	store->dir = dir;
+	store->path = malloc(strlen(dir) + strlen(MEMORY_SNAPSHOT_FILE) + 2);
+	sprintf(store->path, "%s/%s", dir, MEMORY_SNAPSHOT_FILE);
+	store->fd = -1;
+	store->nbuckets = MEMORY_INITIAL_BUCKETS;
+	store->buckets = malloc(store->nbuckets * sizeof(MemoryEntry*));
+	memset(store->buckets, '\0', store->nbuckets * sizeof(MemoryEntry*));
+	store->interval = options ? options->interval : MEMORY_SNAPSHOT_INTERVAL;
+	store->mutex = Thread_create_mutex();
+	store->file_mutex = Thread_create_mutex();
+	if ((rc = MemoryStore_recover(store)) != 0)
+	{
+		pmemclose(store);
+		goto exit;
+	}
+	if (store->interval > 0)
+	{
+		store->running = 1;
+		Thread_start(MemoryStore_writer, store);
+	}
+	*handle = store;
+exit:
+	FUNC_EXIT_RC(rc);
+	return rc;
+}
+
+
+/** Write the outstanding changes and close the file, deleting it and the client directory if
+ *  nothing is live.
+ *  See ::Persistence_close
+ */
+int pmemclose(void* handle)
+{
+	int rc = 0;
+	MemoryStore* store = handle;
+
+	FUNC_ENTRY;
+	if (store == NULL)
+	{
+		rc = MQTTCLIENT_PERSISTENCE_ERROR;
+		goto exit;
+	}
+
+	if (store->running)
+	{
+		store->running = 0;
+		while (!store->stopped)
+			usleep(1000L);
+	}
+	if (store->fd >= 0)
+	{
+		rc = MemoryStore_write(store);
+		close(store->fd);
+		if (store->count == 0)
+			unlink(store->path);
+	}
+	MemoryStore_empty(store);
+	free(store->buckets);
+	free(store->path);
+	Thread_destroy_mutex(store->mutex);
+	Thread_destroy_mutex(store->file_mutex);
+	if (pstclose(store->dir) != 0)
+		rc = MQTTCLIENT_PERSISTENCE_ERROR;
+	free(store);
+
+exit:
+	FUNC_EXIT_RC(rc);
+	return rc;
+}
+
+
+/** Set the data of a key in the table, to be written out on the next pass.
+ *  See ::Persistence_put
+ */
+int pmemput(void* handle, char* key, int bufcount, char* buffers[], int buflens[])
+{
+	int rc = 0;
+	MemoryStore* store = handle;
+	char* data;
+	int datalen = 0, i;
+
+	FUNC_ENTRY;
+	if (store == NULL)
+	{
+		rc = MQTTCLIENT_PERSISTENCE_ERROR;
+		goto exit;
+	}
+	for (i = 0; i < bufcount; ++i)
+		datalen += buflens[i];
+	data = malloc(datalen);
+	for (datalen = 0, i = 0; i < bufcount; ++i)
+	{
+		memcpy(data + datalen, buffers[i], buflens[i]);
+		datalen += buflens[i];
+	}
+	Thread_lock_mutex(store->mutex);
+	MemoryStore_setDirty(store, MemoryStore_set(store, key, data, datalen), 1);
+	Thread_unlock_mutex(store->mutex);
+
+exit:
+	FUNC_EXIT_RC(rc);
+	return rc;
+}
+
+
+/** Copy the data of a key out of the table.
+ *  See ::Persistence_get
+ */
+int pmemget(void* handle, char* key, char** buffer, int* buflen)
+{
+	int rc = 0;
+	MemoryStore* store = handle;
+	MemoryEntry* entry;
+
+	FUNC_ENTRY;
+	if (store == NULL)
+	{
+		rc = MQTTCLIENT_PERSISTENCE_ERROR;
+		goto exit;
+	}
+	Thread_lock_mutex(store->mutex);
+	entry = MemoryStore_find(store, key, MemoryStore_checksum(key, strlen(key), 2166136261u));
+	if (entry == NULL || entry->removed)
+		rc = MQTTCLIENT_PERSISTENCE_ERROR;
+	else
+	{
+		*buffer = malloc(entry->datalen);
+		memcpy(*buffer, entry->data, entry->datalen);
+		*buflen = entry->datalen;
+	}
+	Thread_unlock_mutex(store->mutex);
+
+exit:
+	FUNC_EXIT_RC(rc);
+	return rc;
+}
+
+
+/** Remove a key.  If the file never held it, it is forgotten straight away.
+ *  See ::Persistence_remove
+ */
+int pmemremove(void* handle, char* key)
+{
+	int rc = 0;
+	MemoryStore* store = handle;
+	MemoryEntry* entry;
+
+	FUNC_ENTRY;
+	if (store == NULL)
+	{
+		rc = MQTTCLIENT_PERSISTENCE_ERROR;
+		goto exit;
+	}
+	Thread_lock_mutex(store->mutex);
+	entry = MemoryStore_find(store, key, MemoryStore_checksum(key, strlen(key), 2166136261u));
+	if (entry && !entry->removed)
+	{
+		if (!entry->written)
+			MemoryStore_delete(store, entry);
+		else
+		{
+			store->live_bytes -= MemoryStore_length(entry);
+			--store->count;
+			free(entry->data);
+			entry->data = NULL;
+			entry->datalen = 0;
+			entry->removed = 1;
+			MemoryStore_setDirty(store, entry, 1);
+		}
+	}
+	Thread_unlock_mutex(store->mutex);
+
+exit:
+	FUNC_EXIT_RC(rc);
+	return rc;
+}
+
+
+/** Return the live keys of the table.
+ *  See ::Persistence_keys
+ */
+int pmemkeys(void* handle, char*** keys, int* nkeys)
+{
+	int rc = 0;
+	MemoryStore* store = handle;
+	char** fkeys = NULL;
+	unsigned int b;
+	int i = 0;
+
+	FUNC_ENTRY;
+	if (store == NULL)
+	{
+		rc = MQTTCLIENT_PERSISTENCE_ERROR;
+		goto exit;
+	}
+	Thread_lock_mutex(store->mutex);
+	if (store->count > 0)
+		fkeys = malloc(store->count * sizeof(char*));
+	for (b = 0; b < store->nbuckets; ++b)
+	{
+		MemoryEntry* entry;
+
+		for (entry = store->buckets[b]; entry; entry = entry->next)
+		{
+			if (!entry->removed)
+			{
+				fkeys[i] = malloc(strlen(entry->key) + 1);
+				strcpy(fkeys[i++], entry->key);
+			}
+		}
+	}
+	Thread_unlock_mutex(store->mutex);
+	*keys = fkeys;
+	*nkeys = i;
+
+exit:
+	FUNC_EXIT_RC(rc);
+	return rc;
+}
+
+
+/** Empty the table and the file.
+ *  See ::Persistence_clear
+ */
+int pmemclear(void* handle)
+{
+	int rc = 0;
+	MemoryStore* store = handle;
+
+	FUNC_ENTRY;
+	if (store == NULL)
+	{
+		rc = MQTTCLIENT_PERSISTENCE_ERROR;
+		goto exit;
+	}
+	Thread_lock_mutex(store->file_mutex);
+	Thread_lock_mutex(store->mutex);
+	MemoryStore_empty(store);
+	if (ftruncate(store->fd, 0) != 0)
+		rc = MQTTCLIENT_PERSISTENCE_ERROR;
+	lseek(store->fd, 0, SEEK_SET);
+	store->file_bytes = 0;
+	Thread_unlock_mutex(store->mutex);
+	Thread_unlock_mutex(store->file_mutex);
+
+exit:
+	FUNC_EXIT_RC(rc);
+	return rc;
+}
+
+
+/** Returns whether the key is live.
+ *  See ::Persistence_containskey
+ */
+int pmemcontainskey(void* handle, char* key)
+{
+	int rc = 0;
+	MemoryStore* store = handle;
+	MemoryEntry* entry;
+
+	FUNC_ENTRY;
+	if (store == NULL)
+	{
+		rc = MQTTCLIENT_PERSISTENCE_ERROR;
+		goto exit;
+	}
+	Thread_lock_mutex(store->mutex);
+	entry = MemoryStore_find(store, key, MemoryStore_checksum(key, strlen(key), 2166136261u));
+	if (entry == NULL || entry->removed)
+		rc = MQTTCLIENT_PERSISTENCE_ERROR;
+	Thread_unlock_mutex(store->mutex);
+
+exit:
+	FUNC_EXIT_RC(rc);
+	return rc;
+}
+
+#endif
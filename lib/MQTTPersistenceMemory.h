@@ -0,0 +1,41 @@
+/*******************************************************************************
+ * Copyright (c) 2017 IBM Corp.
+ *
+ * All rights reserved. This program and the accompanying materials
+ * are made available under the terms of the Eclipse Public License v1.0
+ * and Eclipse Distribution License v1.0 which accompany this distribution.
+ *
+ * The Eclipse Public License is available at
+ *    http://www.eclipse.org/legal/epl-v10.html
+ * and the Eclipse Distribution License is available at
+ *   http://www.eclipse.org/org/documents/edl-v10.php.
+ *
+ * Contributors:
+ *    in-memory persistence with snapshots - initial implementation
+ *******************************************************************************/
+
+#if !defined(MQTTPERSISTENCEMEMORY_H)
+#define MQTTPERSISTENCEMEMORY_H
+
+/** Name of the snapshot file in the client persistence directory */
+#define MEMORY_SNAPSHOT_FILE "session.psnap"
+/** Milliseconds between writes of the changes to the snapshot file, when not set in the context */
+#define MEMORY_SNAPSHOT_INTERVAL 1000
+/** Number of hash buckets a store starts with, doubled as it fills up */
+#define MEMORY_INITIAL_BUCKETS 64
+/** The file is rewritten as a snapshot once it is this many times the size of the live records */
+#define MEMORY_SNAPSHOT_RATIO 4
+/** ...and at least this size, so small stores are not rewritten on every write */
+#define MEMORY_SNAPSHOT_MIN_BYTES (64 * 1024)
+
+/* prototypes of the functions for the in-memory persistence */
+int pmemopen(void** handle, const char* clientID, const char* serverURI, void* context);
+int pmemclose(void* handle);
+int pmemput(void* handle, char* key, int bufcount, char* buffers[], int buflens[]);
+int pmemget(void* handle, char* key, char** buffer, int* buflen);
+int pmemremove(void* handle, char* key);
+int pmemkeys(void* handle, char*** keys, int* nkeys);
+int pmemclear(void* handle);
+int pmemcontainskey(void* handle, char* key);
+
+#endif
@@ -17,6 +17,7 @@
  *    Ian Craggs - fix for bug 421103 - trying to write to same socket, in retry
  *    Rong Xiang, Ian Craggs - C++ compatibility
  *    Ian Craggs - turn off DUP flag for PUBREL - MQTT 3.1.1
+ *    round trip samples and loss signals for the in-flight window
  *******************************************************************************/
 
 /**
@@ -190,6 +191,7 @@ Messages* MQTTProtocol_createMessage(Publish* publish, Messages **mm, int qos, i
 	m->qos = qos;
 	m->retain = retained;
 	time(&(m->lastTouch));
+	m->sent = MQTTInflight_now();
 	if (qos == 2)
 		m->nextMessageType = PUBREC;
 	FUNC_EXIT;
@@ -330,6 +332,7 @@ int MQTTProtocol_handlePubacks(void* pack, int sock)
 		else
 		{
 			Log(TRACE_MIN, 6, NULL, "PUBACK", client->clientID, puback->msgId);
+			MQTTInflight_acked(&client->inflight, m->sent, MQTTInflight_now());
 			#if !defined(NO_PERSISTENCE)
 				rc = MQTTPersistence_remove(client, PERSISTENCE_PUBLISH_SENT, m->qos, puback->msgId);
 			#endif
@@ -381,6 +384,8 @@ int MQTTProtocol_handlePubrecs(void* pack, int sock)
 		}
 		else
 		{
+			MQTTInflight_acked(&client->inflight, m->sent, MQTTInflight_now());
+			m->sent = 0;
 			rc = MQTTPacket_send_pubrel(pubrec->msgId, 0, &client->net, client->clientID);
 			m->nextMessageType = PUBCOMP;
 			time(&(m->lastTouch));
@@ -574,6 +579,10 @@ void MQTTProtocol_retries(time_t now, Clients* client, int regardless)
 				int rc;
 
 				Log(TRACE_MIN, 7, NULL, "PUBLISH", client->clientID, client->net.socket, m->msgid);
+				/* a resend on reconnect is not a sign of congestion, a timed out one is */
+				if (!regardless)
+					MQTTInflight_lost(&client->inflight, MQTTInflight_now());
+				m->sent = 0;
 				publish.msgId = m->msgid;
 				publish.topic = m->publish->topic;
 				publish.payload = m->publish->payload;
@@ -14,6 +14,7 @@
 #include <log4cpp/TimeStamp.hh>
 #include <log4cpp/FactoryParams.hh>
 #include <memory>
+#include <atomic>
 
 #ifdef LOG4CPP_HAVE_SSTREAM
 #include <sstream>
@@ -48,208 +49,64 @@ std::ostream& operator<<(std::ostream& os, int64_t i) {
 
 namespace log4cpp {
 
-    struct StringLiteralComponent : public PatternLayout::PatternComponent {
-        StringLiteralComponent(const std::string& literal) :
-            _literal(literal) {
+    namespace {
+        const char* const FORMAT_ISO8601 = "%Y-%m-%d %H:%M:%S,%l";
+        const char* const FORMAT_ABSOLUTE = "%H:%M:%S,%l";
+        const char* const FORMAT_DATE = "%d %b %Y %H:%M:%S,%l";
+
+        // The dates a thread formatted last, each for the second it was
+        // formatted in, keyed by the dateId of its component
+        struct DateCache {
+            unsigned long dateId;
+            std::time_t seconds;
+            std::string before;         // the date up to its milliseconds
+            std::string after;          // and after them
+        };
+
+        const size_t DATE_CACHES = 8;
+        std::atomic<unsigned long> nextDateId(1);
+        thread_local DateCache dateCaches[DATE_CACHES];
+
+        void appendTime(std::string& out, const std::string& format, const struct std::tm& time) {
+            if (format.empty())
+                return;
+            char formatted[100];
+            out.append(formatted, std::strftime(formatted, sizeof(formatted), format.c_str(), &time));
         }
 
-        virtual void append(std::ostringstream& out, const LoggingEvent& event) {
-            out << _literal;
+        void appendInteger(std::string& out, long long value) {
+            char digits[24];
+            char* p = digits + sizeof(digits);
+            unsigned long long magnitude = (value < 0) ? 0ULL - (unsigned long long)value : value;
+            do {
+                *--p = (char)('0' + magnitude % 10);
+                magnitude /= 10;
+            } while (magnitude);
+            if (value < 0)
+                *--p = '-';
+            out.append(p, digits + sizeof(digits) - p);
         }
 
-        private:
-        std::string _literal;
-    };
-
-    struct CategoryNameComponent : public PatternLayout::PatternComponent {
-        CategoryNameComponent(std::string specifier) {
-            if (specifier == "") {
-                _precision = -1;
-            } else {
-#ifdef LOG4CPP_HAVE_SSTREAM 
-                std::istringstream s(specifier);
-#else
-                std::istrstream s(specifier.c_str());
-#endif
-                s >> _precision;
+        void appendCategory(std::string& out, const std::string& categoryName, int precision) {
+            if (precision == -1) {
+                out += categoryName;
+                return;
             }
-        }
-
-        virtual void append(std::ostringstream& out, const LoggingEvent& event) {
-            if (_precision == -1) {
-                out << event.categoryName;
-            } else {
-                std::string::size_type begin = std::string::npos;
-                for(int i = 0; i < _precision; i++) {
-                    begin = event.categoryName.rfind('.', begin - 2);
-                    if (begin == std::string::npos) {
-                        begin = 0;
-                        break;
-                    }
-                    begin++;
-                }
+            std::string::size_type begin = std::string::npos;
+            for(int i = 0; i < precision; i++) {
+                begin = categoryName.rfind('.', begin - 2);
                 if (begin == std::string::npos) {
                     begin = 0;
+                    break;
                 }
-                out << event.categoryName.substr(begin);
-            }
-        }
-
-        private:
-        int _precision;
-    };
-
-    struct MessageComponent : public PatternLayout::PatternComponent {
-        virtual void append(std::ostringstream& out, const LoggingEvent& event) {
-            out << event.message;
-        }
-    };
-
-    struct NDCComponent : public PatternLayout::PatternComponent {
-        virtual void append(std::ostringstream& out, const LoggingEvent& event) {
-            out << event.ndc;
-        }
-    };
-
-    struct PriorityComponent : public PatternLayout::PatternComponent {
-        virtual void append(std::ostringstream& out, const LoggingEvent& event) {
-            out << Priority::getPriorityName(event.priority);
-        }
-    };
-
-    struct ThreadNameComponent : public PatternLayout::PatternComponent {
-        virtual void append(std::ostringstream& out, const LoggingEvent& event) {
-            out << event.threadName;
-        }
-    };
-
-    struct ProcessorTimeComponent : public PatternLayout::PatternComponent {
-        virtual void append(std::ostringstream& out, const LoggingEvent& event) {
-            out << std::clock();
-        }
-    };
-
-    struct TimeStampComponent : public PatternLayout::PatternComponent {
-        static const char* const FORMAT_ISO8601;
-        static const char* const FORMAT_ABSOLUTE;
-        static const char* const FORMAT_DATE;
-
-        TimeStampComponent(std::string timeFormat) {
-            if ((timeFormat == "") || (timeFormat == "ISO8601")) {
-                timeFormat = FORMAT_ISO8601;
-            } else if (timeFormat == "ABSOLUTE") {
-                timeFormat = FORMAT_ABSOLUTE;
-            } else if (timeFormat == "DATE") {
-                timeFormat = FORMAT_DATE;
-            }
-            std::string::size_type pos = timeFormat.find("%l");
-            if (pos == std::string::npos) {
-                _printMillis = false;
-                _timeFormat1 = timeFormat; 
-            } else {
-                _printMillis = true;
-                _timeFormat1 = timeFormat.substr(0, pos);
-                _timeFormat2 = timeFormat.substr(pos + 2);
-            }
-        }
-
-        virtual void append(std::ostringstream& out, const LoggingEvent& event) {
-            struct std::tm currentTime;
-            std::time_t t = event.timeStamp.getSeconds();
-            localtime(&t, &currentTime);
-            char formatted[100];
-            std::string timeFormat;
-            if (_printMillis) {
-                std::ostringstream formatStream;
-                formatStream << _timeFormat1 
-                             << std::setw(3) << std::setfill('0')
-                             << event.timeStamp.getMilliSeconds()
-                             << _timeFormat2;
-                timeFormat = formatStream.str();
-            } else {
-                timeFormat = _timeFormat1;
-            }
-            std::strftime(formatted, sizeof(formatted), timeFormat.c_str(), &currentTime);
-            out << formatted;
-        }
-
-        private:
-        std::string _timeFormat1;
-        std::string _timeFormat2;
-        bool _printMillis;
-    };
-
-    const char* const TimeStampComponent::FORMAT_ISO8601 = "%Y-%m-%d %H:%M:%S,%l";
-    const char* const TimeStampComponent::FORMAT_ABSOLUTE = "%H:%M:%S,%l";
-    const char* const TimeStampComponent::FORMAT_DATE = "%d %b %Y %H:%M:%S,%l";
-
-    struct SecondsSinceEpochComponent : public PatternLayout::PatternComponent {
-        virtual void append(std::ostringstream& out, const LoggingEvent& event) {
-            out << event.timeStamp.getSeconds();
-        }
-    };
-
-    struct MillisSinceEpochComponent : public PatternLayout::PatternComponent {
-        virtual void append(std::ostringstream& out, const LoggingEvent& event) {
-#ifdef LOG4CPP_HAVE_INT64_T
-            int64_t t = event.timeStamp.getSeconds() -
-                TimeStamp::getStartTime().getSeconds();
-            t *= 1000;
-            t += event.timeStamp.getMilliSeconds() -
-                TimeStamp::getStartTime().getMilliSeconds();
-            
-            out << t;
-#else
-            double t = event.timeStamp.getSeconds() -
-                TimeStamp::getStartTime().getSeconds();
-            t *= 1000;
-            t += event.timeStamp.getMilliSeconds() -
-                TimeStamp::getStartTime().getMilliSeconds();
-            
-            out << std::setiosflags(std::ios::fixed)
-                << std::setprecision(0) << t;
-#endif
-        }
-    };
-
-    struct FormatModifierComponent : public PatternLayout::PatternComponent {
-        FormatModifierComponent(PatternLayout::PatternComponent* component,
-                                size_t minWidth, size_t maxWidth, bool alignLeft) :
-            _component(component) , 
-            _minWidth(minWidth),
-            _maxWidth(maxWidth),
-            _alignLeft(alignLeft) {
-        }
-
-        virtual ~FormatModifierComponent() {
-            delete _component;
-        }
-
-        virtual void append(std::ostringstream& out, const LoggingEvent& event) {
-            std::ostringstream s;
-            _component->append(s, event);
-            std::string msg = s.str();
-            if (_maxWidth > 0 && _maxWidth < msg.length()) {
-                msg.erase(_maxWidth);
+                begin++;
             }
-            size_t fillCount = _minWidth - msg.length();
-            if (_minWidth > msg.length()) {
-                if (_alignLeft) {
-                    out << msg << std::string(fillCount, ' ');
-                } else {
-                    out << std::string(fillCount, ' ') << msg;
-                }
-            } else {
-                out << msg;
+            if (begin == std::string::npos) {
+                begin = 0;
             }
+            out.append(categoryName, begin, std::string::npos);
         }
-
-        private:
-        PatternLayout::PatternComponent* _component;
-        size_t _minWidth;
-        size_t _maxWidth;
-        bool _alignLeft;
-    };
+    }
 
     const char* PatternLayout::DEFAULT_CONVERSION_PATTERN = "%m%n";
     const char* PatternLayout::SIMPLE_CONVERSION_PATTERN = "%p - %m%n";
@@ -267,11 +124,19 @@ namespace log4cpp {
         clearConversionPattern();
     }
 
+    PatternLayout::Component PatternLayout::literalComponent(const std::string& literal) {
+        Component component;
+        component.kind = Component::LITERAL;
+        component.text = literal;
+        component.millis = false;
+        component.dateId = 0;
+        component.precision = -1;
+        component.minWidth = component.maxWidth = 0;
+        component.alignLeft = false;
+        return component;
+    }
+
     void PatternLayout::clearConversionPattern() {
-        for(ComponentVector::const_iterator i = _components.begin();
-            i != _components.end(); ++i) {
-            delete (*i);
-        }
         _components.clear();
         _conversionPattern = "";
     }
@@ -285,7 +150,8 @@ namespace log4cpp {
         std::string literal;
 
         char ch;
-        PatternLayout::PatternComponent* component = NULL;
+        Component component;
+        bool converted = false;
         int minWidth = 0;
         size_t maxWidth = 0;
         clearConversionPattern();
@@ -324,12 +190,19 @@ namespace log4cpp {
                         }
                     }
                 }
+                component.text.clear();
+                component.textAfter.clear();
+                component.millis = false;
+                component.dateId = 0;
+                component.precision = -1;
+                converted = true;
                 switch (ch) {
                 case '%':
                     literal += ch;
+                    converted = false;
                     break;
                 case 'm':
-                    component = new MessageComponent();
+                    component.kind = Component::MESSAGE;
                     break;
                 case 'n':
                     {
@@ -337,54 +210,78 @@ namespace log4cpp {
                         endline << std::endl;
                         literal += endline.str();
                     }
+                    converted = false;
                     break;
                 case 'c':
-                    component = new CategoryNameComponent(specPostfix);
+                    component.kind = Component::CATEGORY;
+                    if (specPostfix != "") {
+#ifdef LOG4CPP_HAVE_SSTREAM 
+                        std::istringstream s(specPostfix);
+#else
+                        std::istrstream s(specPostfix.c_str());
+#endif
+                        s >> component.precision;
+                    }
                     break;
                 case 'd':
-                    component = new TimeStampComponent(specPostfix);
+                    {
+                        std::string timeFormat = specPostfix;
+                        if ((timeFormat == "") || (timeFormat == "ISO8601")) {
+                            timeFormat = FORMAT_ISO8601;
+                        } else if (timeFormat == "ABSOLUTE") {
+                            timeFormat = FORMAT_ABSOLUTE;
+                        } else if (timeFormat == "DATE") {
+                            timeFormat = FORMAT_DATE;
+                        }
+                        std::string::size_type pos = timeFormat.find("%l");
+                        component.kind = Component::DATE;
+                        component.millis = (pos != std::string::npos);
+                        component.text = timeFormat.substr(0, pos);
+                        if (component.millis)
+                            component.textAfter = timeFormat.substr(pos + 2);
+                        component.dateId = nextDateId++;
+                    }
                     break;
                 case 'p':
-                    component = new PriorityComponent();
+                    component.kind = Component::PRIORITY;
                     break;
                 case 'r':
-                    component = new MillisSinceEpochComponent();
+                    component.kind = Component::MILLIS_SINCE_START;
                     break;
                 case 'R':
-                    component = new SecondsSinceEpochComponent();
+                    component.kind = Component::SECONDS_SINCE_EPOCH;
                     break;
                 case 't':
-                    component = new ThreadNameComponent();
+                    component.kind = Component::THREAD;
                     break;
                 case 'u':
-                    component = new ProcessorTimeComponent();
+                    component.kind = Component::PROCESSOR_TIME;
                     break;
                 case 'x':
-                    component = new NDCComponent();
+                    component.kind = Component::NDC;
                     break;
                 default:
                     std::ostringstream msg;
                     msg << "unknown conversion specifier '" << ch << "' in '" << conversionPattern << "' at index " << conversionStream.tellg();
                     throw ConfigureFailure(msg.str());                    
                 }
-                if (component) {
+                if (converted) {
                     if (!literal.empty()) {
-                        _components.push_back(new StringLiteralComponent(literal));
+                        _components.push_back(literalComponent(literal));
                         literal = "";
                     }
-                    if ((minWidth != 0) || (maxWidth != 0)) {
-                        component = new FormatModifierComponent(component, std::abs(minWidth), maxWidth, minWidth < 0);
-                        minWidth = maxWidth = 0;
-                    }
+                    component.minWidth = std::abs(minWidth);
+                    component.maxWidth = maxWidth;
+                    component.alignLeft = minWidth < 0;
+                    minWidth = maxWidth = 0;
                     _components.push_back(component);
-                    component = NULL;
                 }
             } else {
                 literal += ch;
             }
         }
         if (!literal.empty()) {
-            _components.push_back(new StringLiteralComponent(literal));
+            _components.push_back(literalComponent(literal));
         }
 
         _conversionPattern = conversionPattern;
@@ -395,14 +292,92 @@ namespace log4cpp {
     }
 
     std::string PatternLayout::format(const LoggingEvent& event) {
-        std::ostringstream message;
+        static thread_local std::string message;
+        message.clear();
+        appendFormatted(event, message);
+        return message;
+    }
 
+    void PatternLayout::appendFormatted(const LoggingEvent& event, std::string& out) {
         for(ComponentVector::const_iterator i = _components.begin();
             i != _components.end(); ++i) {
-            (*i)->append(message, event);
-        }
+            const Component& component = *i;
+            std::string::size_type start = out.size();
+            switch (component.kind) {
+            case Component::LITERAL:
+                out += component.text;
+                break;
+            case Component::MESSAGE:
+                out += event.message;
+                break;
+            case Component::CATEGORY:
+                appendCategory(out, event.categoryName, component.precision);
+                break;
+            case Component::DATE:
+                {
+                    std::time_t t = event.timeStamp.getSeconds();
+                    DateCache& cache = dateCaches[component.dateId % DATE_CACHES];
+                    if (cache.dateId != component.dateId || cache.seconds != t) {
+                        struct std::tm currentTime;
+                        localtime(&t, &currentTime);
+                        cache.before.clear();
+                        cache.after.clear();
+                        appendTime(cache.before, component.text, currentTime);
+                        appendTime(cache.after, component.textAfter, currentTime);
+                        cache.dateId = component.dateId;
+                        cache.seconds = t;
+                    }
+                    out += cache.before;
+                    if (component.millis) {
+                        int millis = event.timeStamp.getMilliSeconds();
+                        out += (char)('0' + millis / 100 % 10);
+                        out += (char)('0' + millis / 10 % 10);
+                        out += (char)('0' + millis % 10);
+                    }
+                    out += cache.after;
+                }
+                break;
+            case Component::PRIORITY:
+                out += Priority::getPriorityName(event.priority);
+                break;
+            case Component::MILLIS_SINCE_START:
+                {
+                    long long t = (long long)event.timeStamp.getSeconds() -
+                        TimeStamp::getStartTime().getSeconds();
+                    t *= 1000;
+                    t += event.timeStamp.getMilliSeconds() -
+                        TimeStamp::getStartTime().getMilliSeconds();
+                    appendInteger(out, t);
+                }
+                break;
+            case Component::SECONDS_SINCE_EPOCH:
+                appendInteger(out, event.timeStamp.getSeconds());
+                break;
+            case Component::THREAD:
+                out += event.threadName;
+                break;
+            case Component::PROCESSOR_TIME:
+                appendInteger(out, std::clock());
+                break;
+            case Component::NDC:
+                out += event.ndc;
+                break;
+            }
 
-        return message.str();
+            // the format modifiers, on what the component wrote
+            std::string::size_type length = out.size() - start;
+            if (component.maxWidth > 0 && component.maxWidth < length) {
+                out.erase(start + component.maxWidth);
+                length = component.maxWidth;
+            }
+            if (component.minWidth > length) {
+                if (component.alignLeft) {
+                    out.append(component.minWidth - length, ' ');
+                } else {
+                    out.insert(start, component.minWidth - length, ' ');
+                }
+            }
+        }
     }
 
     std::auto_ptr<Layout> create_pattern_layout(const FactoryParams& params)
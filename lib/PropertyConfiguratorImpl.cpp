@@ -27,6 +27,7 @@
 #include <log4cpp/RollingFileAppender.hh>
 #include <log4cpp/DailyRollingFileAppender.hh>
 #include <log4cpp/AbortAppender.hh>
+#include <log4cpp/AsyncAppender.hh>
 #ifdef WIN32
 #include <log4cpp/Win32DebugAppender.hh>
 #include <log4cpp/NTEventLogAppender.hh>
@@ -46,6 +47,7 @@
 #include <log4cpp/BasicLayout.hh>
 #include <log4cpp/SimpleLayout.hh>
 #include <log4cpp/PatternLayout.hh>
+#include <log4cpp/PassThroughLayout.hh>
 
 #include <log4cpp/Priority.hh>
 #include <log4cpp/NDC.hh>
@@ -121,10 +123,12 @@ namespace log4cpp {
                 // simply skip properties for the current appender
             } else {
                 if (i2 == iEnd) {
-                    // a new appender
+                    // a new appender, unless an AsyncAppender made it already as its sink
                     currentAppender = appenderName;
-                    _allAppenders[currentAppender] = 
-                        instantiateAppender(currentAppender);
+                    if (_allAppenders.find(currentAppender) == _allAppenders.end()) {
+                        _allAppenders[currentAppender] = 
+                            instantiateAppender(currentAppender);
+                    }
                 } else {
                     throw ConfigureFailure(std::string("partial appender definition : ") + key);
                 }
@@ -259,6 +263,31 @@ namespace log4cpp {
         else if (appenderType == "AbortAppender") {
             appender = new AbortAppender(appenderName);
         }
+        else if (appenderType == "AsyncAppender") {
+            // the sink is another appender of the file, made here if it comes later
+            std::string sinkName = _properties.getString(appenderPrefix + ".appender", "");
+            std::string sinkType = _properties.getString(std::string("appender.") + sinkName, "");
+            if (sinkType == "")
+                throw ConfigureFailure(std::string("Appender '") + appenderName +
+                                       "' has no appender to write to");
+            if (sinkType.substr(sinkType.find_last_of(".") + 1) == "AsyncAppender")
+                throw ConfigureFailure(std::string("Appender '") + appenderName +
+                                       "' writes to another AsyncAppender '" + sinkName + "'");
+            AppenderMap::const_iterator sink = _allAppenders.find(sinkName);
+            Appender* sinkAppender = (sink != _allAppenders.end()) ? (*sink).second :
+                (_allAppenders[sinkName] = instantiateAppender(sinkName));
+
+            size_t bufferSize = _properties.getInt(appenderPrefix + ".bufferSize", 1024);
+            std::string overflowName = _properties.getString(appenderPrefix + ".overflow", "block");
+            AsyncAppender::OverflowPolicy overflow;
+            try {
+                overflow = AsyncAppender::getOverflowPolicy(overflowName);
+            } catch(std::invalid_argument& e) {
+                throw ConfigureFailure(std::string(e.what()) +
+                    " for appender '" + appenderName + "'");
+            }
+            appender = new AsyncAppender(appenderName, *sinkAppender, bufferSize, overflow);
+        }
 #ifdef LOG4CPP_HAVE_LIBIDSA
         else if (appenderType == "IdsaAppender") {
             // default idsa name ???
@@ -339,6 +368,9 @@ namespace log4cpp {
 
             layout = patternLayout;
         }
+        else if (layoutType == "PassThroughLayout") {
+            layout = new PassThroughLayout();
+        }
         else {
             throw ConfigureFailure(std::string("Unknown layout type '" + layoutType +
                                                "' for appender '") + appenderName + "'");
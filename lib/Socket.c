@@ -32,6 +32,9 @@
 #if defined(OPENSSL)
 #include "SSLSocket.h"
 #endif
+#if defined(IO_URING)
+#include "SocketUring.h"
+#endif
 
 #include <stdlib.h>
 #include <string.h>
@@ -131,6 +134,9 @@ void Socket_outInitialize()
 	FD_ZERO(&(s.pending_wset));
 	s.maxfdp1 = 0;
 	memcpy((void*)&(s.rset_saved), (void*)&(s.rset), sizeof(s.rset_saved));
+#if defined(IO_URING)
+	SocketUring_initialize();
+#endif
 	FUNC_EXIT;
 }
 
@@ -141,6 +147,9 @@ void Socket_outInitialize()
 void Socket_outTerminate()
 {
 	FUNC_ENTRY;
+#if defined(IO_URING)
+	SocketUring_terminate();
+#endif
 	ListFree(s.connect_pending);
 	ListFree(s.write_pending);
 	ListFree(s.clientsds);
@@ -223,6 +232,16 @@ int Socket_getReadySocket(int more_work, struct timeval *tp)
 	else if (tp)
 		timeout = *tp;
 
+#if defined(IO_URING)
+	if ((rc = SocketUring_nextReady()) != 0)
+		goto exit;
+	if (SocketUring_count() == s.clientsds->count)
+	{	/* every socket is served by the ring, so there is nothing for select to do */
+		rc = SocketUring_wait(&timeout);
+		goto exit;
+	}
+#endif
+
 	while (s.cur_clientsds != NULL)
 	{
 		if (isReady(*((int*)(s.cur_clientsds->content)), &(s.rset), &wset))
@@ -233,11 +252,20 @@ int Socket_getReadySocket(int more_work, struct timeval *tp)
 	if (s.cur_clientsds == NULL)
 	{
 		int rc1;
+		int nfds = s.maxfdp1;
 		fd_set pwset;
 
 		memcpy((void*)&(s.rset), (void*)&(s.rset_saved), sizeof(s.rset));
 		memcpy((void*)&(pwset), (void*)&(s.pending_wset), sizeof(pwset));
-		if ((rc = select(s.maxfdp1, &(s.rset), &pwset, NULL, &timeout)) == SOCKET_ERROR)
+#if defined(IO_URING)
+		if (SocketUring_fd() >= 0)
+		{	/* the ring descriptor is readable when completions are waiting */
+			SocketUring_flushPending();
+			FD_SET(SocketUring_fd(), &(s.rset));
+			nfds = max(nfds, SocketUring_fd() + 1);
+		}
+#endif
+		if ((rc = select(nfds, &(s.rset), &pwset, NULL, &timeout)) == SOCKET_ERROR)
 		{
 			Socket_error("read select", 0);
 			goto exit;
@@ -273,7 +301,11 @@ int Socket_getReadySocket(int more_work, struct timeval *tp)
 	}
 
 	if (s.cur_clientsds == NULL)
+#if defined(IO_URING)
+		rc = SocketUring_nextReady();
+#else
 		rc = 0;
+#endif
 	else
 	{
 		rc = *((int*)(s.cur_clientsds->content));
@@ -285,6 +317,23 @@ exit:
 } /* end getReadySocket */
 
 
+/**
+ *  Receives data from a socket, from the io_uring read-ahead buffer if the socket is served by the ring
+ *  @param socket the socket to read from
+ *  @param buf the buffer to read into
+ *  @param len the maximum number of bytes to read
+ *  @return the recv return code
+ */
+static int Socket_recv(int socket, char* buf, size_t len)
+{
+#if defined(IO_URING)
+	if (SocketUring_armed(socket))
+		return SocketUring_recv(socket, buf, len);
+#endif
+	return recv(socket, buf, len, 0);
+}
+
+
 /**
  *  Reads one byte from a socket
  *  @param socket the socket to read from
@@ -299,7 +348,7 @@ int Socket_getch(int socket, char* c)
 	if ((rc = SocketBuffer_getQueuedChar(socket, c)) != SOCKETBUFFER_INTERRUPTED)
 		goto exit;
 
-	if ((rc = recv(socket, c, (size_t)1, 0)) == SOCKET_ERROR)
+	if ((rc = Socket_recv(socket, c, (size_t)1)) == SOCKET_ERROR)
 	{
 		int err = Socket_error("recv - getch", socket);
 		if (err == EWOULDBLOCK || err == EAGAIN)
@@ -343,7 +392,7 @@ char *Socket_getdata(int socket, size_t bytes, size_t* actual_len)
 
 	buf = SocketBuffer_getQueuedData(socket, bytes, actual_len);
 
-	if ((rc = recv(socket, buf + (*actual_len), (int)(bytes - (*actual_len)), 0)) == SOCKET_ERROR)
+	if ((rc = Socket_recv(socket, buf + (*actual_len), (int)(bytes - (*actual_len)))) == SOCKET_ERROR)
 	{
 		rc = Socket_error("recv - getdata", socket);
 		if (rc != EAGAIN && rc != EWOULDBLOCK)
@@ -463,6 +512,21 @@ int Socket_putdatas(int socket, char* buf0, size_t buf0len, int count, char** bu
 		frees1[i+1] = frees[i];
 	}
 
+#if defined(IO_URING)
+	/* the first write on a plain TCP socket is the MQTT CONNECT, after which the ring takes over */
+	if (!SocketUring_armed(socket) && SocketUring_arm(socket) == 0)
+	{
+		FD_CLR(socket, &(s.rset_saved));
+		FD_CLR(socket, &(s.rset));
+	}
+	if (SocketUring_armed(socket))
+	{
+		if ((rc = SocketUring_putdatas(socket, iovecs, count+1)) == SOCKET_ERROR)
+			Socket_error("io_uring - putdatas", socket);
+		goto exit;
+	}
+#endif
+
 	if ((rc = Socket_writev(socket, iovecs, count+1, &bytes)) != SOCKET_ERROR)
 	{
 		if (bytes == total)
@@ -548,6 +612,9 @@ int Socket_close_only(int socket)
 void Socket_close(int socket)
 {
 	FUNC_ENTRY;
+#if defined(IO_URING)
+	SocketUring_disarm(socket);
+#endif
 	Socket_close_only(socket);
 	FD_CLR(socket, &(s.rset_saved));
 	if (FD_ISSET(socket, &(s.pending_wset)))
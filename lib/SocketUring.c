@@ -0,0 +1,850 @@
+/*******************************************************************************
+ * Copyright (c) 2017 IBM Corp.
+ *
+ * All rights reserved. This program and the accompanying materials
+ * are made available under the terms of the Eclipse Public License v1.0
+ * and Eclipse Distribution License v1.0 which accompany this distribution.
+ *
+ * The Eclipse Public License is available at
+ *    http://www.eclipse.org/legal/epl-v10.html
+ * and the Eclipse Distribution License is available at
+ *   http://www.eclipse.org/org/documents/edl-v10.php.
+ *
+ * Contributors:
+ *    io_uring socket backend - initial implementation
+ *******************************************************************************/
+
+/**
+ * @file
+ * \brief io_uring backend for plain TCP sockets
+ *
+ * Once the CONNECT packet is written, a socket is handed to a single process wide ring.
+ * Inbound data arrives through one multishot recv into a ring of provided buffers, and is
+ * copied into a per socket read-ahead buffer which Socket_getch and Socket_getdata drain
+ * without system calls.  Outbound packets are copied into a per socket buffer; at most one
+ * send is in flight per socket, and packets written while it is outstanding are batched into
+ * the next one.  SSL sockets are never armed and keep using select.
+ */
+
+#if defined(IO_URING)
+
+#include "SocketUring.h"
+#include "Log.h"
+#include "StackTrace.h"
+#include "Thread.h"
+#include "LinkedList.h"
+
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <signal.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "Heap.h"
+
+#define URING_ENTRIES 256			/**< submission queue size */
+#define URING_BUF_COUNT 64			/**< number of provided receive buffers, must be a power of 2 */
+#define URING_BUF_SIZE 16384		/**< size of each provided receive buffer */
+#define URING_BUF_GROUP 1			/**< buffer group id of the provided receive buffers */
+
+#define URING_OP_RECV 1
+#define URING_OP_SEND 2
+#define URING_OP_CANCEL 3
+#define URING_OP_MASK 3
+
+/**
+ * io_uring state for one socket.  The structure stays allocated until the kernel has
+ * completed every operation that refers to it, even after the socket is closed.
+ */
+typedef struct
+{
+	int socket;
+	int inflight;		/**< operations still owned by the kernel */
+	int closing;		/**< Socket_close has been called */
+	int recv_armed;		/**< a recv is outstanding */
+	int multishot;		/**< the kernel accepts multishot recv */
+	int eof;			/**< the peer closed the connection */
+	int error;			/**< errno of a failed recv or send */
+	char* inbuf;		/**< received data not yet read by the packet layer */
+	size_t inpos, inlen, insize;
+	char* outbuf;		/**< packets written while a send was in flight */
+	size_t outlen, outsize;
+	char* sendbuf;		/**< data of the send in flight */
+	size_t sendpos, sendlen, sendsize;
+	int sending;
+} uring_socket;
+
+static struct
+{
+	int fd;
+	unsigned sq_entries;
+	unsigned *sq_head, *sq_tail, *sq_mask, *sq_array;
+	unsigned *cq_head, *cq_tail, *cq_mask;
+	unsigned sq_local_tail;
+	struct io_uring_sqe* sqes;
+	struct io_uring_cqe* cqes;
+	void* sq_ring;
+	size_t sq_ring_size;
+	void* cq_ring;
+	size_t cq_ring_size;
+	size_t sqes_size;
+	struct io_uring_buf_ring* br;
+	size_t br_size;
+	unsigned short br_tail;
+	char* bufs;
+	List* sockets;
+	int last_ready;
+	mutex_type mutex;
+} uring;
+
+
+static int uring_socketcompare(void* a, void* b)
+{
+	uring_socket* us = (uring_socket*)a;
+
+	return us->socket == *(int*)b && !us->closing;
+}
+
+
+static uring_socket* SocketUring_find(int socket)
+{
+	ListElement* found = ListFindItem(uring.sockets, &socket, uring_socketcompare);
+
+	return (found) ? (uring_socket*)(found->content) : NULL;
+}
+
+
+/**
+ * Make sure a growable buffer can hold a number of bytes
+ * @param buf the buffer, reallocated if necessary
+ * @param size the current size of the buffer, updated
+ * @param needed the number of bytes needed
+ */
+static void SocketUring_reserve(char** buf, size_t* size, size_t needed)
+{
+	if (needed > *size)
+	{
+		size_t newsize = (*size) ? *size : 1024;
+
+		while (newsize < needed)
+			newsize *= 2;
+		*buf = (*buf) ? realloc(*buf, newsize) : malloc(newsize);
+		*size = newsize;
+	}
+}
+
+
+static int SocketUring_enter(unsigned to_submit, unsigned min_complete, unsigned flags, void* arg, size_t argsz)
+{
+	return (int)syscall(__NR_io_uring_enter, uring.fd, to_submit, min_complete, flags, arg, argsz);
+}
+
+
+/**
+ * Get a free submission queue entry.  Must be called with the uring mutex held.
+ * @return the zeroed entry, or NULL if the submission queue is full
+ */
+static struct io_uring_sqe* SocketUring_getsqe(void)
+{
+	struct io_uring_sqe* sqe = NULL;
+	unsigned index;
+
+	if (uring.sq_local_tail - __atomic_load_n(uring.sq_head, __ATOMIC_ACQUIRE) >= uring.sq_entries)
+	{
+		SocketUring_submit();
+		if (uring.sq_local_tail - __atomic_load_n(uring.sq_head, __ATOMIC_ACQUIRE) >= uring.sq_entries)
+			goto exit;
+	}
+	index = uring.sq_local_tail & *uring.sq_mask;
+	sqe = &uring.sqes[index];
+	memset(sqe, '\0', sizeof(*sqe));
+	uring.sq_array[index] = index;
+	++uring.sq_local_tail;
+exit:
+	return sqe;
+}
+
+
+/**
+ * Publish the prepared entries to the kernel.  Must be called with the uring mutex held.
+ * @return the number of entries the kernel has not consumed yet
+ */
+static unsigned SocketUring_flush(void)
+{
+	__atomic_store_n(uring.sq_tail, uring.sq_local_tail, __ATOMIC_RELEASE);
+	return uring.sq_local_tail - __atomic_load_n(uring.sq_head, __ATOMIC_ACQUIRE);
+}
+
+
+static void SocketUring_provide(unsigned short bid)
+{
+	struct io_uring_buf* buf = &uring.br->bufs[uring.br_tail & (URING_BUF_COUNT - 1)];
+
+	buf->addr = (__u64)(uintptr_t)(uring.bufs + (size_t)bid * URING_BUF_SIZE);
+	buf->len = URING_BUF_SIZE;
+	buf->bid = bid;
+	++uring.br_tail;
+	__atomic_store_n(&uring.br->tail, uring.br_tail, __ATOMIC_RELEASE);
+}
+
+
+static void SocketUring_armRecv(uring_socket* us)
+{
+	struct io_uring_sqe* sqe = SocketUring_getsqe();
+
+	if (sqe == NULL)
+	{
+		Log(LOG_ERROR, -1, "io_uring submission queue full, cannot arm recv for socket %d", us->socket);
+		us->error = ENOBUFS;
+		return;
+	}
+	sqe->opcode = IORING_OP_RECV;
+	sqe->fd = us->socket;
+	sqe->flags = IOSQE_BUFFER_SELECT;
+	sqe->buf_group = URING_BUF_GROUP;
+	if (us->multishot)
+		sqe->ioprio = IORING_RECV_MULTISHOT;
+	else
+		sqe->len = URING_BUF_SIZE;
+	sqe->user_data = (__u64)(uintptr_t)us | URING_OP_RECV;
+	us->recv_armed = 1;
+	++us->inflight;
+}
+
+
+static void SocketUring_send(uring_socket* us)
+{
+	struct io_uring_sqe* sqe = SocketUring_getsqe();
+
+	if (sqe == NULL)
+	{
+		Log(LOG_ERROR, -1, "io_uring submission queue full, cannot send on socket %d", us->socket);
+		us->error = ENOBUFS;
+		return;
+	}
+	sqe->opcode = IORING_OP_SEND;
+	sqe->fd = us->socket;
+	sqe->addr = (__u64)(uintptr_t)(us->sendbuf + us->sendpos);
+	sqe->len = (__u32)(us->sendlen - us->sendpos);
+	sqe->msg_flags = MSG_NOSIGNAL;
+	sqe->user_data = (__u64)(uintptr_t)us | URING_OP_SEND;
+	us->sending = 1;
+	++us->inflight;
+}
+
+
+/**
+ * Start a send of everything accumulated in the outbound buffer, if no send is in flight.
+ */
+static void SocketUring_startSend(uring_socket* us)
+{
+	char* temp;
+	size_t tempsize;
+
+	if (us->sending || us->outlen == 0 || us->error || us->closing)
+		return;
+	temp = us->sendbuf;
+	tempsize = us->sendsize;
+	us->sendbuf = us->outbuf;
+	us->sendsize = us->outsize;
+	us->sendlen = us->outlen;
+	us->sendpos = 0;
+	us->outbuf = temp;
+	us->outsize = tempsize;
+	us->outlen = 0;
+	SocketUring_send(us);
+}
+
+
+static void SocketUring_free(uring_socket* us)
+{
+	free(us->inbuf);
+	free(us->outbuf);
+	free(us->sendbuf);
+	ListRemove(uring.sockets, us);
+}
+
+
+static void SocketUring_complete(struct io_uring_cqe* cqe)
+{
+	uring_socket* us = (uring_socket*)(uintptr_t)(cqe->user_data & ~(__u64)URING_OP_MASK);
+	int op = (int)(cqe->user_data & URING_OP_MASK);
+
+	if (op == URING_OP_RECV)
+	{
+		if (cqe->flags & IORING_CQE_F_BUFFER)
+		{
+			unsigned short bid = (unsigned short)(cqe->flags >> IORING_CQE_BUFFER_SHIFT);
+
+			if (cqe->res > 0 && !us->closing)
+			{
+				if (us->inpos == us->inlen)
+					us->inpos = us->inlen = 0;
+				else if (us->inpos > us->insize / 2)
+				{	/* keep the read-ahead buffer from growing while the reader lags behind */
+					memmove(us->inbuf, us->inbuf + us->inpos, us->inlen - us->inpos);
+					us->inlen -= us->inpos;
+					us->inpos = 0;
+				}
+				SocketUring_reserve(&us->inbuf, &us->insize, us->inlen + cqe->res);
+				memcpy(us->inbuf + us->inlen, uring.bufs + (size_t)bid * URING_BUF_SIZE, cqe->res);
+				us->inlen += cqe->res;
+			}
+			SocketUring_provide(bid);
+		}
+		if (cqe->res == 0)
+			us->eof = 1;
+		else if (cqe->res == -EINVAL && us->multishot)
+		{
+			Log(TRACE_MIN, -1, "Multishot recv not supported, using single shot recv for socket %d", us->socket);
+			us->multishot = 0;
+		}
+		else if (cqe->res < 0 && cqe->res != -ENOBUFS && cqe->res != -ECANCELED && cqe->res != -EAGAIN)
+			us->error = -cqe->res;
+		if ((cqe->flags & IORING_CQE_F_MORE) == 0)
+		{
+			us->recv_armed = 0;
+			--us->inflight;
+			if (!us->closing && !us->eof && !us->error)
+				SocketUring_armRecv(us);
+		}
+	}
+	else if (op == URING_OP_SEND)
+	{
+		us->sending = 0;
+		--us->inflight;
+		if (cqe->res == -EAGAIN || cqe->res == -EINTR)
+			SocketUring_send(us);
+		else if (cqe->res < 0)
+		{
+			Log(TRACE_MIN, -1, "io_uring send failed with %d on socket %d", -cqe->res, us->socket);
+			us->error = -cqe->res;
+		}
+		else
+		{
+			us->sendpos += cqe->res;
+			if (us->sendpos < us->sendlen && !us->closing)
+				SocketUring_send(us);
+			else
+				SocketUring_startSend(us);
+		}
+	}
+
+	if (op != URING_OP_CANCEL && us->closing && us->inflight == 0)
+		SocketUring_free(us);
+}
+
+
+/**
+ * Process completions.  Must be called with the uring mutex held.  Follow on operations,
+ * recv re-arms and the next batch of a socket's output, are submitted straight away.
+ */
+static void SocketUring_reap_locked(void)
+{
+	unsigned head = *uring.cq_head;
+	unsigned sq_tail = uring.sq_local_tail;
+
+	while (head != __atomic_load_n(uring.cq_tail, __ATOMIC_ACQUIRE))
+	{
+		SocketUring_complete(&uring.cqes[head & *uring.cq_mask]);
+		++head;
+		__atomic_store_n(uring.cq_head, head, __ATOMIC_RELEASE);
+	}
+	if (uring.sq_local_tail != sq_tail)
+		SocketUring_submit();
+}
+
+
+static int SocketUring_nextReady_locked(void)
+{
+	ListElement* current = NULL;
+	int passed = (uring.last_ready == 0), rc = 0, pass;
+
+	/* start after the socket returned last time, so that no socket is starved */
+	for (pass = 0; pass < 2 && rc == 0; ++pass)
+	{
+		current = NULL;
+		while (rc == 0 && ListNextElement(uring.sockets, &current))
+		{
+			uring_socket* us = (uring_socket*)(current->content);
+
+			if (!passed)
+				passed = (us->socket == uring.last_ready);
+			else if (!us->closing && (us->inpos < us->inlen || us->eof || us->error))
+				rc = us->socket;
+		}
+		passed = 1;
+	}
+	if (rc != 0)
+		uring.last_ready = rc;
+	return rc;
+}
+
+
+/**
+ * Set up the process wide ring, unless disabled by the environment or not supported by the kernel.
+ */
+void SocketUring_initialize(void)
+{
+	struct io_uring_params p;
+	struct io_uring_buf_reg reg;
+	char* envval = NULL;
+	int i;
+
+	FUNC_ENTRY;
+	uring.fd = -1;
+	if ((envval = getenv(URING_ENV)) != NULL && strcmp(envval, "0") == 0)
+	{
+		Log(TRACE_MIN, -1, "io_uring disabled by %s", URING_ENV);
+		goto exit;
+	}
+
+	memset(&p, '\0', sizeof(p));
+	if ((uring.fd = (int)syscall(__NR_io_uring_setup, URING_ENTRIES, &p)) < 0)
+	{
+		Log(TRACE_MIN, -1, "io_uring_setup failed with %d, using select", errno);
+		uring.fd = -1;
+		goto exit;
+	}
+	if ((p.features & IORING_FEAT_EXT_ARG) == 0)
+	{
+		Log(TRACE_MIN, -1, "io_uring has no timed waits, using select");
+		goto error;
+	}
+
+	uring.sq_entries = p.sq_entries;
+	uring.sq_ring_size = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+	uring.cq_ring_size = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+	if (p.features & IORING_FEAT_SINGLE_MMAP)
+	{
+		if (uring.cq_ring_size > uring.sq_ring_size)
+			uring.sq_ring_size = uring.cq_ring_size;
+		uring.cq_ring_size = 0;
+	}
+	uring.sq_ring = mmap(NULL, uring.sq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+			uring.fd, IORING_OFF_SQ_RING);
+	if (uring.sq_ring == MAP_FAILED)
+		goto error;
+	if (uring.cq_ring_size == 0)
+		uring.cq_ring = uring.sq_ring;
+	else if ((uring.cq_ring = mmap(NULL, uring.cq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+			uring.fd, IORING_OFF_CQ_RING)) == MAP_FAILED)
+		goto error;
+	uring.sqes_size = p.sq_entries * sizeof(struct io_uring_sqe);
+	if ((uring.sqes = mmap(NULL, uring.sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+			uring.fd, IORING_OFF_SQES)) == MAP_FAILED)
+		goto error;
+
+	uring.sq_head = (unsigned*)((char*)uring.sq_ring + p.sq_off.head);
+	uring.sq_tail = (unsigned*)((char*)uring.sq_ring + p.sq_off.tail);
+	uring.sq_mask = (unsigned*)((char*)uring.sq_ring + p.sq_off.ring_mask);
+	uring.sq_array = (unsigned*)((char*)uring.sq_ring + p.sq_off.array);
+	uring.sq_local_tail = *uring.sq_tail;
+	uring.cq_head = (unsigned*)((char*)uring.cq_ring + p.cq_off.head);
+	uring.cq_tail = (unsigned*)((char*)uring.cq_ring + p.cq_off.tail);
+	uring.cq_mask = (unsigned*)((char*)uring.cq_ring + p.cq_off.ring_mask);
+	uring.cqes = (struct io_uring_cqe*)((char*)uring.cq_ring + p.cq_off.cqes);
+
+	/* the provided buffer ring must be page aligned */
+	uring.br_size = URING_BUF_COUNT * sizeof(struct io_uring_buf);
+	if ((uring.br = mmap(NULL, uring.br_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0)) == MAP_FAILED)
+		goto error;
+	memset(&reg, '\0', sizeof(reg));
+	reg.ring_addr = (__u64)(uintptr_t)uring.br;
+	reg.ring_entries = URING_BUF_COUNT;
+	reg.bgid = URING_BUF_GROUP;
+	if (syscall(__NR_io_uring_register, uring.fd, IORING_REGISTER_PBUF_RING, &reg, 1) < 0)
+	{
+		Log(TRACE_MIN, -1, "io_uring provided buffer rings not supported (%d), using select", errno);
+		goto error;
+	}
+	uring.bufs = malloc((size_t)URING_BUF_COUNT * URING_BUF_SIZE);
+	uring.br_tail = 0;
+	for (i = 0; i < URING_BUF_COUNT; ++i)
+		SocketUring_provide((unsigned short)i);
+
+	uring.sockets = ListInitialize();
+	uring.last_ready = 0;
+	uring.mutex = Thread_create_mutex();
+	Log(TRACE_MIN, -1, "io_uring socket backend initialized with %u entries", p.sq_entries);
+	goto exit;
+
+error:
+	SocketUring_terminate();
+exit:
+	FUNC_EXIT;
+}
+
+
+/**
+ * Tear down the ring and free all per socket state.
+ */
+void SocketUring_terminate(void)
+{
+	FUNC_ENTRY;
+	if (uring.fd >= 0)
+		close(uring.fd); /* cancels anything still in flight */
+	if (uring.sockets)
+	{
+		ListElement* current = NULL;
+
+		while (ListNextElement(uring.sockets, &current))
+		{
+			uring_socket* us = (uring_socket*)(current->content);
+
+			free(us->inbuf);
+			free(us->outbuf);
+			free(us->sendbuf);
+		}
+		ListFree(uring.sockets);
+		uring.sockets = NULL;
+		Thread_destroy_mutex(uring.mutex);
+	}
+	if (uring.bufs)
+		free(uring.bufs);
+	if (uring.br && uring.br != MAP_FAILED)
+		munmap(uring.br, uring.br_size);
+	if (uring.sqes && uring.sqes != MAP_FAILED)
+		munmap(uring.sqes, uring.sqes_size);
+	if (uring.cq_ring && uring.cq_ring != MAP_FAILED && uring.cq_ring != uring.sq_ring)
+		munmap(uring.cq_ring, uring.cq_ring_size);
+	if (uring.sq_ring && uring.sq_ring != MAP_FAILED)
+		munmap(uring.sq_ring, uring.sq_ring_size);
+	memset(&uring, '\0', sizeof(uring));
+	uring.fd = -1;
+	FUNC_EXIT;
+}
+
+
+/**
+ * Is the io_uring backend in use?
+ * @return boolean
+ */
+int SocketUring_enabled(void)
+{
+	return uring.sockets != NULL;
+}
+
+
+/**
+ * The ring descriptor, which select reports readable when completions are waiting.
+ * @return the descriptor, or -1 if the backend is not in use
+ */
+int SocketUring_fd(void)
+{
+	return (uring.sockets) ? uring.fd : -1;
+}
+
+
+/**
+ * The number of open sockets served by the ring
+ */
+int SocketUring_count(void)
+{
+	int count = 0;
+
+	if (uring.sockets)
+	{
+		ListElement* current = NULL;
+
+		Thread_lock_mutex(uring.mutex);
+		while (ListNextElement(uring.sockets, &current))
+		{
+			if (!((uring_socket*)(current->content))->closing)
+				++count;
+		}
+		Thread_unlock_mutex(uring.mutex);
+	}
+	return count;
+}
+
+
+/**
+ * Hand a connected socket over to the ring and start receiving on it.
+ * @param socket the socket
+ * @return 0 if the socket is now served by the ring
+ */
+int SocketUring_arm(int socket)
+{
+	uring_socket* us = NULL;
+	int rc = -1;
+
+	FUNC_ENTRY;
+	if (uring.sockets == NULL)
+		goto exit;
+	Thread_lock_mutex(uring.mutex);
+	if (SocketUring_find(socket) == NULL)
+	{
+		us = malloc(sizeof(uring_socket));
+		memset(us, '\0', sizeof(uring_socket));
+		us->socket = socket;
+		us->multishot = 1;
+		ListAppend(uring.sockets, us, sizeof(uring_socket));
+		SocketUring_armRecv(us);
+	}
+	Thread_unlock_mutex(uring.mutex);
+	rc = 0;
+exit:
+	FUNC_EXIT_RC(rc);
+	return rc;
+}
+
+
+/**
+ * Is a socket served by the ring?
+ * @return boolean
+ */
+int SocketUring_armed(int socket)
+{
+	int rc = 0;
+
+	if (uring.sockets)
+	{
+		Thread_lock_mutex(uring.mutex);
+		rc = SocketUring_find(socket) != NULL;
+		Thread_unlock_mutex(uring.mutex);
+	}
+	return rc;
+}
+
+
+/**
+ * Stop serving a socket which is about to be closed.  The outstanding recv is cancelled;
+ * the state is freed once the kernel has completed every operation on it.
+ * @param socket the socket
+ */
+void SocketUring_disarm(int socket)
+{
+	uring_socket* us = NULL;
+
+	FUNC_ENTRY;
+	if (uring.sockets == NULL)
+		goto exit;
+	Thread_lock_mutex(uring.mutex);
+	if ((us = SocketUring_find(socket)) != NULL)
+	{
+		us->closing = 1;
+		if (us->recv_armed)
+		{
+			struct io_uring_sqe* sqe = SocketUring_getsqe();
+
+			if (sqe)
+			{
+				sqe->opcode = IORING_OP_ASYNC_CANCEL;
+				sqe->addr = (__u64)(uintptr_t)us | URING_OP_RECV;
+				sqe->user_data = URING_OP_CANCEL;
+			}
+		}
+		if (us->inflight == 0)
+			SocketUring_free(us);
+		SocketUring_submit();
+	}
+	Thread_unlock_mutex(uring.mutex);
+exit:
+	FUNC_EXIT;
+}
+
+
+/**
+ * Read from the data the ring has already received for a socket, with recv semantics.
+ * @param socket the socket
+ * @param buf the buffer to read into
+ * @param len the maximum number of bytes to read
+ * @return the number of bytes read, 0 if the peer has closed the connection, or -1 with errno set
+ */
+int SocketUring_recv(int socket, char* buf, size_t len)
+{
+	uring_socket* us = NULL;
+	int rc = -1;
+
+	Thread_lock_mutex(uring.mutex);
+	if ((us = SocketUring_find(socket)) == NULL)
+	{
+		errno = EBADF;
+		goto exit;
+	}
+	if (us->inpos == us->inlen)
+		SocketUring_reap_locked();
+	if (us->inpos < us->inlen)
+	{
+		size_t available = us->inlen - us->inpos;
+
+		if (len > available)
+			len = available;
+		memcpy(buf, us->inbuf + us->inpos, len);
+		us->inpos += len;
+		rc = (int)len;
+	}
+	else if (us->error)
+		errno = us->error;
+	else if (us->eof)
+		rc = 0;
+	else
+		errno = EAGAIN;
+exit:
+	Thread_unlock_mutex(uring.mutex);
+	return rc;
+}
+
+
+/**
+ * Queue a series of buffers for sending on a socket.  The data is copied, so the caller
+ * can treat the write as complete.
+ * @param socket the socket
+ * @param iovecs the buffers to send
+ * @param count the number of buffers
+ * @return TCPSOCKET_COMPLETE (0), or -1 if the socket has failed
+ */
+int SocketUring_putdatas(int socket, struct iovec* iovecs, int count)
+{
+	uring_socket* us = NULL;
+	int rc = -1, i;
+
+	FUNC_ENTRY;
+	Thread_lock_mutex(uring.mutex);
+	if ((us = SocketUring_find(socket)) == NULL || us->error)
+	{
+		if (us)
+			errno = us->error;
+		goto exit;
+	}
+	for (i = 0; i < count; ++i)
+	{
+		SocketUring_reserve(&us->outbuf, &us->outsize, us->outlen + iovecs[i].iov_len);
+		memcpy(us->outbuf + us->outlen, iovecs[i].iov_base, iovecs[i].iov_len);
+		us->outlen += iovecs[i].iov_len;
+	}
+	/* if a send is still in flight this is picked up by its completion, batched with anything else written meanwhile */
+	SocketUring_reap_locked();
+	if (!us->sending)
+	{
+		SocketUring_startSend(us);
+		SocketUring_submit();
+	}
+	rc = 0;
+exit:
+	Thread_unlock_mutex(uring.mutex);
+	FUNC_EXIT_RC(rc);
+	return rc;
+}
+
+
+/**
+ * Submit any prepared entries.  Must be called with the uring mutex held.
+ */
+void SocketUring_submit(void)
+{
+	unsigned pending = SocketUring_flush();
+
+	if (pending > 0 && SocketUring_enter(pending, 0, 0, NULL, 0) < 0 && errno != EAGAIN && errno != EBUSY && errno != EINTR)
+		Log(LOG_ERROR, -1, "io_uring_enter submit failed with %d", errno);
+}
+
+
+/**
+ * Submit any prepared entries from a thread which does not hold the uring mutex, such as
+ * the receive thread before it selects on the ring descriptor.
+ */
+void SocketUring_flushPending(void)
+{
+	if (uring.sockets)
+	{
+		Thread_lock_mutex(uring.mutex);
+		SocketUring_submit();
+		Thread_unlock_mutex(uring.mutex);
+	}
+}
+
+
+/**
+ * Find the next socket with received data, a closed connection or an error, round robin.
+ * @return the socket, or 0 if none is ready
+ */
+int SocketUring_nextReady(void)
+{
+	int rc = 0;
+
+	if (uring.sockets)
+	{
+		Thread_lock_mutex(uring.mutex);
+		SocketUring_reap_locked();
+		rc = SocketUring_nextReady_locked();
+		Thread_unlock_mutex(uring.mutex);
+	}
+	return rc;
+}
+
+
+/**
+ * Wait for a socket served by the ring to become ready.  Completions which do not make a
+ * socket ready, such as finished sends, do not end the wait.
+ * @param timeout how long to wait
+ * @return the ready socket, or 0 if the timeout expired
+ */
+int SocketUring_wait(struct timeval* timeout)
+{
+	struct timespec now, deadline;
+	int rc = 0;
+
+	FUNC_ENTRY;
+	clock_gettime(CLOCK_MONOTONIC, &deadline);
+	deadline.tv_sec += timeout->tv_sec;
+	deadline.tv_nsec += timeout->tv_usec * 1000L;
+	if (deadline.tv_nsec >= 1000000000L)
+	{
+		deadline.tv_sec += 1;
+		deadline.tv_nsec -= 1000000000L;
+	}
+	while (1)
+	{
+		struct __kernel_timespec ts;
+		struct io_uring_getevents_arg arg;
+		unsigned pending;
+
+		Thread_lock_mutex(uring.mutex);
+		SocketUring_reap_locked();
+		rc = SocketUring_nextReady_locked();
+		pending = SocketUring_flush();
+		Thread_unlock_mutex(uring.mutex);
+		if (rc != 0)
+		{
+			if (pending > 0)
+				SocketUring_enter(pending, 0, 0, NULL, 0);
+			break;
+		}
+
+		clock_gettime(CLOCK_MONOTONIC, &now);
+		ts.tv_sec = deadline.tv_sec - now.tv_sec;
+		ts.tv_nsec = deadline.tv_nsec - now.tv_nsec;
+		if (ts.tv_nsec < 0)
+		{
+			ts.tv_sec -= 1;
+			ts.tv_nsec += 1000000000L;
+		}
+		if (ts.tv_sec < 0)
+		{
+			if (pending > 0)
+				SocketUring_enter(pending, 0, 0, NULL, 0);
+			break;
+		}
+		memset(&arg, '\0', sizeof(arg));
+		arg.sigmask_sz = _NSIG / 8;
+		arg.ts = (__u64)(uintptr_t)&ts;
+		if (SocketUring_enter(pending, 1, IORING_ENTER_GETEVENTS | IORING_ENTER_EXT_ARG, &arg, sizeof(arg)) < 0
+				&& errno != ETIME && errno != EINTR && errno != EBUSY)
+		{
+			Log(LOG_ERROR, -1, "io_uring_enter wait failed with %d", errno);
+			break;
+		}
+	}
+	FUNC_EXIT_RC(rc);
+	return rc;
+}
+
+#endif
@@ -0,0 +1,47 @@
+/*******************************************************************************
+ * Copyright (c) 2017 IBM Corp.
+ *
+ * All rights reserved. This program and the accompanying materials
+ * are made available under the terms of the Eclipse Public License v1.0
+ * and Eclipse Distribution License v1.0 which accompany this distribution.
+ *
+ * The Eclipse Public License is available at
+ *    http://www.eclipse.org/legal/epl-v10.html
+ * and the Eclipse Distribution License is available at
+ *   http://www.eclipse.org/org/documents/edl-v10.php.
+ *
+ * Contributors:
+ *    io_uring socket backend - initial implementation
+ *******************************************************************************/
+#if !defined(SOCKETURING_H)
+#define SOCKETURING_H
+
+#if defined(IO_URING)
+
+#include <sys/time.h>
+#include <sys/uio.h>
+
+/** environment variable which, when set to 0, keeps the select based socket layer */
+#define URING_ENV "MQTT_C_CLIENT_IO_URING"
+
+void SocketUring_initialize(void);
+void SocketUring_terminate(void);
+int SocketUring_enabled(void);
+int SocketUring_fd(void);
+int SocketUring_count(void);
+
+int SocketUring_arm(int socket);
+int SocketUring_armed(int socket);
+void SocketUring_disarm(int socket);
+
+int SocketUring_recv(int socket, char* buf, size_t len);
+int SocketUring_putdatas(int socket, struct iovec* iovecs, int count);
+
+void SocketUring_submit(void);
+void SocketUring_flushPending(void);
+int SocketUring_nextReady(void);
+int SocketUring_wait(struct timeval* timeout);
+
+#endif
+
+#endif
@@ -77,6 +77,32 @@ async_client::async_client(const std::string& serverURI, const std::string& clie
 	}
 }
 
+async_client::async_client(const std::string& serverURI, const std::string& clientId,
+						   int persistenceType, const std::string& persistDir,
+						   int maxBufferedMessages, int snapshotInterval)
+				: serverURI_(serverURI), clientId_(clientId),
+					persist_(nullptr), userCallback_(nullptr)
+{
+	MQTTAsync_createOptions opts = MQTTAsync_createOptions_initializer;
+	MQTTClient_memoryPersistenceOptions memory = MQTTClient_memoryPersistenceOptions_initializer;
+	void* context = persistDir.empty() ? nullptr : const_cast<char*>(persistDir.c_str());
+
+	if (maxBufferedMessages > 0) {
+		opts.sendWhileDisconnected = 1;
+		opts.maxBufferedMessages = maxBufferedMessages;
+	}
+	if (persistenceType == MQTTCLIENT_PERSISTENCE_MEMORY) {
+		// copied by the C client, so it need not outlive the create call
+		memory.directory = persistDir.empty() ? nullptr : persistDir.c_str();
+		memory.interval = snapshotInterval;
+		context = &memory;
+	}
+	else if (persistenceType == MQTTCLIENT_PERSISTENCE_NONE)
+		context = nullptr;
+	MQTTAsync_createWithOptions(&cli_, serverURI.c_str(), clientId.c_str(),
+					 persistenceType, context, &opts);
+}
+
 async_client::~async_client()
 {
 	MQTTAsync_destroy(&cli_);
@@ -374,6 +400,8 @@ idelivery_token_ptr async_client::publish(const std::string& topic, const_messag
 	dtok->set_message(msg);
 
 	delivery_response_options opts(dtok);
+	opts.opts_.priority = msg->get_priority();
+	opts.opts_.coalesce = msg->is_coalesced();
 
 	int rc = MQTTAsync_sendMessage(cli_, topic.c_str(), &(msg->msg_),
 								   &opts.opts_);
@@ -401,6 +429,8 @@ idelivery_token_ptr async_client::publish(const std::string& topic, const_messag
 	dtok->set_message(msg);
 
 	delivery_response_options opts(dtok);
+	opts.opts_.priority = msg->get_priority();
+	opts.opts_.coalesce = msg->is_coalesced();
 
 	int rc = MQTTAsync_sendMessage(cli_, topic.c_str(), &(msg->msg_),
 								   &opts.opts_);
@@ -416,6 +446,26 @@ idelivery_token_ptr async_client::publish(const std::string& topic, const_messag
 	return tok;
 }
 
+idelivery_token_ptr async_client::complete_unsent(const std::string& topic, const_message_ptr msg,
+												  void* userContext, iaction_listener& cb, int rc)
+{
+	auto tok = std::make_shared<delivery_token>(*this, topic, msg);
+	tok->set_user_context(userContext);
+	tok->set_action_callback(cb);
+
+	token& completed = *tok;
+	if (rc == MQTTASYNC_SUCCESS) {
+		completed.on_success(nullptr);
+	}
+	else {
+		MQTTAsync_failureData rsp;
+		memset(&rsp, 0, sizeof(rsp));
+		rsp.code = rc;
+		completed.on_failure(&rsp);
+	}
+	return tok;
+}
+
 // --------------------------------------------------------------------------
 
 void async_client::set_callback(callback& cb)
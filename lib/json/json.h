@@ -127,6 +127,12 @@ license you like.
 /// as Value container.
 //#  define JSON_USE_CPPTL_SMALLMAP 1
 
+/// If defined, indicates that a sorted vector (Json::FlatMap) should be used
+/// instead of std::map as Value container: one allocation per object or array
+/// rather than one per member. References to the members of an object are
+/// invalidated when a member is added to or removed from that object.
+//#  define JSON_USE_FLAT_MAP 1
+
 // If non-zero, the library uses exceptions to report bad input instead of C
 // assertion macros. The default is to use exceptions.
 #ifndef JSON_USE_EXCEPTION
@@ -368,6 +374,11 @@ public:
 #else
 #include <cpptl/smallmap.h>
 #endif
+#include <algorithm>
+#include <functional>
+#include <cstring>
+#include <utility>
+#include <new>
 #ifdef JSON_USE_CPPTL
 #include <cpptl/forwards.h>
 #endif
@@ -488,6 +499,287 @@ private:
   const char* c_str_;
 };
 
+/** \brief Monotonic storage for the strings, keys and containers of Values.
+ *
+ * While an Arena::Scope is open on a thread, the Values built on that thread
+ * take their storage from the arena, carved out of a few large blocks, instead
+ * of one malloc each, and freeing it costs nothing. release() takes all of it
+ * back at once and keeps the blocks, so a thread that reads one document after
+ * another in the arena of forThread() stops allocating once the arena has
+ * grown to the largest of them.
+ *
+ * Only allocations are tied to the scope: a Value built in it may be read,
+ * changed and destroyed after it is closed, and takes what it allocates then
+ * from the heap. Every Value holding storage of an arena must be destroyed
+ * before the arena is released, and must not be swapped into a Value that
+ * outlives it.
+ *
+ * Example of usage:
+ * \code
+ * Json::Arena& arena = Json::Arena::forThread();
+ * {
+ *   Json::Value root;
+ *   {
+ *     Json::Arena::Scope scope(arena);
+ *     reader.parse(text, root);
+ *   }
+ *   handle(root);
+ * }
+ * arena.release();
+ * \endcode
+ */
+class JSON_API Arena {
+public:
+  explicit Arena(size_t blockSize = 4096);
+  ~Arena();
+
+  /// size bytes aligned for any member of a Value, or 0 if malloc fails.
+  void* allocate(size_t size);
+
+  /// Takes back everything allocated, keeping the blocks for reuse.
+  void release();
+
+  /// The bytes allocated since the last release().
+  size_t allocated() const { return allocated_; }
+
+  /// The arena of the calling thread, created on first use.
+  static Arena& forThread();
+
+  /// The arena of the innermost Scope open on the calling thread, or 0.
+  static Arena* current();
+
+  /** \brief Makes the Values built on the thread use an arena while it lives.
+   *
+   * Scopes nest, the innermost one being used.
+   */
+  class JSON_API Scope {
+  public:
+    explicit Scope(Arena& arena);
+    ~Scope();
+
+  private:
+    Scope(const Scope&);
+    Scope& operator=(const Scope&);
+
+    Arena* previous_;
+  };
+
+private:
+  struct Block {
+    Block* next_;
+    size_t size_;
+  };
+
+  Arena(const Arena&);
+  Arena& operator=(const Arena&);
+
+  static Block* newBlock(size_t size, Block* next);
+
+  Block* blocks_;  // of blockSize_, filled in order up to current_
+  Block* current_;
+  Block* large_;   // one per allocation bigger than a block
+  char* next_;
+  char* end_;
+  size_t blockSize_;
+  size_t allocated_;
+};
+
+/** Storage for a Value: from the arena of the Arena::Scope open on the thread
+ * if there is one, else from the heap. Returns 0 if malloc fails.
+ */
+JSON_API void* allocateStorage(size_t size);
+
+/// Frees storage of allocateStorage(), nothing to do if it is in an arena.
+JSON_API void releaseStorage(void* storage);
+
+/** \brief Standard allocator of allocateStorage(), for the std::map of objects.
+ */
+template <typename T> class StorageAllocator {
+public:
+  typedef T value_type;
+  typedef T* pointer;
+  typedef const T* const_pointer;
+  typedef T& reference;
+  typedef const T& const_reference;
+  typedef size_t size_type;
+  typedef ptrdiff_t difference_type;
+  template <typename U> struct rebind { typedef StorageAllocator<U> other; };
+
+  StorageAllocator() {}
+  template <typename U> StorageAllocator(const StorageAllocator<U>&) {}
+
+  T* allocate(size_type count) {
+    void* storage = allocateStorage(count * sizeof(T));
+    if (storage == 0)
+      throw std::bad_alloc();
+    return static_cast<T*>(storage);
+  }
+  void deallocate(T* storage, size_type) { releaseStorage(storage); }
+
+  template <typename U> bool operator==(const StorageAllocator<U>&) const {
+    return true;
+  }
+  template <typename U> bool operator!=(const StorageAllocator<U>&) const {
+    return false;
+  }
+};
+
+/** \brief Sorted vector with the part of the std::map interface Value uses.
+ *
+ * Members are kept in key order, so objects iterate, compare and write as with
+ * std::map, and arrays, whose keys are their indexes, append at the end.
+ * Elements are moved in memory with memmove rather than copied: this holds for
+ * Value and its keys, which own what they point to and never point to
+ * themselves, and saves a deep copy of every member that is moved.
+ *
+ * It is declared whether or not JSON_USE_FLAT_MAP makes it the storage of
+ * Value, so that it can be tested against std::map in any build.
+ */
+template <typename K, typename V> class FlatMap {
+public:
+  typedef K key_type;
+  typedef V mapped_type;
+  typedef std::pair<K, V> value_type;
+  typedef value_type* iterator;
+  typedef const value_type* const_iterator;
+  typedef size_t size_type;
+
+  FlatMap() : data_(0), size_(0), capacity_(0) {}
+  FlatMap(const FlatMap& other) : data_(0), size_(0), capacity_(0) {
+    reserve(other.size_);
+    for (; size_ < other.size_; ++size_)
+      new (data_ + size_) value_type(other.data_[size_]);
+  }
+  ~FlatMap() {
+    clear();
+    releaseStorage(data_);
+  }
+  FlatMap& operator=(FlatMap other) {
+    swap(other);
+    return *this;
+  }
+  void swap(FlatMap& other) {
+    std::swap(data_, other.data_);
+    std::swap(size_, other.size_);
+    std::swap(capacity_, other.capacity_);
+  }
+
+  size_type size() const { return size_; }
+  bool empty() const { return size_ == 0; }
+  iterator begin() { return data_; }
+  iterator end() { return data_ + size_; }
+  const_iterator begin() const { return data_; }
+  const_iterator end() const { return data_ + size_; }
+
+  void clear() {
+    while (size_ > 0)
+      data_[--size_].~value_type();
+  }
+
+  iterator lower_bound(const K& key) {
+    // appending, as arrays and most readers do
+    if (size_ == 0 || data_[size_ - 1].first < key)
+      return end();
+    return std::lower_bound(begin(), end(), key, KeyLess());
+  }
+  iterator find(const K& key) {
+    // an equality test mostly stops at the length of a key, cheaper than the
+    // comparisons of a binary search for the few members of most objects
+    if (size_ <= 32) {
+      for (iterator it = begin(); it != end(); ++it) {
+        if (it->first == key)
+          return it;
+      }
+      return end();
+    }
+    iterator it = std::lower_bound(begin(), end(), key, KeyLess());
+    return (it != end() && !(key < it->first)) ? it : end();
+  }
+  const_iterator find(const K& key) const {
+    return const_cast<FlatMap*>(this)->find(key);
+  }
+
+  /// Inserts at the hint, which must be the lower_bound of the key. The value
+  /// may be an element of this map.
+  iterator insert(iterator hint, const value_type& value) {
+    // growing or shifting the elements would move it from under the copy
+    if (!std::less<const value_type*>()(&value, data_) &&
+        std::less<const value_type*>()(&value, data_ + size_)) {
+      value_type copy(value);
+      return insert(hint, copy);
+    }
+    size_type at = hint - data_;
+    if (size_ == capacity_)
+      reserve(capacity_ ? 2 * capacity_ : 4);
+    value_type* slot = data_ + at;
+    std::memmove(static_cast<void*>(slot + 1), static_cast<void*>(slot),
+                 (size_ - at) * sizeof(value_type));
+    try {
+      new (slot) value_type(value);
+    } catch (...) {
+      std::memmove(static_cast<void*>(slot), static_cast<void*>(slot + 1),
+                   (size_ - at) * sizeof(value_type));
+      throw;
+    }
+    ++size_;
+    return slot;
+  }
+  V& operator[](const K& key) {
+    iterator it = lower_bound(key);
+    if (it == end() || key < it->first)
+      it = insert(it, value_type(key, V()));
+    return it->second;
+  }
+
+  void erase(iterator it) {
+    it->~value_type();
+    std::memmove(static_cast<void*>(it), static_cast<void*>(it + 1),
+                 (end() - it - 1) * sizeof(value_type));
+    --size_;
+  }
+  size_type erase(const K& key) {
+    iterator it = find(key);
+    if (it == end())
+      return 0;
+    erase(it);
+    return 1;
+  }
+
+  bool operator==(const FlatMap& other) const {
+    return size_ == other.size_ && std::equal(begin(), end(), other.begin());
+  }
+  bool operator<(const FlatMap& other) const {
+    return std::lexicographical_compare(begin(), end(), other.begin(),
+                                        other.end());
+  }
+
+private:
+  struct KeyLess {
+    bool operator()(const value_type& member, const K& key) const {
+      return member.first < key;
+    }
+  };
+
+  void reserve(size_type capacity) {
+    if (capacity <= capacity_)
+      return;
+    value_type* data =
+        static_cast<value_type*>(allocateStorage(capacity * sizeof(value_type)));
+    if (data == 0)
+      throw std::bad_alloc();
+    if (size_ > 0)
+      std::memcpy(static_cast<void*>(data), static_cast<void*>(data_),
+                  size_ * sizeof(value_type));
+    releaseStorage(data_);
+    data_ = data;
+    capacity_ = capacity;
+  }
+
+  value_type* data_;
+  size_type size_;
+  size_type capacity_;
+};
+
 /** \brief Represents a <a HREF="http://www.json.org">JSON</a> value.
  *
  * This class is a discriminated union wrapper that can represents a:
@@ -604,8 +896,12 @@ private:
   };
 
 public:
-#ifndef JSON_USE_CPPTL_SMALLMAP
-  typedef std::map<CZString, Value> ObjectValues;
+#if defined(JSON_USE_FLAT_MAP)
+  typedef FlatMap<CZString, Value> ObjectValues;
+#elif !defined(JSON_USE_CPPTL_SMALLMAP)
+  typedef std::map<CZString, Value, std::less<CZString>,
+                   StorageAllocator<std::pair<const CZString, Value> > >
+      ObjectValues;
 #else
   typedef CppTL::SmallMap<CZString, Value> ObjectValues;
 #endif // ifndef JSON_USE_CPPTL_SMALLMAP
@@ -1890,6 +2186,14 @@ std::string JSON_API valueToString(double value);
 std::string JSON_API valueToString(bool value);
 std::string JSON_API valueToQuotedString(const char* value);
 
+/** Writes a number as valueToString() does, to a buffer of 32 chars at least,
+ * and returns the end of the text, which is not null-terminated. Doubles are
+ * written with the fewest digits that read back as the same value.
+ */
+char JSON_API* valueToChars(LargestInt value, char* buffer);
+char JSON_API* valueToChars(LargestUInt value, char* buffer);
+char JSON_API* valueToChars(double value, char* buffer);
+
 /// \brief Output using the StyledStreamWriter.
 /// \see Json::operator>>()
 JSON_API std::ostream& operator<<(std::ostream&, const Value& root);
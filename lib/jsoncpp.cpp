@@ -147,11 +147,31 @@ typedef char UIntToStringBuffer[uintToStringBufferSize];
  *        Must have at least uintToStringBufferSize chars free.
  */
 static inline void uintToString(LargestUInt value, char*& current) {
+  static const char digitPairs[] = "00010203040506070809"
+                                   "10111213141516171819"
+                                   "20212223242526272829"
+                                   "30313233343536373839"
+                                   "40414243444546474849"
+                                   "50515253545556575859"
+                                   "60616263646566676869"
+                                   "70717273747576777879"
+                                   "80818283848586878889"
+                                   "90919293949596979899";
   *--current = 0;
-  do {
-    *--current = static_cast<signed char>(value % 10U + static_cast<unsigned>('0'));
-    value /= 10;
-  } while (value != 0);
+  // two digits a division
+  while (value >= 100) {
+    unsigned pair = static_cast<unsigned>(value % 100U) * 2;
+    value /= 100;
+    *--current = digitPairs[pair + 1];
+    *--current = digitPairs[pair];
+  }
+  if (value >= 10) {
+    unsigned pair = static_cast<unsigned>(value) * 2;
+    *--current = digitPairs[pair + 1];
+    *--current = digitPairs[pair];
+  } else {
+    *--current = static_cast<char>('0' + value);
+  }
 }
 
 /** Change ',' to '.' everywhere in buffer.
@@ -231,7 +251,7 @@ static int       stackDepth_g = 0;  // see readValue()
 namespace Json {
 
 #if __GNUC__ >= 6
-typedef std::scoped_ptr<CharReader> const  CharReaderPtr;
+typedef std::unique_ptr<CharReader> const  CharReaderPtr;
 #else
 typedef std::auto_ptr<CharReader>          CharReaderPtr;
 #endif
@@ -2076,7 +2096,7 @@ void ValueIteratorBase::decrement() {
 
 ValueIteratorBase::difference_type
 ValueIteratorBase::computeDistance(const SelfType& other) const {
-#ifdef JSON_USE_CPPTL_SMALLMAP
+#if defined(JSON_USE_CPPTL_SMALLMAP) || defined(JSON_USE_FLAT_MAP)
   return other.current_ - current_;
 #else
   // Iterator for null value are initialized using the default
@@ -2288,6 +2308,149 @@ static inline bool InRange(double d, T min, U max) {
 }
 #endif // if !defined(JSON_USE_INT64_DOUBLE_CONVERSION)
 
+// //////////////////////////////////////////////////////////////////
+// class Arena
+// //////////////////////////////////////////////////////////////////
+
+// Every block of storage starts with the arena it comes from, 0 for the heap,
+// so that it is freed the right way whatever scope is open at the time.
+union StorageHeader {
+  Arena* arena_;
+  double align_;
+};
+
+static thread_local Arena* currentArena = 0;
+
+Arena::Arena(size_t blockSize)
+    : blocks_(0), current_(0), large_(0), next_(0), end_(0),
+      blockSize_(blockSize), allocated_(0) {}
+
+Arena::~Arena() {
+  release();
+  while (blocks_) {
+    Block* next = blocks_->next_;
+    free(blocks_);
+    blocks_ = next;
+  }
+}
+
+Arena::Block* Arena::newBlock(size_t size, Block* next) {
+  Block* block = static_cast<Block*>(malloc(sizeof(Block) + size));
+  if (block) {
+    block->next_ = next;
+    block->size_ = size;
+  }
+  return block;
+}
+
+void* Arena::allocate(size_t size) {
+  size = (size + sizeof(StorageHeader) - 1) & ~(sizeof(StorageHeader) - 1);
+  if (size > static_cast<size_t>(end_ - next_)) {
+    if (size > blockSize_) {
+      Block* block = newBlock(size, large_);
+      if (block == 0)
+        return 0;
+      large_ = block;
+      allocated_ += size;
+      return block + 1;
+    }
+    Block* block = current_ ? current_->next_ : blocks_;
+    if (block == 0) {
+      block = newBlock(blockSize_, 0);
+      if (block == 0)
+        return 0;
+      if (current_)
+        current_->next_ = block;
+      else
+        blocks_ = block;
+    }
+    current_ = block;
+    next_ = reinterpret_cast<char*>(block + 1);
+    end_ = next_ + block->size_;
+  }
+  void* storage = next_;
+  next_ += size;
+  allocated_ += size;
+  return storage;
+}
+
+void Arena::release() {
+  while (large_) {
+    Block* next = large_->next_;
+    free(large_);
+    large_ = next;
+  }
+  current_ = 0;
+  next_ = end_ = 0;
+  allocated_ = 0;
+}
+
+Arena& Arena::forThread() {
+  static thread_local Arena arena;
+  return arena;
+}
+
+Arena* Arena::current() { return currentArena; }
+
+Arena::Scope::Scope(Arena& arena) : previous_(currentArena) {
+  currentArena = &arena;
+}
+
+Arena::Scope::~Scope() { currentArena = previous_; }
+
+void* allocateStorage(size_t size) {
+  Arena* arena = currentArena;
+  size += sizeof(StorageHeader);
+  StorageHeader* header = static_cast<StorageHeader*>(
+      arena ? arena->allocate(size) : malloc(size));
+  if (header == 0)
+    return 0;
+  header->arena_ = arena;
+  return header + 1;
+}
+
+void releaseStorage(void* storage) {
+  if (storage == 0)
+    return;
+  StorageHeader* header = static_cast<StorageHeader*>(storage) - 1;
+  if (header->arena_ == 0)
+    free(header);
+}
+
+/** Allocates the members of an object or array like its strings, from the
+ * arena of the current Arena::Scope if there is one.
+ */
+static Value::ObjectValues* newObjectValues() {
+  void* storage = allocateStorage(sizeof(Value::ObjectValues));
+  if (storage == 0) {
+    throwRuntimeError(
+        "in Json::Value::newObjectValues(): "
+        "Failed to allocate object value");
+  }
+  return new (storage) Value::ObjectValues();
+}
+
+static Value::ObjectValues* newObjectValues(const Value::ObjectValues& other) {
+  void* storage = allocateStorage(sizeof(Value::ObjectValues));
+  if (storage == 0) {
+    throwRuntimeError(
+        "in Json::Value::newObjectValues(): "
+        "Failed to allocate object value");
+  }
+  try {
+    return new (storage) Value::ObjectValues(other);
+  } catch (...) {
+    releaseStorage(storage);
+    throw;
+  }
+}
+
+static void releaseObjectValues(Value::ObjectValues* values) {
+  typedef Value::ObjectValues ObjectValues;
+  values->~ObjectValues();
+  releaseStorage(values);
+}
+
 /** Duplicates the specified string value.
  * @param value Pointer to the string to duplicate. Must be zero-terminated if
  *              length is "unknown".
@@ -2297,12 +2460,12 @@ static inline bool InRange(double d, T min, U max) {
  */
 static inline char* duplicateStringValue(const char* value,
                                          size_t length) {
-  // Avoid an integer overflow in the call to malloc below by limiting length
+  // Avoid an integer overflow in the allocation below by limiting length
   // to a sane value.
   if (length >= (size_t)Value::maxInt)
     length = Value::maxInt - 1;
 
-  char* newString = static_cast<char*>(malloc(length + 1));
+  char* newString = static_cast<char*>(allocateStorage(length + 1));
   if (newString == NULL) {
     throwRuntimeError(
         "in Json::Value::duplicateStringValue(): "
@@ -2319,13 +2482,13 @@ static inline char* duplicateAndPrefixStringValue(
     const char* value,
     unsigned int length)
 {
-  // Avoid an integer overflow in the call to malloc below by limiting length
+  // Avoid an integer overflow in the allocation below by limiting length
   // to a sane value.
   JSON_ASSERT_MESSAGE(length <= (unsigned)Value::maxInt - sizeof(unsigned) - 1U,
                       "in Json::Value::duplicateAndPrefixStringValue(): "
                       "length too big for prefixing");
   unsigned actualLength = length + static_cast<unsigned>(sizeof(unsigned)) + 1U;
-  char* newString = static_cast<char*>(malloc(actualLength));
+  char* newString = static_cast<char*>(allocateStorage(actualLength));
   if (newString == 0) {
     throwRuntimeError(
         "in Json::Value::duplicateAndPrefixStringValue(): "
@@ -2350,7 +2513,7 @@ inline static void decodePrefixedString(
 }
 /** Free the string duplicated by duplicateStringValue()/duplicateAndPrefixStringValue().
  */
-static inline void releaseStringValue(char* value) { free(value); }
+static inline void releaseStringValue(char* value) { releaseStorage(value); }
 
 } // namespace Json
 
@@ -2528,7 +2691,7 @@ Value::Value(ValueType vtype) {
     break;
   case arrayValue:
   case objectValue:
-    value_.map_ = new ObjectValues();
+    value_.map_ = newObjectValues();
     break;
   case booleanValue:
     value_.bool_ = false;
@@ -2625,7 +2788,7 @@ Value::Value(Value const& other)
     break;
   case arrayValue:
   case objectValue:
-    value_.map_ = new ObjectValues(*other.value_.map_);
+    value_.map_ = newObjectValues(*other.value_.map_);
     break;
   default:
     JSON_ASSERT_UNREACHABLE;
@@ -2655,7 +2818,7 @@ Value::~Value() {
     break;
   case arrayValue:
   case objectValue:
-    delete value_.map_;
+    releaseObjectValues(value_.map_);
     break;
   default:
     JSON_ASSERT_UNREACHABLE;
@@ -3259,7 +3422,14 @@ Value const& Value::operator[](CppTL::ConstString const& key) const
 }
 #endif
 
-Value& Value::append(const Value& value) { return (*this)[size()] = value; }
+Value& Value::append(const Value& value) {
+  // copied before the array grows, which under JSON_USE_FLAT_MAP moves its
+  // elements, the value among them when it is one: arr.append(arr[0])
+  Value copy(value);
+  Value& appended = (*this)[size()];
+  appended.swap(copy);
+  return appended;
+}
 
 Value Value::get(char const* key, char const* cend, Value const& defaultValue) const
 {
@@ -3800,7 +3970,7 @@ Value& Path::make(Value& root) const {
 namespace Json {
 
 #if __GNUC__ >= 6
-typedef std::scoped_ptr<StreamWriter> const  StreamWriterPtr;
+typedef std::unique_ptr<StreamWriter> const  StreamWriterPtr;
 #else
 typedef std::auto_ptr<StreamWriter>          StreamWriterPtr;
 #endif
@@ -3823,6 +3993,297 @@ static bool containsControlCharacter0(const char* str, unsigned len) {
   return false;
 }
 
+// Shortest round-trip formatting of doubles, after Grisu2 in "Printing
+// Floating-Point Numbers Quickly and Accurately with Integers" (Loitsch, 2010):
+// the digits are generated in 64-bit integer arithmetic from the boundaries
+// halfway to the neighbouring doubles, and stop as soon as they identify the
+// value. The result always reads back as the same double; for about one value
+// in a thousand it has a digit more than the shortest.
+
+// A floating point number f * 2^e with a 64-bit significand
+struct DiyFp {
+  DiyFp() : f(0), e(0) {}
+  DiyFp(UInt64 significand, int exponent) : f(significand), e(exponent) {}
+
+  explicit DiyFp(double value) {
+    UInt64 bits;
+    memcpy(&bits, &value, sizeof(bits));
+    int biasedExponent = static_cast<int>((bits >> 52) & 0x7FF);
+    f = bits & fractionMask;
+    if (biasedExponent != 0) {
+      f += hiddenBit;
+      e = biasedExponent - 1075;
+    } else {
+      e = -1074;
+    }
+  }
+
+  DiyFp operator-(const DiyFp& other) const { return DiyFp(f - other.f, e); }
+
+  // The upper half of the 128-bit product, rounded
+  DiyFp operator*(const DiyFp& other) const {
+#if defined(__SIZEOF_INT128__)
+    unsigned __int128 product =
+        static_cast<unsigned __int128>(f) * static_cast<unsigned __int128>(other.f);
+    UInt64 high = static_cast<UInt64>(product >> 64);
+    UInt64 low = static_cast<UInt64>(product);
+    if (low & (UInt64(1) << 63))
+      ++high;
+    return DiyFp(high, e + other.e + 64);
+#else
+    const UInt64 mask = 0xFFFFFFFFu;
+    UInt64 a = f >> 32, b = f & mask, c = other.f >> 32, d = other.f & mask;
+    UInt64 ac = a * c, bc = b * c, ad = a * d, bd = b * d;
+    UInt64 middle = (bd >> 32) + (ad & mask) + (bc & mask);
+    middle += UInt64(1) << 31;
+    return DiyFp(ac + (ad >> 32) + (bc >> 32) + (middle >> 32),
+                 e + other.e + 64);
+#endif
+  }
+
+  DiyFp normalize() const {
+    DiyFp result = *this;
+    while (!(result.f & (UInt64(1) << 63))) {
+      result.f <<= 1;
+      --result.e;
+    }
+    return result;
+  }
+
+  // The boundaries m- and m+ halfway to the neighbouring doubles, normalized
+  // to the exponent of m+
+  void boundaries(DiyFp* minus, DiyFp* plus) const {
+    DiyFp high = DiyFp((f << 1) + 1, e - 1);
+    while (!(high.f & (hiddenBit << 1))) {
+      high.f <<= 1;
+      --high.e;
+    }
+    high.f <<= 10;
+    high.e -= 10;
+    // the lower neighbour of a power of two is closer
+    DiyFp low = (f == hiddenBit) ? DiyFp((f << 2) - 1, e - 2)
+                                 : DiyFp((f << 1) - 1, e - 1);
+    low.f <<= low.e - high.e;
+    low.e = high.e;
+    *minus = low;
+    *plus = high;
+  }
+
+  static const UInt64 fractionMask = 0x000FFFFFFFFFFFFFULL;
+  static const UInt64 hiddenBit = 0x0010000000000000ULL;
+
+  UInt64 f;
+  int e;
+};
+
+// 10^k for k = -348, -340, ..., 340
+static DiyFp cachedPower(int index) {
+  static const UInt64 significands[] = {
+  0xFA8FD5A0081C0288ULL, 0xBAAEE17FA23EBF76ULL, 0x8B16FB203055AC76ULL,
+  0xCF42894A5DCE35EAULL, 0x9A6BB0AA55653B2DULL, 0xE61ACF033D1A45DFULL,
+  0xAB70FE17C79AC6CAULL, 0xFF77B1FCBEBCDC4FULL, 0xBE5691EF416BD60CULL,
+  0x8DD01FAD907FFC3CULL, 0xD3515C2831559A83ULL, 0x9D71AC8FADA6C9B5ULL,
+  0xEA9C227723EE8BCBULL, 0xAECC49914078536DULL, 0x823C12795DB6CE57ULL,
+  0xC21094364DFB5637ULL, 0x9096EA6F3848984FULL, 0xD77485CB25823AC7ULL,
+  0xA086CFCD97BF97F4ULL, 0xEF340A98172AACE5ULL, 0xB23867FB2A35B28EULL,
+  0x84C8D4DFD2C63F3BULL, 0xC5DD44271AD3CDBAULL, 0x936B9FCEBB25C996ULL,
+  0xDBAC6C247D62A584ULL, 0xA3AB66580D5FDAF6ULL, 0xF3E2F893DEC3F126ULL,
+  0xB5B5ADA8AAFF80B8ULL, 0x87625F056C7C4A8BULL, 0xC9BCFF6034C13053ULL,
+  0x964E858C91BA2655ULL, 0xDFF9772470297EBDULL, 0xA6DFBD9FB8E5B88FULL,
+  0xF8A95FCF88747D94ULL, 0xB94470938FA89BCFULL, 0x8A08F0F8BF0F156BULL,
+  0xCDB02555653131B6ULL, 0x993FE2C6D07B7FACULL, 0xE45C10C42A2B3B06ULL,
+  0xAA242499697392D3ULL, 0xFD87B5F28300CA0EULL, 0xBCE5086492111AEBULL,
+  0x8CBCCC096F5088CCULL, 0xD1B71758E219652CULL, 0x9C40000000000000ULL,
+  0xE8D4A51000000000ULL, 0xAD78EBC5AC620000ULL, 0x813F3978F8940984ULL,
+  0xC097CE7BC90715B3ULL, 0x8F7E32CE7BEA5C70ULL, 0xD5D238A4ABE98068ULL,
+  0x9F4F2726179A2245ULL, 0xED63A231D4C4FB27ULL, 0xB0DE65388CC8ADA8ULL,
+  0x83C7088E1AAB65DBULL, 0xC45D1DF942711D9AULL, 0x924D692CA61BE758ULL,
+  0xDA01EE641A708DEAULL, 0xA26DA3999AEF774AULL, 0xF209787BB47D6B85ULL,
+  0xB454E4A179DD1877ULL, 0x865B86925B9BC5C2ULL, 0xC83553C5C8965D3DULL,
+  0x952AB45CFA97A0B3ULL, 0xDE469FBD99A05FE3ULL, 0xA59BC234DB398C25ULL,
+  0xF6C69A72A3989F5CULL, 0xB7DCBF5354E9BECEULL, 0x88FCF317F22241E2ULL,
+  0xCC20CE9BD35C78A5ULL, 0x98165AF37B2153DFULL, 0xE2A0B5DC971F303AULL,
+  0xA8D9D1535CE3B396ULL, 0xFB9B7CD9A4A7443CULL, 0xBB764C4CA7A44410ULL,
+  0x8BAB8EEFB6409C1AULL, 0xD01FEF10A657842CULL, 0x9B10A4E5E9913129ULL,
+  0xE7109BFBA19C0C9DULL, 0xAC2820D9623BF429ULL, 0x80444B5E7AA7CF85ULL,
+  0xBF21E44003ACDD2DULL, 0x8E679C2F5E44FF8FULL, 0xD433179D9C8CB841ULL,
+  0x9E19DB92B4E31BA9ULL, 0xEB96BF6EBADF77D9ULL, 0xAF87023B9BF0EE6BULL,
+  };
+  static const short exponents[] = {
+  -1220, -1193, -1166, -1140, -1113, -1087, -1060, -1034, -1007, -980, -954, -927,
+  -901, -874, -847, -821, -794, -768, -741, -715, -688, -661, -635, -608,
+  -582, -555, -529, -502, -475, -449, -422, -396, -369, -343, -316, -289,
+  -263, -236, -210, -183, -157, -130, -103, -77, -50, -24, 3, 30,
+  56, 83, 109, 136, 162, 189, 216, 242, 269, 295, 322, 348,
+  375, 402, 428, 455, 481, 508, 534, 561, 588, 614, 641, 667,
+  694, 720, 747, 774, 800, 827, 853, 880, 907, 933, 960, 986,
+  1013, 1039, 1066,
+  };
+  return DiyFp(significands[index], exponents[index]);
+}
+
+// A power of ten c = 10^-k that brings the product with 2^e into [2^-60, 2^-32]
+static DiyFp cachedPowerFor(int e, int* k) {
+  // ceil((-61 - e) * log10(2)) + 347
+  double dk = (-61 - e) * 0.30102999566398114 + 347;
+  int ik = static_cast<int>(dk);
+  if (dk - ik > 0.0)
+    ++ik;
+  int index = (ik >> 3) + 1;
+  *k = -(-348 + index * 8);
+  return cachedPower(index);
+}
+
+static const UInt64 powersOfTen[] = {
+  1ULL, 10ULL, 100ULL, 1000ULL, 10000ULL, 100000ULL, 1000000ULL,
+  10000000ULL, 100000000ULL, 1000000000ULL, 10000000000ULL,
+  100000000000ULL, 1000000000000ULL, 10000000000000ULL,
+  100000000000000ULL, 1000000000000000ULL, 10000000000000000ULL,
+  100000000000000000ULL, 1000000000000000000ULL, 10000000000000000000ULL
+};
+
+// Moves the last digit towards w while that stays within the boundaries
+static void grisuRound(char* digits, int length, UInt64 delta, UInt64 rest,
+                       UInt64 tenKappa, UInt64 distance) {
+  while (rest < distance && delta - rest >= tenKappa &&
+         (rest + tenKappa < distance ||
+          distance - rest > rest + tenKappa - distance)) {
+    --digits[length - 1];
+    rest += tenKappa;
+  }
+}
+
+// The digits of w, as few as the boundaries [plus - delta, plus] allow
+static int grisuDigits(const DiyFp& w, const DiyFp& plus, UInt64 delta,
+                       char* digits, int* k) {
+  const DiyFp one(UInt64(1) << -plus.e, plus.e);
+  const UInt64 distance = (plus - w).f;
+  UInt integral = static_cast<UInt>(plus.f >> -one.e);
+  UInt64 fraction = plus.f & (one.f - 1);
+  int kappa = 1;
+  while (kappa < 10 && integral >= powersOfTen[kappa])
+    ++kappa;
+  int length = 0;
+  while (kappa > 0) {
+    UInt divisor = static_cast<UInt>(powersOfTen[kappa - 1]);
+    UInt digit = integral / divisor;
+    integral %= divisor;
+    if (digit || length)
+      digits[length++] = static_cast<char>('0' + digit);
+    --kappa;
+    UInt64 rest = (static_cast<UInt64>(integral) << -one.e) + fraction;
+    if (rest <= delta) {
+      *k += kappa;
+      grisuRound(digits, length, delta, rest, powersOfTen[kappa] << -one.e,
+                 distance);
+      return length;
+    }
+  }
+  for (;;) {
+    fraction *= 10;
+    delta *= 10;
+    char digit = static_cast<char>(fraction >> -one.e);
+    if (digit || length)
+      digits[length++] = static_cast<char>('0' + digit);
+    fraction &= one.f - 1;
+    --kappa;
+    if (fraction < delta) {
+      *k += kappa;
+      grisuRound(digits, length, delta, fraction, one.f,
+                 -kappa < 20 ? distance * powersOfTen[-kappa] : 0);
+      return length;
+    }
+  }
+}
+
+// Lays out value = digits * 10^k as %.17g does: positional for exponents from
+// -5 to 16, else scientific with a two-digit exponent at least
+static char* formatDigits(const char* digits, int length, int k, char* out) {
+  int exponent = length + k - 1;
+  if (exponent < -4 || exponent >= 17) {
+    *out++ = digits[0];
+    if (length > 1) {
+      *out++ = '.';
+      memcpy(out, digits + 1, length - 1);
+      out += length - 1;
+    }
+    *out++ = 'e';
+    *out++ = exponent < 0 ? '-' : '+';
+    unsigned magnitude = static_cast<unsigned>(exponent < 0 ? -exponent : exponent);
+    if (magnitude >= 100)
+      *out++ = static_cast<char>('0' + magnitude / 100);
+    *out++ = static_cast<char>('0' + magnitude / 10 % 10);
+    *out++ = static_cast<char>('0' + magnitude % 10);
+  } else if (exponent < 0) {
+    *out++ = '0';
+    *out++ = '.';
+    for (int i = -1; i > exponent; --i)
+      *out++ = '0';
+    memcpy(out, digits, length);
+    out += length;
+  } else if (length <= exponent + 1) {
+    memcpy(out, digits, length);
+    out += length;
+    for (int i = length; i <= exponent; ++i)
+      *out++ = '0';
+  } else {
+    memcpy(out, digits, exponent + 1);
+    out += exponent + 1;
+    *out++ = '.';
+    memcpy(out, digits + exponent + 1, length - exponent - 1);
+    out += length - exponent - 1;
+  }
+  return out;
+}
+
+char* valueToChars(double value, char* buffer) {
+  char* out = buffer;
+  if (!isfinite(value)) {
+    const char* text =
+        (value != value) ? "null" : (value < 0 ? "-1e+9999" : "1e+9999");
+    size_t length = strlen(text);
+    memcpy(out, text, length);
+    return out + length;
+  }
+  if (value < 0 || (value == 0.0 && 1.0 / value < 0)) {
+    *out++ = '-';
+    value = -value;
+  }
+  if (value == 0.0) {
+    *out++ = '0';
+    return out;
+  }
+  DiyFp v(value), minus, plus;
+  v.boundaries(&minus, &plus);
+  int k;
+  const DiyFp power = cachedPowerFor(plus.e, &k);
+  DiyFp w = v.normalize() * power;
+  DiyFp high = plus * power;
+  DiyFp low = minus * power;
+  ++low.f;
+  --high.f;
+  char digits[20];
+  int length = grisuDigits(w, high, high.f - low.f, digits, &k);
+  return formatDigits(digits, length, k, out);
+}
+
+char* valueToChars(LargestInt value, char* buffer) {
+  if (value < 0) {
+    *buffer++ = '-';
+    return valueToChars(LargestUInt(0) - LargestUInt(value), buffer);
+  }
+  return valueToChars(LargestUInt(value), buffer);
+}
+
+char* valueToChars(LargestUInt value, char* buffer) {
+  UIntToStringBuffer digits;
+  char* current = digits + sizeof(digits);
+  uintToString(value, current);
+  size_t length = digits + sizeof(digits) - 1 - current;
+  memcpy(buffer, current, length);
+  return buffer + length;
+}
+
 std::string valueToString(LargestInt value) {
   UIntToStringBuffer buffer;
   char* current = buffer + sizeof(buffer);
@@ -3865,6 +4326,10 @@ std::string valueToString(double value, bool useSpecialFloats, unsigned int prec
   char buffer[32];
   int len = -1;
 
+  // 17 digits tell every double apart, and so do the fewest that read back as it
+  if (precision == 17 && (isfinite(value) || !useSpecialFloats))
+    return std::string(buffer, valueToChars(value, buffer));
+
   char formatString[6];
   sprintf(formatString, "%%.%dg", precision);
 
@@ -4057,15 +4522,21 @@ void FastWriter::writeValue(const Value& value) {
   case nullValue:
     document_ += "null";
     break;
-  case intValue:
-    document_ += valueToString(value.asLargestInt());
+  case intValue: {
+    char buffer[32];
+    document_.append(buffer, valueToChars(value.asLargestInt(), buffer));
     break;
-  case uintValue:
-    document_ += valueToString(value.asLargestUInt());
+  }
+  case uintValue: {
+    char buffer[32];
+    document_.append(buffer, valueToChars(value.asLargestUInt(), buffer));
     break;
-  case realValue:
-    document_ += valueToString(value.asDouble());
+  }
+  case realValue: {
+    char buffer[32];
+    document_.append(buffer, valueToChars(value.asDouble(), buffer));
     break;
+  }
   case stringValue:
   {
     // Is NULL possible for value.string_?
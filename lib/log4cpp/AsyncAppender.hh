@@ -0,0 +1,109 @@
+/*
+ * AsyncAppender.hh
+ *
+ * Copyright 2017, Log4cpp Project. All rights reserved.
+ *
+ * See the COPYING file for the terms of usage and distribution.
+ */
+
+#ifndef _LOG4CPP_ASYNCAPPENDER_HH
+#define _LOG4CPP_ASYNCAPPENDER_HH
+
+#include <log4cpp/Portability.hh>
+#include <log4cpp/LayoutAppender.hh>
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <thread>
+
+namespace log4cpp {
+
+    /**
+     * AsyncAppender takes the writing of events off the threads that log
+     * them. An event is formatted with the layout of the AsyncAppender on
+     * the thread that logs it, and copied into a slot of a ring allocated
+     * when the appender is made; a thread of the appender's own takes the
+     * slots in order and writes as many as are ready to another appender,
+     * the sink, in one event. The threads logging take slots without a
+     * lock, so a slow disk or a lost syslog server holds up the appender's
+     * thread and not theirs.
+     *
+     * The sink is given a PassThroughLayout, the events it is given being
+     * formatted already, and its threshold is taken over by the
+     * AsyncAppender; a filter is set on the AsyncAppender too. The sink has
+     * to be left to the AsyncAppender, and it is not owned by it.
+     *
+     * When the ring is full, the policy is to BLOCK, waiting for the
+     * appender's thread to free a slot, or to DROP the event and count it.
+     * close() and Category::shutdown() write out what is left, stop the
+     * thread and close the sink.
+     **/
+    class LOG4CPP_EXPORT AsyncAppender : public LayoutAppender {
+        public:
+        typedef enum {
+            BLOCK,
+            DROP
+        } OverflowPolicy;
+
+        /**
+         * @param name The name of this Appender.
+         * @param sink The Appender to write the events to.
+         * @param bufferSize The number of events that can wait to be
+         * written, rounded up to a power of two.
+         * @param overflow What to do with an event when as many are waiting.
+         **/
+        AsyncAppender(const std::string& name, Appender& sink, size_t bufferSize = 1024,
+                      OverflowPolicy overflow = BLOCK);
+        virtual ~AsyncAppender();
+
+        virtual bool reopen();
+        virtual void close();
+
+        Appender& getSink() { return _sink; }
+        OverflowPolicy getOverflowPolicy() const { return _overflow; }
+
+        /**
+         * The events dropped because the ring was full, or because they
+         * were logged after close().
+         **/
+        unsigned long getDropped() const { return _dropped.load(std::memory_order_relaxed); }
+
+        /**
+         * The policy of a name, "block" or "drop" in any case.
+         * @exception std::invalid_argument if the name is neither
+         **/
+        static OverflowPolicy getOverflowPolicy(const std::string& name);
+
+        protected:
+        virtual void _append(const LoggingEvent& event);
+
+        private:
+        struct Slot {
+            std::atomic<size_t> sequence;   // the position it is free for, or that position + 1 once filled
+            std::string text;
+        };
+
+        void _run();
+        void _wakeWriter();
+
+        Appender& _sink;
+        const OverflowPolicy _overflow;
+        Slot* _slots;
+        const size_t _mask;
+        std::atomic<size_t> _enqueue;
+        std::atomic<unsigned long> _dropped;
+        std::atomic<bool> _closed;
+        std::atomic<int> _appending;        // threads in _append() that may still fill a slot
+        std::atomic<bool> _stopping;        // set once they are done, for the writer to finish
+        std::atomic<bool> _writerWaiting;
+        std::mutex _wakeMutex;
+        std::condition_variable _wake;
+        std::thread _writer;
+
+        AsyncAppender(const AsyncAppender&);
+        AsyncAppender& operator=(const AsyncAppender&);
+    };
+}
+
+#endif // _LOG4CPP_ASYNCAPPENDER_HH
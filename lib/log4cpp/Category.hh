@@ -19,6 +19,7 @@
 #include <log4cpp/convenience.h>
 
 #include <map>
+#include <atomic>
 #include <vector>
 #include <cstdarg>
 #include <stdexcept>
@@ -132,13 +133,16 @@ namespace log4cpp {
          *  of the root category.
          * 
          * <p>The Category class is designed so that this method executes as
-         * quickly as possible.
+         * quickly as possible: the chained priority is resolved whenever a
+         * priority in the hierarchy is set, and kept in an atomic that is
+         * read without a lock.
          **/
         virtual Priority::Value getChainedPriority() const throw();
 
         /** 
          * Returns true if the chained priority of the Category is equal to
-         * or higher than given priority.
+         * or higher than given priority. It is one atomic load, so that
+         * logging at a disabled priority costs next to nothing.
          * @param priority The priority to compare with.
          * @returns whether logging is enable for this priority.
          **/
@@ -642,6 +646,15 @@ namespace log4cpp {
          **/
         volatile Priority::Value _priority;
 
+        /**
+         * The priority of this category, or of the nearest ancestor with
+         * one set, kept up to date by setPriority().
+         **/
+        std::atomic<Priority::Value> _chainedPriority;
+
+        /** Resolve _chainedPriority from _priority and the parent's. **/
+        void _updateChainedPriority() throw();
+
         typedef std::map<Appender *, bool> OwnsAppenderMap;
 
         /**
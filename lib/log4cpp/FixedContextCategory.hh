@@ -73,6 +73,13 @@ namespace log4cpp {
          * quickly as possible.
          **/
         virtual Priority::Value getChainedPriority() const throw();
+
+        /**
+         * Returns true if the chained priority of this category, which
+         * follows that of the delegate, is equal to or higher than given
+         * priority.
+         **/
+        virtual bool isPriorityEnabled(Priority::Value priority) const throw();
         
         /**
          * For the moment this method does nothing.
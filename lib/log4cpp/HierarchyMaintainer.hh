@@ -14,6 +14,7 @@
 #include <string>
 #include <map>
 #include <vector>
+#include <atomic>
 #include <log4cpp/Category.hh>
 #include <log4cpp/threading/Threading.hh>
 
@@ -23,9 +24,14 @@ namespace log4cpp {
      * HierarchyMaintainer is an internal log4cpp class. It is responsible
      * for maintaining the hierarchy of Categories. Applications should
      * not have to use this class directly.
+     *
+     * <p>Categories, once made, are published in a table of their own that
+     * getInstance() and getExistingInstance() read without a lock; only the
+     * first lookup of a category takes the mutex, to make it.
      **/
     class HierarchyMaintainer {
         friend class Log4cppCleanup;
+        friend class Category;
 
         public:
         typedef std::map<std::string, Category*> CategoryMap;
@@ -50,6 +56,24 @@ namespace log4cpp {
 
         private:
         typedef std::vector<shutdown_fun_ptr> handlers_t;
+
+        /**
+         * A published category. Entries are only ever added, at the head
+         * of their bucket, until deleteAllCategories().
+         **/
+        struct Published {
+            size_t hash;
+            Category* category;
+            Published* next;
+        };
+
+        static const size_t PUBLISHED_BUCKETS = 256;
+
+        Category* _findPublished(const std::string& name, size_t hash) const;
+        void _publish(Category* category, size_t hash);
+        void _updateChainedPriorities();
+
+        std::atomic<Published*> _published[PUBLISHED_BUCKETS];
      
         static HierarchyMaintainer* _defaultMaintainer;
         handlers_t handlers_;
@@ -33,6 +33,17 @@ namespace log4cpp {
          * @returns an appendable string.
          **/
         virtual std::string format(const LoggingEvent& event) = 0;
+
+        /**
+         * Formats the LoggingEvent data onto the end of a string, so that
+         * an appender can format every event into the same buffer. By
+         * default it appends what format() returns.
+         * @param event The LoggingEvent.
+         * @param out The string to append to.
+         **/
+        virtual void appendFormatted(const LoggingEvent& event, std::string& out) {
+            out += format(event);
+        }
     };        
 }
 
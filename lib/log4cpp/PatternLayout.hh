@@ -58,6 +58,14 @@ namespace log4cpp {
          **/
         virtual std::string format(const LoggingEvent& event);
 
+        /**
+         * Formats the LoggingEvent onto the end of a string, writing the
+         * components of the pattern compiled by setConversionPattern
+         * straight into it. The date of a %%d is formatted once a second
+         * on each thread and copied for the events within that second.
+         **/
+        virtual void appendFormatted(const LoggingEvent& event, std::string& out);
+
         /**
          * Sets the format of log lines handled by this
          * PatternLayout. By default, set to "%%m%%n".<br>
@@ -87,6 +95,11 @@ namespace log4cpp {
 
         virtual void clearConversionPattern();
 
+        /**
+         * The interface of the components a pattern was once built from.
+         * PatternLayout no longer uses it and keeps it for the code that
+         * does.
+         **/
         class LOG4CPP_EXPORT PatternComponent {
             public:
             inline virtual ~PatternComponent() {};
@@ -94,7 +107,32 @@ namespace log4cpp {
         };
 
         private:
-        typedef std::vector<PatternComponent*> ComponentVector; 
+        struct Component {
+            typedef enum {
+                LITERAL,
+                MESSAGE,
+                CATEGORY,
+                DATE,
+                PRIORITY,
+                MILLIS_SINCE_START,
+                SECONDS_SINCE_EPOCH,
+                THREAD,
+                PROCESSOR_TIME,
+                NDC
+            } Kind;
+
+            Kind kind;
+            std::string text;           // the literal, or the strftime format of a date before its %l
+            std::string textAfter;      // the strftime format of a date after its %l
+            bool millis;                // the date has a %l
+            unsigned long dateId;       // which date it is in the per thread cache
+            int precision;              // the trailing components of the category, -1 for all
+            size_t minWidth;
+            size_t maxWidth;
+            bool alignLeft;
+        };
+        typedef std::vector<Component> ComponentVector; 
+        static Component literalComponent(const std::string& literal);
         ComponentVector _components;
 
         std::string _conversionPattern;
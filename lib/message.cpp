@@ -62,13 +62,15 @@ message::message(const MQTTAsync_message& msg) : msg_(msg)
 	set_payload(msg.payload, msg.payloadlen);
 }
 
-message::message(const message& other) : msg_(other.msg_)
+message::message(const message& other) : msg_(other.msg_), priority_(other.priority_),
+		coalesce_(other.coalesce_)
 {
 	set_payload(other.payload_);
 }
 
 message::message(message&& other)
-		: msg_(other.msg_), payload_(std::move(other.payload_))
+		: msg_(other.msg_), payload_(std::move(other.payload_)), priority_(other.priority_),
+		  coalesce_(other.coalesce_)
 {
 	msg_.payload = const_cast<char*>(payload_.data());
 	msg_.payloadlen = payload_.length();
@@ -85,6 +87,8 @@ message& message::operator=(const message& rhs)
 {
 	if (&rhs != this) {
 		msg_ = rhs.msg_;
+		priority_ = rhs.priority_;
+		coalesce_ = rhs.coalesce_;
 		set_payload(rhs.payload_);
 	}
 	return *this;
@@ -95,6 +99,8 @@ message& message::operator=(message&& rhs)
 	if (&rhs != this) {
 		msg_ = rhs.msg_;
 		payload_ = std::move(rhs.payload_);
+		priority_ = rhs.priority_;
+		coalesce_ = rhs.coalesce_;
 
 		msg_.payload = const_cast<char*>(payload_.data());
 		msg_.payloadlen = payload_.length();
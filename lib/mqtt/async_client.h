@@ -129,7 +129,7 @@ public:
 	 *  				as a URI.
 	 * @param clientId a client identifier that is unique on the server
 	 *  			   being connected to
-	 * @param persistDir
+	 * @param persistDir the directory holding the buffered messages
 	 */
 	async_client(const std::string& serverURI, const std::string& clientId,
 				 const std::string& persistDir);
@@ -147,6 +147,24 @@ public:
 	 */
 	async_client(const std::string& serverURI, const std::string& clientId,
 				 iclient_persistence* persistence);
+	/**
+	 * Create an async_client with one of the built-in persistence types.
+	 * @param serverURI the address of the server to connect to, specified
+	 *  				as a URI.
+	 * @param clientId a client identifier that is unique on the server
+	 *  			   being connected to
+	 * @param persistenceType one of MQTTCLIENT_PERSISTENCE_DEFAULT, _LOG,
+	 *  					  _MEMORY or _NONE
+	 * @param persistDir the directory holding the persisted messages, or
+	 *  				 empty for the current working directory
+	 * @param maxBufferedMessages the maximum number of messages buffered
+	 *  						  while disconnected, 0 to not buffer
+	 * @param snapshotInterval milliseconds between writes of the memory
+	 *  					   store to its snapshot file
+	 */
+	async_client(const std::string& serverURI, const std::string& clientId,
+				 int persistenceType, const std::string& persistDir,
+				 int maxBufferedMessages, int snapshotInterval);
 	/**
 	 * Destructor
 	 */
@@ -273,6 +291,16 @@ public:
 	 * @return true if connected, false otherwise.
 	 */
 	bool is_connected() const override { return MQTTAsync_isConnected(cli_) != 0; }
+	/**
+	 * Gets the in-flight window, round trip time estimate and pacing rate of
+	 * the connection.
+	 * @return MQTTAsync_inflightStats
+	 */
+	MQTTAsync_inflightStats get_inflight_stats() const {
+		MQTTAsync_inflightStats stats = MQTTAsync_inflightStats_initializer;
+		MQTTAsync_getInflightStats(cli_, &stats);
+		return stats;
+	}
 	/**
 	 * Publishes a message to a topic on the server
 	 * @param topic The topic to deliver the message to
@@ -330,6 +358,21 @@ public:
 	 */
 	idelivery_token_ptr publish(const std::string& topic, const_message_ptr msg,
 										void* userContext, iaction_listener& cb) override;
+	/**
+	 * Completes a publish that is not handed to the server, such as an
+	 * event the application drops over a rate limit, so that the listener
+	 * waiting for it is called.
+	 * @param topic the topic the message was for
+	 * @param msg the message
+	 * @param userContext optional object used to pass context to the
+	 *  				  callback. Use @em nullptr if not required.
+	 * @param cb the listener to call
+	 * @param rc the return code the token fails with, or
+	 *  		 MQTTASYNC_SUCCESS for it to succeed
+	 * @return the token, already complete
+	 */
+	idelivery_token_ptr complete_unsent(const std::string& topic, const_message_ptr msg,
+										void* userContext, iaction_listener& cb, int rc);
 	/**
 	 * Sets a callback listener to use for events that happen
 	 * asynchronously.
@@ -239,6 +239,20 @@ public:
 	  *   @li MQTTVERSION_3_1_1 (4) = only try version 3.1.1
 	  */
 	void set_mqtt_version(int mqttVersion) { opts_.MQTTVersion = mqttVersion; }
+	/**
+	 * Sets the largest number of QoS 1 and 2 messages in flight.
+	 * @param maxInflight
+	 */
+	void set_max_inflight(int maxInflight) { opts_.maxInflight = maxInflight; }
+	/**
+	 * Sets how the messages in flight are limited.
+	 * @param inflightControl
+	 *   @li MQTTASYNC_INFLIGHT_NONE (0) = no limit
+	 *   @li MQTTASYNC_INFLIGHT_FIXED (1) = at most the max inflight
+	 *   @li MQTTASYNC_INFLIGHT_ADAPTIVE (2) = a window sized from the
+	 *       acknowledgement round trip time, up to the max inflight
+	 */
+	void set_inflight_control(int inflightControl) { opts_.inflightControl = inflightControl; }
 	/**
 	 * Gets a string representation of the object.
 	 * @return
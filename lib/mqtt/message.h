@@ -48,6 +48,10 @@ class message
 	 * an arbitrary binary blob held in a std::string container.
 	 */
 	std::string payload_;
+	/** The command queue lane the message is published on */
+	int priority_ = MQTTASYNC_PRIORITY_NORMAL;
+	/** Whether a later message to the topic replaces this one while it is queued */
+	bool coalesce_ = false;
 
 	/** The client has special access. */
 	friend class async_client;
@@ -142,6 +146,16 @@ public:
 	 * @return The quality of service for this message.
 	 */
 	int get_qos() const { return msg_.qos; }
+	/**
+	 * Returns the lane the message is queued on when published.
+	 * @return MQTTASYNC_PRIORITY_NORMAL, _HIGH or _BULK
+	 */
+	int get_priority() const { return priority_; }
+	/**
+	 * Returns whether a later message to the same topic replaces this one
+	 * while it is waiting to be sent.
+	 */
+	bool is_coalesced() const { return coalesce_; }
 	/**
 	 * Returns whether or not this message might be a duplicate of one which
 	 * has already been received.
@@ -181,6 +195,21 @@ public:
 	 *  			   broker, @em false if not.
 	 */
 	void set_retained(bool retained) { msg_.retained = (retained) ? (!0) : 0; }
+	/**
+	 * Sets the lane the message is queued on when published. High priority
+	 * messages go ahead of all others, bulk messages share the connection
+	 * with normal ones rather than hold them up.
+	 * @param priority MQTTASYNC_PRIORITY_NORMAL, _HIGH or _BULK
+	 */
+	void set_priority(int priority) { priority_ = priority; }
+	/**
+	 * Sets whether a later message to the same topic, also coalesced,
+	 * replaces this one while it is waiting to be sent. The replaced
+	 * message is never sent: its token fails with MQTTASYNC_SUPERSEDED.
+	 * For state-style messages where only the latest value matters.
+	 * @param coalesce @em true to keep only the latest queued value
+	 */
+	void set_coalesced(bool coalesce) { coalesce_ = coalesce; }
 	/**
 	 * Returns a string representation of this messages payload.
 	 * @return std::string
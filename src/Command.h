@@ -12,11 +12,15 @@
  *
  * Contributors:
  *    Hari Prasada Reddy - initial API and implementation and/or initial documentation
+ *    Added the decoded payload of json, cbor and msgpack commands.
  *******************************************************************************/
 
 #ifndef SRC_COMMAND_H_
 #define SRC_COMMAND_H_
 
+#include <string>
+#include "json/json.h"
+
 class Command{
 private:
 	std::string deviceType;
@@ -24,6 +28,8 @@ private:
 	std::string commandName;
 	std::string format;
 	std::string payload;
+	Json::Value data;
+	bool decoded;
 public:
 	Command(std::string type, std::string id, std::string cmdName, std::string fmt, std::string strPayload){
 		deviceType = type;
@@ -31,6 +37,7 @@ public:
 		commandName = cmdName;
 		format = fmt;
 		payload = strPayload;
+		decoded = false;
 	}
 	std::string getDeviceType(){
 		return deviceType;
@@ -49,6 +56,25 @@ public:
 	std::string getPayload() {
 		return payload;
 	}
+
+	/**
+	 * Whether the payload was decoded, as its format says: json, cbor or msgpack
+	 */
+	bool hasData() {
+		return decoded;
+	}
+
+	/**
+	 * The decoded payload, null if it was not decoded
+	 */
+	const Json::Value& getData() {
+		return data;
+	}
+
+	void setData(const Json::Value& value) {
+		data = value;
+		decoded = true;
+	}
 };
 
 #endif /* SRC_COMMAND_H_ */
@@ -0,0 +1,196 @@
+/*******************************************************************************
+ * Copyright (c) 2017 IBM Corp.
+ *
+ * All rights reserved. This program and the accompanying materials
+ * are made available under the terms of the Eclipse Public License v1.0
+ * and Eclipse Distribution License v1.0 which accompany this distribution.
+ *
+ * The Eclipse Public License is available at
+ *    http://www.eclipse.org/legal/epl-v10.html
+ * and the Eclipse Distribution License is available at
+ *   http://www.eclipse.org/org/documents/edl-v10.php.
+ *
+ * Contributors:
+ *    Windowed aggregation of gateway telemetry
+ *******************************************************************************/
+
+#include "IOTP_Aggregator.h"
+
+#include <algorithm>
+#include <chrono>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace Watson_IOTP {
+
+IOTP_Aggregator::IOTP_Aggregator(int64_t window, int64_t slide) :
+	mWindow(window > 0 ? window : 1),
+	mSlide((slide > 0 && slide < mWindow) ? slide : mWindow)
+{
+}
+
+void IOTP_Aggregator::add(const std::string& deviceType, const std::string& deviceId, const std::string& eventType,
+		const std::string& field, double value, int64_t time) {
+	std::lock_guard<std::mutex> lck(mLock);
+	Series& s = series(deviceType, deviceId, eventType, field, time);
+	s.values.push_back(value);
+	s.times.push_back(time);
+}
+
+void IOTP_Aggregator::add(const std::string& deviceType, const std::string& deviceId, const std::string& eventType,
+		const std::string& field, const double* values, const int64_t* times, size_t count) {
+	if (count == 0)
+		return;
+	std::lock_guard<std::mutex> lck(mLock);
+	Series& s = series(deviceType, deviceId, eventType, field, times[0]);
+	s.values.insert(s.values.end(), values, values + count);
+	s.times.insert(s.times.end(), times, times + count);
+}
+
+size_t IOTP_Aggregator::close(int64_t now, std::vector<Window>& closed) {
+	std::lock_guard<std::mutex> lck(mLock);
+	size_t count = 0;
+	std::unordered_map<std::string, Group>::iterator it = mGroups.begin();
+	while (it != mGroups.end()) {
+		Group& group = it->second;
+		while (group.end != 0 && group.end <= now) {
+			Window window;
+			if (closeWindow(group, window)) {
+				closed.push_back(std::move(window));
+				++count;
+			}
+		}
+		// a device that stopped sending is forgotten once its last window closes
+		if (group.end == 0)
+			it = mGroups.erase(it);
+		else
+			++it;
+	}
+	return count;
+}
+
+size_t IOTP_Aggregator::flush(std::vector<Window>& closed) {
+	return close(INT64_MAX, closed);
+}
+
+int64_t IOTP_Aggregator::nextClose() {
+	std::lock_guard<std::mutex> lck(mLock);
+	int64_t next = 0;
+	for (std::unordered_map<std::string, Group>::const_iterator it = mGroups.begin(); it != mGroups.end(); ++it)
+		if (it->second.end != 0 && (next == 0 || it->second.end < next))
+			next = it->second.end;
+	return next;
+}
+
+IOTP_Aggregator::Stats IOTP_Aggregator::aggregate(const double* values, size_t count) {
+	Stats stats = { 0, 0, 0, 0, count };
+	if (count == 0)
+		return stats;
+
+	double mn = values[0], mx = values[0], sum = 0;
+	size_t i = 0;
+#if defined(__SSE2__)
+	// two registers of each so consecutive adds do not wait on one another
+	__m128d min0 = _mm_set1_pd(mn), min1 = min0, max0 = min0, max1 = min0;
+	__m128d sum0 = _mm_setzero_pd(), sum1 = sum0;
+	for (; i + 4 <= count; i += 4) {
+		__m128d a = _mm_loadu_pd(values + i), b = _mm_loadu_pd(values + i + 2);
+		min0 = _mm_min_pd(min0, a);
+		min1 = _mm_min_pd(min1, b);
+		max0 = _mm_max_pd(max0, a);
+		max1 = _mm_max_pd(max1, b);
+		sum0 = _mm_add_pd(sum0, a);
+		sum1 = _mm_add_pd(sum1, b);
+	}
+	double lanes[2];
+	_mm_storeu_pd(lanes, _mm_min_pd(min0, min1));
+	mn = std::min(lanes[0], lanes[1]);
+	_mm_storeu_pd(lanes, _mm_max_pd(max0, max1));
+	mx = std::max(lanes[0], lanes[1]);
+	_mm_storeu_pd(lanes, _mm_add_pd(sum0, sum1));
+	sum = lanes[0] + lanes[1];
+#else
+	double min4[4] = { mn, mn, mn, mn }, max4[4] = { mn, mn, mn, mn }, sum4[4] = { 0, 0, 0, 0 };
+	for (; i + 4 <= count; i += 4) {
+		for (int lane = 0; lane < 4; ++lane) {
+			double v = values[i + lane];
+			min4[lane] = v < min4[lane] ? v : min4[lane];
+			max4[lane] = v > max4[lane] ? v : max4[lane];
+			sum4[lane] += v;
+		}
+	}
+	mn = std::min(std::min(min4[0], min4[1]), std::min(min4[2], min4[3]));
+	mx = std::max(std::max(max4[0], max4[1]), std::max(max4[2], max4[3]));
+	sum = (sum4[0] + sum4[1]) + (sum4[2] + sum4[3]);
+#endif
+	for (; i < count; ++i) {
+		mn = std::min(mn, values[i]);
+		mx = std::max(mx, values[i]);
+		sum += values[i];
+	}
+
+	stats.min = mn;
+	stats.max = mx;
+	stats.mean = sum / count;
+	stats.last = values[count - 1];
+	return stats;
+}
+
+int64_t IOTP_Aggregator::now() {
+	return std::chrono::duration_cast<std::chrono::milliseconds>(
+			std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+IOTP_Aggregator::Series& IOTP_Aggregator::series(const std::string& deviceType, const std::string& deviceId,
+		const std::string& eventType, const std::string& field, int64_t time) {
+	Group& group = mGroups[deviceType + "/" + deviceId + "/" + eventType];
+	if (group.end == 0) {
+		group.deviceType = deviceType;
+		group.deviceId = deviceId;
+		group.eventType = eventType;
+		group.end = (time / mSlide + 1) * mSlide;
+	}
+	return group.fields[field];
+}
+
+// Aggregate the window ending at group.end, drop the samples no later window covers and move
+// on to the next window that has samples
+bool IOTP_Aggregator::closeWindow(Group& group, Window& window) {
+	int64_t start = group.end - mWindow, next = group.end + mSlide;
+	int64_t earliest = 0;
+	bool any = false;
+
+	window.deviceType = group.deviceType;
+	window.deviceId = group.deviceId;
+	window.eventType = group.eventType;
+	window.start = start;
+	window.end = group.end;
+	for (std::map<std::string, Series>::iterator it = group.fields.begin(); it != group.fields.end(); ++it) {
+		Series& s = it->second;
+		size_t lo = std::lower_bound(s.times.begin(), s.times.end(), start) - s.times.begin();
+		size_t hi = std::lower_bound(s.times.begin() + lo, s.times.end(), group.end) - s.times.begin();
+		if (hi > lo) {
+			Field field = { it->first, aggregate(s.values.data() + lo, hi - lo) };
+			window.fields.push_back(field);
+		}
+
+		size_t keep = std::lower_bound(s.times.begin(), s.times.end(), next - mWindow) - s.times.begin();
+		s.values.erase(s.values.begin(), s.values.begin() + keep);
+		s.times.erase(s.times.begin(), s.times.begin() + keep);
+		if (!s.times.empty()) {
+			if (!any || s.times.front() < earliest)
+				earliest = s.times.front();
+			any = true;
+		}
+	}
+
+	if (!any)
+		group.end = 0;
+	else
+		group.end = std::max(next, (earliest / mSlide + 1) * mSlide);
+	return !window.fields.empty();
+}
+
+} /* namespace Watson_IOTP */
@@ -0,0 +1,152 @@
+/*******************************************************************************
+ * Copyright (c) 2017 IBM Corp.
+ *
+ * All rights reserved. This program and the accompanying materials
+ * are made available under the terms of the Eclipse Public License v1.0
+ * and Eclipse Distribution License v1.0 which accompany this distribution.
+ *
+ * The Eclipse Public License is available at
+ *    http://www.eclipse.org/legal/epl-v10.html
+ * and the Eclipse Distribution License is available at
+ *   http://www.eclipse.org/org/documents/edl-v10.php.
+ *
+ * Contributors:
+ *    Windowed aggregation of gateway telemetry
+ *******************************************************************************/
+
+#ifndef IOTP_AGGREGATOR_H_
+#define IOTP_AGGREGATOR_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace Watson_IOTP {
+
+/**
+ * Windowed aggregation of numeric event fields, per device, event type and field. Samples
+ * are kept as a structure of arrays, a buffer of values and one of timestamps per field, and
+ * a window is reduced to its min, max, mean, count and last value by a kernel that runs over
+ * the value buffer two doubles at a time.
+ *
+ * Windows are aligned to multiples of the slide and cover the window length before their end:
+ * tumbling windows when the slide is the window length, overlapping sliding windows when it is
+ * shorter. A window closes, and its aggregate is returned, once the time passes its end.
+ * Samples are expected in time order per field, so times should come from a clock that does
+ * not step back, such as now().
+ */
+class IOTP_Aggregator {
+public:
+	typedef std::shared_ptr<IOTP_Aggregator> ptr_t;
+
+	/** The aggregate of a field over a window */
+	struct Stats {
+		double min;
+		double max;
+		double mean;
+		double last;
+		uint64_t count;
+	};
+
+	struct Field {
+		std::string name;
+		Stats stats;
+	};
+
+	/** A closed window of a device and event type, with the fields that had samples */
+	struct Window {
+		std::string deviceType;
+		std::string deviceId;
+		std::string eventType;
+		int64_t start;			// milliseconds, on the clock of the samples' times
+		int64_t end;
+		std::vector<Field> fields;
+	};
+
+	/**
+	 * Constructor of an IOTP_Aggregator.
+	 * @param window - window length in milliseconds
+	 * @param slide - milliseconds between the ends of windows, 0 or the window length for
+	 * tumbling windows
+	 */
+	IOTP_Aggregator(int64_t window, int64_t slide = 0);
+
+	/**
+	 * Add a sample of a field.
+	 * @param time - milliseconds, as given by now()
+	 */
+	void add(const std::string& deviceType, const std::string& deviceId, const std::string& eventType,
+			const std::string& field, double value, int64_t time);
+
+	/**
+	 * Add samples of a field in bulk, in time order.
+	 */
+	void add(const std::string& deviceType, const std::string& deviceId, const std::string& eventType,
+			const std::string& field, const double* values, const int64_t* times, size_t count);
+
+	/**
+	 * Close the windows that end at or before a time.
+	 * @param now - milliseconds, as given by now()
+	 * @param closed - the windows closed are appended to this
+	 * @return the number of windows closed
+	 */
+	size_t close(int64_t now, std::vector<Window>& closed);
+
+	/**
+	 * Close every window that has samples, including those that have not reached their end,
+	 * so that nothing is lost when aggregation stops.
+	 * @param closed - the windows closed are appended to this
+	 * @return the number of windows closed
+	 */
+	size_t flush(std::vector<Window>& closed);
+
+	/**
+	 * The end of the next window to close, or 0 if there are no samples.
+	 */
+	int64_t nextClose();
+
+	int64_t window() const { return mWindow; }
+	int64_t slide() const { return mSlide; }
+
+	/**
+	 * Reduce a buffer of values to their min, max, mean, count and last value.
+	 */
+	static Stats aggregate(const double* values, size_t count);
+
+	/** Milliseconds of a steady clock, which a change of the system time does not move */
+	static int64_t now();
+
+private:
+	struct Series {
+		std::vector<double> values;
+		std::vector<int64_t> times;
+	};
+
+	struct Group {
+		std::string deviceType;
+		std::string deviceId;
+		std::string eventType;
+		int64_t end;						// of the next window to close, 0 when there are no samples
+		std::map<std::string, Series> fields;
+	};
+
+	Series& series(const std::string& deviceType, const std::string& deviceId, const std::string& eventType,
+			const std::string& field, int64_t time);
+	bool closeWindow(Group& group, Window& window);
+
+	int64_t mWindow;
+	int64_t mSlide;
+	std::mutex mLock;
+	std::unordered_map<std::string, Group> mGroups;
+};
+
+typedef IOTP_Aggregator::ptr_t iotp_aggregator_ptr;
+
+} /* namespace Watson_IOTP */
+
+#endif /* IOTP_AGGREGATOR_H_ */
@@ -18,6 +18,14 @@
  *    Lokesh Haralakatta - Added log4cpp integration code for logging.
  *    Lokesh K Haralakatta - Added SSL/TLS Support.
  *    Lokesh K Haralakatta - Added custom port support.
+ *    Added disk spool for events published while offline.
+ *    Added persistence settings and routing of topics to the connections of a sharded client.
+ *    Added priority lanes for management and event messages.
+ *    Added rate limits for published events.
+ *    Added latest-value coalescing of queued state events.
+ *    Added deadband filter for published events.
+ *    Added CBOR and MessagePack payloads of events and commands.
+ *    Added compression of event and command payloads.
  *******************************************************************************/
 
 #include <algorithm>
@@ -86,18 +94,43 @@ namespace Watson_IOTP {
 
 	void IOTP_Client::IOTF_Callback::message_arrived(const std::string& topic, mqtt::const_message_ptr msg) {
 		Json::Value jsonPayload;
-		Json::Reader reader;
 		iotp_message_handler_ptr handler = nullptr;
 		iotp_reply_message_ptr reply;
 
 		//guard g1(mLock);
 		mArrivedMessages++;
 
+		// A compressed payload names its codec after its format, "fmt/json.zlib"
+		std::string payloadTopic = topic;
+		if (IOTP_Compressor::isCompressed(topic)) {
+			std::string payload = msg->get_payload();
+			if (mClient->mCompressor == nullptr || !mClient->mCompressor->decompress(payloadTopic, payload)) {
+				std::cout << typeid(*this).name() << " Failed to decompress message on " << topic << std::endl;
+				return;
+			}
+			mqtt::message_ptr decompressed = std::make_shared<mqtt::message>(payload);
+			decompressed->set_qos(msg->get_qos());
+			msg = decompressed;
+		}
+
+		// Commands are decoded as their fmt/ segment says; management messages have none and are json
+		IOTP_Encoding::Format payloadFormat = IOTP_Encoding::topicFormat(payloadTopic);
+		if (payloadFormat == IOTP_Encoding::UNKNOWN)
+			payloadFormat = IOTP_Encoding::JSON;
+
 		std::pair <std::multimap<std::string,iotp_message_handler_ptr>::iterator, std::multimap<std::string,iotp_message_handler_ptr>::iterator> ret;
 		ret = mHandlers.equal_range(topic);
+
+		// Json is indexed once for all the handlers, which read what they need from the index
+		IOTP_JsonDocument document;
+		if (ret.first != ret.second && payloadFormat == IOTP_Encoding::JSON)
+			document.load(msg->get_payload().data(), msg->get_payload().size());
+
 		for (std::multimap<std::string,iotp_message_handler_ptr>::iterator it=ret.first; it!=ret.second; ++it) {
 			handler = it->second;
-			if (reader.parse(msg->get_payload(), jsonPayload)) {
+			if (document.valid()) {
+				reply = handler->message_arrived(topic, document, msg);
+			} else if (payloadFormat != IOTP_Encoding::JSON && decode(msg->get_payload(), payloadFormat, jsonPayload)) {
 				reply = handler->message_arrived(topic, jsonPayload);
 			} else {
 				reply = handler->message_arrived(topic, msg);
@@ -121,15 +154,32 @@ namespace Watson_IOTP {
 			pos = topic.find("cmd/");	//"iot-2/cmd/+/fmt/+"
 			nxtpos = topic.find_first_of('/', pos+4);
 			std::string command = topic.substr(pos+4,nxtpos-(pos+4));
-			pos = topic.find("fmt/",nxtpos+1);
-			nxtpos = topic.find_first_of('/', pos+4);
-			std::string format = topic.substr(pos+4,nxtpos);
+			pos = payloadTopic.find("fmt/",nxtpos+1);
+			nxtpos = payloadTopic.find_first_of('/', pos+4);
+			std::string format = payloadTopic.substr(pos+4,nxtpos);
 			std::string payload = msg->get_payload();
 
 			Command cmd(deviceType, deviceId, command, format, payload);
+			if (decode(payload, payloadFormat, jsonPayload))
+				cmd.setData(jsonPayload);
 
 			user_callback->processCommand(cmd);
 		}
+
+		// Nothing decoded from the payload is left once it is handled, so the arena is free for the next one
+		jsonPayload = Json::Value();
+		Json::Arena::forThread().release();
+	}
+
+	/**
+	 * Decode a payload into the arena of the thread, which message_arrived() releases once the
+	 * message is handled: handlers and the command callback get the Json::Value without a malloc
+	 * for each of its strings and objects, and what they copy out of it is on the heap.
+	 */
+	bool IOTP_Client::IOTF_Callback::decode(const std::string& payload, IOTP_Encoding::Format format,
+			Json::Value& root) {
+		Json::Arena::Scope scope(Json::Arena::forThread());
+		return IOTP_Encoding::decode(payload, format, root);
 	}
 
 	void IOTP_Client::IOTF_Callback::delivery_complete(mqtt::idelivery_token_ptr tok) {
@@ -228,10 +278,150 @@ namespace Watson_IOTP {
 		mResponseHandler = std::make_shared<IOTP_ResponseHandler> ();
 		mReplyThread = std::thread(&IOTP_Client::_send_reply, this);
 		mKeepAliveInterval = 60;
+		InitializeSpool();
+		InitializeRateLimiter();
+		InitializeDeadband();
+		InitializeCompression();
 
 		logger.debug(methodName+" Exit: ");
 	}
 
+	// Open the spool and start draining it, when a spool directory is configured
+	void IOTP_Client::InitializeSpool() {
+		std::string methodName = __func__;
+		logger.debug(methodName+" Entry: ");
+
+		if (mProperties.getspoolDirectory().size() > 0) {
+			mSpool = std::make_shared<IOTP_Spool>(mProperties.getspoolDirectory(), mProperties.getspoolMaxBytes(),
+					IOTP_Spool::toDropPolicy(mProperties.getspoolDropPolicy()));
+			if (mSpool->isOpen()) {
+				logger.debug("Spool opened with " + std::to_string(mSpool->count()) + " pending messages");
+				mSpoolThread = std::thread(&IOTP_Client::_drain_spool, this);
+			}
+			else {
+				console.error("Failed to open spool directory: " + mProperties.getspoolDirectory());
+				mSpool = nullptr;
+			}
+		}
+
+		logger.debug(methodName+" Exit: ");
+	}
+
+	/*
+	 * Set up the event rate limits when any are configured. rateLimitEvents overrides the
+	 * default rate and burst per event type: "status:10,gps:1:5" is 10 status events a second
+	 * and 1 gps event a second with bursts of 5. coalesceEvents, "status,gps" or "*", lists
+	 * the state event types of which only the latest value waiting for send capacity is sent.
+	 */
+	void IOTP_Client::InitializeRateLimiter() {
+		std::string methodName = __func__;
+		logger.debug(methodName+" Entry: ");
+
+		std::istringstream coalesced(mProperties.getcoalesceEvents());
+		std::string eventType;
+		while (std::getline(coalesced, eventType, ','))
+			if (eventType.size() > 0)
+				mCoalesceEvents.insert(eventType);
+
+		std::string events = mProperties.getrateLimitEvents();
+		if (mProperties.getrateLimit() > 0 || events.size() > 0) {
+			int rate = mProperties.getrateLimit();
+			int burst = mProperties.getrateBurst() > 0 ? mProperties.getrateBurst() : rate;
+			mRateLimiter = std::make_shared<IOTP_RateLimiter>(rate, burst,
+					IOTP_RateLimiter::toPolicy(mProperties.getrateLimitPolicy()));
+
+			std::istringstream list(events);
+			std::string item;
+			while (std::getline(list, item, ',')) {
+				std::istringstream fields(item);
+				std::string eventType, eventRate, eventBurst;
+				if (std::getline(fields, eventType, ':') && std::getline(fields, eventRate, ':')) {
+					int limit = std::stoi(eventRate);
+					int size = std::getline(fields, eventBurst, ':') ? std::stoi(eventBurst) : limit;
+					mRateLimiter->setLimit(eventType, limit, size);
+				}
+				else
+					console.error("Ignoring rate limit \"" + item + "\", expected eventType:rate[:burst]");
+			}
+
+			if (mRateLimiter->policy() == IOTP_RateLimiter::COALESCE)
+				mCoalesceThread = std::thread(&IOTP_Client::_flush_coalesced, this);
+		}
+
+		logger.debug(methodName+" Exit: ");
+	}
+
+	/*
+	 * Set up the deadband filter when deadbandEvents is set, see IOTP_Deadband::configure for
+	 * its format. deadbandHeartbeat is in seconds.
+	 */
+	void IOTP_Client::InitializeDeadband() {
+		std::string methodName = __func__;
+		logger.debug(methodName+" Entry: ");
+
+		std::string events = mProperties.getdeadbandEvents();
+		if (events.size() > 0) {
+			mDeadband = std::make_shared<IOTP_Deadband>((int64_t)mProperties.getdeadbandHeartbeat() * 1000);
+			std::string rejected = mDeadband->configure(events);
+			if (rejected.size() > 0)
+				console.error("Ignoring deadbands \"" + rejected + "\", expected eventType:field=band[%][/band%][|field...]");
+		}
+
+		logger.debug(methodName+" Exit: ");
+	}
+
+	/*
+	 * Set up compression of published events when compression is "zlib" or "zstd", and a
+	 * worker thread to compress them on. Compressed commands are decompressed whatever the
+	 * setting. With compressionTrainSamples set, a dictionary is trained from that many of
+	 * the first events compressed.
+	 */
+	void IOTP_Client::InitializeCompression() {
+		std::string methodName = __func__;
+		logger.debug(methodName+" Entry: ");
+
+		IOTP_Compressor::Codec codec = IOTP_Compressor::toCodec(mProperties.getcompression());
+		if (codec == IOTP_Compressor::NONE && mProperties.getcompression() != "none")
+			console.error("Ignoring compression \"" + mProperties.getcompression() + "\", expected none, zlib or zstd");
+		mCompressor = std::make_shared<IOTP_Compressor>(codec, mProperties.getcompressionThreshold(),
+				mProperties.getcompressionTrainSamples());
+		if (codec != IOTP_Compressor::NONE)
+			mCompressThread = std::thread(&IOTP_Client::_compress_events, this);
+
+		logger.debug(methodName+" Exit: ");
+	}
+
+	// Create the underlying async client with the configured persistence and buffering
+	mqtt::async_client* IOTP_Client::CreateAsyncClient(const std::string& clientId) {
+		std::string methodName = __func__;
+		logger.debug(methodName+" Entry: ");
+
+		std::string type = mProperties.getpersistenceType();
+		std::string directory = mProperties.getpersistenceDirectory();
+		int persistenceType = MQTTCLIENT_PERSISTENCE_DEFAULT;
+
+		if (type.compare("memory") == 0)
+			persistenceType = MQTTCLIENT_PERSISTENCE_MEMORY;
+		else if (type.compare("log") == 0)
+			persistenceType = MQTTCLIENT_PERSISTENCE_LOG;
+		else if (type.compare("none") == 0)
+			persistenceType = MQTTCLIENT_PERSISTENCE_NONE;
+		else if (type.compare("default") != 0)
+			logger.error("Unknown persistenceType " + type + ", using default");
+
+		// Buffered messages used to be kept in the spool directory
+		if (directory.size() == 0 && mProperties.getmaxBufferedMessages() > 0)
+			directory = mProperties.getspoolDirectory();
+
+		mqtt::async_client* client = new mqtt::async_client(mServerURI, clientId, persistenceType,
+					directory, mProperties.getmaxBufferedMessages(), mProperties.getpersistenceSnapshotInterval());
+		logger.debug("Underlying async_client created with " + type + " persistence and " +
+					std::to_string(mProperties.getmaxBufferedMessages()) + " buffered messages...");
+
+		logger.debug(methodName+" Exit: ");
+		return client;
+	}
+
 	/* Method to read properties from file and Initialize to Properties Instance.
 	* Parameters are:
 	* WIoTP Properties file path.
@@ -294,6 +484,92 @@ namespace Watson_IOTP {
 						prop.setPort(std::stoi(customPort));
 				}
 
+				std::string maxBuffered = root.get("maxBufferedMessages", "0").asString();
+				if (maxBuffered.size() != 0)
+					prop.setmaxBufferedMessages(std::stoi(maxBuffered));
+
+				std::string spoolDirectory = root.get("spoolDirectory", "").asString();
+				if (spoolDirectory.size() != 0)
+					prop.setspoolDirectory(spoolDirectory);
+
+				std::string spoolMaxBytes = root.get("spoolMaxBytes", "").asString();
+				if (spoolMaxBytes.size() != 0)
+					prop.setspoolMaxBytes(std::stoull(spoolMaxBytes));
+
+				std::string spoolDropPolicy = root.get("spoolDropPolicy", "").asString();
+				if (spoolDropPolicy.size() != 0)
+					prop.setspoolDropPolicy(spoolDropPolicy);
+
+				std::string spoolDrainRate = root.get("spoolDrainRate", "").asString();
+				if (spoolDrainRate.size() != 0)
+					prop.setspoolDrainRate(std::stoi(spoolDrainRate));
+
+				std::string persistenceType = root.get("persistenceType", "").asString();
+				if (persistenceType.size() != 0)
+					prop.setpersistenceType(persistenceType);
+
+				std::string persistenceDirectory = root.get("persistenceDirectory", "").asString();
+				if (persistenceDirectory.size() != 0)
+					prop.setpersistenceDirectory(persistenceDirectory);
+
+				std::string snapshotInterval = root.get("persistenceSnapshotInterval", "").asString();
+				if (snapshotInterval.size() != 0)
+					prop.setpersistenceSnapshotInterval(std::stoi(snapshotInterval));
+
+				std::string gatewayShards = root.get("gatewayShards", "").asString();
+				if (gatewayShards.size() != 0)
+					prop.setgatewayShards(std::stoi(gatewayShards));
+
+				std::string inflightControl = root.get("inflightControl", "").asString();
+				if (inflightControl.size() != 0)
+					prop.setinflightControl(inflightControl);
+
+				std::string maxInflight = root.get("maxInflight", "").asString();
+				if (maxInflight.size() != 0)
+					prop.setmaxInflight(std::stoi(maxInflight));
+
+				std::string rateLimit = root.get("rateLimit", "").asString();
+				if (rateLimit.size() != 0)
+					prop.setrateLimit(std::stoi(rateLimit));
+
+				std::string rateBurst = root.get("rateBurst", "").asString();
+				if (rateBurst.size() != 0)
+					prop.setrateBurst(std::stoi(rateBurst));
+
+				std::string rateLimitPolicy = root.get("rateLimitPolicy", "").asString();
+				if (rateLimitPolicy.size() != 0)
+					prop.setrateLimitPolicy(rateLimitPolicy);
+
+				prop.setrateLimitEvents(root.get("rateLimitEvents", "").asString());
+				prop.setcoalesceEvents(root.get("coalesceEvents", "").asString());
+
+				std::string aggregateWindow = root.get("aggregateWindow", "").asString();
+				if (aggregateWindow.size() != 0)
+					prop.setaggregateWindow(std::stoi(aggregateWindow));
+
+				std::string aggregateSlide = root.get("aggregateSlide", "").asString();
+				if (aggregateSlide.size() != 0)
+					prop.setaggregateSlide(std::stoi(aggregateSlide));
+
+				prop.setaggregateEvents(root.get("aggregateEvents", "").asString());
+				prop.setdeadbandEvents(root.get("deadbandEvents", "").asString());
+
+				std::string deadbandHeartbeat = root.get("deadbandHeartbeat", "").asString();
+				if (deadbandHeartbeat.size() != 0)
+					prop.setdeadbandHeartbeat(std::stoi(deadbandHeartbeat));
+
+				std::string compression = root.get("compression", "").asString();
+				if (compression.size() != 0)
+					prop.setcompression(compression);
+
+				std::string compressionThreshold = root.get("compressionThreshold", "").asString();
+				if (compressionThreshold.size() != 0)
+					prop.setcompressionThreshold(std::stoi(compressionThreshold));
+
+				std::string compressionTrainSamples = root.get("compressionTrainSamples", "").asString();
+				if (compressionTrainSamples.size() != 0)
+					prop.setcompressionTrainSamples(std::stoi(compressionTrainSamples));
+
 				if(org.compare("quickstart") != 0) {
 					std::string username = root.get("Authentication-Method", "").asString();
 					if (username.size() == 0) {
@@ -381,12 +657,36 @@ namespace Watson_IOTP {
 		logger.debug("Client Cert Path: " + mProperties.getkeyStore());
 		logger.debug("Client Key Path: " + mProperties.getprivateKey());
 		logger.debug("Client Key Password: " + mProperties.getkeyPassPhrase());
+		logger.debug("Max Buffered Messages: " + std::to_string(mProperties.getmaxBufferedMessages()));
+		logger.debug("Spool Directory: " + mProperties.getspoolDirectory());
+		logger.debug("Spool Max Bytes: " + std::to_string(mProperties.getspoolMaxBytes()));
+		logger.debug("Spool Drop Policy: " + mProperties.getspoolDropPolicy());
+		logger.debug("Spool Drain Rate: " + std::to_string(mProperties.getspoolDrainRate()));
+		logger.debug("Persistence Type: " + mProperties.getpersistenceType());
+		logger.debug("Persistence Directory: " + mProperties.getpersistenceDirectory());
+		logger.debug("Persistence Snapshot Interval: " + std::to_string(mProperties.getpersistenceSnapshotInterval()));
+		logger.debug("Gateway Shards: " + std::to_string(mProperties.getgatewayShards()));
+		logger.debug("Inflight Control: " + mProperties.getinflightControl());
+		logger.debug("Max Inflight: " + std::to_string(mProperties.getmaxInflight()));
+		logger.debug("Rate Limit: " + std::to_string(mProperties.getrateLimit()));
+		logger.debug("Rate Burst: " + std::to_string(mProperties.getrateBurst()));
+		logger.debug("Rate Limit Policy: " + mProperties.getrateLimitPolicy());
+		logger.debug("Rate Limit Events: " + mProperties.getrateLimitEvents());
+		logger.debug("Coalesce Events: " + mProperties.getcoalesceEvents());
+		logger.debug("Aggregate Window: " + std::to_string(mProperties.getaggregateWindow()));
+		logger.debug("Aggregate Slide: " + std::to_string(mProperties.getaggregateSlide()));
+		logger.debug("Aggregate Events: " + mProperties.getaggregateEvents());
+		logger.debug("Deadband Events: " + mProperties.getdeadbandEvents());
+		logger.debug("Deadband Heartbeat: " + std::to_string(mProperties.getdeadbandHeartbeat()));
+		logger.debug("Compression: " + mProperties.getcompression());
+		logger.debug("Compression Threshold: " + std::to_string(mProperties.getcompressionThreshold()));
+		logger.debug("Compression Train Samples: " + std::to_string(mProperties.getcompressionTrainSamples()));
 
 		logger.debug(methodName+" Exit: ");
 	}
 	// IOTP_Client constructor using a properties file
 	IOTP_Client::IOTP_Client(const std::string& filePath, std::string logPropertiesFile):
-		mServerURI(""),mClientID("")
+		pasync_client(nullptr),mServerURI(""),mClientID("")
 	{
 		log4cpp::PropertyConfigurator::configure(logPropertiesFile);
 		std::string methodName = __PRETTY_FUNCTION__;
@@ -400,6 +700,10 @@ namespace Watson_IOTP {
 		    mResponseHandler = std::make_shared<IOTP_ResponseHandler> ();
 		    mReplyThread = std::thread(&IOTP_Client::_send_reply, this);
 		    mKeepAliveInterval = 60;
+		    InitializeSpool();
+		    InitializeRateLimiter();
+		    InitializeDeadband();
+		    InitializeCompression();
 		    //Dump properties to log file
 		    dumpProperties();
 	        }
@@ -411,7 +715,7 @@ namespace Watson_IOTP {
 
 	// IOTF_Client constructors and methods
 	IOTP_Client::IOTP_Client(Properties& prop, std::string logPropertiesFile):
-		mServerURI(""),mClientID("")
+		pasync_client(nullptr),mServerURI(""),mClientID("")
 	{
 		log4cpp::PropertyConfigurator::configure(logPropertiesFile);
 		std::string methodName = __PRETTY_FUNCTION__;
@@ -426,7 +730,7 @@ namespace Watson_IOTP {
 	//IOTP_Client::IOTP_Client(Properties& prop, Watson_IOTP::IOTP_DeviceInfo* deviceInfo,
 	IOTP_Client::IOTP_Client(Properties& prop, iotp_device_action_handler_ptr& actionHandler,
 		iotp_device_firmware_handler_ptr& firmwareHandler, std::string logPropertiesFile):
-		mServerURI(""),mClientID("")
+		pasync_client(nullptr),mServerURI(""),mClientID("")
 	{
 		log4cpp::PropertyConfigurator::configure(logPropertiesFile);
 		std::string methodName = __PRETTY_FUNCTION__;
@@ -446,6 +750,19 @@ namespace Watson_IOTP {
 		try {
 			mExit = true;
 			mReplyThread.join();
+			if (mSpoolThread.joinable()) {
+				mSpoolCond.notify_one();
+				mSpoolThread.join();
+			}
+			if (mCoalesceThread.joinable())
+				mCoalesceThread.join();
+			if (mCompressThread.joinable()) {
+				mCompressCond.notify_one();
+				mCompressRoom.notify_all();
+				mCompressThread.join();
+			}
+			for (mqtt::async_client* client : mShardClients)
+				delete client;
 			delete pasync_client;
 		}
 		catch(const std::exception& e ){
@@ -478,11 +795,35 @@ namespace Watson_IOTP {
 		throw(mqtt::exception, mqtt::security_exception) {
 		std::string methodName = __PRETTY_FUNCTION__;
 		logger.debug(methodName+" Entry: ");
+		bool rc = connectClient(pasync_client);
+		if (rc && mSpool != nullptr)
+			mSpoolCond.notify_one();
+
+		logger.debug(methodName+" Exit: ");
+		return rc;
+	}
+
+	/**
+	 * Connect one of the client's connections using default options. The first connection
+	 * gets a new command callback, further ones share it.
+	 *
+	 * @return bool
+	 * returns true if connection succeeds else false
+	 * @throw MQTT exceptions
+	 */
+	bool IOTP_Client::connectClient(mqtt::async_client* client) {
+		std::string methodName = __func__;
+		logger.debug(methodName+" Entry: ");
 		bool rc = true;
 		IOTF_ActionCallback action;
 		mqtt::connect_options connectOptions;
 		connectOptions.set_clean_session(true);
 		connectOptions.set_keep_alive_interval(mKeepAliveInterval);
+		connectOptions.set_max_inflight(mProperties.getmaxInflight());
+		if (mProperties.getinflightControl().compare("adaptive") == 0)
+			connectOptions.set_inflight_control(MQTTASYNC_INFLIGHT_ADAPTIVE);
+		else if (mProperties.getinflightControl().compare("fixed") == 0)
+			connectOptions.set_inflight_control(MQTTASYNC_INFLIGHT_FIXED);
 		std::string usrName;
 		std::string passwd;
 
@@ -526,13 +867,16 @@ namespace Watson_IOTP {
 
 
 		mqtt::itoken_ptr conntok;
-		logger.debug("Calling pasync_client->connect()...");
-		conntok = pasync_client->connect(connectOptions, NULL, action);
+		logger.debug("Calling client->connect()...");
+		conntok = client->connect(connectOptions, NULL, action);
 		conntok->wait_for_completion(DEFAULT_TIMEOUT());
 
 		if (action.success()) {
 			logger.debug("Setting the callback...");
-			callback_ptr = set_callback();
+			if (client == pasync_client)
+				callback_ptr = set_callback();
+			else
+				client->set_callback(*callback_ptr);
 		}
 
 		if (conntok->is_complete() == false){
@@ -623,8 +967,12 @@ namespace Watson_IOTP {
 	mqtt::idelivery_token_ptr IOTP_Client::publishTopic(std::string topic, mqtt::message_ptr message) {
 		std::string methodName = __PRETTY_FUNCTION__;
 		logger.debug(methodName+" Entry: ");
-		logger.debug("Calling pasync_client->publish()...");
-		mqtt::idelivery_token_ptr delivery_tok = pasync_client->publish(topic, message);
+		if (message->get_priority() == MQTTASYNC_PRIORITY_NORMAL)
+			message->set_priority(priorityForTopic(topic));
+		if (!message->is_coalesced())
+			message->set_coalesced(coalesceForTopic(topic));
+		logger.debug("Calling client->publish()...");
+		mqtt::idelivery_token_ptr delivery_tok = clientForTopic(topic)->publish(topic, message);
 		logger.debug(methodName+" Exit: ");
 		return delivery_tok;
 	}
@@ -633,19 +981,289 @@ namespace Watson_IOTP {
 					void* userContext, mqtt::iaction_listener& cb) {
 		std::string methodName = __PRETTY_FUNCTION__;
 		logger.debug(methodName+" Entry: ");
-		logger.debug("Calling pasync_client->publish(cb)...");
-		mqtt::idelivery_token_ptr delivery_tok = pasync_client->publish(topic, message, userContext, cb);
+		if (message->get_priority() == MQTTASYNC_PRIORITY_NORMAL)
+			message->set_priority(priorityForTopic(topic));
+		if (!message->is_coalesced())
+			message->set_coalesced(coalesceForTopic(topic));
+		logger.debug("Calling client->publish(cb)...");
+		mqtt::idelivery_token_ptr delivery_tok = clientForTopic(topic)->publish(topic, message, userContext, cb);
 		logger.debug(methodName+" Exit: ");
 		return delivery_tok;
 	}
 
+	bool IOTP_Client::limitEvent(const std::string& key, const std::string& eventType, const std::string& topic,
+			const std::string& payload, int qos, const DeadbandSample& passed, mqtt::iaction_listener* cb) {
+		if (mRateLimiter == nullptr)
+			return true;
+		IOTP_RateLimiter::Message message = { topic, payload, qos, cb };
+		IOTP_RateLimiter::Message replaced;
+		IOTP_RateLimiter::Result result = mRateLimiter->acquire(key, eventType, message, &replaced);
+		if (result == IOTP_RateLimiter::DROPPED) {
+			logger.debug("Rate limit of " + key + " exceeded, event dropped");
+			if (cb != nullptr)
+				completeUnsent(topic, payload, qos, *cb, MQTTASYNC_DROPPED);
+		}
+		else if (result == IOTP_RateLimiter::COALESCED) {
+			logger.debug("Rate limit of " + key + " exceeded, event held for the next token");
+			recordEvent(passed);
+			if (replaced.context != nullptr)
+				completeUnsent(replaced.topic, replaced.payload, replaced.qos,
+						*static_cast<mqtt::iaction_listener*>(replaced.context), MQTTASYNC_SUPERSEDED);
+		}
+		return result == IOTP_RateLimiter::SEND;
+	}
+
+	void IOTP_Client::completeUnsent(const std::string& topic, const std::string& payload, int qos,
+			mqtt::iaction_listener& cb, int rc) {
+		mqtt::message_ptr pubmsg = std::make_shared < mqtt::message > (payload);
+		pubmsg->set_qos(qos);
+		clientForTopic(topic)->complete_unsent(topic, pubmsg, NULL, cb, rc);
+	}
+
+	bool IOTP_Client::decodeEvent(const std::string& eventFormat, const std::string& payload, Json::Value& root) {
+		static thread_local Json::Arena arena;
+		arena.release();
+		IOTP_Encoding::Format format = IOTP_Encoding::toFormat(eventFormat);
+		Json::Arena::Scope scope(arena);
+		return format != IOTP_Encoding::UNKNOWN && IOTP_Encoding::decode(payload, format, root) && root.isObject();
+	}
+
+	static int64_t deadbandNow() {
+		return std::chrono::duration_cast<std::chrono::milliseconds>(
+				std::chrono::steady_clock::now().time_since_epoch()).count();
+	}
+
+	bool IOTP_Client::filterEvent(const std::string& key, const std::string& eventType, const std::string& eventFormat,
+			const std::string& payload, DeadbandSample& passed) {
+		passed.pending = false;
+		if (mDeadband == nullptr || !mDeadband->filters(eventType))
+			return true;
+		Json::Value root;
+		if (!decodeEvent(eventFormat, payload, root))
+			return true;
+		const Json::Value& fields = (root.isMember("d") && root["d"].isObject()) ? root["d"] : root;
+		passed.samples.clear();
+		for (Json::Value::const_iterator it = fields.begin(); it != fields.end(); ++it) {
+			if ((*it).isNumeric()) {
+				IOTP_Deadband::Sample sample = { it.name(), (*it).asDouble() };
+				passed.samples.push_back(sample);
+			}
+		}
+		// recorded by recordEvent() once published, a rate limit may still drop it
+		if (mDeadband->pass(key, eventType, passed.samples, deadbandNow(), false)) {
+			passed.pending = true;
+			passed.key = key;
+			passed.eventType = eventType;
+			return true;
+		}
+		logger.debug("Event " + eventType + " of " + key + " within its deadbands, not published");
+		return false;
+	}
+
+	void IOTP_Client::recordEvent(const DeadbandSample& passed) {
+		if (passed.pending)
+			mDeadband->record(passed.key, passed.eventType, passed.samples, deadbandNow());
+	}
+
+	/**
+	 * Publish the events the coalesce policy held back, each once its bucket has a token.
+	 */
+	void IOTP_Client::_flush_coalesced() {
+		IOTP_RateLimiter::Message message;
+		while (mExit == false) {
+			if (mRateLimiter->takeCoalesced(message, std::chrono::milliseconds(1000))) {
+				mqtt::iaction_listener* cb = static_cast<mqtt::iaction_listener*>(message.context);
+				try {
+					if (cb == nullptr) {
+						this->publishCompressed(message.topic, message.payload, message.qos);
+					} else {
+						// published as the event would have been, with its listener
+						mqtt::message_ptr pubmsg = std::make_shared < mqtt::message > (message.payload);
+						pubmsg->set_qos(message.qos);
+						this->publishTopic(message.topic, pubmsg, NULL, *cb);
+					}
+				}
+				catch (const mqtt::exception& e) {
+					logger.debug("Publishing a held event failed: " + std::string(e.what()));
+					if (cb != nullptr)
+						completeUnsent(message.topic, message.payload, message.qos, *cb, e.get_reason_code());
+				}
+			}
+		}
+	}
+
+	IOTP_RateLimiter::Stats IOTP_Client::getRateLimitStats() {
+		if (mRateLimiter == nullptr) {
+			IOTP_RateLimiter::Stats none = { 0, 0, 0, 0, 0 };
+			return none;
+		}
+		return mRateLimiter->stats();
+	}
+
+	bool IOTP_Client::getRateLimitStats(const std::string& key, IOTP_RateLimiter::Stats& stats) {
+		return mRateLimiter != nullptr && mRateLimiter->stats(key, stats);
+	}
+
+	/**
+	 * Compress the events queued by publishCompressed and publish them, in the order they
+	 * were queued.
+	 */
+	void IOTP_Client::_compress_events() {
+		std::unique_lock<std::mutex> lck(mCompressLock);
+		while (mExit == false || !mCompressQueue.empty()) {
+			if (mCompressQueue.empty()) {
+				mCompressCond.wait_for(lck, std::chrono::milliseconds(1000));
+				continue;
+			}
+			PendingEvent event = std::move(mCompressQueue.front());
+			mCompressQueue.pop_front();
+			lck.unlock();
+			mCompressRoom.notify_one();
+			mCompressor->compress(event.topic, event.payload);
+			try {
+				this->publishSpooled(event.topic, event.payload, event.qos, event.priority);
+			}
+			catch (const mqtt::exception& e) {
+				logger.debug("Publishing a compressed event failed: " + std::string(e.what()));
+			}
+			lck.lock();
+		}
+	}
+
+	bool IOTP_Client::publishCompressed(const std::string& topic, const std::string& payload, int qos, int priority) {
+		if (mCompressor == nullptr || mCompressor->codec() == IOTP_Compressor::NONE ||
+				!mCompressThread.joinable())
+			return this->publishSpooled(topic, payload, qos, priority);
+		{
+			// every event queues, those below the threshold too, so none overtakes another;
+			// when the worker falls behind, the caller waits for it
+			std::unique_lock<std::mutex> lck(mCompressLock);
+			while (mCompressQueue.size() >= MAX_COMPRESS_QUEUE && mExit == false)
+				mCompressRoom.wait_for(lck, std::chrono::milliseconds(1000));
+			if (mExit == false) {
+				PendingEvent event = { topic, payload, qos, priority };
+				mCompressQueue.push_back(std::move(event));
+				mCompressCond.notify_one();
+				return true;
+			}
+		}
+		return this->publishSpooled(topic, payload, qos, priority);
+	}
+
+	IOTP_Compressor::Stats IOTP_Client::getCompressionStats() {
+		if (mCompressor == nullptr) {
+			IOTP_Compressor::Stats none = { 0, 0, 0, 0 };
+			return none;
+		}
+		return mCompressor->stats();
+	}
+
+	IOTP_Deadband::Stats IOTP_Client::getDeadbandStats() {
+		if (mDeadband == nullptr) {
+			IOTP_Deadband::Stats none = { 0, 0, 0 };
+			return none;
+		}
+		return mDeadband->stats();
+	}
+
+	int IOTP_Client::priorityForTopic(const std::string& topic) {
+		if (topic.compare(0, 12, "iotdevice-1/") == 0)
+			return MQTTASYNC_PRIORITY_HIGH;
+		if (topic.find("/evt/") != std::string::npos)
+			return MQTTASYNC_PRIORITY_BULK;
+		return MQTTASYNC_PRIORITY_NORMAL;
+	}
+
+	bool IOTP_Client::coalesceForTopic(const std::string& topic) {
+		if (mCoalesceEvents.empty())
+			return false;
+		// iot-2/evt/<eventType>/fmt/<format>, or iot-2/type/<type>/id/<id>/evt/<eventType>/fmt/<format>
+		size_t evt = topic.find("/evt/");
+		if (evt == std::string::npos)
+			return false;
+		if (mCoalesceEvents.count("*") != 0)
+			return true;
+		evt += 5;
+		return mCoalesceEvents.count(topic.substr(evt, topic.find('/', evt) - evt)) != 0;
+	}
+
+	bool IOTP_Client::publishSpooled(const std::string& topic, const std::string& payload, int qos, int priority) {
+		std::string methodName = __PRETTY_FUNCTION__;
+		logger.debug(methodName+" Entry: ");
+		bool rc = true;
+		if (mSpool == nullptr) {
+			mqtt::message_ptr pubmsg = std::make_shared<mqtt::message>(payload);
+			pubmsg->set_qos(qos);
+			this->publishTopic(topic, pubmsg);
+		}
+		else {
+			// Messages already in the spool go first, so later ones queue up behind them
+			bool published = false;
+			if (isConnectedFor(topic) && mSpool->empty()) {
+				try {
+					mqtt::message_ptr pubmsg = std::make_shared<mqtt::message>(payload);
+					pubmsg->set_qos(qos);
+					this->publishTopic(topic, pubmsg);
+					published = true;
+				}
+				catch (const mqtt::exception& e) {
+					logger.debug("Publish failed, spooling the message: " + std::string(e.what()));
+				}
+			}
+			if (!published) {
+				logger.debug("Appending message for topic " + topic + " to the spool");
+				rc = mSpool->append(topic, payload, qos, priority);
+				mSpoolCond.notify_one();
+			}
+		}
+		logger.debug(methodName+" Exit: ");
+		return rc;
+	}
+
+	/**
+	 * Publish the spooled messages in order while the connection of the next one is up, no
+	 * faster than the configured drain rate so a reconnect does not flood the connection.
+	 * On a sharded client a message waits for its own shard, and the ones behind it with it.
+	 * A message whose delivery is not confirmed within the timeout stays in the spool and is
+	 * published again, even if the first publish gets through late.
+	 */
+	void IOTP_Client::_drain_spool() {
+		int rate = mProperties.getspoolDrainRate();
+		std::chrono::microseconds interval(rate > 0 ? 1000000 / rate : 0);
+		std::chrono::steady_clock::time_point next = std::chrono::steady_clock::now();
+		IOTP_Spool::Record record;
+		while (mExit == false) {
+			{
+				std::unique_lock<std::mutex> lck(mSpoolLock);
+				mSpoolCond.wait_for(lck, std::chrono::seconds(1));
+			}
+			while (mExit == false && mSpool->front(record) && isConnectedFor(record.topic)) {
+				std::this_thread::sleep_until(next);
+				try {
+					mqtt::message_ptr pubmsg = std::make_shared<mqtt::message>(record.payload);
+					pubmsg->set_qos(record.qos);
+					mqtt::idelivery_token_ptr pubtok = this->publishTopic(record.topic, pubmsg);
+					pubtok->wait_for_completion(DEFAULT_TIMEOUT());
+					if (!pubtok->is_complete())
+						break;
+				}
+				catch (const mqtt::exception& e) {
+					logger.debug("Spool drain stopped: " + std::string(e.what()));
+					break;
+				}
+				mSpool->pop();
+				next = std::max(next, std::chrono::steady_clock::now()) + interval;
+			}
+		}
+	}
+
 	bool IOTP_Client::subscribeTopic(const std::string& topic, int qos) {
 		std::string methodName = __PRETTY_FUNCTION__;
 		logger.debug(methodName+" Entry: ");
 		bool rc = false;
 		if ((rc = callback_ptr->check_subscription(topic)) == false) {
-			logger.debug("Calling pasync_client->subscribe()....");
-			mqtt::itoken_ptr tok = pasync_client->subscribe(topic, qos);
+			logger.debug("Calling client->subscribe()....");
+			mqtt::itoken_ptr tok = clientForTopic(topic)->subscribe(topic, qos);
 			tok->wait_for_completion(DEFAULT_TIMEOUT());
 			if (tok->is_complete()) {
 				logger.debug("Adding the subscription for the topic: "+topic);
@@ -674,8 +1292,8 @@ namespace Watson_IOTP {
 		int qos =1;
 		bool rc = false;
 		if (callback_ptr->check_subscription(topic, handler) == false) {
-			logger.debug("Calling pasync_client->subscribe() for the topic - " + topic);
-			mqtt::itoken_ptr tok = pasync_client->subscribe(topic, qos);
+			logger.debug("Calling client->subscribe() for the topic - " + topic);
+			mqtt::itoken_ptr tok = clientForTopic(topic)->subscribe(topic, qos);
 			tok->wait_for_completion(DEFAULT_TIMEOUT());
 			if (tok->is_complete()) {
 				logger.debug("Calling callback_ptr->add_subscription() for the topic - " + topic);
@@ -703,8 +1321,8 @@ namespace Watson_IOTP {
 		bool rc = false;
 		if (callback_ptr->check_subscription(topic) == true) {
 			logger.debug("There exists subscription for topic - " + topic);
-			logger.debug("Calling pasync_client->unsubscribe() for this topic...");
-			mqtt::itoken_ptr tok = pasync_client->unsubscribe(topic);
+			logger.debug("Calling client->unsubscribe() for this topic...");
+			mqtt::itoken_ptr tok = clientForTopic(topic)->unsubscribe(topic);
 			tok->wait_for_completion(DEFAULT_TIMEOUT());
 			if (tok->is_complete()) {
 				logger.debug("Calling callback_ptr->remove_subscription() for this topic...");
@@ -734,8 +1352,9 @@ namespace Watson_IOTP {
 	 * Static helper method to convert a Json object to string.
 	 */
 	std::string IOTP_Client::jsonValueToString(Json::Value& jsonValue) {
-		Json::FastWriter fastWriter;
-		return fastWriter.write(jsonValue);
+		std::string jsonString;
+		IOTP_JsonWriter(jsonString).value(jsonValue);
+		return jsonString;
 	}
 
 	/**
@@ -758,9 +1377,12 @@ namespace Watson_IOTP {
 					iotp_reply_message_ptr reply = mReplyMsgs.front();
 					mReplyMsgs.pop();
 					std::string topic(reply->getTopic());
-					std::string jsonMessage(jsonValueToString(reply->getPayload()));
+					std::string& jsonMessage = IOTP_JsonWriter::threadBuffer();
+					IOTP_JsonWriter(jsonMessage).value(reply->getPayload());
 					std::cout << "Sending TOPIC " << topic << " PAYLOAD " << jsonMessage << std::endl;
-					mqtt::idelivery_token_ptr pubtok = pasync_client->publish(topic, (void*)jsonMessage.data(), jsonMessage.size(), reply->getQos(), false);
+					mqtt::message_ptr pubmsg = std::make_shared<mqtt::message>(jsonMessage, reply->getQos(), false);
+					pubmsg->set_priority(MQTTASYNC_PRIORITY_HIGH);
+					mqtt::idelivery_token_ptr pubtok = clientForTopic(topic)->publish(topic, pubmsg);
 					pubtok->wait_for_completion(DEFAULT_TIMEOUT());
 					bool success = pubtok->is_complete();
 				} else {
@@ -782,20 +1404,36 @@ namespace Watson_IOTP {
 
 	//Utility function for pushing manage messages to the Watson IoT Platform
 	bool IOTP_Client::pushManageMessage(std::string topic, Json::Value data) {
-		if (this->subscribeCommandHandler(SERVER_RESPONSE_TOPIC, mResponseHandler)) {
+		if (subscribeResponses()) {
 			std::string reqId = send_message(topic, data);
-			if (!reqId.empty()) {
-				Json::Value res = mResponseHandler->wait_for_response(DEFAULT_TIMEOUT(), reqId);
-				int rc = res.get("rc", -1).asInt();
-				return (rc == 200);
-			}
+			return !reqId.empty() && awaitResponse(reqId);
 		}
 		return false;
 
 	}
+
+	bool IOTP_Client::subscribeResponses() {
+		return this->subscribeCommandHandler(SERVER_RESPONSE_TOPIC, mResponseHandler);
+	}
+
+	bool IOTP_Client::awaitResponse(const std::string& reqId) {
+		Json::Value res = mResponseHandler->wait_for_response(DEFAULT_TIMEOUT(), reqId);
+		int rc = res.get("rc", -1).asInt();
+		return (rc == 200);
+	}
+
 	std::string IOTP_Client::send_message(const std::string& topic, const Json::Value& data, int qos) {
-		bool success = false;
-		Json::Value jsonManagePayload;
+		std::string reqId = nextRequestId();
+		std::string& jsonMessage = IOTP_JsonWriter::threadBuffer();
+		IOTP_JsonWriter writer(jsonMessage);
+		writer.beginObject();
+		if (data.isNull() == false)
+			writer.member("d", data);
+		writer.member("reqId", reqId).endObject();
+		return publishManageMessage(topic, jsonMessage, reqId, qos);
+	}
+
+	std::string IOTP_Client::nextRequestId() {
 		time_t now;
 		time(&now);
 
@@ -805,23 +1443,18 @@ namespace Watson_IOTP {
 
 		std::ostringstream ss;
 		ss << ++mReqCounter + now;
-		std::string reqId = ss.str();
-
-		if (data.isNull() == false)
-			jsonManagePayload["d"] = data;
-
-		jsonManagePayload["reqId"] = reqId;
-
-		std::string jsonMessage = IOTP_Client::jsonValueToString(jsonManagePayload);
+		return ss.str();
+	}
 
-		mqtt::message_ptr pubmsg = std::make_shared<mqtt::message>(jsonMessage);
+	std::string IOTP_Client::publishManageMessage(const std::string& topic, const std::string& payload, std::string& reqId, int qos) {
+		mqtt::message_ptr pubmsg = std::make_shared<mqtt::message>(payload);
 		pubmsg->set_qos(qos);
 		mqtt::idelivery_token_ptr pubtok = this->publishTopic(topic, pubmsg);
 		pubtok->wait_for_completion(DEFAULT_TIMEOUT());
-		success = pubtok->is_complete();
+		bool success = pubtok->is_complete();
 
 		if (success == false) {
-			std::cout << "send_message FAILED to send message to TOPIC " << topic << " PAYLOAD " << std::endl << jsonMessage << std::endl << std::flush;
+			std::cout << "send_message FAILED to send message to TOPIC " << topic << " PAYLOAD " << std::endl << payload << std::endl << std::flush;
 			reqId.clear();
 		}
 		return reqId;
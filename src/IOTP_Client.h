@@ -19,13 +19,23 @@
  *    Lokesh Haralakatta - Added members to hold serverURI and clientID.
  *    Lokesh K Haralakatta - Added SSL/TLS Support.
  *    Lokesh K Haralakatta - Added custom port support.
+ *    Added disk spool for events published while offline.
+ *    Added configurable persistence for the underlying client.
+ *    Added routing of topics to the connection of a sharded client.
+ *    Added priority lanes for management and event messages.
+ *    Added rate limits for published events.
+ *    Added latest-value coalescing of queued state events.
+ *    Added deadband filter for published events.
  *******************************************************************************/
 
 #ifndef IOTF_CLIENT_H_
 #define IOTF_CLIENT_H_
 
 
+#include <deque>
 #include <queue>
+#include <set>
+#include <vector>
 #include "mqtt/async_client.h"
 #include "mqtt/exception.h"
 #include "json/json.h"
@@ -39,6 +49,12 @@
 #include "IOTP_DeviceFirmwareHandler.h"
 #include "IOTP_DeviceAttributeHandler.h"
 #include "IOTP_ResponseHandler.h"
+#include "IOTP_Spool.h"
+#include "IOTP_RateLimiter.h"
+#include "IOTP_Deadband.h"
+#include "IOTP_Encoding.h"
+#include "IOTP_Compressor.h"
+#include "IOTP_JsonWriter.h"
 
 namespace Watson_IOTP {
 
@@ -81,6 +97,7 @@ namespace Watson_IOTP {
 
 				private:
 					int get_arrived_messages();
+					static bool decode(const std::string& payload, IOTP_Encoding::Format format, Json::Value& root);
 
 					int mArrivedMessages;
 					std::vector<std::string> mSubscriptions;
@@ -190,10 +207,69 @@ namespace Watson_IOTP {
 
 			/**
 			 * Gives information whether a client is Connected to Watson IoT Platform.
+			 * A sharded client is connected when every one of its connections is.
 			 *
 			 * @return bool
 			 */
-			bool isConnected() { return pasync_client->is_connected(); }
+			bool isConnected() {
+				if (pasync_client == nullptr || !pasync_client->is_connected())
+					return false;
+				for (mqtt::async_client* client : mShardClients) {
+					if (!client->is_connected())
+						return false;
+				}
+				return true;
+			}
+
+			/**
+			 * In-flight window, round trip time estimate and pacing rate of the connection,
+			 * when inflightControl is configured. All zero before the client is created.
+			 *
+			 * @return MQTTAsync_inflightStats
+			 */
+			MQTTAsync_inflightStats getInflightStats() {
+				if (pasync_client == nullptr) {
+					MQTTAsync_inflightStats none = MQTTAsync_inflightStats_initializer;
+					return none;
+				}
+				return pasync_client->get_inflight_stats();
+			}
+
+			/**
+			 * Function used to get the counters of the event rate limits: events passed,
+			 * blocked, dropped, coalesced and flushed. All zero when no limit is configured.
+			 *
+			 * @return IOTP_RateLimiter::Stats
+			 */
+			IOTP_RateLimiter::Stats getRateLimitStats();
+			/**
+			 * Function used to get the rate limit counters of one bucket: an event type, or on
+			 * a gateway "deviceType/deviceId/eventType".
+			 *
+			 * @return false if the bucket has not been used
+			 */
+			bool getRateLimitStats(const std::string& key, IOTP_RateLimiter::Stats& stats);
+			/**
+			 * Function used to get the counters of the deadband filter: events published,
+			 * published for the heartbeat only, and suppressed.
+			 *
+			 * @return IOTP_Deadband::Stats
+			 */
+			IOTP_Deadband::Stats getDeadbandStats();
+			/**
+			 * Function used to get the counters of payload compression: events compressed,
+			 * left as they are, and their bytes before and after.
+			 *
+			 * @return IOTP_Compressor::Stats
+			 */
+			IOTP_Compressor::Stats getCompressionStats();
+			/**
+			 * Function used to get the compressor, whose dictionaries the receivers of the
+			 * compressed events need, and to which dictionaries of compressed commands are added.
+			 *
+			 * @return iotp_compressor_ptr
+			 */
+			iotp_compressor_ptr getCompressor() { return mCompressor; }
 			/**
 			* Function used to set the Command Callback function. This must be set if you to receive commands.
 			*
@@ -256,8 +332,164 @@ namespace Watson_IOTP {
 		protected:
 			std::string send_message(const std::string& topic, const Json::Value& data, int qos = 1);
 			bool pushManageMessage(std::string topic, Json::Value data);
+
+			/**
+			 * Send a management message as send_message does, with the data written by
+			 * writeData(IOTP_JsonWriter&) into the thread's buffer rather than built as a
+			 * Json::Value first.
+			 * @return the reqId of the message, empty if it could not be sent
+			 */
+			template <typename WriteData>
+			std::string send_streamed(const std::string& topic, WriteData writeData, int qos = 1) {
+				std::string reqId = nextRequestId();
+				std::string& payload = IOTP_JsonWriter::threadBuffer();
+				IOTP_JsonWriter writer(payload);
+				writer.beginObject().key("d");
+				writeData(writer);
+				writer.member("reqId", reqId).endObject();
+				return publishManageMessage(topic, payload, reqId, qos);
+			}
+
+			/**
+			 * Send a management message with send_streamed and wait for the platform's response.
+			 * @return true if the response has rc 200
+			 */
+			template <typename WriteData>
+			bool pushStreamedMessage(const std::string& topic, WriteData writeData) {
+				if (subscribeResponses()) {
+					std::string reqId = send_streamed(topic, writeData);
+					return !reqId.empty() && awaitResponse(reqId);
+				}
+				return false;
+			}
+
+			/**
+			 * Publish a message, or append it to the spool when the client is offline or
+			 * older messages are still waiting in the spool. Without a spool directory
+			 * this is the same as publishTopic. A spooled message is published again when its
+			 * delivery is not confirmed within the timeout, so it is delivered at least once and
+			 * may arrive more than once.
+			 * @return false if the spool dropped the message
+			 */
+			bool publishSpooled(const std::string& topic, const std::string& payload, int qos, int priority = 0);
+
+			/**
+			 * Publish a message as publishSpooled does, compressed on the compression thread
+			 * when compression is on and the payload is as large as the threshold. While
+			 * compression is on every message goes through that thread, the small ones too,
+			 * so that messages keep the order they were published in; when its queue is full
+			 * the caller waits for room.
+			 * @return false if the spool dropped the message. A message queued for the
+			 * compression thread returns true, though the spool may still drop it when the
+			 * thread publishes it.
+			 */
+			bool publishCompressed(const std::string& topic, const std::string& payload, int qos, int priority = 0);
+
 			virtual bool InitializeMqttClient() = 0;
+			mqtt::async_client* CreateAsyncClient(const std::string& clientId);
+
+			/**
+			 * Connect one of the client's connections and route its messages to the
+			 * command callback.
+			 * @return true if the connection succeeds
+			 */
+			bool connectClient(mqtt::async_client* client);
+
+			/**
+			 * The connection that publishes and subscribes to a topic. A sharded client
+			 * overrides this to keep a device's traffic on one connection.
+			 */
+			virtual mqtt::async_client* clientForTopic(const std::string& topic) { return pasync_client; }
+
+			/**
+			 * Whether the connection that publishes on a topic is up.
+			 */
+			bool isConnectedFor(const std::string& topic) {
+				mqtt::async_client* client = clientForTopic(topic);
+				return client != nullptr && client->is_connected();
+			}
+
+			/**
+			 * The command queue lane of messages published on a topic: device management
+			 * requests and replies go ahead of everything else, events are bulk traffic.
+			 */
+			static int priorityForTopic(const std::string& topic);
+
+			/**
+			 * Whether an event published on a topic is state, of an event type listed in
+			 * coalesceEvents: only its latest value waiting in the command queue is sent.
+			 */
+			bool coalesceForTopic(const std::string& topic);
+
+			/**
+			 * The numeric fields of an event that passed its deadbands, recorded as the last
+			 * published once the event is.
+			 */
+			struct DeadbandSample {
+				bool pending;
+				std::string key;
+				std::string eventType;
+				std::vector<IOTP_Deadband::Sample> samples;
+				DeadbandSample() : pending(false) {}
+			};
+
+			/**
+			 * Apply the rate limit of an event before it is published. Blocks under the block
+			 * policy; under the coalesce policy a held event is published later by the client,
+			 * and its deadband sample is recorded now: a later event that replaces it is
+			 * recorded in turn.
+			 * @param key - the rate limit bucket
+			 * @param passed - the event's deadband sample
+			 * @param cb - the listener of the publish, called by the client for an event
+			 * dropped, or held and then replaced
+			 * @return true if the event is to be published now
+			 */
+			bool limitEvent(const std::string& key, const std::string& eventType, const std::string& topic,
+					const std::string& payload, int qos, const DeadbandSample& passed,
+					mqtt::iaction_listener* cb = nullptr);
+
+			/**
+			 * Call the listener of an event that is not published: on_success for one within
+			 * its deadbands or folded into an aggregate, on_failure with MQTTASYNC_DROPPED for
+			 * one over its rate limit and with MQTTASYNC_SUPERSEDED for one held and replaced.
+			 */
+			void completeUnsent(const std::string& topic, const std::string& payload, int qos,
+					mqtt::iaction_listener& cb, int rc);
+
+			/**
+			 * Decode the payload of an event published as json, cbor or msgpack. The root takes its
+			 * storage from an arena of the thread's that the next call releases, so it must be
+			 * destroyed before the thread decodes another event.
+			 * @return false for other formats, or a payload that does not decode to an object
+			 */
+			static bool decodeEvent(const std::string& eventFormat, const std::string& payload, Json::Value& root);
+
+			/**
+			 * Apply the deadbands of an event type to the numeric fields of an event, in "d"
+			 * or at the top level, before it is published. Its values are not recorded as the
+			 * last published until recordEvent() is called, once it is.
+			 * @param key - the device: the event type on a device, "type/id" on a gateway
+			 * @param passed - set to the sample to record, pending only if the event type has
+			 * deadbands
+			 * @return true if the event is to be published
+			 */
+			bool filterEvent(const std::string& key, const std::string& eventType, const std::string& eventFormat,
+					const std::string& payload, DeadbandSample& passed);
+
+			/**
+			 * Record the values of an event that filterEvent() passed, once it is published.
+			 */
+			void recordEvent(const DeadbandSample& passed);
+
 			mqtt::async_client* pasync_client;
+			// further connections of a sharded client, released along with pasync_client
+			std::vector<mqtt::async_client*> mShardClients;
+			iotp_spool_ptr mSpool;
+			iotp_rate_limiter_ptr mRateLimiter;
+			iotp_deadband_ptr mDeadband;
+			iotp_compressor_ptr mCompressor;
+			// event types whose queued events are replaced by later ones, "*" for all
+			std::set<std::string> mCoalesceEvents;
 			iotp_response_handler_ptr mResponseHandler;
 			iotp_device_action_handler_ptr mActionHandler;
 			iotp_device_firmware_handler_ptr mFirmwareHandler;
@@ -267,6 +499,17 @@ namespace Watson_IOTP {
 		private:
 
 			void _send_reply();
+			void _drain_spool();
+			void _flush_coalesced();
+			void _compress_events();
+			void InitializeSpool();
+			void InitializeRateLimiter();
+			void InitializeDeadband();
+			void InitializeCompression();
+			std::string nextRequestId();
+			std::string publishManageMessage(const std::string& topic, const std::string& payload, std::string& reqId, int qos);
+			bool subscribeResponses();
+			bool awaitResponse(const std::string& reqId);
 			iotf_callback_ptr set_callback();
 			void InitializeProperties(Properties& prop);
 			bool InitializePropertiesFromFile(const std::string& filePath,Properties& prop);
@@ -277,6 +520,23 @@ namespace Watson_IOTP {
 			mutable std::condition_variable mCond;
 			std::queue<iotp_reply_message_ptr> mReplyMsgs;
 			std::thread mReplyThread;
+			std::mutex mSpoolLock;
+			std::condition_variable mSpoolCond;
+			std::thread mSpoolThread;
+			std::thread mCoalesceThread;
+			// events waiting for the compression thread
+			struct PendingEvent {
+				std::string topic;
+				std::string payload;
+				int qos;
+				int priority;
+			};
+			static const size_t MAX_COMPRESS_QUEUE = 10000;
+			std::mutex mCompressLock;
+			std::condition_variable mCompressCond;
+			std::condition_variable mCompressRoom;
+			std::deque<PendingEvent> mCompressQueue;
+			std::thread mCompressThread;
 			bool mExit;
 			int mKeepAliveInterval;
 			//////////////////////////////////////////////////////////////////////
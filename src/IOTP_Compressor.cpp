@@ -0,0 +1,469 @@
+/*******************************************************************************
+ * Copyright (c) 2017 IBM Corp.
+ *
+ * All rights reserved. This program and the accompanying materials
+ * are made available under the terms of the Eclipse Public License v1.0
+ * and Eclipse Distribution License v1.0 which accompany this distribution.
+ *
+ * The Eclipse Public License is available at
+ *    http://www.eclipse.org/legal/epl-v10.html
+ * and the Eclipse Distribution License is available at
+ *   http://www.eclipse.org/org/documents/edl-v10.php.
+ *
+ * Contributors:
+ *    Payload compression with shared dictionaries
+ *******************************************************************************/
+
+#include "IOTP_Compressor.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <unordered_map>
+#include <zlib.h>
+#ifdef IOTP_HAVE_ZSTD
+#include <zstd.h>
+#include <zdict.h>
+#endif
+
+namespace Watson_IOTP {
+
+// length of the segments of payloads a dictionary is made of
+static const size_t SEGMENT = 12;
+
+const size_t IOTP_Compressor::MAX_PAYLOAD;
+
+struct IOTP_Compressor::Dictionary {
+	Codec codec;
+	uint32_t id;
+	std::string bytes;
+#ifdef IOTP_HAVE_ZSTD
+	ZSTD_CDict* cdict;
+	ZSTD_DDict* ddict;
+#endif
+
+	Dictionary(Codec dictCodec, uint32_t dictId, const std::string& content, int level) :
+		codec(dictCodec), id(dictId), bytes(content)
+	{
+#ifdef IOTP_HAVE_ZSTD
+		cdict = nullptr;
+		ddict = nullptr;
+		if (codec == ZSTD) {
+			cdict = ZSTD_createCDict(bytes.data(), bytes.size(), level);
+			ddict = ZSTD_createDDict(bytes.data(), bytes.size());
+		}
+#else
+		(void)level;
+#endif
+	}
+
+	~Dictionary() {
+#ifdef IOTP_HAVE_ZSTD
+		ZSTD_freeCDict(cdict);
+		ZSTD_freeDDict(ddict);
+#endif
+	}
+};
+
+// compression state kept from one payload to the next, as setting it up costs more than
+// compressing a short payload
+struct IOTP_Compressor::Streams {
+	z_stream deflater;
+	z_stream inflater;
+	bool deflaterReady;
+	bool inflaterReady;
+#ifdef IOTP_HAVE_ZSTD
+	ZSTD_CCtx* cctx;
+	ZSTD_DCtx* dctx;
+#endif
+
+	Streams() : deflaterReady(false), inflaterReady(false) {
+		memset(&deflater, 0, sizeof(deflater));
+		memset(&inflater, 0, sizeof(inflater));
+#ifdef IOTP_HAVE_ZSTD
+		cctx = ZSTD_createCCtx();
+		dctx = ZSTD_createDCtx();
+#endif
+	}
+
+	~Streams() {
+		if (deflaterReady)
+			deflateEnd(&deflater);
+		if (inflaterReady)
+			inflateEnd(&inflater);
+#ifdef IOTP_HAVE_ZSTD
+		ZSTD_freeCCtx(cctx);
+		ZSTD_freeDCtx(dctx);
+#endif
+	}
+};
+
+/*
+ * Find the codec suffix of the fmt/ segment of a topic: "json.zlib-1a2b3c4d" has the codec
+ * zlib, the dictionary 1a2b3c4d, and the suffix starts at the '.'.
+ */
+static bool parseSuffix(const std::string& topic, size_t& suffix, size_t& end, IOTP_Compressor::Codec& codec,
+		uint32_t& id) {
+	size_t fmt = topic.rfind("/fmt/");
+	if (fmt == std::string::npos)
+		return false;
+	end = topic.find('/', fmt + 5);
+	if (end == std::string::npos)
+		end = topic.size();
+	suffix = topic.rfind('.', end);
+	if (suffix == std::string::npos || suffix < fmt + 5)
+		return false;
+	std::string name = topic.substr(suffix + 1, end - suffix - 1);
+	size_t dash = name.find('-');
+	id = 0;
+	if (dash != std::string::npos) {
+		char* last = nullptr;
+		id = (uint32_t)strtoul(name.c_str() + dash + 1, &last, 16);
+		if (*last != '\0' || id == 0)
+			return false;
+		name.erase(dash);
+	}
+	codec = (name == "zlib") ? IOTP_Compressor::ZLIB : (name == "zstd") ? IOTP_Compressor::ZSTD : IOTP_Compressor::NONE;
+	return codec != IOTP_Compressor::NONE;
+}
+
+IOTP_Compressor::Codec IOTP_Compressor::toCodec(const std::string& codec) {
+	if (codec == "zstd")
+		return available(ZSTD) ? ZSTD : ZLIB;
+	if (codec == "zlib")
+		return ZLIB;
+	return NONE;
+}
+
+const char* IOTP_Compressor::toName(Codec codec) {
+	switch (codec) {
+	case ZLIB: return "zlib";
+	case ZSTD: return "zstd";
+	default: return "none";
+	}
+}
+
+bool IOTP_Compressor::available(Codec codec) {
+#ifdef IOTP_HAVE_ZSTD
+	(void)codec;
+	return true;
+#else
+	return codec != ZSTD;
+#endif
+}
+
+IOTP_Compressor::IOTP_Compressor(Codec codec, size_t threshold, int trainSamples, size_t dictionarySize, int level) :
+	mCodec(available(codec) ? codec : ZLIB), mThreshold(threshold), mTrainSamples(trainSamples > 0 ? trainSamples : 0),
+	mDictionarySize(std::max(dictionarySize, (size_t)256)), mLevel(level), mStreams(new Streams()), mTrained(false)
+{
+	mStats.compressed = mStats.skipped = mStats.bytesIn = mStats.bytesOut = 0;
+}
+
+IOTP_Compressor::~IOTP_Compressor() {}
+
+bool IOTP_Compressor::compress(std::string& topic, std::string& payload) {
+	std::lock_guard<std::mutex> lck(mLock);
+	if (mCodec == NONE || payload.size() < mThreshold || topic.rfind("/fmt/") == std::string::npos) {
+		++mStats.skipped;
+		return false;
+	}
+
+	if (!mTrained && mTrainSamples > 0) {
+		mSamples.push_back(payload);
+		if (mSamples.size() >= mTrainSamples) {
+			trainLocked(mSamples);
+			mSamples.clear();
+			mSamples.shrink_to_fit();
+			mTrained = true;
+		}
+	}
+
+	std::string out;
+	const Dictionary* dictionary = (mCurrent != nullptr && mCurrent->codec == mCodec) ? mCurrent.get() : nullptr;
+	bool compressed = (mCodec == ZSTD) ? zstdCompress(payload, dictionary, out) : zlibCompress(payload, dictionary, out);
+	if (!compressed || out.size() >= payload.size()) {
+		++mStats.skipped;
+		return false;
+	}
+	++mStats.compressed;
+	mStats.bytesIn += payload.size();
+	mStats.bytesOut += out.size();
+
+	size_t fmt = topic.rfind("/fmt/");
+	size_t end = topic.find('/', fmt + 5);
+	std::string suffix = std::string(".") + toName(mCodec);
+	if (dictionary != nullptr) {
+		char id[16];
+		snprintf(id, sizeof(id), "-%08x", dictionary->id);
+		suffix += id;
+	}
+	topic.insert((end == std::string::npos) ? topic.size() : end, suffix);
+	payload.swap(out);
+	return true;
+}
+
+bool IOTP_Compressor::decompress(std::string& topic, std::string& payload) {
+	size_t suffix, end;
+	Codec codec;
+	uint32_t id;
+	if (!parseSuffix(topic, suffix, end, codec, id) || !available(codec))
+		return false;
+
+	std::lock_guard<std::mutex> lck(mLock);
+	const Dictionary* dictionary = nullptr;
+	if (id != 0) {
+		std::map<uint32_t, std::shared_ptr<Dictionary> >::const_iterator it = mDictionaries.find(id);
+		if (it == mDictionaries.end() || it->second->codec != codec)
+			return false;
+		dictionary = it->second.get();
+	}
+	std::string out;
+	bool decompressed = (codec == ZSTD) ? zstdDecompress(payload, dictionary, out) :
+			zlibDecompress(payload, dictionary, out);
+	if (!decompressed)
+		return false;
+	topic.erase(suffix, end - suffix);
+	payload.swap(out);
+	return true;
+}
+
+bool IOTP_Compressor::isCompressed(const std::string& topic) {
+	size_t suffix, end;
+	Codec codec;
+	uint32_t id;
+	return parseSuffix(topic, suffix, end, codec, id);
+}
+
+uint32_t IOTP_Compressor::train(const std::vector<std::string>& samples) {
+	std::lock_guard<std::mutex> lck(mLock);
+	mTrained = true;
+	return trainLocked(samples);
+}
+
+uint32_t IOTP_Compressor::trainLocked(const std::vector<std::string>& samples) {
+	Codec codec = (mCodec == NONE) ? ZLIB : mCodec;
+	std::string dictionary;
+	uint32_t id = 0;
+#ifdef IOTP_HAVE_ZSTD
+	if (codec == ZSTD) {
+		std::string joined;
+		std::vector<size_t> sizes;
+		for (const std::string& sample : samples) {
+			joined += sample;
+			sizes.push_back(sample.size());
+		}
+		dictionary.resize(mDictionarySize);
+		size_t size = ZDICT_trainFromBuffer(&dictionary[0], dictionary.size(), joined.data(), sizes.data(),
+				(unsigned)sizes.size());
+		// too few or too small samples for zstd's trainer: fall back to a raw content dictionary
+		if (ZDICT_isError(size))
+			dictionary.clear();
+		else {
+			dictionary.resize(size);
+			id = ZSTD_getDictID_fromDict(dictionary.data(), dictionary.size());
+		}
+	}
+#endif
+	if (dictionary.empty())
+		dictionary = trainContent(samples);
+	if (dictionary.empty())
+		return 0;
+	if (id == 0)
+		id = (uint32_t)adler32(adler32(0L, Z_NULL, 0), (const Bytef*)dictionary.data(), (uInt)dictionary.size());
+	addLocked(codec, dictionary, id);
+	mCurrent = mDictionaries[id];
+	return id;
+}
+
+uint32_t IOTP_Compressor::addDictionary(Codec codec, const std::string& dictionary, bool use) {
+	uint32_t id = 0;
+#ifdef IOTP_HAVE_ZSTD
+	if (codec == ZSTD)
+		id = ZSTD_getDictID_fromDict(dictionary.data(), dictionary.size());
+#endif
+	if (id == 0)
+		id = (uint32_t)adler32(adler32(0L, Z_NULL, 0), (const Bytef*)dictionary.data(), (uInt)dictionary.size());
+	std::lock_guard<std::mutex> lck(mLock);
+	addLocked(codec, dictionary, id);
+	if (use)
+		mCurrent = mDictionaries[id];
+	return id;
+}
+
+uint32_t IOTP_Compressor::addLocked(Codec codec, const std::string& dictionary, uint32_t id) {
+	int level = (mLevel != 0) ? mLevel : 3;
+	mDictionaries[id] = std::make_shared<Dictionary>(codec, id, dictionary, level);
+	return id;
+}
+
+std::string IOTP_Compressor::dictionary(uint32_t id) {
+	std::lock_guard<std::mutex> lck(mLock);
+	std::map<uint32_t, std::shared_ptr<Dictionary> >::const_iterator it = mDictionaries.find(id);
+	return (it == mDictionaries.end()) ? std::string() : it->second->bytes;
+}
+
+uint32_t IOTP_Compressor::dictionaryId() {
+	std::lock_guard<std::mutex> lck(mLock);
+	return (mCurrent == nullptr) ? 0 : mCurrent->id;
+}
+
+IOTP_Compressor::Stats IOTP_Compressor::stats() {
+	std::lock_guard<std::mutex> lck(mLock);
+	return mStats;
+}
+
+/*
+ * A raw content dictionary: the segments found in the most samples, each taken once, with
+ * segments that overlap the end of the dictionary so far joined onto it. Segments of the
+ * same keys appear in the same samples at consecutive offsets, so they join up into the
+ * runs of text the payloads share.
+ */
+std::string IOTP_Compressor::trainContent(const std::vector<std::string>& samples) {
+	struct Segment {
+		int count;			// samples it appears in
+		int sample;			// the last sample it was counted for
+		size_t first;		// where it first appeared, in sample order
+	};
+	std::unordered_map<std::string, Segment> segments;
+	size_t position = 0;
+	for (size_t s = 0; s < samples.size(); ++s) {
+		const std::string& sample = samples[s];
+		for (size_t i = 0; i + SEGMENT <= sample.size(); ++i) {
+			Segment& segment = segments.emplace(sample.substr(i, SEGMENT), Segment{0, -1, position + i}).first->second;
+			if (segment.sample != (int)s) {
+				segment.sample = (int)s;
+				++segment.count;
+			}
+		}
+		position += sample.size();
+	}
+
+	std::vector<std::pair<const std::string*, const Segment*> > ranked;
+	for (std::unordered_map<std::string, Segment>::const_iterator it = segments.begin(); it != segments.end(); ++it)
+		if (it->second.count > 1)
+			ranked.push_back(std::make_pair(&it->first, &it->second));
+	std::sort(ranked.begin(), ranked.end(),
+			[](const std::pair<const std::string*, const Segment*>& a, const std::pair<const std::string*, const Segment*>& b) {
+				return a.second->count != b.second->count ? a.second->count > b.second->count :
+						a.second->first < b.second->first;
+			});
+
+	std::string dictionary;
+	for (size_t r = 0; r < ranked.size() && dictionary.size() < mDictionarySize; ++r) {
+		const std::string& segment = *ranked[r].first;
+		if (dictionary.find(segment) != std::string::npos)
+			continue;
+		size_t overlap = SEGMENT - 1;
+		while (overlap > 0 && (dictionary.size() < overlap ||
+				dictionary.compare(dictionary.size() - overlap, overlap, segment, 0, overlap) != 0))
+			--overlap;
+		dictionary.append(segment, overlap, std::string::npos);
+	}
+	if (dictionary.size() > mDictionarySize)
+		dictionary.resize(mDictionarySize);
+	return dictionary;
+}
+
+bool IOTP_Compressor::zlibCompress(const std::string& payload, const Dictionary* dictionary, std::string& out) {
+	z_stream& z = mStreams->deflater;
+	if (!mStreams->deflaterReady) {
+		if (deflateInit(&z, (mLevel != 0) ? mLevel : Z_DEFAULT_COMPRESSION) != Z_OK)
+			return false;
+		mStreams->deflaterReady = true;
+	}
+	else if (deflateReset(&z) != Z_OK)
+		return false;
+	if (dictionary != nullptr &&
+			deflateSetDictionary(&z, (const Bytef*)dictionary->bytes.data(), (uInt)dictionary->bytes.size()) != Z_OK)
+		return false;
+
+	out.resize(deflateBound(&z, payload.size()));
+	z.next_in = (Bytef*)payload.data();
+	z.avail_in = (uInt)payload.size();
+	z.next_out = (Bytef*)&out[0];
+	z.avail_out = (uInt)out.size();
+	if (::deflate(&z, Z_FINISH) != Z_STREAM_END)
+		return false;
+	out.resize(z.total_out);
+	return true;
+}
+
+bool IOTP_Compressor::zlibDecompress(const std::string& payload, const Dictionary* dictionary, std::string& out) {
+	z_stream& z = mStreams->inflater;
+	if (!mStreams->inflaterReady) {
+		if (inflateInit(&z) != Z_OK)
+			return false;
+		mStreams->inflaterReady = true;
+	}
+	else if (inflateReset(&z) != Z_OK)
+		return false;
+
+	out.resize(std::min(std::max(payload.size() * 4, (size_t)1024), MAX_PAYLOAD));
+	z.next_in = (Bytef*)payload.data();
+	z.avail_in = (uInt)payload.size();
+	z.next_out = (Bytef*)&out[0];
+	z.avail_out = (uInt)out.size();
+	for (;;) {
+		int rc = ::inflate(&z, Z_FINISH);
+		if (rc == Z_STREAM_END)
+			break;
+		if (rc == Z_NEED_DICT) {
+			// the stream names the dictionary it needs by its adler32, which is our id of it
+			if (dictionary == nullptr || z.adler != dictionary->id ||
+					inflateSetDictionary(&z, (const Bytef*)dictionary->bytes.data(), (uInt)dictionary->bytes.size()) != Z_OK)
+				return false;
+			continue;
+		}
+		if ((rc != Z_OK && rc != Z_BUF_ERROR) || z.avail_out != 0 || out.size() >= MAX_PAYLOAD)
+			return false;		// corrupt, cut short, or too large
+		size_t produced = z.total_out;
+		out.resize(std::min(out.size() * 2, MAX_PAYLOAD));
+		z.next_out = (Bytef*)&out[produced];
+		z.avail_out = (uInt)(out.size() - produced);
+	}
+	out.resize(z.total_out);
+	return true;
+}
+
+#ifdef IOTP_HAVE_ZSTD
+
+bool IOTP_Compressor::zstdCompress(const std::string& payload, const Dictionary* dictionary, std::string& out) {
+	out.resize(ZSTD_compressBound(payload.size()));
+	size_t size = (dictionary != nullptr && dictionary->cdict != nullptr) ?
+			ZSTD_compress_usingCDict(mStreams->cctx, &out[0], out.size(), payload.data(), payload.size(),
+					dictionary->cdict) :
+			ZSTD_compressCCtx(mStreams->cctx, &out[0], out.size(), payload.data(), payload.size(),
+					(mLevel != 0) ? mLevel : 3);
+	if (ZSTD_isError(size))
+		return false;
+	out.resize(size);
+	return true;
+}
+
+bool IOTP_Compressor::zstdDecompress(const std::string& payload, const Dictionary* dictionary, std::string& out) {
+	// frames are always written with their content size
+	unsigned long long size = ZSTD_getFrameContentSize(payload.data(), payload.size());
+	if (size == ZSTD_CONTENTSIZE_ERROR || size == ZSTD_CONTENTSIZE_UNKNOWN || size > MAX_PAYLOAD)
+		return false;
+	out.resize((size_t)size);
+	size_t produced = (dictionary != nullptr && dictionary->ddict != nullptr) ?
+			ZSTD_decompress_usingDDict(mStreams->dctx, &out[0], out.size(), payload.data(), payload.size(),
+					dictionary->ddict) :
+			ZSTD_decompressDCtx(mStreams->dctx, &out[0], out.size(), payload.data(), payload.size());
+	return !ZSTD_isError(produced) && produced == size;
+}
+
+#else
+
+bool IOTP_Compressor::zstdCompress(const std::string&, const Dictionary*, std::string&) {
+	return false;
+}
+
+bool IOTP_Compressor::zstdDecompress(const std::string&, const Dictionary*, std::string&) {
+	return false;
+}
+
+#endif
+
+} /* namespace Watson_IOTP */
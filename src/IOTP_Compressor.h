@@ -0,0 +1,152 @@
+/*******************************************************************************
+ * Copyright (c) 2017 IBM Corp.
+ *
+ * All rights reserved. This program and the accompanying materials
+ * are made available under the terms of the Eclipse Public License v1.0
+ * and Eclipse Distribution License v1.0 which accompany this distribution.
+ *
+ * The Eclipse Public License is available at
+ *    http://www.eclipse.org/legal/epl-v10.html
+ * and the Eclipse Distribution License is available at
+ *   http://www.eclipse.org/org/documents/edl-v10.php.
+ *
+ * Contributors:
+ *    Payload compression with shared dictionaries
+ *******************************************************************************/
+
+#ifndef IOTP_COMPRESSOR_H_
+#define IOTP_COMPRESSOR_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace Watson_IOTP {
+
+/**
+ * Compression of event and command payloads with zlib, or zstd when the library is built
+ * with it (IOTP_HAVE_ZSTD). Telemetry repeats the same keys in every message, which a
+ * message on its own is too short to compress well, so the compressor can train a
+ * dictionary from a sample of the payloads it is given and compress later ones with it.
+ *
+ * The codec and dictionary are named in the fmt/ segment of the topic, after the encoding
+ * of the payload: "json.zlib" is json compressed without a dictionary, "json.zlib-1a2b3c4d"
+ * with the dictionary of that id. The id of a zlib dictionary is its adler32 checksum, as in
+ * the zlib stream header; the id of a zstd dictionary is the one zstd gives it. Receivers
+ * need the dictionary, see dictionary(), to decompress.
+ */
+class IOTP_Compressor {
+public:
+	typedef std::shared_ptr<IOTP_Compressor> ptr_t;
+
+	enum Codec { NONE, ZLIB, ZSTD };
+
+	struct Stats {
+		uint64_t compressed;		// payloads compressed
+		uint64_t skipped;			// payloads below the threshold, or that did not get smaller
+		uint64_t bytesIn;			// size of the payloads compressed
+		uint64_t bytesOut;			// their size compressed
+	};
+
+	/** The codec of a setting: "zlib", "zstd" or "none"; zstd falls back to zlib if it is not built */
+	static Codec toCodec(const std::string& codec);
+
+	static const char* toName(Codec codec);
+
+	static bool available(Codec codec);
+
+	/**
+	 * Constructor of an IOTP_Compressor.
+	 * @param codec - the codec payloads are compressed with, NONE to only decompress
+	 * @param threshold - payloads shorter than this are sent as they are
+	 * @param trainSamples - the number of payloads to train a dictionary from, 0 for none
+	 * @param dictionarySize - the largest dictionary to train, in bytes
+	 * @param level - the compression level, 0 for the codec's default
+	 */
+	IOTP_Compressor(Codec codec, size_t threshold = 256, int trainSamples = 0, size_t dictionarySize = 4096,
+			int level = 0);
+	~IOTP_Compressor();
+
+	Codec codec() const { return mCodec; }
+
+	size_t threshold() const { return mThreshold; }
+
+	/**
+	 * Compress a payload and add the codec, and dictionary if any, to the fmt/ segment of its
+	 * topic. Payloads are kept as samples until the dictionary is trained.
+	 * @return false if the payload is left as it is: below the threshold, no codec, or it
+	 * did not get smaller
+	 */
+	bool compress(std::string& topic, std::string& payload);
+
+	/**
+	 * Decompress the payload of a topic whose fmt/ segment names a codec, and take the codec
+	 * off the segment.
+	 * @return false if the codec or dictionary is unknown or the payload is corrupt; the
+	 * payload and topic are then left as they are
+	 */
+	bool decompress(std::string& topic, std::string& payload);
+
+	/** Whether the fmt/ segment of a topic names a codec */
+	static bool isCompressed(const std::string& topic);
+
+	/**
+	 * Train a dictionary for the codec from sample payloads and compress with it from now on.
+	 * @return the id of the dictionary, 0 if none could be trained
+	 */
+	uint32_t train(const std::vector<std::string>& samples);
+
+	/**
+	 * Add a dictionary shared with the other side, to decompress payloads that use it and,
+	 * if use is set, compress with it.
+	 * @return the id of the dictionary
+	 */
+	uint32_t addDictionary(Codec codec, const std::string& dictionary, bool use = false);
+
+	/** The dictionary of an id, empty if there is none */
+	std::string dictionary(uint32_t id);
+
+	/** The id of the dictionary payloads are compressed with, 0 for none */
+	uint32_t dictionaryId();
+
+	Stats stats();
+
+	/** The most payload a decompressed message may have */
+	static const size_t MAX_PAYLOAD = 16 * 1024 * 1024;
+
+private:
+	struct Dictionary;
+	struct Streams;
+
+	uint32_t trainLocked(const std::vector<std::string>& samples);
+	uint32_t addLocked(Codec codec, const std::string& dictionary, uint32_t id);
+	bool zlibCompress(const std::string& payload, const Dictionary* dictionary, std::string& out);
+	bool zlibDecompress(const std::string& payload, const Dictionary* dictionary, std::string& out);
+	bool zstdCompress(const std::string& payload, const Dictionary* dictionary, std::string& out);
+	bool zstdDecompress(const std::string& payload, const Dictionary* dictionary, std::string& out);
+	std::string trainContent(const std::vector<std::string>& samples);
+
+	Codec mCodec;
+	size_t mThreshold;
+	size_t mTrainSamples;
+	size_t mDictionarySize;
+	int mLevel;
+
+	std::mutex mLock;
+	std::unique_ptr<Streams> mStreams;
+	std::map<uint32_t, std::shared_ptr<Dictionary> > mDictionaries;
+	std::shared_ptr<Dictionary> mCurrent;
+	std::vector<std::string> mSamples;
+	bool mTrained;
+	Stats mStats;
+};
+
+typedef IOTP_Compressor::ptr_t iotp_compressor_ptr;
+
+} /* namespace Watson_IOTP */
+
+#endif /* IOTP_COMPRESSOR_H_ */
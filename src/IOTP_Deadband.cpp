@@ -0,0 +1,157 @@
+/*******************************************************************************
+ * Copyright (c) 2017 IBM Corp.
+ *
+ * All rights reserved. This program and the accompanying materials
+ * are made available under the terms of the Eclipse Public License v1.0
+ * and Eclipse Distribution License v1.0 which accompany this distribution.
+ *
+ * The Eclipse Public License is available at
+ *    http://www.eclipse.org/legal/epl-v10.html
+ * and the Eclipse Distribution License is available at
+ *   http://www.eclipse.org/org/documents/edl-v10.php.
+ *
+ * Contributors:
+ *    Deadband filter for published events
+ *******************************************************************************/
+
+#include "IOTP_Deadband.h"
+
+#include <cmath>
+#include <cstdlib>
+#include <limits>
+#include <sstream>
+
+namespace Watson_IOTP {
+
+IOTP_Deadband::IOTP_Deadband(int64_t heartbeat) :
+	mHeartbeat(heartbeat > 0 ? heartbeat : 0)
+{
+	mStats.passed = mStats.heartbeats = mStats.suppressed = 0;
+}
+
+void IOTP_Deadband::setBand(const std::string& eventType, const std::string& field, double absolute, double relative) {
+	EventType& type = mTypes[eventType];
+	Band band = { std::fabs(absolute), std::fabs(relative) };
+	std::map<std::string, size_t>::iterator slot = type.slots.find(field);
+	if (slot != type.slots.end()) {
+		type.bands[slot->second] = band;
+		return;
+	}
+	type.slots[field] = type.bands.size();
+	type.bands.push_back(band);
+}
+
+bool IOTP_Deadband::filters(const std::string& eventType) const {
+	return mTypes.find(eventType) != mTypes.end();
+}
+
+bool IOTP_Deadband::pass(const std::string& key, const std::string& eventType, const std::vector<Sample>& samples,
+		int64_t now, bool record) {
+	std::map<std::string, EventType>::const_iterator type = mTypes.find(eventType);
+	if (type == mTypes.end())
+		return true;
+
+	std::lock_guard<std::mutex> lck(mLock);
+	Row& row = mRows[key + "/" + eventType];
+	bool publish = row.last.empty();
+	if (row.last.size() < type->second.bands.size())
+		row.last.resize(type->second.bands.size(), std::numeric_limits<double>::quiet_NaN());
+
+	for (std::vector<Sample>::const_iterator it = samples.begin(); it != samples.end() && !publish; ++it) {
+		std::map<std::string, size_t>::const_iterator slot = type->second.slots.find(it->field);
+		if (slot != type->second.slots.end())
+			publish = moved(type->second.bands[slot->second], row.last[slot->second], it->value);
+	}
+
+	if (publish)
+		++mStats.passed;
+	else if (mHeartbeat > 0 && now - row.sent >= mHeartbeat) {
+		publish = true;
+		++mStats.heartbeats;
+	}
+	else {
+		++mStats.suppressed;
+		return false;
+	}
+
+	if (record)
+		store(type->second, row, samples, now);
+	return true;
+}
+
+void IOTP_Deadband::record(const std::string& key, const std::string& eventType, const std::vector<Sample>& samples,
+		int64_t now) {
+	std::map<std::string, EventType>::const_iterator type = mTypes.find(eventType);
+	if (type == mTypes.end())
+		return;
+
+	std::lock_guard<std::mutex> lck(mLock);
+	Row& row = mRows[key + "/" + eventType];
+	if (row.last.size() < type->second.bands.size())
+		row.last.resize(type->second.bands.size(), std::numeric_limits<double>::quiet_NaN());
+	store(type->second, row, samples, now);
+}
+
+void IOTP_Deadband::store(const EventType& type, Row& row, const std::vector<Sample>& samples, int64_t now) {
+	row.sent = now;
+	for (std::vector<Sample>::const_iterator it = samples.begin(); it != samples.end(); ++it) {
+		std::map<std::string, size_t>::const_iterator slot = type.slots.find(it->field);
+		if (slot != type.slots.end())
+			row.last[slot->second] = it->value;
+	}
+}
+
+IOTP_Deadband::Stats IOTP_Deadband::stats() {
+	std::lock_guard<std::mutex> lck(mLock);
+	return mStats;
+}
+
+std::string IOTP_Deadband::configure(const std::string& list) {
+	std::string rejected;
+	std::istringstream items(list);
+	std::string item;
+	while (std::getline(items, item, ',')) {
+		std::istringstream fields(item);
+		std::string eventType, field;
+		bool valid = std::getline(fields, eventType, ':') && eventType.size() > 0 && fields.peek() != EOF;
+		while (valid && std::getline(fields, field, '|')) {
+			size_t equals = field.find('=');
+			double band[2] = { 0, 0 };		// absolute, relative
+			if (equals == 0 || equals == std::string::npos) {
+				valid = false;
+				break;
+			}
+			std::istringstream values(field.substr(equals + 1));
+			std::string value;
+			while (valid && std::getline(values, value, '/')) {
+				char* end = nullptr;
+				double number = std::strtod(value.c_str(), &end);
+				if (end == value.c_str())
+					valid = false;
+				else if (*end == '%')
+					band[1] = number / 100;
+				else
+					band[0] = number;
+			}
+			if (valid)
+				setBand(eventType, field.substr(0, equals), band[0], band[1]);
+		}
+		if (!valid)
+			rejected += (rejected.empty() ? "" : ",") + item;
+	}
+	return rejected;
+}
+
+// A field with no value published yet, or that was not a number, has moved
+bool IOTP_Deadband::moved(const Band& band, double last, double value) {
+	if (std::isnan(last) || std::isnan(value))
+		return !(std::isnan(last) && std::isnan(value));
+	double change = std::fabs(value - last);
+	if (band.absolute == 0 && band.relative == 0)
+		return change != 0;
+	// a relative band of 0 is a band of nothing, a value that stays at 0 has not moved
+	return (band.absolute > 0 && change >= band.absolute) ||
+			(band.relative > 0 && change > 0 && change >= band.relative * std::fabs(last));
+}
+
+} /* namespace Watson_IOTP */
@@ -0,0 +1,134 @@
+/*******************************************************************************
+ * Copyright (c) 2017 IBM Corp.
+ *
+ * All rights reserved. This program and the accompanying materials
+ * are made available under the terms of the Eclipse Public License v1.0
+ * and Eclipse Distribution License v1.0 which accompany this distribution.
+ *
+ * The Eclipse Public License is available at
+ *    http://www.eclipse.org/legal/epl-v10.html
+ * and the Eclipse Distribution License is available at
+ *   http://www.eclipse.org/org/documents/edl-v10.php.
+ *
+ * Contributors:
+ *    Deadband filter for published events
+ *******************************************************************************/
+
+#ifndef IOTP_DEADBAND_H_
+#define IOTP_DEADBAND_H_
+
+#include <stdint.h>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace Watson_IOTP {
+
+/**
+ * Change detection for events with numeric fields. Each field of an event type can have a
+ * deadband, absolute, relative to the last value published, or both. An event is published
+ * when a field moved out of its deadband since the last event published for the device, when
+ * no event was published for the heartbeat interval, or the first time; otherwise it is
+ * suppressed.
+ *
+ * The fields of an event type are numbered when their deadbands are set, so the last values
+ * of a device are one row of doubles in the table, found by device and event type.
+ */
+class IOTP_Deadband {
+public:
+	typedef std::shared_ptr<IOTP_Deadband> ptr_t;
+
+	/** A numeric field of an event */
+	struct Sample {
+		std::string field;
+		double value;
+	};
+
+	struct Stats {
+		uint64_t passed;		// published, a field moved out of its deadband or the first value
+		uint64_t heartbeats;	// published for the heartbeat only
+		uint64_t suppressed;	// not published
+	};
+
+	/**
+	 * Constructor of an IOTP_Deadband.
+	 * @param heartbeat - milliseconds after which an event is published even if no field
+	 * moved, 0 for none
+	 */
+	IOTP_Deadband(int64_t heartbeat = 0);
+
+	/**
+	 * Set the deadband of a field of an event type, before events are filtered. A change
+	 * as large as either band moves the field out of it; with both 0 any change does.
+	 * @param absolute - the band, in the field's units
+	 * @param relative - the band as a fraction of the last value published
+	 */
+	void setBand(const std::string& eventType, const std::string& field, double absolute, double relative);
+
+	/**
+	 * Whether an event type has deadbands, so its events are worth taking apart.
+	 */
+	bool filters(const std::string& eventType) const;
+
+	/**
+	 * Decide whether to publish an event and, if so, record its values as the last published.
+	 * Fields without a deadband are ignored.
+	 * @param key - the device: the event type on a device, "type/id" on a gateway
+	 * @param now - milliseconds, on any monotonic clock
+	 * @param record - false to only decide, for an event that may yet not be published; its
+	 * values are recorded by record() once it is
+	 * @return true to publish the event
+	 */
+	bool pass(const std::string& key, const std::string& eventType, const std::vector<Sample>& samples,
+			int64_t now, bool record = true);
+
+	/**
+	 * Record the values of an event passed without recording them, as the last published.
+	 */
+	void record(const std::string& key, const std::string& eventType, const std::vector<Sample>& samples,
+			int64_t now);
+
+	Stats stats();
+
+	/**
+	 * Set up the deadbands from a list: "status:temperature=0.5|humidity=2%,gps:speed=1" is
+	 * an absolute band of 0.5 on temperature and 2% of the last value on humidity of status
+	 * events, and 1 on speed of gps events. "temperature=0.5/2%" gives both bands.
+	 * @return the items that could not be parsed, comma separated
+	 */
+	std::string configure(const std::string& list);
+
+private:
+	struct Band {
+		double absolute;
+		double relative;
+	};
+
+	struct EventType {
+		std::map<std::string, size_t> slots;	// field to position in a device's row
+		std::vector<Band> bands;
+	};
+
+	struct Row {
+		int64_t sent;							// when the last event was published
+		std::vector<double> last;				// last value published of each field, NaN for none
+	};
+
+	static bool moved(const Band& band, double last, double value);
+	static void store(const EventType& type, Row& row, const std::vector<Sample>& samples, int64_t now);
+
+	int64_t mHeartbeat;
+	std::map<std::string, EventType> mTypes;
+	std::mutex mLock;
+	std::unordered_map<std::string, Row> mRows;
+	Stats mStats;
+};
+
+typedef IOTP_Deadband::ptr_t iotp_deadband_ptr;
+
+} /* namespace Watson_IOTP */
+
+#endif /* IOTP_DEADBAND_H_ */
@@ -12,6 +12,8 @@
  *
  * Contributors:
  *    Mike Tran - initial API and implementation and/or initial documentation
+ *    Write location updates from a precompiled template
+ *    Write and read the device model from descriptions of its fields
  *******************************************************************************/
 
 #include <iostream>
@@ -42,19 +44,10 @@ namespace Watson_IOTP {
 				mFwVersion((fwVersion == NULL) ? "" : fwVersion),
 				mHwVersion((hwVersion == NULL) ? "" : hwVersion),
 				mDescriptiveLocation((descriptiveLocation == NULL) ? "" : descriptiveLocation) {
-		setJsonValue();
 	};
 
 	IOTP_DeviceInfo::IOTP_DeviceInfo(const Json::Value& value) {
-		mSerialNumber = value.get("serialNumber", "").asString();
-		mManufacturer = value.get("manufacturer", "").asString();
-		mModel = value.get("model", "").asString();
-		mDeviceClass = value.get("deviceClass", "").asString();
-		mDescription = value.get("description", "").asString();
-		mFwVersion = value.get("fwVersion", "").asString();
-		mHwVersion = value.get("hwVersion", "").asString();
-		mDescriptiveLocation = value.get("descriptiveLocation", "").asString();
-		setJsonValue();
+		IOTP_Fields::read(value, *this);
 	}
 
 	IOTP_DeviceInfo::IOTP_DeviceInfo(const IOTP_DeviceInfo& src) :
@@ -66,31 +59,14 @@ namespace Watson_IOTP {
 		mFwVersion(src.mFwVersion),
 		mHwVersion(src.mHwVersion),
 		mDescriptiveLocation(src.mDescriptiveLocation) {
-		setJsonValue();
 	};
 
-	void IOTP_DeviceInfo::setJsonValue() {
-		if (!mSerialNumber.empty())
-			json["serialNumber"] = mSerialNumber;
-		if (!mManufacturer.empty())
-			json["manufacturer"] = mManufacturer;
-		if (!mModel.empty())
-			json["model"] = mModel;
-		if (!mDeviceClass.empty())
-			json["deviceClass"] = mDeviceClass;
-		if (!mDescription.empty())
-			json["description"] = mDescription;
-		if (!mFwVersion.empty())
-			json["fwVersion"] = mFwVersion;
-		if (!mHwVersion.empty())
-			json["hwVersion"] = mHwVersion;
-		if (!mDescriptiveLocation.empty())
-			json["descriptiveLocation"] = mDescriptiveLocation;
-
+	Json::Value IOTP_DeviceInfo::toJsonValue() const{
+		return IOTP_Fields::toJsonValue(*this);
 	}
 
-	const Json::Value& IOTP_DeviceInfo::toJsonValue() const{
-		return json;
+	void IOTP_DeviceInfo::write(IOTP_JsonWriter& writer) const {
+		IOTP_Fields::write(writer, *this);
 	}
 
 
@@ -101,7 +77,6 @@ namespace Watson_IOTP {
 		mElevation(elevation),
 		mAccuracy(0) {
 		time(&measuredDateTime);
-		setJsonValue();
 	}
 
 	IOTP_DeviceLocation::IOTP_DeviceLocation(double latitude, double longitude, double elevation, double accuracy) :
@@ -110,21 +85,16 @@ namespace Watson_IOTP {
 		mElevation(elevation),
 		mAccuracy(accuracy) {
 		time(&measuredDateTime);
-		setJsonValue();
 	}
 
-	IOTP_DeviceLocation::IOTP_DeviceLocation(const Json::Value& value) {
-		char measuredDateTimeBuf[sizeof "YYYY-MM-DDTHH:MM:SSZ"];
-		mLatitude = value.get("latitude", 0.0).asDouble();
-		mLongitude = value.get("longitude", 0.0).asDouble();
-		mElevation = value.get("elevation", 0.0).asDouble();
-		mAccuracy = value.get("accuracy", 0.0).asDouble();
-		strcpy(measuredDateTimeBuf , value.get("measuredDateTime", "").asString().data());
-		if(strcmp(measuredDateTimeBuf,""))
-			strptime(measuredDateTimeBuf, "%FT%TZ", gmtime(&measuredDateTime));
-		else
-			time(&measuredDateTime);
-		setJsonValue();
+	// Now when the location has no measuredDateTime
+	IOTP_DeviceLocation::IOTP_DeviceLocation(const Json::Value& value) :
+		mLatitude(0),
+		mLongitude(0),
+		mElevation(0),
+		mAccuracy(0) {
+		time(&measuredDateTime);
+		IOTP_Fields::read(value, *this);
 	}
 
 	void IOTP_DeviceLocation::setLatitude(double latitude) {
@@ -144,26 +114,19 @@ namespace Watson_IOTP {
 		mLongitude = longitude;
 		mElevation = elevation;
 		time(&measuredDateTime);
-		setJsonValue();
 	}
 
-	const Json::Value& IOTP_DeviceLocation::toJsonValue() const {
-		return json;
+	Json::Value IOTP_DeviceLocation::toJsonValue() const {
+		return IOTP_Fields::toJsonValue(*this);
 	}
 
-	void IOTP_DeviceLocation::setJsonValue() {
-		char measuredDateTimeBuf[sizeof "YYYY-MM-DDTHH:MM:SSZ"];
-		json["latitude"] = mLatitude;
-		json["longitude"] = mLongitude;
-		json["elevation"] = mElevation;
-		json["accuracy"] = mAccuracy;
-		strftime(measuredDateTimeBuf, sizeof measuredDateTimeBuf, "%FT%TZ", gmtime(&measuredDateTime));
-		json["measuredDateTime"] = measuredDateTimeBuf;
+	// Sent with every update, so from a template rather than member by member
+	void IOTP_DeviceLocation::write(IOTP_JsonWriter& writer) const {
+		IOTP_Fields::writeTemplate(writer, *this);
 	}
 
 	IOTP_DeviceLog::IOTP_DeviceLog(std::string& msg, std::string& time, int severity, std::string data)
 	:mMessage (msg), mMeasuredDateTime (time), mSeverity (severity), mData (data) {
-		setJsonValue();
 	}
 
 	void IOTP_DeviceLog::setLogMessage(std::string& msg) {
@@ -183,19 +146,13 @@ namespace Watson_IOTP {
 		mMeasuredDateTime = time;
 		mSeverity = sev;
 		mData = data;
-		setJsonValue();
 	}
-	const Json::Value& IOTP_DeviceLog::toJsonValue() const {
-		return json;
+	Json::Value IOTP_DeviceLog::toJsonValue() const {
+		return IOTP_Fields::toJsonValue(*this);
 	}
 
-	void IOTP_DeviceLog::setJsonValue() {
-		//char measuredDateTimeBuf[sizeof "YYYY-MM-DDTHH:MM:SSZ"];
-		json["message"] = mMessage;
-		json["severity"] = mSeverity;
-		json["data"] = mData;
-		//strftime(measuredDateTimeBuf, sizeof measuredDateTimeBuf, "%FT%TZ", gmtime(&mMeasuredDateTime));
-		json["timestamp"] = mMeasuredDateTime;
+	void IOTP_DeviceLog::write(IOTP_JsonWriter& writer) const {
+		IOTP_Fields::write(writer, *this);
 	}
 
 }
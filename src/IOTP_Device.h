@@ -21,6 +21,8 @@
 #include "IOTP_DeviceFirmwareHandler.h"
 //#include "IOTP_Client.h"
 #include "IOTP_ResponseHandler.h"
+#include "IOTP_JsonWriter.h"
+#include "IOTP_Fields.h"
 
 
 /**
@@ -61,10 +63,23 @@ namespace Watson_IOTP {
 				const char* descriptiveLocation);
 		IOTP_DeviceInfo(const Json::Value& value);
 		IOTP_DeviceInfo(const IOTP_DeviceInfo& src);
-		const Json::Value& toJsonValue() const;
+		Json::Value toJsonValue() const;
+		void write(IOTP_JsonWriter& writer) const;
 
 	private:
-		void setJsonValue();
+		friend class IOTP_Fields;
+		template <typename Self, typename Visit>
+		static void fields(Self& self, Visit& visit) {
+			visit("description", self.mDescription, IOTP_Fields::OPTIONAL);
+			visit("descriptiveLocation", self.mDescriptiveLocation, IOTP_Fields::OPTIONAL);
+			visit("deviceClass", self.mDeviceClass, IOTP_Fields::OPTIONAL);
+			visit("fwVersion", self.mFwVersion, IOTP_Fields::OPTIONAL);
+			visit("hwVersion", self.mHwVersion, IOTP_Fields::OPTIONAL);
+			visit("manufacturer", self.mManufacturer, IOTP_Fields::OPTIONAL);
+			visit("model", self.mModel, IOTP_Fields::OPTIONAL);
+			visit("serialNumber", self.mSerialNumber, IOTP_Fields::OPTIONAL);
+		}
+
 		std::string mSerialNumber,
 			mManufacturer,
 			mModel,
@@ -73,7 +88,6 @@ namespace Watson_IOTP {
 			mFwVersion,
 			mHwVersion,
 			mDescriptiveLocation;
-		Json::Value json;
 	};
 
 	typedef IOTP_DeviceInfo::ptr_t iotf_device_info_ptr;
@@ -95,16 +109,25 @@ namespace Watson_IOTP {
 		void setLongitude(double longitude);
 		void setElevation(double elevation);
 		void setLocation(double latitude, double longitude, double elevation);
-		const Json::Value& toJsonValue() const;
+		Json::Value toJsonValue() const;
+		void write(IOTP_JsonWriter& writer) const;
 
 	private:
-		void setJsonValue();
+		friend class IOTP_Fields;
+		template <typename Self, typename Visit>
+		static void fields(Self& self, Visit& visit) {
+			visit("accuracy", self.mAccuracy);
+			visit("elevation", self.mElevation);
+			visit("latitude", self.mLatitude);
+			visit("longitude", self.mLongitude);
+			visit("measuredDateTime", IOTP_Fields::time(self.measuredDateTime));
+		}
+
 		double mLatitude;
 		double mLongitude;
 		double mElevation;
 		double mAccuracy;
 		time_t measuredDateTime;
-		Json::Value json;
 	};
 
 	typedef IOTP_DeviceLocation::ptr_t iotf_device_location_ptr;
@@ -175,16 +198,23 @@ namespace Watson_IOTP {
 		void setLogSeverity(int& sev);
 		void setLogdata(std::string& data);
 		void setLogInfo(std::string& msg, std::string& time, int& sev, std::string& data);
-		const Json::Value& toJsonValue() const;
+		Json::Value toJsonValue() const;
+		void write(IOTP_JsonWriter& writer) const;
 
 	private:
-		void setJsonValue();
+		friend class IOTP_Fields;
+		template <typename Self, typename Visit>
+		static void fields(Self& self, Visit& visit) {
+			visit("data", self.mData);
+			visit("message", self.mMessage);
+			visit("severity", self.mSeverity);
+			visit("timestamp", self.mMeasuredDateTime);
+		}
+
 		std::string mMessage;
 		std::string mMeasuredDateTime;
 		int mSeverity;
 		std::string mData;
-
-		Json::Value json;
 	};
 
 	typedef IOTP_DeviceLog::ptr_t iotf_device_log_ptr;
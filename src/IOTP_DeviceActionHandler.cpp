@@ -13,6 +13,7 @@
  * Contributors:
  *    Mike Tran - initial API and implementation and/or initial documentation
  *    Lokesh Haralakatta - Updates to match with latest mqtt lib changes
+ *    Read the reqId of requests without parsing them
  *******************************************************************************/
 
 #include <iostream>
@@ -22,6 +23,7 @@
 #include "IOTP_Client.h"
 #include "IOTP_DeviceActionHandler.h"
 #include "IOTP_ReplyMessage.h"
+#include "IOTP_JsonScanner.h"
 #include "mqtt/message.h"
 #include "IOTP_TopicDefinitions.h"
 
@@ -32,6 +34,15 @@ namespace Watson_IOTP {
 //	extern const std::string& DEVICE_REPONSE_TOPIC;
 
 	iotp_reply_message_ptr IOTP_DeviceActionHandler::message_arrived(const std::string& topic, Json::Value& jsonPayload) {
+		return respond(topic, jsonPayload.get("reqId", "").asString());
+	}
+
+	iotp_reply_message_ptr IOTP_DeviceActionHandler::message_arrived(const std::string& topic, const IOTP_JsonDocument& payload,
+			mqtt::const_message_ptr msg) {
+		return respond(topic, payload.getString("reqId"));
+	}
+
+	iotp_reply_message_ptr IOTP_DeviceActionHandler::respond(const std::string& topic, const std::string& reqId) {
 
 		iotp_device_action_response_ptr rsp;
 
@@ -43,13 +54,13 @@ namespace Watson_IOTP {
 
 		std::cout<<"Rc:"<<rsp->get_rc()<<std::endl;
 		std::cout<<"Msg:"<<rsp->get_message()<<std::endl;
-		std::cout<<"ReqId"<<jsonPayload.get("reqId", "").asString()<<std::endl;
+		std::cout<<"ReqId"<<reqId<<std::endl;
 		Json::Value payload;
 		payload["rc"] = rsp->get_rc();
 		if (rsp->get_message().empty() == false) {
 			payload["message"] = rsp->get_message();
 		}
-		payload["reqId"] = jsonPayload.get("reqId", "").asString();
+		payload["reqId"] = reqId;
 
 		IOTP_ReplyMessage reply(DEVICE_REPONSE_TOPIC, payload);
 		iotp_reply_message_ptr replyPtr = std::make_shared<IOTP_ReplyMessage>(reply);
@@ -66,12 +77,11 @@ namespace Watson_IOTP {
 
 	iotp_reply_message_ptr IOTP_DeviceActionHandler::message_arrived(const std::string& topic, mqtt::const_message_ptr msg) {
 		Json::Value jsonPayload;
-		Json::Reader reader;
 		iotp_reply_message_ptr replyPtr;
 
 		std::cout<<"Message Arrived: msgPtr"<<std::endl;
 
-		if (reader.parse(msg->get_payload(), jsonPayload)) {
+		if (IOTP_JsonScanner::parse(msg->get_payload(), jsonPayload)) {
 			replyPtr = message_arrived(topic, jsonPayload);
 		} else {
 			std::cout << typeid(*this).name() << " Message arrived at TOPIC " << topic << " is not a JSON string." << std::endl;
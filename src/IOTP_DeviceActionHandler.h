@@ -57,6 +57,8 @@ public:
 	virtual ~IOTP_DeviceActionHandler() {}
 	iotp_reply_message_ptr message_arrived(const std::string& topic, Json::Value& jsonPayload);
 	iotp_reply_message_ptr message_arrived(const std::string& topic, mqtt::const_message_ptr msg);
+	iotp_reply_message_ptr message_arrived(const std::string& topic, const IOTP_JsonDocument& payload,
+			mqtt::const_message_ptr msg);
 
 	/**
 	 * If this operation can be initiated immediately, set rc to 202.
@@ -76,6 +78,9 @@ public:
 	 * The factory reset action is considered complete when the device sends a Manage device request following its factory reset.
 	 */
 	virtual iotp_device_action_response_ptr factory_reset() = 0;
+
+private:
+	iotp_reply_message_ptr respond(const std::string& topic, const std::string& reqId);
 };
 typedef IOTP_DeviceActionHandler::ptr_t iotp_device_action_handler_ptr;
 }
@@ -13,6 +13,7 @@
  * Contributors:
  *    Hari Prasada Reddy - Initial implementation
  *    Lokesh Haralakatta - Updates to match with latest mqtt lib changes
+ *    Read location updates without parsing the whole request
  *******************************************************************************/
 
 #include "IOTP_DeviceAttributeHandler.h"
@@ -67,9 +68,24 @@ iotp_reply_message_ptr IOTP_DeviceAttributeHandler::message_arrived(const std::s
 		return nullptr;
 		//Please note: there is no reqId as no response by device is required.
 	}
+	return nullptr;
 }
 
-iotp_reply_message_ptr IOTP_DeviceAttributeHandler::message_arrived(const std::string& topic, mqtt::const_message_ptr msg) {
+iotp_reply_message_ptr IOTP_DeviceAttributeHandler::message_arrived(const std::string& topic, const IOTP_JsonDocument& payload,
+		mqtt::const_message_ptr msg) {
+	if (topic == SERVER_UPDATE_TOPIC) {
+		iotf_device_location_ptr p = std::make_shared<IOTP_DeviceLocation>(0.0,0.0,0.0);
+		if (payload.getString("d/fields/0/field") == "location") {
+			p->setLatitude(payload.getDouble("d/fields/0/value/latitude"));
+			p->setLongitude(payload.getDouble("d/fields/0/value/longitude"));
+			p->setElevation(payload.getDouble("d/fields/0/value/elevation"));
+		}
+		UpdateLocation(p);
+	}
+	return nullptr;
+}
 
+iotp_reply_message_ptr IOTP_DeviceAttributeHandler::message_arrived(const std::string& topic, mqtt::const_message_ptr msg) {
+	return nullptr;
 }
 }
@@ -52,6 +52,8 @@ public:
 	virtual ~IOTP_DeviceAttributeHandler() {}
 	iotp_reply_message_ptr message_arrived(const std::string& topic, Json::Value& jsonPayload);
 	iotp_reply_message_ptr message_arrived(const std::string& topic, mqtt::const_message_ptr msg);
+	iotp_reply_message_ptr message_arrived(const std::string& topic, const IOTP_JsonDocument& payload,
+			mqtt::const_message_ptr msg);
 
 	/**
 	 * If this operation can be initiated immediately, set rc to 202.
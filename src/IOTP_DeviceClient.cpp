@@ -17,6 +17,10 @@
  *    Lokesh Haralakatta - Added logging feature using log4cpp.
  *    Lokesh K Haralakatta - Added SSL/TLS Support.
  *    Lokesh K Haralakatta - Added custom port support
+ *    Added offline buffering and disk spool for events
+ *    Added rate limits per event type
+ *    Added deadband filter per event type
+ *    Added CBOR and MessagePack encoded events
  *******************************************************************************/
 
 #include "IOTP_DeviceClient.h"
@@ -108,18 +112,75 @@ bool IOTP_DeviceClient::connect()
 * @return void
 */
 void IOTP_DeviceClient::publishEvent(char *eventType, char *eventFormat, const char* data, int qos) {
+	publishEvent(eventType, eventFormat, data, qos, 0);
+}
+
+/**
+* Function used to Publish events from the device to the IBM Watson IoT service
+* @param eventType - Type of event to be published e.g status, gps
+* @param eventFormat - Format of the event e.g json
+* @param data - Payload of the event
+* @param QoS - qos for the publish event. Supported values : 0, 1, 2
+* @param priority - spool priority of the event, 0 (lowest) to 255
+*
+* @return bool
+*/
+bool IOTP_DeviceClient::publishEvent(char *eventType, char *eventFormat, const char* data, int qos, int priority) {
 	std::string methodName = __PRETTY_FUNCTION__;
 	logger.debug(methodName+" Entry: ");
-	std::string publishTopic= "iot-2/evt/"+std::string(eventType)+"/fmt/"+std::string(eventFormat);
 	std::string payload = data;
-	logger.debug("publishTopic: " + publishTopic);
 	logger.debug("payload: " + payload);
-	mqtt::message_ptr pubmsg = std::make_shared < mqtt::message > (data);
-	pubmsg->set_qos(qos);
-	mqtt::idelivery_token_ptr delivery_tok = this->publishTopic(publishTopic, pubmsg);
-	//delivery_tok->wait_for_completion(DEFAULT_TIMEOUT());
-	mqtt::const_message_ptr msgPtr = delivery_tok->get_message();
+	bool rc = this->publishPayload(eventType, eventFormat, payload, qos, priority);
 	logger.debug(methodName+" Exit: ");
+	return rc;
+}
+
+/**
+* Function used to Publish events from the device to the IBM Watson IoT service, encoded
+* as json, cbor or msgpack
+* @param eventType - Type of event to be published e.g status, gps
+* @param data - the event
+* @param format - the encoding of the payload, which names the fmt/ segment of the topic
+* @param QoS - qos for the publish event. Supported values : 0, 1, 2
+* @param priority - spool priority of the event, 0 (lowest) to 255
+*
+* @return bool
+*/
+bool IOTP_DeviceClient::publishEvent(char *eventType, const Json::Value& data, IOTP_Encoding::Format format, int qos,
+		int priority) {
+	std::string methodName = __PRETTY_FUNCTION__;
+	logger.debug(methodName+" Entry: ");
+	// binary payloads hold NUL bytes, so they stay in a std::string all the way
+	std::string payload = IOTP_Encoding::encode(data, format);
+	logger.debug("payload: " + std::to_string(payload.size()) + " bytes of " + IOTP_Encoding::toName(format));
+	bool rc = this->publishPayload(eventType, IOTP_Encoding::toName(format), payload, qos, priority);
+	logger.debug(methodName+" Exit: ");
+	return rc;
+}
+
+/*
+ * Filter, rate limit and publish or spool the payload of an event.
+ */
+bool IOTP_DeviceClient::publishPayload(const std::string& eventType, const std::string& eventFormat,
+		const std::string& payload, int qos, int priority) {
+	std::string methodName = __PRETTY_FUNCTION__;
+	logger.debug(methodName+" Entry: ");
+	std::string publishTopic= "iot-2/evt/"+eventType+"/fmt/"+eventFormat;
+	logger.debug("publishTopic: " + publishTopic);
+	DeadbandSample passed;
+	if (!this->filterEvent(eventType, eventType, eventFormat, payload, passed)) {
+		logger.debug(methodName+" Exit: ");
+		return true;
+	}
+	if (!this->limitEvent(eventType, eventType, publishTopic, payload, qos, passed)) {
+		logger.debug(methodName+" Exit: ");
+		return this->mRateLimiter->policy() == IOTP_RateLimiter::COALESCE;
+	}
+	bool rc = this->publishCompressed(publishTopic, payload, qos, priority);
+	if (rc)
+		this->recordEvent(passed);
+	logger.debug(methodName+" Exit: ");
+	return rc;
 }
 
 /**
@@ -140,9 +201,20 @@ void IOTP_DeviceClient::publishEvent(char *eventType, char *eventFormat, const c
 	std::string payload = data;
 	logger.debug("publishTopic: " + publishTopic);
 	logger.debug("payload: " + payload);
+	DeadbandSample passed;
+	if (!this->filterEvent(eventType, eventType, eventFormat, payload, passed)) {
+		this->completeUnsent(publishTopic, payload, qos, cb, MQTTASYNC_SUCCESS);
+		logger.debug(methodName+" Exit: ");
+		return;
+	}
+	if (!this->limitEvent(eventType, eventType, publishTopic, payload, qos, passed, &cb)) {
+		logger.debug(methodName+" Exit: ");
+		return;
+	}
 	mqtt::message_ptr pubmsg = std::make_shared < mqtt::message > (data);
 	pubmsg->set_qos(qos);
 	mqtt::idelivery_token_ptr delivery_tok = this->publishTopic(publishTopic, pubmsg, NULL, cb);
+	this->recordEvent(passed);
 	logger.debug(methodName+" Exit: ");
 }
 
@@ -179,15 +251,16 @@ void IOTP_DeviceClient::disconnect(){
 
 bool IOTP_DeviceClient::manage() {
 	if (this->subscribeCommandHandler(SERVER_RESPONSE_TOPIC, mResponseHandler)) {
-		Json::Value jsonManageData;
-
-		jsonManageData["lifetime"] = mLifetime;
-		jsonManageData["supports"]["deviceActions"] = supportDeviceActions();
-		jsonManageData["supports"]["firmwareActions"] = supportFirmwareActions();
-		//jsonManageData["deviceInfo"] = mDeviceInfo->toJsonValue();
-		jsonManageData["deviceInfo"] = mDeviceData->getDeviceInfo()->toJsonValue();
-
-		std::string reqId = send_message(DEVICE_MANAGE_TOPIC, jsonManageData);
+		std::string reqId = send_streamed(DEVICE_MANAGE_TOPIC, [this](IOTP_JsonWriter& writer) {
+			writer.beginObject().key("deviceInfo");
+			mDeviceData->getDeviceInfo()->write(writer);
+			writer.member("lifetime", mLifetime)
+				.key("supports").beginObject()
+					.member("deviceActions", supportDeviceActions())
+					.member("firmwareActions", supportFirmwareActions())
+				.endObject()
+				.endObject();
+		});
 		if (!reqId.empty()) {
 			Json::Value res = mResponseHandler->wait_for_response(DEFAULT_TIMEOUT(), reqId);
 			int rc = res.get("rc", -1).asInt();
@@ -226,7 +299,9 @@ bool IOTP_DeviceClient::unmanage() {
 }
 
 bool IOTP_DeviceClient::update_device_location(IOTP_DeviceLocation& deviceLocation) {
-	return pushManageMessage(DEVICE_UPDATE_LOCATION_TOPIC, deviceLocation.toJsonValue());
+	return pushStreamedMessage(DEVICE_UPDATE_LOCATION_TOPIC, [&deviceLocation](IOTP_JsonWriter& writer) {
+		deviceLocation.write(writer);
+	});
 //		if (this->subscribeCommandHandler(SERVER_RESPONSE_TOPIC, mResponseHandler)) {
 //			std::string reqId = send_message(DEVICE_UPDATE_LOCATION_TOPIC, deviceLocation.toJsonValue());
 //			if (!reqId.empty()) {
@@ -243,9 +318,9 @@ bool IOTP_DeviceClient::update_device_location(IOTP_DeviceLocation& deviceLocati
  * @return bool
  */
 bool IOTP_DeviceClient::addErrorCodes(int num) {
-	Json::Value jsonPayload;
-	jsonPayload["errorCode"] = num;
-	return pushManageMessage(DEVICE_ADD_ERROR_CODES_TOPIC, jsonPayload);
+	return pushStreamedMessage(DEVICE_ADD_ERROR_CODES_TOPIC, [num](IOTP_JsonWriter& writer) {
+		writer.beginObject().member("errorCode", num).endObject();
+	});
 }
 
 /**
@@ -262,7 +337,9 @@ bool IOTP_DeviceClient::clearErrorCodes() {
  * @return bool
  */
 bool IOTP_DeviceClient::addLogs(IOTP_DeviceLog& deviceLog) {
-	return pushManageMessage(DEVICE_ADD_DIAG_LOG_TOPIC, deviceLog.toJsonValue());
+	return pushStreamedMessage(DEVICE_ADD_DIAG_LOG_TOPIC, [&deviceLog](IOTP_JsonWriter& writer) {
+		deviceLog.write(writer);
+	});
 }
 
 /**
@@ -315,8 +392,7 @@ bool IOTP_DeviceClient::InitializeMqttClient() {
 		logger.debug("serverURI: " + mServerURI);
 		logger.debug("clientId: " + mClientID);
 
-		pasync_client = new mqtt::async_client(mServerURI, mClientID);
-		logger.debug("Underlying async_client created...");
+		pasync_client = CreateAsyncClient(mClientID);
 	}
 
 	logger.debug(methodName+" Exit: ");
@@ -94,10 +94,45 @@ public:
 	* @param eventFormat - Format of the event e.g json
 	* @param data - Payload of the event
 	* @param QoS - qos for the publish event. Supported values : 0, 1, 2
-	* @param iaction_listener& cb - call back function for action listner
+	* @param iaction_listener& cb - call back function for action listner. It is called for
+	* every event: on_success for one the deadband filter suppresses, on_failure with
+	* MQTTASYNC_DROPPED for one the rate limit drops, and with MQTTASYNC_SUPERSEDED for one
+	* it holds and then replaces with a later event; a held event is published with it.
 	* @return void
 	*/
 	void publishEvent(char *eventType, char *eventFormat, const char* data, int qos,  mqtt::iaction_listener& cb);
+	/**
+	* Function used to Publish events from the device to the IBM Watson IoT service. When a
+	* spool directory is configured, events published while offline are spooled and the
+	* priority decides which events the lowest-priority drop policy discards first. Events
+	* over the rate limit of their type wait, are dropped, or replace the one held back
+	* before them, as the rateLimitPolicy setting says. JSON events whose fields listed in
+	* deadbandEvents all stayed within their deadbands are not published. With compression
+	* set, events of at least compressionThreshold bytes are compressed on the compression
+	* thread and their codec added to the fmt/ segment.
+	* @param eventType - Type of event to be published e.g status, gps
+	* @param eventFormat - Format of the event e.g json
+	* @param data - Payload of the event
+	* @param QoS - qos for the publish event. Supported values : 0, 1, 2
+	* @param priority - spool priority of the event, 0 (lowest) to 255
+	* @return bool - false if the event was dropped by the spool or the rate limit
+	*/
+	bool publishEvent(char *eventType, char *eventFormat, const char* data, int qos, int priority);
+
+	/**
+	* Function used to Publish events from the device to the IBM Watson IoT service, encoded
+	* in the given format, whose name is the fmt/ segment of the topic: json, or the smaller
+	* binary cbor or msgpack. Events go through the spool, deadband filter and rate limit
+	* as others do.
+	* @param eventType - Type of event to be published e.g status, gps
+	* @param data - the event
+	* @param format - the encoding of the payload
+	* @param QoS - qos for the publish event. Supported values : 0, 1, 2
+	* @param priority - spool priority of the event, 0 (lowest) to 255
+	* @return bool - false if the event was dropped by the spool or the rate limit
+	*/
+	bool publishEvent(char *eventType, const Json::Value& data, IOTP_Encoding::Format format, int qos,
+			int priority = 0);
 
 	/**
 	 * Function used to subscribe commands from the IBM Watson IoT service
@@ -150,6 +185,8 @@ private:
 	iotp_device_attribute_handler_ptr mDevAttributeHandler;
 	iotf_device_data_ptr mDeviceData;
 	bool InitializeMqttClient();
+	bool publishPayload(const std::string& eventType, const std::string& eventFormat, const std::string& payload,
+			int qos, int priority);
 	static std::string commandTopic;
 
 };
@@ -13,6 +13,8 @@
  * Contributors:
  *    Mike Tran - initial API and implementation and/or initial documentation
  *    Lokesh Haralakatta - Updates to match with latest mqtt lib changes
+ *    Read firmware requests without parsing the whole request
+ *    Build the firmware info json from a description of its fields
  *******************************************************************************/
 
 #include <iostream>
@@ -24,6 +26,7 @@
 #include "IOTP_Client.h"
 #include "IOTP_DeviceFirmwareHandler.h"
 #include "IOTP_ReplyMessage.h"
+#include "IOTP_JsonScanner.h"
 #include "mqtt/message.h"
 #include "json/json.h"
 #include "IOTP_TopicDefinitions.h"
@@ -50,7 +53,6 @@ namespace Watson_IOTP {
 						mState(FIRMWARE_INFO_STATE_IDLE),
 						mUpdateStatus(-1),
 						mUpdatedDateTime(-1) {
-		setJsonValue();
 	}
 
 	IOTP_FirmwareInfo::IOTP_FirmwareInfo(const char* name,
@@ -67,7 +69,6 @@ namespace Watson_IOTP {
 					mState(state),
 					mUpdateStatus(updateStatus),
 					mUpdatedDateTime(updatedDateTime) {
-		setJsonValue();
 	}
 
 	void IOTP_FirmwareInfo::set_name(const std::string name) {
@@ -84,41 +85,18 @@ namespace Watson_IOTP {
 	}
 	void IOTP_FirmwareInfo::set_state(int state) {
 		mState = state;
-		setJsonValue();
 	}
 	void IOTP_FirmwareInfo::set_update_status(int updateStatus) {
 		mUpdateStatus = updateStatus;
-		setJsonValue();
 	}
 	void IOTP_FirmwareInfo::set_updated_date_time(time_t updatedDateTime) {
 		mUpdatedDateTime = updatedDateTime;
-		setJsonValue();
 	}
 
-	const Json::Value& IOTP_FirmwareInfo::toJsonValue() const {
-			return json;
+	Json::Value IOTP_FirmwareInfo::toJsonValue() const {
+		return IOTP_Fields::toJsonValue(*this);
 	}
 
-	void IOTP_FirmwareInfo::setJsonValue() {
-			char updatedDateTimeBuf[sizeof "YYYY-MM-DDTHH:MM:SSZ"];
-			if (!mName.empty())
-				json["name"] = mName;
-			if (!mVersion.empty())
-				json["version"] = mVersion;
-			if (!mURI.empty())
-				json["url"] = mURI;
-			if (!mVerifier.empty())
-				json["verifier"] = mVerifier;
-			json["state"] = mState;
-			if (mUpdateStatus != -1) {
-				json["updateStatus"] = mUpdateStatus;
-			}
-			if (mUpdatedDateTime != -1) {
-				strftime(updatedDateTimeBuf, sizeof updatedDateTimeBuf, "%FT%TZ", gmtime(&mUpdatedDateTime));
-				json["updatedDateTime"] = updatedDateTimeBuf;
-			}
-		}
-
 	/**
 	 * DeviceFirmwareHandler is an abstract class.
 	 *
@@ -171,9 +149,6 @@ namespace Watson_IOTP {
 	}
 
 	iotp_reply_message_ptr IOTP_DeviceFirmwareHandler::message_arrived(const std::string& topic, Json::Value& jsonPayload) {
-		iotp_reply_message_ptr replyPtr = nullptr;
-		iotp_firmware_action_response_ptr rsp;
-
 		iotp_firmware_info_ptr p = std::make_shared<IOTP_FirmwareInfo>(fwinfo);
 
 		if (topic == SERVER_UPDATE_TOPIC) {
@@ -211,7 +186,28 @@ namespace Watson_IOTP {
 				p->set_uri(value.get("uri", "").asString());
 				p->set_verifier(value.get("verifier", "").asString());
 			}
+		}
+		return respond(topic, p, jsonPayload.get("reqId", "").asString());
+	}
 
+	iotp_reply_message_ptr IOTP_DeviceFirmwareHandler::message_arrived(const std::string& topic, const IOTP_JsonDocument& payload,
+			mqtt::const_message_ptr msg) {
+		iotp_firmware_info_ptr p = std::make_shared<IOTP_FirmwareInfo>(fwinfo);
+
+		if (topic == SERVER_UPDATE_TOPIC && payload.getString("d/fields/0/field") == "mgmt.firmware") {
+			p->set_version(payload.getString("d/fields/0/value/version"));
+			p->set_name(payload.getString("d/fields/0/value/name"));
+			p->set_uri(payload.getString("d/fields/0/value/uri"));
+			p->set_verifier(payload.getString("d/fields/0/value/verifier"));
+		}
+		return respond(topic, p, payload.getString("reqId"));
+	}
+
+	iotp_reply_message_ptr IOTP_DeviceFirmwareHandler::respond(const std::string& topic, iotp_firmware_info_ptr p, const std::string& reqId) {
+		iotp_reply_message_ptr replyPtr = nullptr;
+		iotp_firmware_action_response_ptr rsp;
+
+		if (topic == SERVER_UPDATE_TOPIC) {
 			// Call the derived class to perform version check.
 			rsp = verify(p);
 
@@ -265,7 +261,7 @@ namespace Watson_IOTP {
 		payload["rc"] = rsp->get_rc();
 		if (rsp->get_message().empty() == false)
 			payload["message"] = rsp->get_message();
-		payload["reqId"] = jsonPayload.get("reqId", "").asString();
+		payload["reqId"] = reqId;
 
 		IOTP_ReplyMessage reply(DEVICE_REPONSE_TOPIC, payload);
 		replyPtr = std::make_shared<IOTP_ReplyMessage>(reply);
@@ -274,10 +270,9 @@ namespace Watson_IOTP {
 
 	iotp_reply_message_ptr IOTP_DeviceFirmwareHandler::message_arrived(const std::string& topic, mqtt::const_message_ptr msg) {
 		Json::Value jsonPayload;
-		Json::Reader reader;
 		iotp_reply_message_ptr replyPtr = nullptr;
 
-		if (reader.parse(msg->get_payload(), jsonPayload)) {
+		if (IOTP_JsonScanner::parse(msg->get_payload(), jsonPayload)) {
 			replyPtr = message_arrived(topic, jsonPayload);
 		} else {
 			std::cout << typeid(*this).name() << " Message arrived at TOPIC " << topic << " is not a JSON string." << std::endl;
@@ -13,6 +13,7 @@
  * Contributors:
  *    Mike Tran - initial API and implementation and/or initial documentation
  *    Lokesh Haralakatta - Updates to match with latest mqtt lib changes
+ *    Build the firmware info json from a description of its fields
  *******************************************************************************/
 
 #ifndef DEVICEFIRMWAREHANDLER_H_
@@ -20,6 +21,7 @@
 
 #include <thread>
 #include "IOTP_MessageHandler.h"
+#include "IOTP_Fields.h"
 #include "json/json.h"
 
 namespace Watson_IOTP {
@@ -75,10 +77,21 @@ public:
 	const int get_update_status() {return mUpdateStatus;}
 	void set_updated_date_time(time_t updatedDateTime);
 	const time_t get_updated_date_time() {return mUpdatedDateTime;}
-	const Json::Value& toJsonValue() const;
+	Json::Value toJsonValue() const;
 
 private:
-	void setJsonValue();
+	friend class IOTP_Fields;
+	template <typename Self, typename Visit>
+	static void fields(Self& self, Visit& visit) {
+		visit("name", self.mName, IOTP_Fields::OPTIONAL);
+		visit("state", self.mState);
+		visit("updateStatus", self.mUpdateStatus, IOTP_Fields::OPTIONAL);
+		visit("updatedDateTime", IOTP_Fields::time(self.mUpdatedDateTime), IOTP_Fields::OPTIONAL);
+		visit("url", self.mURI, IOTP_Fields::OPTIONAL);
+		visit("verifier", self.mVerifier, IOTP_Fields::OPTIONAL);
+		visit("version", self.mVersion, IOTP_Fields::OPTIONAL);
+	}
+
 	std::string mName;
 	std::string mVersion;
 	std::string mURI;
@@ -86,7 +99,6 @@ private:
 	int mState;
 	int mUpdateStatus;
 	time_t mUpdatedDateTime;
-	Json::Value json;
 };
 
 typedef IOTP_FirmwareInfo::ptr_t iotp_firmware_info_ptr;
@@ -123,6 +135,8 @@ public:
 	virtual ~IOTP_DeviceFirmwareHandler();
 	iotp_reply_message_ptr message_arrived(const std::string& topic, Json::Value& jsonPayload);
 	iotp_reply_message_ptr message_arrived(const std::string& topic, mqtt::const_message_ptr msg);
+	iotp_reply_message_ptr message_arrived(const std::string& topic, const IOTP_JsonDocument& payload,
+			mqtt::const_message_ptr msg);
 
 	/**
 	 * The device is to validate that the firmware differs from the current installed firmware.
@@ -183,6 +197,7 @@ private:
 	std::thread mUpdateProgress;
 	void check_download_progress();
 	void check_update_progress();
+	iotp_reply_message_ptr respond(const std::string& topic, iotp_firmware_info_ptr p, const std::string& reqId);
 
 };
 typedef IOTP_DeviceFirmwareHandler::ptr_t iotp_device_firmware_handler_ptr;
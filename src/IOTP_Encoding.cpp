@@ -0,0 +1,675 @@
+/*******************************************************************************
+ * Copyright (c) 2017 IBM Corp.
+ *
+ * All rights reserved. This program and the accompanying materials
+ * are made available under the terms of the Eclipse Public License v1.0
+ * and Eclipse Distribution License v1.0 which accompany this distribution.
+ *
+ * The Eclipse Public License is available at
+ *    http://www.eclipse.org/legal/epl-v10.html
+ * and the Eclipse Distribution License is available at
+ *   http://www.eclipse.org/org/documents/edl-v10.php.
+ *
+ * Contributors:
+ *    CBOR and MessagePack encodings of events and commands
+ *******************************************************************************/
+
+#include "IOTP_Encoding.h"
+#include "IOTP_JsonScanner.h"
+
+#include <stdint.h>
+#include <cmath>
+#include <cstring>
+
+namespace Watson_IOTP {
+
+namespace {
+
+// nesting deeper than this is refused, as the json reader does
+const int MAX_DEPTH = 1000;
+
+void putBigEndian(std::string& out, uint64_t value, int bytes) {
+	char buffer[8];
+	for (int i = bytes - 1; i >= 0; --i) {
+		buffer[i] = (char)(value & 0xff);
+		value >>= 8;
+	}
+	out.append(buffer, bytes);
+}
+
+uint64_t getBigEndian(const unsigned char* p, int bytes) {
+	uint64_t value = 0;
+	for (int i = 0; i < bytes; ++i)
+		value = (value << 8) | p[i];
+	return value;
+}
+
+bool isFloat(double value) {
+	return (double)(float)value == value || std::isnan(value);
+}
+
+uint32_t floatBits(double value) {
+	float f = (float)value;
+	uint32_t bits;
+	memcpy(&bits, &f, sizeof(bits));
+	return bits;
+}
+
+uint64_t doubleBits(double value) {
+	uint64_t bits;
+	memcpy(&bits, &value, sizeof(bits));
+	return bits;
+}
+
+double fromFloatBits(uint32_t bits) {
+	float f;
+	memcpy(&f, &bits, sizeof(f));
+	return f;
+}
+
+double fromDoubleBits(uint64_t bits) {
+	double d;
+	memcpy(&d, &bits, sizeof(d));
+	return d;
+}
+
+double fromHalfBits(unsigned int half) {
+	int exponent = (half >> 10) & 0x1f, mantissa = half & 0x3ff;
+	double value;
+	if (exponent == 0)
+		value = std::ldexp(mantissa, -24);
+	else if (exponent != 31)
+		value = std::ldexp(mantissa + 1024, exponent - 25);
+	else
+		value = (mantissa == 0) ? INFINITY : NAN;
+	return (half & 0x8000) ? -value : value;
+}
+
+// Integers that fit a signed 64 bit value come out as int values, as the json reader's do
+Json::Value fromUnsigned(uint64_t value) {
+	if (value <= (uint64_t)Json::Value::maxLargestInt)
+		return Json::Value((Json::LargestInt)value);
+	return Json::Value((Json::LargestUInt)value);
+}
+
+/* CBOR */
+
+void cborHead(std::string& out, int major, uint64_t value) {
+	unsigned char type = (unsigned char)(major << 5);
+	if (value < 24)
+		out += (char)(type | value);
+	else if (value <= 0xff) {
+		out += (char)(type | 24);
+		putBigEndian(out, value, 1);
+	}
+	else if (value <= 0xffff) {
+		out += (char)(type | 25);
+		putBigEndian(out, value, 2);
+	}
+	else if (value <= 0xffffffffULL) {
+		out += (char)(type | 26);
+		putBigEndian(out, value, 4);
+	}
+	else {
+		out += (char)(type | 27);
+		putBigEndian(out, value, 8);
+	}
+}
+
+void cborEncode(const Json::Value& value, std::string& out) {
+	switch (value.type()) {
+	case Json::nullValue:
+		out += (char)0xf6;
+		break;
+	case Json::booleanValue:
+		out += (char)(value.asBool() ? 0xf5 : 0xf4);
+		break;
+	case Json::intValue: {
+		Json::LargestInt i = value.asLargestInt();
+		if (i >= 0)
+			cborHead(out, 0, (uint64_t)i);
+		else
+			cborHead(out, 1, (uint64_t)(-(i + 1)));
+		break;
+	}
+	case Json::uintValue:
+		cborHead(out, 0, value.asLargestUInt());
+		break;
+	case Json::realValue: {
+		double d = value.asDouble();
+		if (isFloat(d)) {
+			out += (char)0xfa;
+			putBigEndian(out, floatBits(d), 4);
+		}
+		else {
+			out += (char)0xfb;
+			putBigEndian(out, doubleBits(d), 8);
+		}
+		break;
+	}
+	case Json::stringValue: {
+		const char* begin;
+		const char* end;
+		value.getString(&begin, &end);
+		cborHead(out, 3, end - begin);
+		out.append(begin, end - begin);
+		break;
+	}
+	case Json::arrayValue:
+		cborHead(out, 4, value.size());
+		for (Json::ArrayIndex i = 0; i < value.size(); ++i)
+			cborEncode(value[i], out);
+		break;
+	case Json::objectValue:
+		cborHead(out, 5, value.size());
+		for (Json::Value::const_iterator it = value.begin(); it != value.end(); ++it) {
+			const char* end;
+			const char* name = it.memberName(&end);
+			cborHead(out, 3, end - name);
+			out.append(name, end - name);
+			cborEncode(*it, out);
+		}
+		break;
+	}
+}
+
+class CborReader {
+public:
+	CborReader(const char* data, size_t length) :
+		p((const unsigned char*)data), end((const unsigned char*)data + length) {}
+
+	bool read(Json::Value& value) {
+		return item(value, 0) && p == end;
+	}
+
+private:
+	static const int INDEFINITE = 31;
+
+	// the argument of the head just read: its value, a length or count, none if indefinite
+	bool argument(int info, uint64_t& n) {
+		if (info < 24 || info == INDEFINITE) {
+			n = (info < 24) ? info : 0;
+			return true;
+		}
+		if (info > 27)
+			return false;
+		int bytes = 1 << (info - 24);
+		if (end - p < bytes)
+			return false;
+		n = getBigEndian(p, bytes);
+		p += bytes;
+		return true;
+	}
+
+	bool head(int& major, uint64_t& n, int& info) {
+		if (p == end)
+			return false;
+		major = *p >> 5;
+		info = *p++ & 0x1f;
+		if (major == 7)
+			return true;
+		return argument(info, n);
+	}
+
+	bool breakNext() {
+		if (p < end && *p == 0xff) {
+			++p;
+			return true;
+		}
+		return false;
+	}
+
+	// a text or byte string, which may be in chunks
+	bool string(int major, uint64_t n, int info, std::string& s) {
+		if (info != INDEFINITE) {
+			if ((uint64_t)(end - p) < n)
+				return false;
+			s.append((const char*)p, (size_t)n);
+			p += n;
+			return true;
+		}
+		while (!breakNext()) {
+			int chunkMajor, chunkInfo;
+			uint64_t length;
+			if (!head(chunkMajor, length, chunkInfo) || chunkMajor != major || chunkInfo == INDEFINITE ||
+					!string(major, length, chunkInfo, s))
+				return false;
+		}
+		return true;
+	}
+
+	bool item(Json::Value& value, int depth) {
+		int major, info;
+		uint64_t n = 0;
+		if (depth > MAX_DEPTH || !head(major, n, info))
+			return false;
+		bool indefinite = (info == INDEFINITE);
+		if (indefinite && (major < 2 || major == 6))
+			return false;
+
+		switch (major) {
+		case 0:
+			value = fromUnsigned(n);
+			return true;
+		case 1:
+			if (n <= (uint64_t)Json::Value::maxLargestInt)
+				value = Json::Value(-1 - (Json::LargestInt)n);
+			else
+				value = Json::Value(-1.0 - (double)n);
+			return true;
+		case 2:
+		case 3: {
+			if (!indefinite && (uint64_t)(end - p) >= n) {
+				value = Json::Value((const char*)p, (const char*)p + n);
+				p += n;
+				return true;
+			}
+			std::string s;
+			if (!string(major, n, info, s))
+				return false;
+			value = Json::Value(s);
+			return true;
+		}
+		case 4:
+			value = Json::Value(Json::arrayValue);
+			// every item takes at least a byte, so a count beyond the data is malformed
+			if (!indefinite && n > (uint64_t)(end - p))
+				return false;
+			for (uint64_t i = 0; indefinite ? !breakNext() : i < n; ++i)
+				if (!item(value.append(Json::Value()), depth + 1))
+					return false;
+			return true;
+		case 5:
+			value = Json::Value(Json::objectValue);
+			if (!indefinite && n > (uint64_t)(end - p) / 2)
+				return false;
+			for (uint64_t i = 0; indefinite ? !breakNext() : i < n; ++i) {
+				int keyMajor, keyInfo;
+				uint64_t length;
+				std::string key;
+				if (!head(keyMajor, length, keyInfo) || (keyMajor != 2 && keyMajor != 3) ||
+						!string(keyMajor, length, keyInfo, key) || !item(value[key], depth + 1))
+					return false;
+			}
+			return true;
+		case 6:
+			return item(value, depth + 1);		// the tag is dropped
+		default:
+			return simple(value, info);
+		}
+	}
+
+	bool simple(Json::Value& value, int info) {
+		int bytes = (info == 25) ? 2 : (info == 26) ? 4 : (info == 27) ? 8 : 0;
+		if (end - p < bytes)
+			return false;
+		switch (info) {
+		case 20:
+			value = Json::Value(false);
+			return true;
+		case 21:
+			value = Json::Value(true);
+			return true;
+		case 22:
+		case 23:
+			value = Json::Value();
+			return true;
+		case 25:
+			value = Json::Value(fromHalfBits((unsigned int)getBigEndian(p, 2)));
+			break;
+		case 26:
+			value = Json::Value(fromFloatBits((uint32_t)getBigEndian(p, 4)));
+			break;
+		case 27:
+			value = Json::Value(fromDoubleBits(getBigEndian(p, 8)));
+			break;
+		default:
+			return false;
+		}
+		p += bytes;
+		return true;
+	}
+
+	const unsigned char* p;
+	const unsigned char* end;
+};
+
+/* MessagePack */
+
+void msgpackLength(std::string& out, uint64_t length, unsigned char fix, unsigned char fixMax,
+		unsigned char code8, unsigned char code16) {
+	if (length <= (uint64_t)(fixMax - fix))
+		out += (char)(fix | length);
+	else if (code8 != 0 && length <= 0xff) {
+		out += (char)code8;
+		putBigEndian(out, length, 1);
+	}
+	else if (length <= 0xffff) {
+		out += (char)code16;
+		putBigEndian(out, length, 2);
+	}
+	else {
+		out += (char)(code16 + 1);
+		putBigEndian(out, length, 4);
+	}
+}
+
+void msgpackUnsigned(std::string& out, uint64_t value) {
+	if (value < 0x80)
+		out += (char)value;
+	else if (value <= 0xff) {
+		out += (char)0xcc;
+		putBigEndian(out, value, 1);
+	}
+	else if (value <= 0xffff) {
+		out += (char)0xcd;
+		putBigEndian(out, value, 2);
+	}
+	else if (value <= 0xffffffffULL) {
+		out += (char)0xce;
+		putBigEndian(out, value, 4);
+	}
+	else {
+		out += (char)0xcf;
+		putBigEndian(out, value, 8);
+	}
+}
+
+void msgpackEncode(const Json::Value& value, std::string& out) {
+	switch (value.type()) {
+	case Json::nullValue:
+		out += (char)0xc0;
+		break;
+	case Json::booleanValue:
+		out += (char)(value.asBool() ? 0xc3 : 0xc2);
+		break;
+	case Json::intValue: {
+		Json::LargestInt i = value.asLargestInt();
+		if (i >= 0)
+			msgpackUnsigned(out, (uint64_t)i);
+		else if (i >= -32)
+			out += (char)(i & 0xff);
+		else if (i >= -128) {
+			out += (char)0xd0;
+			putBigEndian(out, (uint64_t)i, 1);
+		}
+		else if (i >= -32768) {
+			out += (char)0xd1;
+			putBigEndian(out, (uint64_t)i, 2);
+		}
+		else if (i >= INT32_MIN) {
+			out += (char)0xd2;
+			putBigEndian(out, (uint64_t)i, 4);
+		}
+		else {
+			out += (char)0xd3;
+			putBigEndian(out, (uint64_t)i, 8);
+		}
+		break;
+	}
+	case Json::uintValue:
+		msgpackUnsigned(out, value.asLargestUInt());
+		break;
+	case Json::realValue: {
+		double d = value.asDouble();
+		if (isFloat(d)) {
+			out += (char)0xca;
+			putBigEndian(out, floatBits(d), 4);
+		}
+		else {
+			out += (char)0xcb;
+			putBigEndian(out, doubleBits(d), 8);
+		}
+		break;
+	}
+	case Json::stringValue: {
+		const char* begin;
+		const char* end;
+		value.getString(&begin, &end);
+		msgpackLength(out, end - begin, 0xa0, 0xbf, 0xd9, 0xda);
+		out.append(begin, end - begin);
+		break;
+	}
+	case Json::arrayValue:
+		msgpackLength(out, value.size(), 0x90, 0x9f, 0, 0xdc);
+		for (Json::ArrayIndex i = 0; i < value.size(); ++i)
+			msgpackEncode(value[i], out);
+		break;
+	case Json::objectValue:
+		msgpackLength(out, value.size(), 0x80, 0x8f, 0, 0xde);
+		for (Json::Value::const_iterator it = value.begin(); it != value.end(); ++it) {
+			const char* end;
+			const char* name = it.memberName(&end);
+			msgpackLength(out, end - name, 0xa0, 0xbf, 0xd9, 0xda);
+			out.append(name, end - name);
+			msgpackEncode(*it, out);
+		}
+		break;
+	}
+}
+
+class MsgpackReader {
+public:
+	MsgpackReader(const char* data, size_t length) :
+		p((const unsigned char*)data), end((const unsigned char*)data + length) {}
+
+	bool read(Json::Value& value) {
+		return item(value, 0) && p == end;
+	}
+
+private:
+	bool take(int bytes, uint64_t& n) {
+		if (end - p < bytes)
+			return false;
+		n = getBigEndian(p, bytes);
+		p += bytes;
+		return true;
+	}
+
+	bool bytes(uint64_t length, const char*& begin) {
+		if ((uint64_t)(end - p) < length)
+			return false;
+		begin = (const char*)p;
+		p += length;
+		return true;
+	}
+
+	// the length of a string or byte array, false if the code is not one
+	bool stringLength(unsigned char code, uint64_t& length) {
+		if (code >= 0xa0 && code <= 0xbf) {
+			length = code & 0x1f;
+			return true;
+		}
+		switch (code) {
+		case 0xc4: case 0xd9: return take(1, length);
+		case 0xc5: case 0xda: return take(2, length);
+		case 0xc6: case 0xdb: return take(4, length);
+		default: return false;
+		}
+	}
+
+	bool array(Json::Value& value, uint64_t count, int depth) {
+		value = Json::Value(Json::arrayValue);
+		if (count > (uint64_t)(end - p))
+			return false;
+		for (uint64_t i = 0; i < count; ++i)
+			if (!item(value.append(Json::Value()), depth + 1))
+				return false;
+		return true;
+	}
+
+	bool map(Json::Value& value, uint64_t count, int depth) {
+		value = Json::Value(Json::objectValue);
+		if (count > (uint64_t)(end - p) / 2)
+			return false;
+		for (uint64_t i = 0; i < count; ++i) {
+			uint64_t length;
+			const char* key;
+			if (p == end || !stringLength(*p++, length) || !bytes(length, key) ||
+					!item(value[std::string(key, (size_t)length)], depth + 1))
+				return false;
+		}
+		return true;
+	}
+
+	bool item(Json::Value& value, int depth) {
+		if (depth > MAX_DEPTH || p == end)
+			return false;
+		unsigned char code = *p++;
+		uint64_t n;
+		const char* begin;
+
+		if (code < 0x80) {
+			value = Json::Value((Json::LargestInt)code);
+			return true;
+		}
+		if (code >= 0xe0) {
+			value = Json::Value((Json::LargestInt)(signed char)code);
+			return true;
+		}
+		if (code <= 0x8f)
+			return map(value, code & 0x0f, depth);
+		if (code <= 0x9f)
+			return array(value, code & 0x0f, depth);
+		if (code <= 0xbf || code == 0xc4 || code == 0xc5 || code == 0xc6 || (code >= 0xd9 && code <= 0xdb)) {
+			if (!stringLength(code, n) || !bytes(n, begin))
+				return false;
+			value = Json::Value(begin, begin + n);
+			return true;
+		}
+
+		switch (code) {
+		case 0xc0:
+			value = Json::Value();
+			return true;
+		case 0xc2:
+			value = Json::Value(false);
+			return true;
+		case 0xc3:
+			value = Json::Value(true);
+			return true;
+		case 0xca:
+			if (!take(4, n))
+				return false;
+			value = Json::Value(fromFloatBits((uint32_t)n));
+			return true;
+		case 0xcb:
+			if (!take(8, n))
+				return false;
+			value = Json::Value(fromDoubleBits(n));
+			return true;
+		case 0xcc: case 0xcd: case 0xce: case 0xcf:
+			if (!take(1 << (code - 0xcc), n))
+				return false;
+			value = fromUnsigned(n);
+			return true;
+		case 0xd0:
+			if (!take(1, n))
+				return false;
+			value = Json::Value((Json::LargestInt)(int8_t)n);
+			return true;
+		case 0xd1:
+			if (!take(2, n))
+				return false;
+			value = Json::Value((Json::LargestInt)(int16_t)n);
+			return true;
+		case 0xd2:
+			if (!take(4, n))
+				return false;
+			value = Json::Value((Json::LargestInt)(int32_t)n);
+			return true;
+		case 0xd3:
+			if (!take(8, n))
+				return false;
+			value = Json::Value((Json::LargestInt)(int64_t)n);
+			return true;
+		case 0xdc:
+			return take(2, n) && array(value, n, depth);
+		case 0xdd:
+			return take(4, n) && array(value, n, depth);
+		case 0xde:
+			return take(2, n) && map(value, n, depth);
+		case 0xdf:
+			return take(4, n) && map(value, n, depth);
+		default:
+			return false;		// extension types have no Json::Value
+		}
+	}
+
+	const unsigned char* p;
+	const unsigned char* end;
+};
+
+} /* namespace */
+
+IOTP_Encoding::Format IOTP_Encoding::toFormat(const std::string& fmt) {
+	if (fmt == "json")
+		return JSON;
+	if (fmt == "cbor")
+		return CBOR;
+	if (fmt == "msgpack")
+		return MSGPACK;
+	return UNKNOWN;
+}
+
+const char* IOTP_Encoding::toName(Format format) {
+	switch (format) {
+	case JSON: return "json";
+	case CBOR: return "cbor";
+	case MSGPACK: return "msgpack";
+	default: return "";
+	}
+}
+
+IOTP_Encoding::Format IOTP_Encoding::topicFormat(const std::string& topic) {
+	size_t fmt = topic.rfind("/fmt/");
+	if (fmt == std::string::npos)
+		return UNKNOWN;
+	fmt += 5;
+	return toFormat(topic.substr(fmt, topic.find('/', fmt) - fmt));
+}
+
+void IOTP_Encoding::encode(const Json::Value& value, Format format, std::string& out) {
+	switch (format) {
+	case CBOR:
+		cborEncode(value, out);
+		break;
+	case MSGPACK:
+		msgpackEncode(value, out);
+		break;
+	default: {
+		Json::FastWriter fastWriter;
+		out += fastWriter.write(value);
+		break;
+	}
+	}
+}
+
+std::string IOTP_Encoding::encode(const Json::Value& value, Format format) {
+	std::string out;
+	encode(value, format, out);
+	return out;
+}
+
+bool IOTP_Encoding::decode(const char* data, size_t length, Format format, Json::Value& value) {
+	switch (format) {
+	case JSON:
+		return IOTP_JsonScanner::parse(data, length, value);
+	case CBOR: {
+		CborReader reader(data, length);
+		return reader.read(value);
+	}
+	case MSGPACK: {
+		MsgpackReader reader(data, length);
+		return reader.read(value);
+	}
+	default:
+		return false;
+	}
+}
+
+bool IOTP_Encoding::decode(const std::string& data, Format format, Json::Value& value) {
+	return decode(data.data(), data.size(), format, value);
+}
+
+} /* namespace Watson_IOTP */
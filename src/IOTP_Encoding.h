@@ -0,0 +1,66 @@
+/*******************************************************************************
+ * Copyright (c) 2017 IBM Corp.
+ *
+ * All rights reserved. This program and the accompanying materials
+ * are made available under the terms of the Eclipse Public License v1.0
+ * and Eclipse Distribution License v1.0 which accompany this distribution.
+ *
+ * The Eclipse Public License is available at
+ *    http://www.eclipse.org/legal/epl-v10.html
+ * and the Eclipse Distribution License is available at
+ *   http://www.eclipse.org/org/documents/edl-v10.php.
+ *
+ * Contributors:
+ *    CBOR and MessagePack encodings of events and commands
+ *******************************************************************************/
+
+#ifndef IOTP_ENCODING_H_
+#define IOTP_ENCODING_H_
+
+#include <stddef.h>
+#include <string>
+#include "json/json.h"
+
+namespace Watson_IOTP {
+
+/**
+ * Encodings of a Json::Value for the payload of an event or command, named by the fmt/
+ * segment of its topic: json text, or the binary CBOR (RFC 7049) and MessagePack encodings,
+ * which are smaller for numeric telemetry and cheaper to produce and parse.
+ *
+ * Integers are encoded in the fewest bytes their value needs, reals as single precision
+ * floats when that holds them exactly and as doubles otherwise. Decoding gives the same
+ * value types the json reader does: byte strings decode as strings, tags are skipped.
+ */
+class IOTP_Encoding {
+public:
+	enum Format { JSON, CBOR, MSGPACK, UNKNOWN };
+
+	/** The format of a fmt/ segment: "json", "cbor" or "msgpack" */
+	static Format toFormat(const std::string& fmt);
+
+	/** The fmt/ segment of a format */
+	static const char* toName(Format format);
+
+	/** The format of the fmt/ segment of an event or command topic */
+	static Format topicFormat(const std::string& topic);
+
+	/**
+	 * Encode a value, appending it to a buffer.
+	 */
+	static void encode(const Json::Value& value, Format format, std::string& out);
+
+	static std::string encode(const Json::Value& value, Format format);
+
+	/**
+	 * Decode a payload.
+	 * @return false if the payload is not a whole, well formed value of the format
+	 */
+	static bool decode(const char* data, size_t length, Format format, Json::Value& value);
+
+	static bool decode(const std::string& data, Format format, Json::Value& value);
+};
+
+} /* namespace Watson_IOTP */
+
+#endif /* IOTP_ENCODING_H_ */
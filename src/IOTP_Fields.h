@@ -0,0 +1,243 @@
+/*******************************************************************************
+ * Copyright (c) 2017 IBM Corp.
+ *
+ * All rights reserved. This program and the accompanying materials
+ * are made available under the terms of the Eclipse Public License v1.0
+ * and Eclipse Distribution License v1.0 which accompany this distribution.
+ *
+ * The Eclipse Public License is available at
+ *    http://www.eclipse.org/legal/epl-v10.html
+ * and the Eclipse Distribution License is available at
+ *   http://www.eclipse.org/org/documents/edl-v10.php.
+ *
+ * Contributors:
+ *    Field descriptions of the device model types
+ *******************************************************************************/
+
+#ifndef IOTP_FIELDS_H_
+#define IOTP_FIELDS_H_
+
+#include <stddef.h>
+#include <ctime>
+#include <cstring>
+#include <string>
+#include "IOTP_JsonWriter.h"
+#include "IOTP_PayloadTemplate.h"
+#include "json/json.h"
+
+namespace Watson_IOTP {
+
+/**
+ * Writes and reads the device model types from a description of their fields, rather than
+ * from a Json::Value each object keeps up to date. A type lists its fields once, in a static
+ * template that is handed a visitor, and makes IOTP_Fields its friend:
+ *
+ *   friend class IOTP_Fields;
+ *   template <typename Self, typename Visit>
+ *   static void fields(Self& self, Visit& visit) {
+ *       visit("accuracy", self.mAccuracy);
+ *       visit("description", self.mDescription, IOTP_Fields::OPTIONAL);
+ *       visit("measuredDateTime", IOTP_Fields::time(self.measuredDateTime));
+ *   }
+ *
+ * The fields are listed in the order of their names, the order Json::Value keeps its members
+ * in, so that writing one gives the text its Json::Value used to. The visitors overload their
+ * call on the type of the field, so the description compiles into the member() calls, the
+ * assignments or the reads of each field, with no table looked up while it runs.
+ *
+ * An OPTIONAL field is left out when it is an empty string, or -1 for a number or a time.
+ * A time is a time_t written "2017-03-01T10:15:30Z".
+ */
+class IOTP_Fields {
+public:
+	enum { REQUIRED = 0, OPTIONAL = 1 };
+
+	template <typename T>
+	struct Time {
+		T& seconds;
+	};
+
+	template <typename T>
+	static Time<T> time(T& seconds) {
+		Time<T> field = { seconds };
+		return field;
+	}
+
+	/** Write an object as a json object */
+	template <typename T>
+	static void write(IOTP_JsonWriter& writer, const T& object) {
+		Writer visit(writer);
+		writer.beginObject();
+		T::fields(object, visit);
+		writer.endObject();
+	}
+
+	/**
+	 * Write an object with no optional fields from a payload template each thread compiles
+	 * from its description once, for the types updated often.
+	 */
+	template <typename T>
+	static void writeTemplate(IOTP_JsonWriter& writer, const T& object) {
+		static thread_local IOTP_PayloadTemplate payload(shape(object));
+		Filler visit(payload);
+		T::fields(object, visit);
+		const std::string& text = payload.render();
+		writer.raw(text.data(), text.size());
+	}
+
+	/** An object as a Json::Value, built when it is asked for */
+	template <typename T>
+	static Json::Value toJsonValue(const T& object) {
+		Json::Value value(Json::objectValue);
+		Builder visit(value);
+		T::fields(object, visit);
+		return value;
+	}
+
+	/**
+	 * Set the fields of an object from the members of a json object. A field the json does not
+	 * have, or has as null, keeps the value it had.
+	 */
+	template <typename T>
+	static void read(const Json::Value& value, T& object) {
+		if (!value.isObject())
+			return;
+		Reader visit(value);
+		T::fields(object, visit);
+	}
+
+private:
+	// "YYYY-MM-DDTHH:MM:SSZ", quoted or not
+	static size_t isoTime(time_t seconds, char* text, bool quoted) {
+		char* p = text;
+		if (quoted)
+			*p++ = '"';
+		memcpy(p, IOTP_PayloadTemplate::isoSecond(seconds), 19);
+		p += 19;
+		*p++ = 'Z';
+		if (quoted)
+			*p++ = '"';
+		return p - text;
+	}
+
+	static bool omit(int flags, const std::string& text) { return (flags & OPTIONAL) && text.empty(); }
+	static bool omit(int flags, long long number) { return (flags & OPTIONAL) && number == -1; }
+
+	class Writer {
+	public:
+		explicit Writer(IOTP_JsonWriter& writer) : mWriter(writer) {}
+		void operator()(const char* name, const std::string& text, int flags = REQUIRED) {
+			if (!omit(flags, text))
+				mWriter.member(name, text);
+		}
+		void operator()(const char* name, int number, int flags = REQUIRED) {
+			if (!omit(flags, number))
+				mWriter.member(name, number);
+		}
+		void operator()(const char* name, double number, int = REQUIRED) {
+			mWriter.member(name, number);
+		}
+		void operator()(const char* name, Time<const time_t> time, int flags = REQUIRED) {
+			if (omit(flags, time.seconds))
+				return;
+			char text[sizeof "\"YYYY-MM-DDTHH:MM:SSZ\""];
+			mWriter.key(name).raw(text, isoTime(time.seconds, text, true));
+		}
+	private:
+		IOTP_JsonWriter& mWriter;
+	};
+
+	class Builder {
+	public:
+		explicit Builder(Json::Value& value) : mValue(value) {}
+		void operator()(const char* name, const std::string& text, int flags = REQUIRED) {
+			if (!omit(flags, text))
+				mValue[name] = text;
+		}
+		void operator()(const char* name, int number, int flags = REQUIRED) {
+			if (!omit(flags, number))
+				mValue[name] = number;
+		}
+		void operator()(const char* name, double number, int = REQUIRED) {
+			mValue[name] = number;
+		}
+		void operator()(const char* name, Time<const time_t> time, int flags = REQUIRED) {
+			if (omit(flags, time.seconds))
+				return;
+			char text[sizeof "YYYY-MM-DDTHH:MM:SSZ"];
+			mValue[name] = std::string(text, isoTime(time.seconds, text, false));
+		}
+	private:
+		Json::Value& mValue;
+	};
+
+	class Reader {
+	public:
+		explicit Reader(const Json::Value& value) : mValue(value) {}
+		void operator()(const char* name, std::string& text, int = REQUIRED) {
+			const Json::Value& member = mValue[name];
+			if (!member.isNull())
+				text = member.asString();
+		}
+		void operator()(const char* name, int& number, int = REQUIRED) {
+			const Json::Value& member = mValue[name];
+			if (!member.isNull())
+				number = member.asInt();
+		}
+		void operator()(const char* name, double& number, int = REQUIRED) {
+			const Json::Value& member = mValue[name];
+			if (!member.isNull())
+				number = member.asDouble();
+		}
+		void operator()(const char* name, Time<time_t> time, int = REQUIRED) {
+			const Json::Value& member = mValue[name];
+			struct tm utc;
+			memset(&utc, 0, sizeof(utc));
+			if (member.isString() && strptime(member.asCString(), "%Y-%m-%dT%H:%M:%S", &utc) != NULL)
+				time.seconds = timegm(&utc);
+		}
+	private:
+		const Json::Value& mValue;
+	};
+
+	// The template text of a description, a slot named after each field
+	class Shape {
+	public:
+		explicit Shape(std::string& text) : mText(text) {}
+		template <typename V>
+		void operator()(const char* name, const V&, int = REQUIRED) {
+			mText += (mText.size() == 1) ? "\"" : ",\"";
+			mText.append(name).append("\":$").append(name);
+		}
+	private:
+		std::string& mText;
+	};
+
+	// Sets the slots of a template compiled from Shape, in the order the fields are described
+	class Filler {
+	public:
+		explicit Filler(IOTP_PayloadTemplate& payload) : mPayload(payload), mSlot(0) {}
+		template <typename V>
+		void operator()(const char*, const V& value, int = REQUIRED) {
+			mPayload.set(mSlot++, value);
+		}
+		void operator()(const char*, Time<const time_t> time, int = REQUIRED) {
+			mPayload.setTime(mSlot++, time.seconds);
+		}
+	private:
+		IOTP_PayloadTemplate& mPayload;
+		int mSlot;
+	};
+
+	template <typename T>
+	static std::string shape(const T& object) {
+		std::string text = "{";
+		Shape visit(text);
+		T::fields(object, visit);
+		return text + "}";
+	}
+};
+
+} /* namespace Watson_IOTP */
+
+#endif /* IOTP_FIELDS_H_ */
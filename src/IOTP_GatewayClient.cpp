@@ -17,9 +17,16 @@
  *    Lokesh Haralakatta - Added logging feature using log4cpp.
  *    Lokesh K Haralakatta - Added SSL/TLS Support.
  *    Lokesh K Haralakatta - Added custom port support
+ *    Added offline buffering of publishes
+ *    Added sharding of attached devices over several connections
+ *    Added rate limits per attached device and event type
+ *    Added windowed aggregation of device events
+ *    Added deadband filter per attached device
+ *    Added CBOR and MessagePack encoded device events
  *******************************************************************************/
 #include "IOTP_GatewayClient.h"
 #include <iostream>
+#include <sstream>
 //#include "IOTF_ActionCallback.h"
 
 namespace Watson_IOTP {
@@ -28,14 +35,20 @@ namespace Watson_IOTP {
 IOTP_GatewayClient::IOTP_GatewayClient(Properties& prop,std::string logPropertiesFile):
 	gatewayCMDTopic(""),deviceCMDTopic(""),IOTP_Client(prop,logPropertiesFile)
 {
-
+	InitializeAggregator();
 }
 
 // GatewayClient constructor with properties file
 IOTP_GatewayClient::IOTP_GatewayClient(const std::string& filePath,std::string logPropertiesFile):
 	gatewayCMDTopic(""),deviceCMDTopic(""),IOTP_Client(filePath,logPropertiesFile)
 {
+	InitializeAggregator();
+}
 
+IOTP_GatewayClient::~IOTP_GatewayClient() {
+	mAggregateExit = true;
+	if (mAggregateThread.joinable())
+		mAggregateThread.join();
 }
 
 /**
@@ -62,6 +75,11 @@ bool IOTP_GatewayClient::connect()
 
 		rc = IOTP_Client::connect();
 
+		for (size_t shard = 0; rc && shard < mShardClients.size(); ++shard) {
+			logger.debug("Connecting shard " + std::to_string(shard + 1) + "...");
+			rc = connectClient(mShardClients[shard]);
+		}
+
 		if(rc)
 			subscribeGatewayCommands();
 		else
@@ -145,10 +163,25 @@ void IOTP_GatewayClient::publishDeviceEvent(char* deviceType, char* deviceId, ch
 	std::string payload = data;
 	logger.debug("publishTopic - " + publishTopic);
 	logger.debug("payload - " + payload);
+	if (this->aggregateEvent(deviceType, deviceId, eventType, eventFormat, payload)) {
+		logger.debug(methodName+" Exit: ");
+		return;
+	}
+	DeadbandSample passed;
+	if (!this->filterEvent(std::string(deviceType) + "/" + std::string(deviceId), eventType, eventFormat, payload, passed)) {
+		logger.debug(methodName+" Exit: ");
+		return;
+	}
+	std::string key = std::string(deviceType) + "/" + std::string(deviceId) + "/" + std::string(eventType);
+	if (!this->limitEvent(key, eventType, publishTopic, payload, qos, passed)) {
+		logger.debug(methodName+" Exit: ");
+		return;
+	}
 	mqtt::message_ptr pubmsg = std::make_shared < mqtt::message > (data);
 	pubmsg->set_qos(qos);
 	logger.debug("Calling method publishTopic() ...");
 	mqtt::idelivery_token_ptr delivery_tok = this->publishTopic(publishTopic, pubmsg);
+	this->recordEvent(passed);
 	delivery_tok->wait_for_completion(DEFAULT_TIMEOUT());
 	mqtt::const_message_ptr msgPtr = delivery_tok->get_message();
 	logger.debug(methodName+" Exit: ");
@@ -173,11 +206,63 @@ void IOTP_GatewayClient::publishDeviceEvent(char* deviceType, char* deviceId, ch
 	std::string payload = data;
 	logger.debug("publishTopic - " + publishTopic);
 	logger.debug("payload - " + payload);
+	DeadbandSample passed;
+	if (this->aggregateEvent(deviceType, deviceId, eventType, eventFormat, payload) ||
+			!this->filterEvent(std::string(deviceType) + "/" + std::string(deviceId), eventType, eventFormat, payload, passed)) {
+		this->completeUnsent(publishTopic, payload, qos, cb, MQTTASYNC_SUCCESS);
+		logger.debug(methodName+" Exit: ");
+		return;
+	}
+	std::string key = std::string(deviceType) + "/" + std::string(deviceId) + "/" + std::string(eventType);
+	if (!this->limitEvent(key, eventType, publishTopic, payload, qos, passed, &cb)) {
+		logger.debug(methodName+" Exit: ");
+		return;
+	}
 	mqtt::message_ptr pubmsg = std::make_shared < mqtt::message > (data);
 	pubmsg->set_qos(qos);
 	logger.debug("Calling method publishTopic() with given callback...");
 	mqtt::idelivery_token_ptr delivery_tok = this->publishTopic(publishTopic, pubmsg, NULL, cb);
+	this->recordEvent(passed);
+	logger.debug(methodName+" Exit: ");
+}
+
+/**
+* Function used to Publish events from the device to the IBM Watson IoT service, encoded
+* as json, cbor or msgpack
+* @param eventType - Type of event to be published e.g status, gps
+* @param data - the event
+* @param format - the encoding of the payload, which names the fmt/ segment of the topic
+* @param QoS - qos for the publish event. Supported values : 0, 1, 2
+* @return bool
+*/
+bool IOTP_GatewayClient::publishDeviceEvent(char* deviceType, char* deviceId, char *eventType, const Json::Value& data,
+		IOTP_Encoding::Format format, int qos) {
+	std::string methodName = __PRETTY_FUNCTION__;
+	logger.debug(methodName+" Entry: ");
+	std::string eventFormat = IOTP_Encoding::toName(format);
+	std::string publishTopic = "iot-2/type/" + std::string(deviceType) + "/id/" +
+				std::string(deviceId) + "/evt/" + std::string(eventType) +
+				"/fmt/" + eventFormat;
+	// binary payloads hold NUL bytes, so they stay in a std::string all the way
+	std::string payload = IOTP_Encoding::encode(data, format);
+	logger.debug("publishTopic - " + publishTopic);
+	logger.debug("payload - " + std::to_string(payload.size()) + " bytes of " + eventFormat);
+	DeadbandSample passed;
+	if (this->aggregateEvent(deviceType, deviceId, eventType, eventFormat, payload) ||
+			!this->filterEvent(std::string(deviceType) + "/" + std::string(deviceId), eventType, eventFormat, payload, passed)) {
+		logger.debug(methodName+" Exit: ");
+		return true;
+	}
+	std::string key = std::string(deviceType) + "/" + std::string(deviceId) + "/" + std::string(eventType);
+	if (!this->limitEvent(key, eventType, publishTopic, payload, qos, passed)) {
+		logger.debug(methodName+" Exit: ");
+		return this->mRateLimiter->policy() == IOTP_RateLimiter::COALESCE;
+	}
+	bool rc = this->publishCompressed(publishTopic, payload, qos);
+	if (rc)
+		this->recordEvent(passed);
 	logger.debug(methodName+" Exit: ");
+	return rc;
 }
 
 /**
@@ -230,9 +315,167 @@ void IOTP_GatewayClient::disconnect(){
 	}
 
 	IOTP_Client::disconnect();
+	for (mqtt::async_client* client : mShardClients) {
+		mqtt::itoken_ptr tok = client->disconnect();
+		tok->wait_for_completion();
+	}
+	logger.debug(methodName+" Exit: ");
+}
+
+/**
+* Function used to find the connection serving a device when the gateway is sharded.
+* The gateway's own type and id always stay on its own connection.
+* @return int
+* index of the connection, 0 for the gateway's own connection
+*/
+int IOTP_GatewayClient::getShard(const std::string& deviceType, const std::string& deviceId) {
+	if (deviceType.compare(mProperties.getdeviceType()) == 0 && deviceId.compare(mProperties.getdeviceId()) == 0)
+		return 0;
+	return mRing.shardFor(deviceType, deviceId);
+}
+
+/**
+* Device topics, iot-2/type/<type>/id/<id>/... and iotdm-1/type/<type>/id/<id>/..., use the
+* connection of the device's shard. Anything else, including wildcard types or ids, uses
+* the gateway's own connection.
+*/
+mqtt::async_client* IOTP_GatewayClient::clientForTopic(const std::string& topic) {
+	if (mShardClients.empty())
+		return pasync_client;
+
+	size_t type = topic.find("/type/");
+	if (type == std::string::npos || topic.find('/') != type)
+		return pasync_client;
+	type += 6;
+	size_t typeEnd = topic.find('/', type);
+	if (typeEnd == std::string::npos || topic.compare(typeEnd, 4, "/id/") != 0)
+		return pasync_client;
+	size_t id = typeEnd + 4;
+	size_t idEnd = topic.find('/', id);
+	std::string deviceType = topic.substr(type, typeEnd - type);
+	std::string deviceId = topic.substr(id, idEnd == std::string::npos ? std::string::npos : idEnd - id);
+	if (deviceType.compare("+") == 0 || deviceId.compare("+") == 0 || deviceType.compare("#") == 0 ||
+			deviceId.compare("#") == 0)
+		return pasync_client;
+
+	int shard = getShard(deviceType, deviceId);
+	return (shard == 0) ? pasync_client : mShardClients[shard - 1];
+}
+
+/*
+ * Set up the aggregation of device events when a window is configured. aggregateEvents lists
+ * the fields of each event type: "status:temperature|humidity,gps:speed". aggregateSlide,
+ * shorter than aggregateWindow, gives sliding windows; otherwise windows are tumbling.
+ */
+void IOTP_GatewayClient::InitializeAggregator() {
+	std::string methodName = __func__;
+	logger.debug(methodName+" Entry: ");
+
+	mAggregateExit = false;
+	std::istringstream list(mProperties.getaggregateEvents());
+	std::string item;
+	while (std::getline(list, item, ',')) {
+		std::istringstream fields(item);
+		std::string eventType, field;
+		if (std::getline(fields, eventType, ':')) {
+			while (std::getline(fields, field, '|'))
+				if (field.size() > 0)
+					mAggregateFields[eventType].push_back(field);
+		}
+		if (mAggregateFields.count(eventType) == 0)
+			console.error("Ignoring aggregation \"" + item + "\", expected eventType:field[|field...]");
+	}
+
+	if (mProperties.getaggregateWindow() > 0 && !mAggregateFields.empty()) {
+		mAggregator = std::make_shared<IOTP_Aggregator>(mProperties.getaggregateWindow(),
+				mProperties.getaggregateSlide());
+		mAggregateThread = std::thread(&IOTP_GatewayClient::_flush_aggregates, this);
+	}
+
 	logger.debug(methodName+" Exit: ");
 }
 
+/*
+ * Take the samples of an event to be aggregated. The fields are looked for in "d", or at the
+ * top level of the payload.
+ * @return true if the event is aggregated rather than published
+ */
+bool IOTP_GatewayClient::aggregateEvent(const std::string& deviceType, const std::string& deviceId,
+		const std::string& eventType, const std::string& eventFormat, const std::string& payload) {
+	if (mAggregator == nullptr)
+		return false;
+	std::map<std::string, std::vector<std::string> >::const_iterator fields = mAggregateFields.find(eventType);
+	if (fields == mAggregateFields.end())
+		return false;
+
+	Json::Value root;
+	if (!decodeEvent(eventFormat, payload, root))
+		return false;
+	const Json::Value& sample = (root.isMember("d") && root["d"].isObject()) ? root["d"] : root;
+	int64_t now = IOTP_Aggregator::now();
+	bool aggregated = false;
+	for (const std::string& field : fields->second) {
+		const Json::Value& value = sample[field];
+		if (value.isNumeric()) {
+			mAggregator->add(deviceType, deviceId, eventType, field, value.asDouble(), now);
+			aggregated = true;
+		}
+	}
+	// an event without any of the fields goes through as it is
+	return aggregated;
+}
+
+/**
+ * Publish the aggregate of each device and event type as its windows close, as a json event
+ * of the event type at QoS 1:
+ * {"d":{"temperature":{"min":..,"max":..,"mean":..,"count":..,"last":..}},"start":..,"end":..}
+ * with the window's start and end in milliseconds since the epoch. When the client is
+ * destroyed the windows still open are published with what they have.
+ */
+void IOTP_GatewayClient::_flush_aggregates() {
+	std::vector<IOTP_Aggregator::Window> closed;
+	Json::FastWriter fastWriter;
+	bool exiting = false;
+	while (!exiting) {
+		exiting = mAggregateExit;
+		closed.clear();
+		if (exiting)
+			mAggregator->flush(closed);
+		else {
+			int64_t now = IOTP_Aggregator::now(), next = mAggregator->nextClose();
+			int64_t wait = (next == 0 || next - now > 100) ? 100 : next - now;
+			if (wait > 0)
+				std::this_thread::sleep_for(std::chrono::milliseconds(wait));
+			mAggregator->close(IOTP_Aggregator::now(), closed);
+		}
+
+		// windows are timed on the steady clock, published on the system clock
+		int64_t epoch = std::chrono::duration_cast<std::chrono::milliseconds>(
+				std::chrono::system_clock::now().time_since_epoch()).count() - IOTP_Aggregator::now();
+		for (const IOTP_Aggregator::Window& window : closed) {
+			Json::Value root;
+			for (const IOTP_Aggregator::Field& field : window.fields) {
+				Json::Value& stats = root["d"][field.name];
+				stats["min"] = field.stats.min;
+				stats["max"] = field.stats.max;
+				stats["mean"] = field.stats.mean;
+				stats["count"] = (Json::UInt64)field.stats.count;
+				stats["last"] = field.stats.last;
+			}
+			root["start"] = (Json::Int64)(window.start + epoch);
+			root["end"] = (Json::Int64)(window.end + epoch);
+			std::string topic = "iot-2/type/" + window.deviceType + "/id/" + window.deviceId +
+					"/evt/" + window.eventType + "/fmt/json";
+			try {
+				this->publishCompressed(topic, fastWriter.write(root), 1);
+			}
+			catch (const mqtt::exception& e) {
+				logger.debug("Publishing an aggregate failed: " + std::string(e.what()));
+			}
+		}
+	}
+}
+
 bool IOTP_GatewayClient::InitializeMqttClient() {
 	std::string methodName = __func__;
 	logger.debug(methodName+" Entry: ");
@@ -273,8 +516,19 @@ bool IOTP_GatewayClient::InitializeMqttClient() {
 		logger.debug("serverURI: " + mServerURI);
 		logger.debug("clientId: " + mClientID);
 
-		pasync_client = new mqtt::async_client(mServerURI, mClientID);
-		logger.debug("Underlying async_client created...");
+		pasync_client = CreateAsyncClient(mClientID);
+
+		// Further connections take the gateway's client id with the shard number appended;
+		// the platform sees each as a gateway of its own, registered as <deviceId>-<shard>
+		int shards = mProperties.getgatewayShards();
+		mRing = IOTP_HashRing(shards);
+		for (mqtt::async_client* client : mShardClients)
+			delete client;
+		mShardClients.clear();
+		for (int shard = 1; shard < shards; ++shard) {
+			logger.debug("clientId of shard " + std::to_string(shard) + ": " + mClientID + "-" + std::to_string(shard));
+			mShardClients.push_back(CreateAsyncClient(mClientID + "-" + std::to_string(shard)));
+		}
 	}
 
 	logger.debug(methodName+" Exit: ");
@@ -14,8 +14,13 @@
  *    Hari Prasada Reddy - Initial implementation
  *    Lokesh Haralakatta - Updates to match with latest mqtt lib changes
  *    Lokesh Haralakatta - Added logging feature using log4cpp.
+ *    Added sharding of attached devices over several connections.
+ *    Added windowed aggregation of device events.
  *******************************************************************************/
+#include <atomic>
 #include "IOTP_Client.h"
+#include "IOTP_HashRing.h"
+#include "IOTP_Aggregator.h"
 
 namespace Watson_IOTP {
 
@@ -38,6 +43,7 @@ public:
 
 	/**
 	 * Connect to Watson IoT Platform messaging server using default options.
+	 * A sharded gateway connects every one of its connections, see getShard().
 	 *
 	 * @return bool
 	 * returns true if connection succeeds else fasle
@@ -76,6 +82,15 @@ public:
 	* @param QoS - qos for the publish event. Supported values : 0, 1, 2
 	*
 	* @return void
+	*
+	* Each attached device has its own rate limit per event type, so one device flooding
+	* events does not use up the limit of the others.
+	*
+	* JSON, CBOR and MessagePack events of a type listed in aggregateEvents are not published as they are: their
+	* listed fields are aggregated per device over a window, and the min, max, mean, count
+	* and last value of each field is published as one event when the window closes. Other
+	* events whose fields listed in deadbandEvents all stayed within their deadbands
+	* since the device's last published event are not published.
 	*/
 	void publishDeviceEvent(char* deviceType, char* deviceId, char *eventType, char *eventFormat, const char* data, int qos);
 
@@ -85,12 +100,30 @@ public:
 	* @param eventFormat - Format of the event e.g json
 	* @param data - Payload of the event
 	* @param QoS - qos for the publish event. Supported values : 0, 1, 2
-	* @param iaction_listener& cb - call back function for action listner
+	* @param iaction_listener& cb - call back function for action listner. It is called for
+	* every event: on_success for one that is aggregated or suppressed by the deadband filter,
+	* on_failure with MQTTASYNC_DROPPED for one the rate limit drops, and with
+	* MQTTASYNC_SUPERSEDED for one it holds and then replaces with a later event; a held event
+	* is published with it.
 	* @return void
 	*/
 	void publishDeviceEvent(char* deviceType, char* deviceId, char *eventType, char *eventFormat,
 			const char* data, int qos, mqtt::iaction_listener& cb);
 
+	/**
+	* Function used to Publish events from the device to the IBM Watson IoT service, encoded
+	* in the given format, whose name is the fmt/ segment of the topic: json, cbor or msgpack.
+	* Events go through the spool, aggregation, deadband filter and rate limit as others do,
+	* and are compressed on the compression thread when compression is set.
+	* @param eventType - Type of event to be published e.g status, gps
+	* @param data - the event
+	* @param format - the encoding of the payload
+	* @param QoS - qos for the publish event. Supported values : 0, 1, 2
+	* @return bool - false if the event was dropped by the spool or the rate limit
+	*/
+	bool publishDeviceEvent(char* deviceType, char* deviceId, char *eventType, const Json::Value& data,
+			IOTP_Encoding::Format format, int qos);
+
 	/**
 	 * Function used to subscribe commands from the IBM Watson IoT service
 	 * @return bool
@@ -111,10 +144,34 @@ public:
 	**/
 	void disconnect();
 
-	~IOTP_GatewayClient(){}
+	/**
+	* Function used to find the connection serving a device when the gateway is sharded.
+	* With gatewayShards set to N above 1, the gateway opens N connections: its own, and
+	* N-1 more whose client ids are its own with "-1" to "-(N-1)" appended. The platform
+	* takes each of those as a gateway of its own, so each has to be registered, with the
+	* same type and the id "<deviceId>-k", and given the gateway's auth token.
+	* @return int
+	* index of the connection, 0 for the gateway's own connection
+	*/
+	int getShard(const std::string& deviceType, const std::string& deviceId);
+
+	~IOTP_GatewayClient();
+
+protected:
+	mqtt::async_client* clientForTopic(const std::string& topic);
 
 private:
 	bool InitializeMqttClient();
+	void InitializeAggregator();
+	bool aggregateEvent(const std::string& deviceType, const std::string& deviceId,
+			const std::string& eventType, const std::string& eventFormat, const std::string& payload);
+	void _flush_aggregates();
+	iotp_aggregator_ptr mAggregator;
+	// the fields aggregated of each event type
+	std::map<std::string, std::vector<std::string> > mAggregateFields;
+	std::thread mAggregateThread;
+	std::atomic<bool> mAggregateExit;
+	IOTP_HashRing mRing;
 	std::string deviceCMDTopic;
 	std::string gatewayCMDTopic;
 };
@@ -0,0 +1,68 @@
+/*******************************************************************************
+ * Copyright (c) 2017 IBM Corp.
+ *
+ * All rights reserved. This program and the accompanying materials
+ * are made available under the terms of the Eclipse Public License v1.0
+ * and Eclipse Distribution License v1.0 which accompany this distribution.
+ *
+ * The Eclipse Public License is available at
+ *    http://www.eclipse.org/legal/epl-v10.html
+ * and the Eclipse Distribution License is available at
+ *   http://www.eclipse.org/org/documents/edl-v10.php.
+ *
+ * Contributors:
+ *    Consistent hash ring for sharding gateway connections
+ *******************************************************************************/
+
+#include "IOTP_HashRing.h"
+
+#include <algorithm>
+
+namespace Watson_IOTP {
+
+IOTP_HashRing::IOTP_HashRing(int shards, int points) :
+	mShards(shards > 0 ? shards : 1)
+{
+	if (points <= 0)
+		points = DEFAULT_POINTS;
+	mRing.reserve(mShards * points);
+	for (int shard = 0; shard < mShards; ++shard) {
+		for (int point = 0; point < points; ++point) {
+			std::string key = "shard-" + std::to_string(shard) + "-" + std::to_string(point);
+			mRing.push_back(std::make_pair(hash(key.data(), key.size()), shard));
+		}
+	}
+	std::sort(mRing.begin(), mRing.end());
+}
+
+int IOTP_HashRing::shardFor(const std::string& key) const {
+	if (mShards == 1)
+		return 0;
+	uint64_t h = hash(key.data(), key.size());
+	std::vector<std::pair<uint64_t, int> >::const_iterator it =
+			std::lower_bound(mRing.begin(), mRing.end(), std::make_pair(h, 0));
+	if (it == mRing.end())
+		it = mRing.begin();
+	return it->second;
+}
+
+int IOTP_HashRing::shardFor(const std::string& deviceType, const std::string& deviceId) const {
+	return shardFor(deviceType + "/" + deviceId);
+}
+
+uint64_t IOTP_HashRing::hash(const char* data, size_t length) {
+	uint64_t h = 14695981039346656037ULL;
+	for (size_t i = 0; i < length; ++i) {
+		h ^= (unsigned char)data[i];
+		h *= 1099511628211ULL;
+	}
+	// FNV-1a leaves the high bits of short keys poorly mixed, spread them over the ring
+	h ^= h >> 33;
+	h *= 0xff51afd7ed558ccdULL;
+	h ^= h >> 33;
+	h *= 0xc4ceb9fe1a85ec53ULL;
+	h ^= h >> 33;
+	return h;
+}
+
+} /* namespace Watson_IOTP */
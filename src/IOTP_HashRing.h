@@ -0,0 +1,68 @@
+/*******************************************************************************
+ * Copyright (c) 2017 IBM Corp.
+ *
+ * All rights reserved. This program and the accompanying materials
+ * are made available under the terms of the Eclipse Public License v1.0
+ * and Eclipse Distribution License v1.0 which accompany this distribution.
+ *
+ * The Eclipse Public License is available at
+ *    http://www.eclipse.org/legal/epl-v10.html
+ * and the Eclipse Distribution License is available at
+ *   http://www.eclipse.org/org/documents/edl-v10.php.
+ *
+ * Contributors:
+ *    Consistent hash ring for sharding gateway connections
+ *******************************************************************************/
+
+#ifndef IOTP_HASHRING_H_
+#define IOTP_HASHRING_H_
+
+#include <stdint.h>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace Watson_IOTP {
+
+/**
+ * Consistent hash ring mapping keys, such as a device type and id, to one of a number of
+ * shards.
+ *
+ * Each shard is placed on the ring at a number of points and a key belongs to the shard of
+ * the first point at or after the key's hash. Growing the ring from N to N+1 shards only
+ * moves about 1/(N+1) of the keys, all of them to the new shard. The hash is FNV-1a, so
+ * the mapping is the same on every platform and across restarts.
+ */
+class IOTP_HashRing {
+public:
+	static const int DEFAULT_POINTS = 160;
+
+	/**
+	 * Constructor of an IOTP_HashRing.
+	 * @param shards - number of shards, at least 1
+	 * @param points - points on the ring per shard
+	 */
+	IOTP_HashRing(int shards = 1, int points = DEFAULT_POINTS);
+
+	/**
+	 * Shard of a key, from 0 to shards() - 1.
+	 */
+	int shardFor(const std::string& key) const;
+
+	/**
+	 * Shard of a device, keyed by its type and id.
+	 */
+	int shardFor(const std::string& deviceType, const std::string& deviceId) const;
+
+	int shards() const { return mShards; }
+
+	static uint64_t hash(const char* data, size_t length);
+
+private:
+	int mShards;
+	std::vector<std::pair<uint64_t, int> > mRing;
+};
+
+} /* namespace Watson_IOTP */
+
+#endif /* IOTP_HASHRING_H_ */
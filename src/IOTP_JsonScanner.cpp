@@ -0,0 +1,784 @@
+/*******************************************************************************
+ * Copyright (c) 2017 IBM Corp.
+ *
+ * All rights reserved. This program and the accompanying materials
+ * are made available under the terms of the Eclipse Public License v1.0
+ * and Eclipse Distribution License v1.0 which accompany this distribution.
+ *
+ * The Eclipse Public License is available at
+ *    http://www.eclipse.org/legal/epl-v10.html
+ * and the Eclipse Distribution License is available at
+ *   http://www.eclipse.org/org/documents/edl-v10.php.
+ *
+ * Contributors:
+ *    Vectorized json scanner for inbound messages
+ *******************************************************************************/
+
+#include "IOTP_JsonScanner.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define IOTP_SCANNER_X86 1
+#include <immintrin.h>
+#endif
+
+namespace Watson_IOTP {
+
+namespace {
+
+/*
+ * The first pass. Each block of 64 bytes is classified into a bit per byte for quotes,
+ * backslashes, brackets/colons/commas and whitespace, by the instruction set in use; the rest
+ * is the same bit arithmetic for all of them:
+ * - a character is escaped if it follows a run of backslashes of odd length, which the carry
+ *   of an addition finds for all the runs of a block at once
+ * - the quotes that are not escaped, xor-ed from the start of the text, give the bytes that
+ *   are inside strings: every opening quote and what follows it, up to the closing quote
+ * - outside strings, a byte that is not whitespace, punctuation or a quote belongs to a
+ *   number or literal, which starts where the previous byte did not
+ */
+struct Masks {
+	uint64_t quote;
+	uint64_t backslash;
+	uint64_t op;
+	uint64_t space;
+};
+
+struct Scan {
+	Scan(uint32_t* out) : prevEscaped(0), prevInString(0), prevAtom(0), out(out) {}
+
+	uint64_t prevEscaped;		// the first byte of the next block is escaped
+	uint64_t prevInString;		// all ones if the next block starts in a string
+	uint64_t prevAtom;			// the last byte of the block was part of a number or literal
+	uint32_t* out;
+
+	static uint64_t prefixXor(uint64_t bits) {
+		bits ^= bits << 1;
+		bits ^= bits << 2;
+		bits ^= bits << 4;
+		bits ^= bits << 8;
+		bits ^= bits << 16;
+		bits ^= bits << 32;
+		return bits;
+	}
+
+	uint64_t escaped(uint64_t backslash) {
+		static const uint64_t EVEN_BITS = 0x5555555555555555ULL;
+		backslash &= ~prevEscaped;
+		uint64_t followsEscape = (backslash << 1) | prevEscaped;
+		uint64_t oddStarts = backslash & ~EVEN_BITS & ~followsEscape;
+		uint64_t sequencesStartingOnEvenBits = oddStarts + backslash;
+		prevEscaped = (sequencesStartingOnEvenBits < oddStarts) ? 1 : 0;
+		uint64_t invertMask = sequencesStartingOnEvenBits << 1;
+		return (EVEN_BITS ^ invertMask) & followsEscape;
+	}
+
+	void block(const Masks& masks, uint32_t base) {
+		uint64_t quote = masks.quote & ~escaped(masks.backslash);
+		uint64_t inString = prefixXor(quote) ^ prevInString;
+		prevInString = (uint64_t)((int64_t)inString >> 63);
+		uint64_t atom = ~(masks.op | masks.space | quote | inString);
+		uint64_t atomStart = atom & ~((atom << 1) | prevAtom);
+		prevAtom = atom >> 63;
+
+		uint64_t structurals = (masks.op & ~inString) | quote | atomStart;
+		while (structurals != 0) {
+			*out++ = base + (uint32_t)__builtin_ctzll(structurals);
+			structurals &= structurals - 1;
+		}
+	}
+};
+
+enum { QUOTE = 1, BACKSLASH = 2, OP = 4, SPACE = 8 };
+
+struct ClassTable {
+	ClassTable() {
+		memset(classes, 0, sizeof(classes));
+		classes[(unsigned char)'"'] = QUOTE;
+		classes[(unsigned char)'\\'] = BACKSLASH;
+		for (const char* c = "{}[]:,"; *c; ++c)
+			classes[(unsigned char)*c] = OP;
+		for (const char* c = " \t\n\r"; *c; ++c)
+			classes[(unsigned char)*c] = SPACE;
+	}
+	unsigned char classes[256];
+};
+
+const ClassTable CLASSES;
+
+inline void classifyScalar(const char* block, Masks& masks) {
+	masks.quote = masks.backslash = masks.op = masks.space = 0;
+	for (int i = 0; i < 64; ++i) {
+		unsigned char c = CLASSES.classes[(unsigned char)block[i]];
+		uint64_t bit = 1ULL << i;
+		if (c & QUOTE)
+			masks.quote |= bit;
+		if (c & BACKSLASH)
+			masks.backslash |= bit;
+		if (c & OP)
+			masks.op |= bit;
+		if (c & SPACE)
+			masks.space |= bit;
+	}
+}
+
+#ifdef IOTP_SCANNER_X86
+
+/*
+ * Whitespace is found with one table lookup by the low nibble of each byte: ' ', '\t', '\n'
+ * and '\r' have different low nibbles, and the other entries can match no byte below 0x80.
+ * Brackets are compared after setting bit 0x20, which makes '[' and ']' into '{' and '}'.
+ */
+#define IOTP_SPACE_TABLE ' ', 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, \
+	0x80, '\t', '\n', 0x80, 0x80, '\r', 0x80, 0x80
+
+__attribute__((target("sse4.2"), always_inline))
+inline void classifySse42(const char* block, Masks& masks) {
+	const __m128i quote = _mm_set1_epi8('"'), backslash = _mm_set1_epi8('\\');
+	const __m128i lower = _mm_set1_epi8(0x20), open = _mm_set1_epi8('{'), close = _mm_set1_epi8('}');
+	const __m128i colon = _mm_set1_epi8(':'), comma = _mm_set1_epi8(',');
+	const __m128i spaces = _mm_setr_epi8(IOTP_SPACE_TABLE);
+	masks.quote = masks.backslash = masks.op = masks.space = 0;
+	for (int i = 0; i < 4; ++i) {
+		__m128i v = _mm_loadu_si128((const __m128i*)(block + 16 * i));
+		__m128i folded = _mm_or_si128(v, lower);
+		__m128i op = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(folded, open), _mm_cmpeq_epi8(folded, close)),
+				_mm_or_si128(_mm_cmpeq_epi8(v, colon), _mm_cmpeq_epi8(v, comma)));
+		__m128i space = _mm_cmpeq_epi8(_mm_shuffle_epi8(spaces, v), v);
+		int shift = 16 * i;
+		masks.quote |= (uint64_t)(uint16_t)_mm_movemask_epi8(_mm_cmpeq_epi8(v, quote)) << shift;
+		masks.backslash |= (uint64_t)(uint16_t)_mm_movemask_epi8(_mm_cmpeq_epi8(v, backslash)) << shift;
+		masks.op |= (uint64_t)(uint16_t)_mm_movemask_epi8(op) << shift;
+		masks.space |= (uint64_t)(uint16_t)_mm_movemask_epi8(space) << shift;
+	}
+}
+
+__attribute__((target("avx2"), always_inline))
+inline void classifyAvx2(const char* block, Masks& masks) {
+	const __m256i quote = _mm256_set1_epi8('"'), backslash = _mm256_set1_epi8('\\');
+	const __m256i lower = _mm256_set1_epi8(0x20), open = _mm256_set1_epi8('{'), close = _mm256_set1_epi8('}');
+	const __m256i colon = _mm256_set1_epi8(':'), comma = _mm256_set1_epi8(',');
+	const __m256i spaces = _mm256_setr_epi8(IOTP_SPACE_TABLE, IOTP_SPACE_TABLE);
+	masks.quote = masks.backslash = masks.op = masks.space = 0;
+	for (int i = 0; i < 2; ++i) {
+		__m256i v = _mm256_loadu_si256((const __m256i*)(block + 32 * i));
+		__m256i folded = _mm256_or_si256(v, lower);
+		__m256i op = _mm256_or_si256(_mm256_or_si256(_mm256_cmpeq_epi8(folded, open), _mm256_cmpeq_epi8(folded, close)),
+				_mm256_or_si256(_mm256_cmpeq_epi8(v, colon), _mm256_cmpeq_epi8(v, comma)));
+		__m256i space = _mm256_cmpeq_epi8(_mm256_shuffle_epi8(spaces, v), v);
+		int shift = 32 * i;
+		masks.quote |= (uint64_t)(uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(v, quote)) << shift;
+		masks.backslash |= (uint64_t)(uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(v, backslash)) << shift;
+		masks.op |= (uint64_t)(uint32_t)_mm256_movemask_epi8(op) << shift;
+		masks.space |= (uint64_t)(uint32_t)_mm256_movemask_epi8(space) << shift;
+	}
+}
+
+#undef IOTP_SPACE_TABLE
+
+#endif /* IOTP_SCANNER_X86 */
+
+// The last block is copied and padded with spaces, which add nothing to the index
+#define IOTP_SCAN_BLOCKS(classify) \
+	size_t whole = length & ~(size_t)63; \
+	Masks masks; \
+	for (size_t i = 0; i < whole; i += 64) { \
+		classify(data + i, masks); \
+		scan.block(masks, (uint32_t)i); \
+	} \
+	if (whole < length) { \
+		char last[64]; \
+		memset(last, ' ', sizeof(last)); \
+		memcpy(last, data + whole, length - whole); \
+		classify(last, masks); \
+		scan.block(masks, (uint32_t)whole); \
+	}
+
+void scanScalar(const char* data, size_t length, Scan& scan) {
+	IOTP_SCAN_BLOCKS(classifyScalar)
+}
+
+#ifdef IOTP_SCANNER_X86
+__attribute__((target("sse4.2")))
+void scanSse42(const char* data, size_t length, Scan& scan) {
+	IOTP_SCAN_BLOCKS(classifySse42)
+}
+
+__attribute__((target("avx2")))
+void scanAvx2(const char* data, size_t length, Scan& scan) {
+	IOTP_SCAN_BLOCKS(classifyAvx2)
+}
+#endif
+
+#undef IOTP_SCAN_BLOCKS
+
+bool supported(IOTP_JsonScanner::Level level) {
+#ifdef IOTP_SCANNER_X86
+	// the level is chosen by a static initializer, which may run before the one that
+	// sets up __builtin_cpu_supports
+	__builtin_cpu_init();
+	switch (level) {
+	case IOTP_JsonScanner::AVX2:
+		return __builtin_cpu_supports("avx2");
+	case IOTP_JsonScanner::SSE42:
+		return __builtin_cpu_supports("sse4.2");
+	default:
+		return true;
+	}
+#else
+	return level == IOTP_JsonScanner::SCALAR;
+#endif
+}
+
+IOTP_JsonScanner::Level bestLevel() {
+	if (supported(IOTP_JsonScanner::AVX2))
+		return IOTP_JsonScanner::AVX2;
+	if (supported(IOTP_JsonScanner::SSE42))
+		return IOTP_JsonScanner::SSE42;
+	return IOTP_JsonScanner::SCALAR;
+}
+
+std::atomic<int> currentLevel(bestLevel());
+
+/*
+ * The second pass, a recursive descent over the index. Every string is an opening quote
+ * followed in the index by its closing quote; a number or literal runs from its entry up to
+ * the whitespace or punctuation after it.
+ */
+class Builder {
+public:
+	Builder(const char* data, size_t length, const std::vector<uint32_t>& offsets) :
+		mData(data), mLength(length), mOffsets(offsets.data()), mCount(offsets.size() - 1), mNext(0) {}
+
+	bool document(Json::Value& root) {
+		return mCount != 0 && value(root, 0) && mNext == mCount;
+	}
+
+	// The value whose first entry in the index is at
+	bool subtree(size_t at, Json::Value& out) {
+		mNext = at;
+		return value(out, 0);
+	}
+
+	// The text of the string whose opening quote is at, unescaped
+	bool text(size_t at, std::string& out) {
+		size_t open = mOffsets[at], close = mOffsets[at + 1];
+		if (memchr(mData + open + 1, '\\', close - open - 1) == NULL) {
+			out.assign(mData + open + 1, close - open - 1);
+			return true;
+		}
+		return unescape(open + 1, close, out);
+	}
+
+private:
+	char peek() const {
+		return (mNext < mCount) ? mData[mOffsets[mNext]] : 0;
+	}
+
+	bool value(Json::Value& out, int depth) {
+		if (mNext >= mCount)
+			return false;
+		size_t at = mOffsets[mNext++];
+		switch (mData[at]) {
+		case '{':
+			return object(out, depth + 1);
+		case '[':
+			return array(out, depth + 1);
+		case '"': {
+			size_t close;
+			if (!closingQuote(close))
+				return false;
+			Json::Value text;
+			if (!string(at + 1, close, text))
+				return false;
+			out.swapPayload(text);
+			return true;
+		}
+		case '}': case ']': case ':': case ',':
+			return false;
+		default:
+			return atom(at, out);
+		}
+	}
+
+	bool object(Json::Value& out, int depth) {
+		if (depth > IOTP_JsonScanner::MAX_DEPTH)
+			return false;
+		out = Json::Value(Json::objectValue);
+		if (peek() == '}') {
+			++mNext;
+			return true;
+		}
+		for (;;) {
+			if (peek() != '"')
+				return false;
+			size_t open = mOffsets[mNext++], close;
+			if (!closingQuote(close))
+				return false;
+			if (memchr(mData + open + 1, '\\', close - open - 1) == NULL)
+				mKey.assign(mData + open + 1, close - open - 1);
+			else if (!unescape(open + 1, close, mKey))
+				return false;
+			if (peek() != ':')
+				return false;
+			++mNext;
+			if (!value(out[mKey], depth))
+				return false;
+			char next = peek();
+			++mNext;
+			if (next == '}')
+				return true;
+			if (next != ',')
+				return false;
+		}
+	}
+
+	bool array(Json::Value& out, int depth) {
+		if (depth > IOTP_JsonScanner::MAX_DEPTH)
+			return false;
+		out = Json::Value(Json::arrayValue);
+		if (peek() == ']') {
+			++mNext;
+			return true;
+		}
+		for (Json::ArrayIndex index = 0; ; ++index) {
+			if (!value(out[index], depth))
+				return false;
+			char next = peek();
+			++mNext;
+			if (next == ']')
+				return true;
+			if (next != ',')
+				return false;
+		}
+	}
+
+	bool closingQuote(size_t& close) {
+		if (peek() != '"')
+			return false;
+		close = mOffsets[mNext++];
+		return true;
+	}
+
+	bool string(size_t begin, size_t end, Json::Value& out) {
+		if (memchr(mData + begin, '\\', end - begin) == NULL) {
+			out = Json::Value(mData + begin, mData + end);
+			return true;
+		}
+		if (!unescape(begin, end, mScratch))
+			return false;
+		out = Json::Value(mScratch.data(), mScratch.data() + mScratch.size());
+		return true;
+	}
+
+	bool unescape(size_t begin, size_t end, std::string& out) {
+		out.clear();
+		const char* p = mData + begin;
+		const char* last = mData + end;
+		while (p < last) {
+			const char* escape = (const char*)memchr(p, '\\', last - p);
+			if (escape == NULL) {
+				out.append(p, last - p);
+				break;
+			}
+			out.append(p, escape - p);
+			p = escape + 1;
+			if (p == last)
+				return false;
+			switch (*p++) {
+			case '"': out += '"'; break;
+			case '/': out += '/'; break;
+			case '\\': out += '\\'; break;
+			case 'b': out += '\b'; break;
+			case 'f': out += '\f'; break;
+			case 'n': out += '\n'; break;
+			case 'r': out += '\r'; break;
+			case 't': out += '\t'; break;
+			case 'u': {
+				unsigned int unicode;
+				if (!hex4(p, last, unicode))
+					return false;
+				if (unicode >= 0xD800 && unicode <= 0xDBFF) {
+					unsigned int low;
+					if (last - p < 6 || p[0] != '\\' || p[1] != 'u')
+						return false;
+					p += 2;
+					if (!hex4(p, last, low))
+						return false;
+					unicode = 0x10000 + ((unicode & 0x3FF) << 10) + (low & 0x3FF);
+				}
+				utf8(unicode, out);
+				break;
+			}
+			default:
+				return false;
+			}
+		}
+		return true;
+	}
+
+	static bool hex4(const char*& p, const char* last, unsigned int& unicode) {
+		if (last - p < 4)
+			return false;
+		unicode = 0;
+		for (int i = 0; i < 4; ++i) {
+			char c = *p++;
+			unicode *= 16;
+			if (c >= '0' && c <= '9')
+				unicode += c - '0';
+			else if (c >= 'a' && c <= 'f')
+				unicode += c - 'a' + 10;
+			else if (c >= 'A' && c <= 'F')
+				unicode += c - 'A' + 10;
+			else
+				return false;
+		}
+		return true;
+	}
+
+	static void utf8(unsigned int cp, std::string& out) {
+		if (cp <= 0x7F)
+			out += (char)cp;
+		else if (cp <= 0x7FF) {
+			out += (char)(0xC0 | (cp >> 6));
+			out += (char)(0x80 | (cp & 0x3F));
+		}
+		else if (cp <= 0xFFFF) {
+			out += (char)(0xE0 | (cp >> 12));
+			out += (char)(0x80 | ((cp >> 6) & 0x3F));
+			out += (char)(0x80 | (cp & 0x3F));
+		}
+		else if (cp <= 0x10FFFF) {
+			out += (char)(0xF0 | (cp >> 18));
+			out += (char)(0x80 | ((cp >> 12) & 0x3F));
+			out += (char)(0x80 | ((cp >> 6) & 0x3F));
+			out += (char)(0x80 | (cp & 0x3F));
+		}
+	}
+
+	bool delimited(const char* p) const {
+		return p == mData + mLength || (CLASSES.classes[(unsigned char)*p] & (OP | SPACE | QUOTE)) != 0;
+	}
+
+	bool literal(const char* p, const char* word, size_t length) const {
+		return (size_t)(mData + mLength - p) >= length && memcmp(p, word, length) == 0 && delimited(p + length);
+	}
+
+	static bool digit(char c) {
+		return c >= '0' && c <= '9';
+	}
+
+	bool atom(size_t at, Json::Value& out) {
+		const char* p = mData + at;
+		const char* end = mData + mLength;
+		switch (*p) {
+		case 't':
+			if (!literal(p, "true", 4))
+				return false;
+			out = true;
+			return true;
+		case 'f':
+			if (!literal(p, "false", 5))
+				return false;
+			out = false;
+			return true;
+		case 'n':
+			if (!literal(p, "null", 4))
+				return false;
+			out = Json::Value();
+			return true;
+		}
+
+		// as Json::Reader::decodeNumber: integers that fit in 64 bits stay integers
+		const char* q = p;
+		bool negative = (*q == '-');
+		if (negative)
+			++q;
+		const char* digits = q;
+		while (q < end && digit(*q))
+			++q;
+		if (q == digits)
+			return false;
+		bool integral = true;
+		if (q < end && *q == '.') {
+			integral = false;
+			const char* fraction = ++q;
+			while (q < end && digit(*q))
+				++q;
+			if (q == fraction)
+				return false;
+		}
+		if (q < end && (*q == 'e' || *q == 'E')) {
+			integral = false;
+			++q;
+			if (q < end && (*q == '+' || *q == '-'))
+				++q;
+			const char* exponent = q;
+			while (q < end && digit(*q))
+				++q;
+			if (q == exponent)
+				return false;
+		}
+		if (!delimited(q))
+			return false;
+
+		if (integral) {
+			Json::Value::LargestUInt maxIntegerValue = negative ?
+					Json::Value::LargestUInt(Json::Value::maxLargestInt) + 1 : Json::Value::maxLargestUInt;
+			Json::Value::LargestUInt threshold = maxIntegerValue / 10;
+			Json::Value::LargestUInt number = 0;
+			const char* d = digits;
+			for (; d < q; ++d) {
+				unsigned int digit = *d - '0';
+				if (number >= threshold && (number > threshold || d + 1 != q || digit > maxIntegerValue % 10))
+					break;
+				number = number * 10 + digit;
+			}
+			if (d == q) {
+				if (negative && number == maxIntegerValue)
+					out = Json::Value::minLargestInt;
+				else if (negative)
+					out = -Json::Value::LargestInt(number);
+				else if (number <= Json::Value::LargestUInt(Json::Value::maxInt))
+					out = Json::Value::LargestInt(number);
+				else
+					out = number;
+				return true;
+			}
+		}
+
+		char buffer[64];
+		std::string longNumber;
+		const char* text = buffer;
+		if ((size_t)(q - p) < sizeof(buffer)) {
+			memcpy(buffer, p, q - p);
+			buffer[q - p] = '\0';
+		}
+		else {
+			longNumber.assign(p, q - p);
+			text = longNumber.c_str();
+		}
+		// as Json::Reader::decodeDouble, which rejects a number too large for a double and
+		// takes one too small as 0
+		double value = strtod(text, NULL);
+		if (!std::isfinite(value))
+			return false;
+		out = value;
+		return true;
+	}
+
+	const char* mData;
+	size_t mLength;
+	const uint32_t* mOffsets;
+	size_t mCount;
+	size_t mNext;
+	std::string mKey;
+	std::string mScratch;
+};
+
+} /* namespace */
+
+IOTP_JsonScanner::Level IOTP_JsonScanner::level() {
+	return (Level)currentLevel.load(std::memory_order_relaxed);
+}
+
+bool IOTP_JsonScanner::setLevel(Level level) {
+	if (!supported(level))
+		return false;
+	currentLevel.store(level, std::memory_order_relaxed);
+	return true;
+}
+
+const char* IOTP_JsonScanner::toName(Level level) {
+	switch (level) {
+	case AVX2:
+		return "avx2";
+	case SSE42:
+		return "sse4.2";
+	default:
+		return "scalar";
+	}
+}
+
+bool IOTP_JsonScanner::index(const char* data, size_t length, std::vector<uint32_t>& offsets) {
+	if (length >= UINT32_MAX)
+		return false;
+	offsets.resize(length + 1);
+	Scan scan(offsets.data());
+	switch (level()) {
+#ifdef IOTP_SCANNER_X86
+	case AVX2:
+		scanAvx2(data, length, scan);
+		break;
+	case SSE42:
+		scanSse42(data, length, scan);
+		break;
+#endif
+	default:
+		scanScalar(data, length, scan);
+		break;
+	}
+	*scan.out++ = (uint32_t)length;
+	offsets.resize(scan.out - offsets.data());
+	return scan.prevInString == 0;
+}
+
+bool IOTP_JsonScanner::parse(const char* data, size_t length, Json::Value& root) {
+	static thread_local std::vector<uint32_t> offsets;
+	if (!index(data, length, offsets))
+		return false;
+	Builder builder(data, length, offsets);
+	return builder.document(root);
+}
+
+bool IOTP_JsonDocument::load(const char* data, size_t length) {
+	mData = data;
+	mLength = length;
+	mValid = IOTP_JsonScanner::index(data, length, mOffsets) && mOffsets.size() > 1;
+	return mValid;
+}
+
+// The entry after the value whose first entry is at, or the count of entries if it is cut off
+size_t IOTP_JsonDocument::skip(size_t at) const {
+	size_t count = mOffsets.size() - 1;
+	if (at >= count)
+		return count;
+	switch (mData[mOffsets[at]]) {
+	case '"':
+		return std::min(at + 2, count);
+	case '{':
+	case '[': {
+		int depth = 0;
+		for (; at < count; ++at) {
+			char c = mData[mOffsets[at]];
+			if (c == '{' || c == '[')
+				++depth;
+			else if ((c == '}' || c == ']') && --depth == 0)
+				return at + 1;
+		}
+		return count;
+	}
+	default:
+		return at + 1;
+	}
+}
+
+bool IOTP_JsonDocument::find(const char* path, size_t& at) const {
+	if (!mValid)
+		return false;
+	size_t count = mOffsets.size() - 1;
+	at = 0;
+	while (*path != '\0') {
+		const char* end = strchr(path, '/');
+		if (end == NULL)
+			end = path + strlen(path);
+		size_t length = end - path;
+
+		char c = mData[mOffsets[at]];
+		size_t next = at + 1;
+		if (c == '{') {
+			std::string unescaped;
+			for (;;) {
+				// "key" : value , or }, with the value there
+				if (next + 3 >= count || mData[mOffsets[next]] != '"')
+					return false;
+				size_t open = mOffsets[next], close = mOffsets[next + 1];
+				const char* key = mData + open + 1;
+				size_t keyLength = close - open - 1;
+				if (memchr(key, '\\', keyLength) != NULL) {
+					Builder builder(mData, mLength, mOffsets);
+					if (!builder.text(next, unescaped))
+						return false;
+					key = unescaped.data();
+					keyLength = unescaped.size();
+				}
+				if (mData[mOffsets[next + 2]] != ':')
+					return false;
+				if (keyLength == length && memcmp(key, path, length) == 0) {
+					at = next + 3;
+					break;
+				}
+				next = skip(next + 3);
+				if (next >= count || mData[mOffsets[next]] != ',')
+					return false;
+				++next;
+			}
+		}
+		else if (c == '[') {
+			if (length == 0 || length > 9 || strspn(path, "0123456789") < length)
+				return false;
+			unsigned long index = strtoul(path, NULL, 10);
+			for (unsigned long i = 0; i < index; ++i) {
+				if (next >= count)
+					return false;
+				next = skip(next);
+				if (next >= count || mData[mOffsets[next]] != ',')
+					return false;
+				++next;
+			}
+			char first = (next < count) ? mData[mOffsets[next]] : ']';
+			if (first == ']' || first == ',')
+				return false;
+			at = next;
+		}
+		else
+			return false;
+		if (at >= count)
+			return false;
+		path = (*end == '/') ? end + 1 : end;
+	}
+	return true;
+}
+
+bool IOTP_JsonDocument::has(const char* path) const {
+	size_t at;
+	return find(path, at);
+}
+
+bool IOTP_JsonDocument::get(const char* path, Json::Value& value) const {
+	size_t at;
+	if (!find(path, at))
+		return false;
+	Builder builder(mData, mLength, mOffsets);
+	if (at == 0)
+		return builder.document(value);
+	return builder.subtree(at, value);
+}
+
+std::string IOTP_JsonDocument::getString(const char* path, const std::string& defaultValue) const {
+	size_t at;
+	if (!find(path, at))
+		return defaultValue;
+	std::string text;
+	Builder builder(mData, mLength, mOffsets);
+	if (mData[mOffsets[at]] == '"') {
+		if (!builder.text(at, text))
+			return defaultValue;
+		return text;
+	}
+	Json::Value value;
+	if (!builder.subtree(at, value))
+		return defaultValue;
+	return value.asString();
+}
+
+double IOTP_JsonDocument::getDouble(const char* path, double defaultValue) const {
+	Json::Value value;
+	if (!get(path, value) || !value.isNumeric())
+		return defaultValue;
+	return value.asDouble();
+}
+
+int IOTP_JsonDocument::getInt(const char* path, int defaultValue) const {
+	Json::Value value;
+	if (!get(path, value) || !value.isInt())
+		return defaultValue;
+	return value.asInt();
+}
+
+} /* namespace Watson_IOTP */
@@ -0,0 +1,126 @@
+/*******************************************************************************
+ * Copyright (c) 2017 IBM Corp.
+ *
+ * All rights reserved. This program and the accompanying materials
+ * are made available under the terms of the Eclipse Public License v1.0
+ * and Eclipse Distribution License v1.0 which accompany this distribution.
+ *
+ * The Eclipse Public License is available at
+ *    http://www.eclipse.org/legal/epl-v10.html
+ * and the Eclipse Distribution License is available at
+ *   http://www.eclipse.org/org/documents/edl-v10.php.
+ *
+ * Contributors:
+ *    Vectorized json scanner for inbound messages
+ *******************************************************************************/
+
+#ifndef IOTP_JSONSCANNER_H_
+#define IOTP_JSONSCANNER_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include "json/json.h"
+
+namespace Watson_IOTP {
+
+/**
+ * Parses inbound json in two passes. The first finds the structure of the text 64 bytes at
+ * a time, with AVX2 or SSE4.2 when the processor has them: the brackets, colons and commas
+ * outside strings, every quote that is not escaped, and the first character of each number
+ * and literal. The second walks that index to build the Json::Value, so it only looks at
+ * the bytes of the values themselves.
+ *
+ * The text must be json as RFC 7159 has it: unlike Json::Reader the scanner takes no
+ * comments. Numbers and strings decode to the same values Json::Reader gives them.
+ */
+class IOTP_JsonScanner {
+public:
+	enum Level { SCALAR, SSE42, AVX2 };
+
+	/** The instruction set the first pass uses, the best one the processor has */
+	static Level level();
+
+	/**
+	 * Use another instruction set for the first pass, for comparing them.
+	 * @return false if the processor does not have it
+	 */
+	static bool setLevel(Level level);
+
+	static const char* toName(Level level);
+
+	/**
+	 * Find the structure of a text: the offsets of its brackets, colons, commas, quotes and
+	 * the first characters of its numbers and literals, in order, followed by the length.
+	 * @return false if a string is not closed or the text is 4 GB or more
+	 */
+	static bool index(const char* data, size_t length, std::vector<uint32_t>& offsets);
+
+	/**
+	 * Parse a json text into root.
+	 * @return false if the text is not json; root is then left in an unspecified state
+	 */
+	static bool parse(const char* data, size_t length, Json::Value& root);
+	static bool parse(const std::string& text, Json::Value& root) {
+		return parse(text.data(), text.size(), root);
+	}
+
+	/** The deepest nesting of objects and arrays parse() takes */
+	static const int MAX_DEPTH = 1000;
+};
+
+/**
+ * A json text read on demand: the text is indexed by IOTP_JsonScanner, and a path such as
+ * "d/fields/0/value/latitude" is found by walking the index, skipping the members and
+ * elements it passes over. Only the value at the path is decoded, so reading the reqId of a
+ * message builds no Json::Value at all.
+ *
+ * A path is a list of object member names and array indexes separated by '/'; the empty
+ * path is the whole text. Only the value read is checked to be json, not the rest of the
+ * text. The document keeps a pointer to the text, which must outlive it.
+ */
+class IOTP_JsonDocument {
+public:
+	IOTP_JsonDocument() : mData(NULL), mLength(0), mValid(false) {}
+	IOTP_JsonDocument(const char* data, size_t length) { load(data, length); }
+	explicit IOTP_JsonDocument(const std::string& text) { load(text.data(), text.size()); }
+
+	/**
+	 * Index a text, in place of the one before.
+	 * @return false if the text cannot be indexed, a string in it is not closed
+	 */
+	bool load(const char* data, size_t length);
+
+	bool valid() const { return mValid; }
+	const char* data() const { return mData; }
+	size_t size() const { return mLength; }
+
+	bool has(const char* path) const;
+
+	/**
+	 * Decode the value at a path.
+	 * @return false if there is none or it is not json
+	 */
+	bool get(const char* path, Json::Value& value) const;
+
+	/** The value at a path as Json::Value::asString() has it, or the default if there is none */
+	std::string getString(const char* path, const std::string& defaultValue = "") const;
+
+	double getDouble(const char* path, double defaultValue = 0.0) const;
+
+	int getInt(const char* path, int defaultValue = 0) const;
+
+private:
+	bool find(const char* path, size_t& at) const;
+	size_t skip(size_t at) const;
+
+	const char* mData;
+	size_t mLength;
+	bool mValid;
+	std::vector<uint32_t> mOffsets;
+};
+
+} /* namespace Watson_IOTP */
+
+#endif /* IOTP_JSONSCANNER_H_ */
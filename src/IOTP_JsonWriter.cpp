@@ -0,0 +1,150 @@
+/*******************************************************************************
+ * Copyright (c) 2017 IBM Corp.
+ *
+ * All rights reserved. This program and the accompanying materials
+ * are made available under the terms of the Eclipse Public License v1.0
+ * and Eclipse Distribution License v1.0 which accompany this distribution.
+ *
+ * The Eclipse Public License is available at
+ *    http://www.eclipse.org/legal/epl-v10.html
+ * and the Eclipse Distribution License is available at
+ *   http://www.eclipse.org/org/documents/edl-v10.php.
+ *
+ * Contributors:
+ *    Streaming json writer for outbound payloads
+ *******************************************************************************/
+
+#include "IOTP_JsonWriter.h"
+
+namespace Watson_IOTP {
+
+std::string& IOTP_JsonWriter::threadBuffer() {
+	static thread_local std::string buffer;
+	buffer.clear();
+	return buffer;
+}
+
+IOTP_JsonWriter& IOTP_JsonWriter::key(const char* name, size_t length) {
+	separate();
+	quoted(name, length);
+	mOut += ':';
+	mAfterKey = true;
+	return *this;
+}
+
+IOTP_JsonWriter& IOTP_JsonWriter::value(const char* text, size_t length) {
+	separate();
+	quoted(text, length);
+	return *this;
+}
+
+IOTP_JsonWriter& IOTP_JsonWriter::value(bool flag) {
+	separate();
+	if (flag)
+		mOut.append("true", 4);
+	else
+		mOut.append("false", 5);
+	return *this;
+}
+
+IOTP_JsonWriter& IOTP_JsonWriter::null() {
+	separate();
+	mOut.append("null", 4);
+	return *this;
+}
+
+IOTP_JsonWriter& IOTP_JsonWriter::raw(const char* json, size_t length) {
+	separate();
+	mOut.append(json, length);
+	return *this;
+}
+
+IOTP_JsonWriter& IOTP_JsonWriter::integer(long long number) {
+	separate();
+	char digits[32];
+	mOut.append(digits, Json::valueToChars((Json::LargestInt)number, digits));
+	return *this;
+}
+
+IOTP_JsonWriter& IOTP_JsonWriter::unsignedInteger(unsigned long long number) {
+	separate();
+	char digits[32];
+	mOut.append(digits, Json::valueToChars((Json::LargestUInt)number, digits));
+	return *this;
+}
+
+// as Json::FastWriter writes them: the fewest digits that read back as the number, NaN as
+// null and infinities as numbers too large for a double
+IOTP_JsonWriter& IOTP_JsonWriter::value(double number) {
+	separate();
+	char buffer[32];
+	mOut.append(buffer, Json::valueToChars(number, buffer));
+	return *this;
+}
+
+IOTP_JsonWriter& IOTP_JsonWriter::value(const Json::Value& json) {
+	switch (json.type()) {
+	case Json::nullValue:
+		return null();
+	case Json::booleanValue:
+		return value(json.asBool());
+	case Json::intValue:
+		return integer(json.asLargestInt());
+	case Json::uintValue:
+		return unsignedInteger(json.asLargestUInt());
+	case Json::realValue:
+		return value(json.asDouble());
+	case Json::stringValue: {
+		const char* begin;
+		const char* end;
+		json.getString(&begin, &end);
+		return value(begin, end - begin);
+	}
+	case Json::arrayValue:
+		beginArray();
+		for (Json::ArrayIndex i = 0; i < json.size(); ++i)
+			value(json[i]);
+		return endArray();
+	case Json::objectValue:
+		beginObject();
+		for (Json::Value::const_iterator it = json.begin(); it != json.end(); ++it) {
+			const char* end;
+			const char* name = it.memberName(&end);
+			key(name, end - name);
+			value(*it);
+		}
+		return endObject();
+	}
+	return *this;
+}
+
+void IOTP_JsonWriter::quoted(const char* text, size_t length) {
+	static const char hex[] = "0123456789ABCDEF";
+	mOut += '"';
+	const char* run = text;
+	const char* end = text + length;
+	for (const char* p = text; p < end; ++p) {
+		unsigned char c = (unsigned char)*p;
+		if (c >= 0x20 && c != '"' && c != '\\')
+			continue;
+		mOut.append(run, p - run);
+		run = p + 1;
+		switch (c) {
+		case '"': mOut.append("\\\"", 2); break;
+		case '\\': mOut.append("\\\\", 2); break;
+		case '\b': mOut.append("\\b", 2); break;
+		case '\f': mOut.append("\\f", 2); break;
+		case '\n': mOut.append("\\n", 2); break;
+		case '\r': mOut.append("\\r", 2); break;
+		case '\t': mOut.append("\\t", 2); break;
+		default: {
+			char escaped[6] = { '\\', 'u', '0', '0', hex[c >> 4], hex[c & 0x0f] };
+			mOut.append(escaped, 6);
+		}
+		}
+	}
+	mOut.append(run, end - run);
+	mOut += '"';
+}
+
+} /* namespace Watson_IOTP */
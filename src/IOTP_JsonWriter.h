@@ -0,0 +1,145 @@
+/*******************************************************************************
+ * Copyright (c) 2017 IBM Corp.
+ *
+ * All rights reserved. This program and the accompanying materials
+ * are made available under the terms of the Eclipse Public License v1.0
+ * and Eclipse Distribution License v1.0 which accompany this distribution.
+ *
+ * The Eclipse Public License is available at
+ *    http://www.eclipse.org/legal/epl-v10.html
+ * and the Eclipse Distribution License is available at
+ *   http://www.eclipse.org/org/documents/edl-v10.php.
+ *
+ * Contributors:
+ *    Streaming json writer for outbound payloads
+ *******************************************************************************/
+
+#ifndef IOTP_JSONWRITER_H_
+#define IOTP_JSONWRITER_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <cstring>
+#include <string>
+#include <vector>
+#include "json/json.h"
+
+namespace Watson_IOTP {
+
+/**
+ * Writes json text straight into a buffer, without building a Json::Value first. Commas
+ * and quotes are the writer's business: members are written as key() then a value, or with
+ * member(), and objects and arrays nest to any depth; past 64 deep the writer keeps what it
+ * needs on the heap.
+ *
+ *   IOTP_JsonWriter writer(IOTP_JsonWriter::threadBuffer());
+ *   writer.beginObject().member("rc", 200).member("reqId", reqId).endObject();
+ *
+ * The buffer keeps its capacity when it is cleared, so a message written into a reused
+ * buffer allocates nothing once the buffer has grown to the size of the messages.
+ * Numbers and strings are written as Json::FastWriter writes them.
+ */
+class IOTP_JsonWriter {
+public:
+	/**
+	 * Constructor of an IOTP_JsonWriter, which appends to a buffer
+	 */
+	explicit IOTP_JsonWriter(std::string& out) : mOut(out), mFirst(0), mDepth(0), mAfterKey(false) {}
+
+	/**
+	 * The calling thread's buffer, emptied. Only one message at a time can be written into
+	 * it: it is emptied again the next time it is asked for.
+	 */
+	static std::string& threadBuffer();
+
+	IOTP_JsonWriter& beginObject() { return open('{'); }
+	IOTP_JsonWriter& endObject() { return close('}'); }
+	IOTP_JsonWriter& beginArray() { return open('['); }
+	IOTP_JsonWriter& endArray() { return close(']'); }
+
+	IOTP_JsonWriter& key(const char* name, size_t length);
+	IOTP_JsonWriter& key(const char* name) { return key(name, strlen(name)); }
+	IOTP_JsonWriter& key(const std::string& name) { return key(name.data(), name.size()); }
+
+	IOTP_JsonWriter& value(const char* text, size_t length);
+	IOTP_JsonWriter& value(const char* text) { return value(text, strlen(text)); }
+	IOTP_JsonWriter& value(const std::string& text) { return value(text.data(), text.size()); }
+	IOTP_JsonWriter& value(bool flag);
+	IOTP_JsonWriter& value(int number) { return integer(number); }
+	IOTP_JsonWriter& value(long number) { return integer(number); }
+	IOTP_JsonWriter& value(long long number) { return integer(number); }
+	IOTP_JsonWriter& value(unsigned int number) { return unsignedInteger(number); }
+	IOTP_JsonWriter& value(unsigned long number) { return unsignedInteger(number); }
+	IOTP_JsonWriter& value(unsigned long long number) { return unsignedInteger(number); }
+	IOTP_JsonWriter& value(double number);
+	IOTP_JsonWriter& value(const Json::Value& json);
+	IOTP_JsonWriter& null();
+
+	/** Write text that is already json, such as a message written before */
+	IOTP_JsonWriter& raw(const char* json, size_t length);
+
+	template <typename T>
+	IOTP_JsonWriter& member(const char* name, const T& v) {
+		key(name);
+		return value(v);
+	}
+
+	/** The depth of the objects and arrays not closed yet */
+	int depth() const { return mDepth; }
+
+private:
+	// a comma before every element of an object or array but the first
+	void separate() {
+		if (mAfterKey)
+			mAfterKey = false;
+		else if (mDepth > 0 && !takeFirst(mDepth - 1))
+			mOut += ',';
+	}
+
+	// whether nothing has been written at a depth yet, which it no longer is after
+	bool takeFirst(int depth) {
+		if (depth < 64) {
+			uint64_t bit = 1ULL << depth;
+			bool first = (mFirst & bit) != 0;
+			mFirst &= ~bit;
+			return first;
+		}
+		bool first = mDeepFirst[depth - 64];
+		mDeepFirst[depth - 64] = false;
+		return first;
+	}
+
+	IOTP_JsonWriter& open(char bracket) {
+		separate();
+		mOut += bracket;
+		if (mDepth < 64)
+			mFirst |= 1ULL << mDepth;
+		else {
+			if (mDeepFirst.size() <= (size_t)(mDepth - 64))
+				mDeepFirst.resize(mDepth - 63);
+			mDeepFirst[mDepth - 64] = true;
+		}
+		++mDepth;
+		return *this;
+	}
+
+	IOTP_JsonWriter& close(char bracket) {
+		--mDepth;
+		mOut += bracket;
+		return *this;
+	}
+
+	IOTP_JsonWriter& integer(long long number);
+	IOTP_JsonWriter& unsignedInteger(unsigned long long number);
+	void quoted(const char* text, size_t length);
+
+	std::string& mOut;
+	uint64_t mFirst;		// a bit per depth, set until the first element is written
+	std::vector<bool> mDeepFirst;	// the same, for the depths past 64
+	int mDepth;
+	bool mAfterKey;
+};
+
+} /* namespace Watson_IOTP */
+
+#endif /* IOTP_JSONWRITER_H_ */
@@ -21,6 +21,7 @@
 #include "json/json.h"
 #include "mqtt/message.h"
 #include "IOTP_ReplyMessage.h"
+#include "IOTP_JsonScanner.h"
 
 namespace Watson_IOTP {
 
@@ -51,6 +52,28 @@ public:
 	 */
 	virtual iotp_reply_message_ptr message_arrived(const std::string& topic, mqtt::const_message_ptr msg) =0;
 
+	/**
+	 * This method is called when a json message arrives from the server, before it is parsed.
+	 * Handlers that need only a few fields override it to read them from the document;
+	 * by default the whole payload is parsed for message_arrived(topic, jsonPayload).
+	 * @param topic
+	 * @param payload
+	 * @param msg
+	 */
+	virtual iotp_reply_message_ptr message_arrived(const std::string& topic, const IOTP_JsonDocument& payload,
+			mqtt::const_message_ptr msg) {
+		// Decoded into the thread's arena, which the client releases once the message is handled
+		Json::Value jsonPayload;
+		bool decoded;
+		{
+			Json::Arena::Scope scope(Json::Arena::forThread());
+			decoded = payload.get("", jsonPayload);
+		}
+		if (decoded)
+			return message_arrived(topic, jsonPayload);
+		return message_arrived(topic, msg);
+	}
+
 	friend IOTP_Client;
 
 protected:
@@ -0,0 +1,159 @@
+/*******************************************************************************
+ * Copyright (c) 2017 IBM Corp.
+ *
+ * All rights reserved. This program and the accompanying materials
+ * are made available under the terms of the Eclipse Public License v1.0
+ * and Eclipse Distribution License v1.0 which accompany this distribution.
+ *
+ * The Eclipse Public License is available at
+ *    http://www.eclipse.org/legal/epl-v10.html
+ * and the Eclipse Distribution License is available at
+ *   http://www.eclipse.org/org/documents/edl-v10.php.
+ *
+ * Contributors:
+ *    Payload templates for frequent updates
+ *******************************************************************************/
+
+#include "IOTP_PayloadTemplate.h"
+
+#include <cstring>
+#include "IOTP_JsonScanner.h"
+#include "IOTP_JsonWriter.h"
+
+namespace Watson_IOTP {
+
+static bool isNameChar(char c) {
+	return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c == '_' || c == '.';
+}
+
+bool IOTP_PayloadTemplate::compile(const std::string& shape) {
+	mLiteral.clear();
+	mSlots.clear();
+	mValid = false;
+
+	bool inString = false;
+	for (size_t i = 0; i < shape.size(); ++i) {
+		char c = shape[i];
+		if (inString) {
+			if (c == '\\' && i + 1 < shape.size()) {
+				// the escaped character is copied with its backslash, a quote does not end the string
+				mLiteral += c;
+				c = shape[++i];
+			} else if (c == '"')
+				inString = false;
+		} else if (c == '"') {
+			inString = true;
+		} else if (c == '$') {
+			size_t end = i + 1;
+			while (end < shape.size() && isNameChar(shape[end]))
+				++end;
+			Slot slot;
+			slot.name = shape.substr(i + 1, end - i - 1);
+			if (slot.name.empty() || this->slot(slot.name.c_str()) >= 0)
+				return false;
+			slot.at = mLiteral.size();
+			slot.value = "null";
+			mSlots.push_back(slot);
+			i = end - 1;
+			continue;
+		}
+		mLiteral += c;
+	}
+
+	// every slot a value, the shape must be json
+	Json::Value parsed;
+	mValid = IOTP_JsonScanner::parse(render(), parsed);
+	return mValid;
+}
+
+int IOTP_PayloadTemplate::slot(const char* name) const {
+	for (size_t i = 0; i < mSlots.size(); ++i) {
+		if (mSlots[i].name == name)
+			return (int)i;
+	}
+	return -1;
+}
+
+void IOTP_PayloadTemplate::set(int slot, double number) {
+	if (!has(slot))
+		return;
+	char buffer[32];
+	mSlots[slot].value.assign(buffer, Json::valueToChars(number, buffer));
+}
+
+void IOTP_PayloadTemplate::set(int slot, long long number) {
+	if (!has(slot))
+		return;
+	char buffer[32];
+	mSlots[slot].value.assign(buffer, Json::valueToChars((Json::LargestInt)number, buffer));
+}
+
+void IOTP_PayloadTemplate::set(int slot, bool flag) {
+	if (!has(slot))
+		return;
+	mSlots[slot].value = flag ? "true" : "false";
+}
+
+void IOTP_PayloadTemplate::set(int slot, const char* text, size_t length) {
+	if (!has(slot))
+		return;
+	std::string& value = mSlots[slot].value;
+	value.clear();
+	IOTP_JsonWriter(value).value(text, length);
+}
+
+void IOTP_PayloadTemplate::set(int slot, const char* text) {
+	set(slot, text, strlen(text));
+}
+
+void IOTP_PayloadTemplate::setNull(int slot) {
+	if (!has(slot))
+		return;
+	mSlots[slot].value = "null";
+}
+
+void IOTP_PayloadTemplate::setTime(int slot, time_t seconds, int milliseconds) {
+	if (!has(slot))
+		return;
+	char buffer[sizeof "\"YYYY-MM-DDTHH:MM:SS.mmmZ\""];
+	char* p = buffer;
+	*p++ = '"';
+	memcpy(p, isoSecond(seconds), 19);
+	p += 19;
+	if (milliseconds >= 0) {
+		*p++ = '.';
+		*p++ = (char)('0' + milliseconds / 100 % 10);
+		*p++ = (char)('0' + milliseconds / 10 % 10);
+		*p++ = (char)('0' + milliseconds % 10);
+	}
+	*p++ = 'Z';
+	*p++ = '"';
+	mSlots[slot].value.assign(buffer, p - buffer);
+}
+
+const std::string& IOTP_PayloadTemplate::render() {
+	mOut.clear();
+	size_t from = 0;
+	for (const Slot& slot : mSlots) {
+		mOut.append(mLiteral, from, slot.at - from);
+		mOut += slot.value;
+		from = slot.at;
+	}
+	mOut.append(mLiteral, from, std::string::npos);
+	return mOut;
+}
+
+const char* IOTP_PayloadTemplate::isoSecond(time_t seconds) {
+	static thread_local bool cached = false;
+	static thread_local time_t cachedSecond;
+	static thread_local char cachedText[sizeof "YYYY-MM-DDTHH:MM:SS"];
+	if (!cached || seconds != cachedSecond) {
+		struct tm utc;
+		strftime(cachedText, sizeof cachedText, "%Y-%m-%dT%H:%M:%S", gmtime_r(&seconds, &utc));
+		cachedSecond = seconds;
+		cached = true;
+	}
+	return cachedText;
+}
+
+} /* namespace Watson_IOTP */
@@ -0,0 +1,108 @@
+/*******************************************************************************
+ * Copyright (c) 2017 IBM Corp.
+ *
+ * All rights reserved. This program and the accompanying materials
+ * are made available under the terms of the Eclipse Public License v1.0
+ * and Eclipse Distribution License v1.0 which accompany this distribution.
+ *
+ * The Eclipse Public License is available at
+ *    http://www.eclipse.org/legal/epl-v10.html
+ * and the Eclipse Distribution License is available at
+ *   http://www.eclipse.org/org/documents/edl-v10.php.
+ *
+ * Contributors:
+ *    Payload templates for frequent updates
+ *******************************************************************************/
+
+#ifndef IOTP_PAYLOADTEMPLATE_H_
+#define IOTP_PAYLOADTEMPLATE_H_
+
+#include <stddef.h>
+#include <ctime>
+#include <string>
+#include <vector>
+
+namespace Watson_IOTP {
+
+/**
+ * A payload of a fixed shape, compiled once and written again for every update with new
+ * values. The shape is json in which $name, outside strings, stands for a value:
+ *
+ *   IOTP_PayloadTemplate status("{\"d\":{\"battery\":$battery,\"state\":$state,\"ts\":$ts}}");
+ *   int battery = status.slot("battery");
+ *   ...
+ *   status.set(battery, 87.5);
+ *   status.set(state, "driving");
+ *   status.setTime(ts, time(NULL));
+ *   publish(status.render());
+ *
+ * Everything between the slots is copied as it is; the values are formatted as they are set,
+ * numbers and strings as IOTP_JsonWriter writes them, so rendering builds no Json::Value and
+ * allocates nothing once the template's buffer has grown to the size of the payload.
+ * A slot never set is null, and setting slot -1, which slot() gives for a name the shape
+ * does not have, changes nothing.
+ */
+class IOTP_PayloadTemplate {
+public:
+	IOTP_PayloadTemplate() : mValid(false) {}
+	explicit IOTP_PayloadTemplate(const std::string& shape) { compile(shape); }
+
+	/**
+	 * Compile a shape, in place of the one before.
+	 * @return false if a slot has no name or the same name as another, or the shape is not
+	 * json once its slots are values
+	 */
+	bool compile(const std::string& shape);
+
+	bool valid() const { return mValid; }
+
+	/** The index of the slot of a name, or -1 if the shape has none */
+	int slot(const char* name) const;
+
+	size_t slots() const { return mSlots.size(); }
+
+	void set(int slot, double number);
+	void set(int slot, int number) { set(slot, (long long)number); }
+	void set(int slot, long long number);
+	void set(int slot, bool flag);
+	void set(int slot, const char* text, size_t length);
+	void set(int slot, const char* text);
+	void set(int slot, const std::string& text) { set(slot, text.data(), text.size()); }
+	void setNull(int slot);
+
+	/**
+	 * Set a slot to a time as the platform has them, "2017-03-01T10:15:30Z", or with
+	 * milliseconds "2017-03-01T10:15:30.123Z" when they are given.
+	 */
+	void setTime(int slot, time_t seconds, int milliseconds = -1);
+
+	/**
+	 * The payload with the values the slots have now. It stays in the template's buffer
+	 * until the next render.
+	 */
+	const std::string& render();
+
+	/**
+	 * "YYYY-MM-DDTHH:MM:SS" of a time in UTC, 19 characters not null-terminated. Each thread
+	 * keeps the second it formatted last, so updates within the same second format nothing.
+	 */
+	static const char* isoSecond(time_t seconds);
+
+private:
+	bool has(int slot) const { return slot >= 0 && (size_t)slot < mSlots.size(); }
+
+	struct Slot {
+		std::string name;
+		size_t at;			// where the slot is in the literal text
+		std::string value;
+	};
+
+	std::string mLiteral;	// the shape without its slots
+	std::vector<Slot> mSlots;
+	std::string mOut;
+	bool mValid;
+};
+
+} /* namespace Watson_IOTP */
+
+#endif /* IOTP_PAYLOADTEMPLATE_H_ */
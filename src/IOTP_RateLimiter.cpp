@@ -0,0 +1,224 @@
+/*******************************************************************************
+ * Copyright (c) 2017 IBM Corp.
+ *
+ * All rights reserved. This program and the accompanying materials
+ * are made available under the terms of the Eclipse Public License v1.0
+ * and Eclipse Distribution License v1.0 which accompany this distribution.
+ *
+ * The Eclipse Public License is available at
+ *    http://www.eclipse.org/legal/epl-v10.html
+ * and the Eclipse Distribution License is available at
+ *   http://www.eclipse.org/org/documents/edl-v10.php.
+ *
+ * Contributors:
+ *    Token bucket rate limits for published events
+ *******************************************************************************/
+
+#include "IOTP_RateLimiter.h"
+
+#include <algorithm>
+#include <functional>
+#include <thread>
+
+namespace Watson_IOTP {
+
+IOTP_RateLimiter::Bucket::Bucket(const std::string& k, const Limit& l) :
+	key(k), limit(l), tat(0), pending(false), passed(0), blocked(0), dropped(0), coalesced(0), flushed(0)
+{
+}
+
+IOTP_RateLimiter::IOTP_RateLimiter(double rate, double burst, Policy policy, size_t capacity) :
+	mPolicy(policy),
+	mDefault(toLimit(rate, burst)),
+	mOverflow("", mDefault)
+{
+	size_t size = 1;
+	while (size < capacity)
+		size <<= 1;
+	mMask = size - 1;
+	mTable.reset(new std::atomic<Bucket*>[size]);
+	for (size_t i = 0; i < size; ++i)
+		mTable[i].store(nullptr, std::memory_order_relaxed);
+}
+
+IOTP_RateLimiter::~IOTP_RateLimiter() {
+	for (size_t i = 0; i <= mMask; ++i)
+		delete mTable[i].load(std::memory_order_relaxed);
+}
+
+void IOTP_RateLimiter::setLimit(const std::string& eventType, double rate, double burst) {
+	mLimits[eventType] = toLimit(rate, burst);
+}
+
+IOTP_RateLimiter::Result IOTP_RateLimiter::acquire(const std::string& key, const std::string& eventType,
+		const Message& message, Message* replaced) {
+	if (replaced != nullptr)
+		replaced->context = nullptr;
+	Bucket* bucket = find(key, eventType);
+	if (bucket->limit.interval == 0) {
+		bucket->passed.fetch_add(1, std::memory_order_relaxed);
+		return SEND;
+	}
+
+	// while a message is held, later ones replace it rather than overtake it
+	if (!bucket->pending.load(std::memory_order_acquire)) {
+		int64_t wait = take(*bucket, now());
+		if (wait == 0) {
+			bucket->passed.fetch_add(1, std::memory_order_relaxed);
+			return SEND;
+		}
+		if (mPolicy == BLOCK) {
+			while (wait != 0) {
+				std::this_thread::sleep_for(std::chrono::nanoseconds(wait));
+				wait = take(*bucket, now());
+			}
+			bucket->blocked.fetch_add(1, std::memory_order_relaxed);
+			return SEND;
+		}
+		if (mPolicy == DROP) {
+			bucket->dropped.fetch_add(1, std::memory_order_relaxed);
+			return DROPPED;
+		}
+	}
+	return hold(*bucket, message, replaced);
+}
+
+bool IOTP_RateLimiter::takeCoalesced(Message& message, std::chrono::milliseconds timeout) {
+	std::unique_lock<std::mutex> lck(mPendingLock);
+	std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::now() + timeout;
+	while (true) {
+		int64_t t = now(), next = -1;
+		for (std::vector<Bucket*>::iterator it = mPending.begin(); it != mPending.end(); ++it) {
+			int64_t wait = take(**it, t);
+			if (wait == 0) {
+				Bucket* bucket = *it;
+				std::unique_lock<std::mutex> held(bucket->lock);
+				message = std::move(bucket->held);
+				bucket->pending.store(false, std::memory_order_release);
+				bucket->flushed.fetch_add(1, std::memory_order_relaxed);
+				mPending.erase(it);
+				return true;
+			}
+			if (next < 0 || wait < next)
+				next = wait;
+		}
+
+		std::chrono::steady_clock::time_point until = deadline;
+		if (next >= 0)
+			until = std::min(until, std::chrono::steady_clock::now() + std::chrono::nanoseconds(next));
+		if (std::chrono::steady_clock::now() >= deadline)
+			return false;
+		mPendingCond.wait_until(lck, until);
+	}
+}
+
+IOTP_RateLimiter::Stats IOTP_RateLimiter::stats() const {
+	Stats total = { 0, 0, 0, 0, 0 };
+	for (size_t i = 0; i <= mMask; ++i) {
+		Bucket* bucket = mTable[i].load(std::memory_order_acquire);
+		if (bucket != nullptr)
+			addStats(*bucket, total);
+	}
+	addStats(mOverflow, total);
+	return total;
+}
+
+bool IOTP_RateLimiter::stats(const std::string& key, Stats& stats) const {
+	size_t h = std::hash<std::string>()(key);
+	for (size_t probe = 0; probe <= mMask; ++probe) {
+		Bucket* bucket = mTable[(h + probe) & mMask].load(std::memory_order_acquire);
+		if (bucket == nullptr)
+			return false;
+		if (bucket->key == key) {
+			stats = Stats();
+			addStats(*bucket, stats);
+			return true;
+		}
+	}
+	return false;
+}
+
+IOTP_RateLimiter::Policy IOTP_RateLimiter::toPolicy(const std::string& name) {
+	if (name == "block")
+		return BLOCK;
+	if (name == "coalesce")
+		return COALESCE;
+	return DROP;
+}
+
+int64_t IOTP_RateLimiter::now() {
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(
+			std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+IOTP_RateLimiter::Limit IOTP_RateLimiter::toLimit(double rate, double burst) {
+	Limit limit = { 0, 0 };
+	if (rate > 0) {
+		limit.interval = (int64_t)(1e9 / rate);
+		if (limit.interval < 1)
+			limit.interval = 1;
+		limit.tolerance = (int64_t)((std::max(burst, 1.0) - 1) * limit.interval);
+	}
+	return limit;
+}
+
+// Take a token: returns 0, or the nanoseconds until there is one
+int64_t IOTP_RateLimiter::take(Bucket& bucket, int64_t now) {
+	int64_t tat = bucket.tat.load(std::memory_order_relaxed);
+	while (true) {
+		int64_t start = std::max(tat, now);
+		if (start - now > bucket.limit.tolerance)
+			return start - now - bucket.limit.tolerance;
+		if (bucket.tat.compare_exchange_weak(tat, start + bucket.limit.interval, std::memory_order_relaxed))
+			return 0;
+	}
+}
+
+IOTP_RateLimiter::Bucket* IOTP_RateLimiter::find(const std::string& key, const std::string& eventType) {
+	size_t h = std::hash<std::string>()(key);
+	for (size_t probe = 0; probe <= mMask; ++probe) {
+		std::atomic<Bucket*>& slot = mTable[(h + probe) & mMask];
+		Bucket* bucket = slot.load(std::memory_order_acquire);
+		if (bucket == nullptr) {
+			std::map<std::string, Limit>::const_iterator limit = mLimits.find(eventType);
+			Bucket* created = new Bucket(key, (limit == mLimits.end()) ? mDefault : limit->second);
+			if (slot.compare_exchange_strong(bucket, created, std::memory_order_acq_rel))
+				return created;
+			delete created;		// another publisher filled the slot first
+		}
+		if (bucket->key == key)
+			return bucket;
+	}
+	return &mOverflow;
+}
+
+IOTP_RateLimiter::Result IOTP_RateLimiter::hold(Bucket& bucket, const Message& message, Message* replaced) {
+	bool first;
+	{
+		std::unique_lock<std::mutex> held(bucket.lock);
+		first = !bucket.pending.load(std::memory_order_relaxed);
+		if (!first) {
+			bucket.coalesced.fetch_add(1, std::memory_order_relaxed);
+			if (replaced != nullptr)
+				*replaced = std::move(bucket.held);
+		}
+		bucket.held = message;
+		bucket.pending.store(true, std::memory_order_release);
+	}
+	if (first) {
+		std::unique_lock<std::mutex> lck(mPendingLock);
+		mPending.push_back(&bucket);
+		mPendingCond.notify_one();
+	}
+	return COALESCED;
+}
+
+void IOTP_RateLimiter::addStats(const Bucket& bucket, Stats& stats) const {
+	stats.passed += bucket.passed.load(std::memory_order_relaxed);
+	stats.blocked += bucket.blocked.load(std::memory_order_relaxed);
+	stats.dropped += bucket.dropped.load(std::memory_order_relaxed);
+	stats.coalesced += bucket.coalesced.load(std::memory_order_relaxed);
+	stats.flushed += bucket.flushed.load(std::memory_order_relaxed);
+}
+
+} /* namespace Watson_IOTP */
@@ -0,0 +1,156 @@
+/*******************************************************************************
+ * Copyright (c) 2017 IBM Corp.
+ *
+ * All rights reserved. This program and the accompanying materials
+ * are made available under the terms of the Eclipse Public License v1.0
+ * and Eclipse Distribution License v1.0 which accompany this distribution.
+ *
+ * The Eclipse Public License is available at
+ *    http://www.eclipse.org/legal/epl-v10.html
+ * and the Eclipse Distribution License is available at
+ *   http://www.eclipse.org/org/documents/edl-v10.php.
+ *
+ * Contributors:
+ *    Token bucket rate limits for published events
+ *******************************************************************************/
+
+#ifndef IOTP_RATELIMITER_H_
+#define IOTP_RATELIMITER_H_
+
+#include <stdint.h>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace Watson_IOTP {
+
+/**
+ * Token bucket rate limits for published events, one bucket per key: an event type, or a
+ * device and event type on a gateway. Each event type can have its own rate and burst.
+ *
+ * A bucket is a single atomic theoretical arrival time (GCRA), so taking a token is one
+ * compare-and-swap and the buckets are found in an open addressing table of atomic
+ * pointers without a lock. Only messages over the limit take the slow path, according to
+ * the policy: the caller waits for a token, the message is dropped, or it is held in its
+ * bucket in place of any message held before it and published when a token is available.
+ */
+class IOTP_RateLimiter {
+public:
+	typedef std::shared_ptr<IOTP_RateLimiter> ptr_t;
+
+	enum Policy { BLOCK, DROP, COALESCE };
+	enum Result { SEND, DROPPED, COALESCED };
+
+	/** A message held by the coalesce policy */
+	struct Message {
+		std::string topic;
+		std::string payload;
+		int qos;
+		void* context;		// the publisher's, given back with the message
+	};
+
+	/** Counters of a bucket, or of all of them */
+	struct Stats {
+		uint64_t passed;	// sent when published
+		uint64_t blocked;	// sent after the publisher waited for a token
+		uint64_t dropped;	// dropped over the limit
+		uint64_t coalesced;	// held, then replaced by a later message before it was sent
+		uint64_t flushed;	// held, then sent when a token was available
+	};
+
+	static const size_t DEFAULT_CAPACITY = 4096;
+
+	/**
+	 * Constructor of an IOTP_RateLimiter.
+	 * @param rate - tokens per second of a bucket with no limit of its own, 0 for no limit
+	 * @param burst - tokens a full bucket holds, at least 1
+	 * @param policy - what happens to a message over the limit
+	 * @param capacity - buckets kept, keys beyond these share one bucket
+	 */
+	IOTP_RateLimiter(double rate, double burst, Policy policy, size_t capacity = DEFAULT_CAPACITY);
+
+	~IOTP_RateLimiter();
+
+	/**
+	 * Set the limit of the buckets of an event type. Limits are set up before publishing
+	 * starts, they do not change buckets already in use.
+	 * @param rate - tokens per second, 0 for no limit
+	 */
+	void setLimit(const std::string& eventType, double rate, double burst);
+
+	/**
+	 * Take a token for a message. With the block policy this waits until there is one.
+	 * @param key - the bucket: an event type, or device type, id and event type
+	 * @param eventType - selects the limit of a new bucket
+	 * @param message - the message, held by the coalesce policy
+	 * @param replaced - set to the message held before, which this one replaced and which
+	 * will not be published, when the result is COALESCED; its context is null if there was none
+	 * @return SEND if the message is to be published now
+	 */
+	Result acquire(const std::string& key, const std::string& eventType, const Message& message,
+			Message* replaced = nullptr);
+
+	/**
+	 * Wait for a held message whose bucket has a token again.
+	 * @param message - set to the message to publish
+	 * @param timeout - longest time to wait
+	 * @return false if no message became due in time
+	 */
+	bool takeCoalesced(Message& message, std::chrono::milliseconds timeout);
+
+	Stats stats() const;
+	bool stats(const std::string& key, Stats& stats) const;
+	Policy policy() const { return mPolicy; }
+
+	/**
+	 * Convert a policy name, "block", "drop" or "coalesce", to its value. Unknown names map
+	 * to DROP.
+	 */
+	static Policy toPolicy(const std::string& name);
+
+private:
+	struct Limit {
+		int64_t interval;	// nanoseconds per token, 0 for no limit
+		int64_t tolerance;	// nanoseconds of tokens a full bucket holds beyond the first
+	};
+
+	struct Bucket {
+		Bucket(const std::string& k, const Limit& l);
+		std::string key;
+		Limit limit;
+		std::atomic<int64_t> tat;			// when the bucket is full again
+		std::atomic<bool> pending;			// a message is held
+		std::atomic<uint64_t> passed, blocked, dropped, coalesced, flushed;
+		std::mutex lock;					// guards held
+		Message held;
+	};
+
+	static int64_t now();
+	static Limit toLimit(double rate, double burst);
+	static int64_t take(Bucket& bucket, int64_t now);
+	Bucket* find(const std::string& key, const std::string& eventType);
+	Result hold(Bucket& bucket, const Message& message, Message* replaced);
+	void addStats(const Bucket& bucket, Stats& stats) const;
+
+	Policy mPolicy;
+	Limit mDefault;
+	std::map<std::string, Limit> mLimits;
+	size_t mMask;
+	std::unique_ptr<std::atomic<Bucket*>[]> mTable;
+	Bucket mOverflow;
+
+	std::mutex mPendingLock;
+	std::condition_variable mPendingCond;
+	std::vector<Bucket*> mPending;			// buckets holding a message
+};
+
+typedef IOTP_RateLimiter::ptr_t iotp_rate_limiter_ptr;
+
+} /* namespace Watson_IOTP */
+
+#endif /* IOTP_RATELIMITER_H_ */
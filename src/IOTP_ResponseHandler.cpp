@@ -22,6 +22,8 @@
 
 #include "json/json.h"
 #include "IOTP_ResponseHandler.h"
+#include "IOTP_JsonScanner.h"
+#include "IOTP_JsonWriter.h"
 
 namespace Watson_IOTP {
 
@@ -34,25 +36,35 @@ namespace Watson_IOTP {
 	}
 
 	iotp_reply_message_ptr IOTP_ResponseHandler::message_arrived(const std::string& topic, Json::Value& jsonPayload) {
+		std::string text;
+		IOTP_JsonWriter(text).value(jsonPayload);
+		add_response(topic, jsonPayload.get("reqId", "").asString(), text.data(), text.size());
+		return nullptr;
+	}
+
+	iotp_reply_message_ptr IOTP_ResponseHandler::message_arrived(const std::string& topic, const IOTP_JsonDocument& payload,
+			mqtt::const_message_ptr msg) {
+		add_response(topic, payload.getString("reqId"), payload.data(), payload.size());
+		return nullptr;
+	}
+
+	void IOTP_ResponseHandler::add_response(const std::string& topic, const std::string& reqId, const char* text, size_t length) {
 		guard g(mLock);
 
-		std::string reqId = jsonPayload.get("reqId", "").asString();
 		if (reqId.empty() == false) {
-			mResponseMessages[reqId] = jsonPayload;
+			mResponseMessages[reqId].assign(text, length);
 		} else {
 			std::cout << typeid(*this).name() << "Message arrived at TOPIC " << topic << " without a reqId field." << std::endl;
 		}
 
 		g.unlock();
 		mCond.notify_all();
-		return nullptr;
 	}
 
 	iotp_reply_message_ptr IOTP_ResponseHandler::message_arrived(const std::string& topic, mqtt::const_message_ptr msg) {
 		Json::Value jsonPayload;
-		Json::Reader reader;
 
-		if (reader.parse(msg->get_payload(), jsonPayload)) {
+		if (IOTP_JsonScanner::parse(msg->get_payload(), jsonPayload)) {
 			message_arrived(topic, jsonPayload);
 		} else {
 			std::cout << typeid(*this).name() << " Message arrived at TOPIC " << topic << " is not a JSON string." << std::endl;
@@ -68,7 +80,7 @@ namespace Watson_IOTP {
 			return jsonPayload;
 		auto search = mResponseMessages.find(reqId);
 		if(search != mResponseMessages.end()) {
-			jsonPayload = search->second;
+			IOTP_JsonScanner::parse(search->second, jsonPayload);
 			mResponseMessages.erase(search);
 		}
 		return jsonPayload;
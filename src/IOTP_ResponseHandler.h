@@ -13,6 +13,7 @@
  * Contributors:
  *    Mike Tran - initial API and implementation and/or initial documentation
  *    Lokesh Haralakatta - Updates to match with latest mqtt lib changes
+ *    Keep responses as text and read their reqId without parsing them
  *******************************************************************************/
 
 #ifndef IOTF_RESPONSEHANDLER_H_
@@ -37,13 +38,22 @@ public:
 
 	iotp_reply_message_ptr message_arrived(const std::string& topic, mqtt::const_message_ptr msg);
 
+	/**
+	 * Only the reqId of a response is read when it arrives; the rest is parsed by
+	 * wait_for_response, for the responses waited for.
+	 */
+	iotp_reply_message_ptr message_arrived(const std::string& topic, const IOTP_JsonDocument& payload,
+			mqtt::const_message_ptr msg);
+
 	Json::Value const wait_for_response(long timeout, const std::string& reqId);
 
 private:
+	void add_response(const std::string& topic, const std::string& reqId, const char* text, size_t length);
+
 	typedef std::unique_lock<std::mutex> guard;
 	mutable std::mutex mLock;
 	mutable std::condition_variable mCond;
-	std::map<std::string, Json::Value> mResponseMessages;
+	std::map<std::string, std::string> mResponseMessages;
 };
 typedef IOTP_ResponseHandler::ptr_t iotp_response_handler_ptr;
 }
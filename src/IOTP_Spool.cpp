@@ -0,0 +1,419 @@
+/*******************************************************************************
+ * Copyright (c) 2017 IBM Corp.
+ *
+ * All rights reserved. This program and the accompanying materials
+ * are made available under the terms of the Eclipse Public License v1.0
+ * and Eclipse Distribution License v1.0 which accompany this distribution.
+ *
+ * The Eclipse Public License is available at
+ *    http://www.eclipse.org/legal/epl-v10.html
+ * and the Eclipse Distribution License is available at
+ *   http://www.eclipse.org/org/documents/edl-v10.php.
+ *
+ * Contributors:
+ *    Disk backed store-and-forward spool for offline publishing
+ *******************************************************************************/
+
+#include <iostream>
+#include <typeinfo>
+#include <vector>
+#include <algorithm>
+#include <cstring>
+#include <cstddef>
+#include <cstdio>
+#include <cstdint>
+#include <cerrno>
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "IOTP_Spool.h"
+
+namespace Watson_IOTP {
+
+	/*
+	 * Every record is a fixed header followed by the topic and the payload.  The only
+	 * in-place update is the flags byte, set when a record is dropped from the middle
+	 * of the log by the lowest priority policy.
+	 */
+	namespace {
+		const uint32_t RECORD_MAGIC = 0x31505349;	// "ISP1"
+		const uint8_t RECORD_DROPPED = 0x01;
+		const char* const SEGMENT_SUFFIX = ".seg";
+		const char* const CURSOR_FILE = "cursor";
+
+		struct RecordHeader {
+			uint32_t magic;
+			uint32_t length;		// bytes of topic and payload
+			uint32_t checksum;		// FNV-1a of topic and payload
+			uint8_t flags;
+			uint8_t qos;
+			uint8_t priority;
+			uint8_t reserved;
+			uint16_t topicLength;
+			uint16_t reserved2;
+		};
+		const size_t FLAGS_OFFSET = offsetof(RecordHeader, flags);
+
+		uint32_t checksum(const char* data, size_t len, uint32_t hash = 2166136261u) {
+			for (size_t i = 0; i < len; ++i) {
+				hash ^= (unsigned char) data[i];
+				hash *= 16777619u;
+			}
+			return hash;
+		}
+
+		bool writeFully(int fd, const char* buf, size_t len, off_t offset) {
+			while (len > 0) {
+				ssize_t n = pwrite(fd, buf, len, offset);
+				if (n < 0) {
+					if (errno == EINTR)
+						continue;
+					return false;
+				}
+				buf += n;
+				len -= n;
+				offset += n;
+			}
+			return true;
+		}
+
+		bool readFully(int fd, char* buf, size_t len, off_t offset) {
+			while (len > 0) {
+				ssize_t n = pread(fd, buf, len, offset);
+				if (n <= 0) {
+					if (n < 0 && errno == EINTR)
+						continue;
+					return false;
+				}
+				buf += n;
+				len -= n;
+				offset += n;
+			}
+			return true;
+		}
+	}
+
+	IOTP_Spool::IOTP_Spool(const std::string& directory, unsigned long long maxBytes, DropPolicy policy,
+			unsigned long segmentBytes) :
+		mDirectory(directory), mMaxBytes(maxBytes), mPolicy(policy), mSegmentBytes(segmentBytes),
+		mOpen(false), mFirstSeq(0), mInflightSeq(~0ULL), mTailSegment(0), mTailOffset(0), mHeadSegment(0), mHeadOffset(0),
+		mCursorFd(-1), mCount(0), mBytes(0), mDropped(0)
+	{
+		mkdir(mDirectory.c_str(), 0700);
+		mOpen = recover();
+		if (!mOpen)
+			std::cout << typeid(*this).name() << " Failed to open spool directory " << mDirectory << std::endl;
+	}
+
+	IOTP_Spool::~IOTP_Spool() {
+		guard g(mLock);
+		for (auto it = mSegments.begin(); it != mSegments.end(); ++it) {
+			fdatasync(it->second);
+			close(it->second);
+		}
+		if (mCursorFd >= 0)
+			close(mCursorFd);
+	}
+
+	IOTP_Spool::DropPolicy IOTP_Spool::toDropPolicy(const std::string& name) {
+		if (name.compare("lowest-priority") == 0)
+			return DROP_LOWEST_PRIORITY;
+		if (name.compare("newest") == 0)
+			return DROP_NEWEST;
+		return DROP_OLDEST;
+	}
+
+	std::string IOTP_Spool::segmentPath(unsigned long long segment) const {
+		char name[32];
+		snprintf(name, sizeof(name), "%016llx%s", segment, SEGMENT_SUFFIX);
+		return mDirectory + "/" + name;
+	}
+
+	int IOTP_Spool::segmentFd(unsigned long long segment) {
+		auto it = mSegments.find(segment);
+		if (it != mSegments.end())
+			return it->second;
+		int fd = ::open(segmentPath(segment).c_str(), O_RDWR | O_CREAT, 0600);
+		if (fd >= 0)
+			mSegments[segment] = fd;
+		return fd;
+	}
+
+	/**
+	 * Rebuild the index from the segment files, starting at the saved read cursor.
+	 */
+	bool IOTP_Spool::recover() {
+		std::vector<unsigned long long> segments;
+		DIR* dir = opendir(mDirectory.c_str());
+		if (dir == NULL)
+			return false;
+		struct dirent* entry;
+		while ((entry = readdir(dir)) != NULL) {
+			std::string name = entry->d_name;
+			size_t suffix = name.rfind(SEGMENT_SUFFIX);
+			if (suffix != std::string::npos && suffix + strlen(SEGMENT_SUFFIX) == name.size() && suffix > 0)
+				segments.push_back(std::stoull(name.substr(0, suffix), nullptr, 16));
+		}
+		closedir(dir);
+		std::sort(segments.begin(), segments.end());
+
+		std::string cursorPath = mDirectory + "/" + CURSOR_FILE;
+		if ((mCursorFd = ::open(cursorPath.c_str(), O_RDWR | O_CREAT, 0600)) < 0)
+			return false;
+		uint64_t cursor[2] = { 0, 0 };
+		if (readFully(mCursorFd, (char*) cursor, sizeof(cursor), 0)) {
+			mHeadSegment = cursor[0];
+			mHeadOffset = cursor[1];
+		}
+		else if (!segments.empty()) {
+			mHeadSegment = segments.front();
+			mHeadOffset = 0;
+		}
+
+		for (size_t i = 0; i < segments.size(); ++i) {
+			if (segments[i] < mHeadSegment)
+				unlink(segmentPath(segments[i]).c_str());
+			else if (!scanSegment(segments[i], (segments[i] == mHeadSegment) ? mHeadOffset : 0))
+				return false;
+		}
+
+		if (mSegments.empty()) {
+			mTailSegment = (mHeadSegment > 0) ? mHeadSegment : 1;
+			mTailOffset = 0;
+			if (segmentFd(mTailSegment) < 0)
+				return false;
+		}
+		advance();
+		return true;
+	}
+
+	/**
+	 * Index the records of one segment from an offset.  A torn or corrupt record ends the
+	 * segment, which is truncated there.
+	 */
+	bool IOTP_Spool::scanSegment(unsigned long long segment, unsigned long long offset) {
+		int fd = segmentFd(segment);
+		if (fd < 0)
+			return false;
+		struct stat st;
+		if (fstat(fd, &st) != 0)
+			return false;
+		unsigned long long end = st.st_size;
+		std::vector<char> data(end - std::min(offset, end));
+		if (!data.empty() && !readFully(fd, data.data(), data.size(), offset))
+			return false;
+
+		const char* p = data.data();
+		const char* limit = p + data.size();
+		while (limit - p >= (ptrdiff_t) sizeof(RecordHeader)) {
+			RecordHeader header;
+			memcpy(&header, p, sizeof(header));
+			if (header.magic != RECORD_MAGIC || header.topicLength > header.length
+					|| (unsigned long long) (limit - p) - sizeof(header) < header.length
+					|| checksum(p + sizeof(header), header.length) != header.checksum)
+				break;
+			unsigned int size = sizeof(header) + header.length;
+			if ((header.flags & RECORD_DROPPED) == 0) {
+				Entry e = { segment, offset, size, header.priority, false };
+				if (mEntries.empty())
+					mFirstSeq = 0;
+				mByPriority[e.priority].push_back(mFirstSeq + mEntries.size());
+				mEntries.push_back(e);
+				++mCount;
+				mBytes += size;
+			}
+			offset += size;
+			p += size;
+		}
+		if (offset < end) {
+			std::cout << typeid(*this).name() << " Truncating spool segment " << segmentPath(segment)
+					<< " at offset " << offset << std::endl;
+			if (ftruncate(fd, offset) != 0)
+				return false;
+		}
+		mTailSegment = segment;
+		mTailOffset = offset;
+		return true;
+	}
+
+	bool IOTP_Spool::startSegment() {
+		int fd = segmentFd(mTailSegment);
+		if (fd >= 0)
+			fdatasync(fd);
+		++mTailSegment;
+		mTailOffset = 0;
+		return segmentFd(mTailSegment) >= 0;
+	}
+
+	/**
+	 * Drop records according to the policy until a new record of the given size fits.
+	 * @return false if the new record is the one to drop
+	 */
+	bool IOTP_Spool::makeRoom(unsigned int size, int priority) {
+		while (mBytes + size > mMaxBytes) {
+			if (mCount == 0 || mPolicy == DROP_NEWEST)
+				return false;
+			if (mPolicy == DROP_OLDEST)
+				dropEntry(mFirstSeq);
+			else {
+				auto lowest = mByPriority.begin();
+				if (lowest->first > priority)
+					return false;
+				dropEntry(lowest->second.front());
+			}
+			++mDropped;
+		}
+		return true;
+	}
+
+	/**
+	 * Remove a live record, which must be the oldest of its priority.
+	 */
+	void IOTP_Spool::dropEntry(unsigned long long seq) {
+		Entry& e = mEntries[seq - mFirstSeq];
+		e.dropped = true;
+		std::deque<unsigned long long>& bucket = mByPriority[e.priority];
+		bucket.pop_front();
+		if (bucket.empty())
+			mByPriority.erase(e.priority);
+		--mCount;
+		mBytes -= e.size;
+		if (seq != mFirstSeq) {	// the cursor does not skip it, so mark it on disk
+			char flags = RECORD_DROPPED;
+			int fd = segmentFd(e.segment);
+			if (fd >= 0)
+				writeFully(fd, &flags, 1, e.offset + FLAGS_OFFSET);
+		}
+		advance();
+	}
+
+	/**
+	 * Move the read cursor past removed records and delete the segments it has left.
+	 */
+	void IOTP_Spool::advance() {
+		while (!mEntries.empty() && mEntries.front().dropped) {
+			mEntries.pop_front();
+			++mFirstSeq;
+		}
+		unsigned long long headSegment = mTailSegment, headOffset = mTailOffset;
+		if (!mEntries.empty()) {
+			headSegment = mEntries.front().segment;
+			headOffset = mEntries.front().offset;
+		}
+		while (!mSegments.empty() && mSegments.begin()->first < headSegment) {
+			close(mSegments.begin()->second);
+			unlink(segmentPath(mSegments.begin()->first).c_str());
+			mSegments.erase(mSegments.begin());
+		}
+		if (headSegment != mHeadSegment || headOffset != mHeadOffset) {
+			mHeadSegment = headSegment;
+			mHeadOffset = headOffset;
+			saveCursor();
+		}
+	}
+
+	void IOTP_Spool::saveCursor() {
+		uint64_t cursor[2] = { mHeadSegment, mHeadOffset };
+		if (mCursorFd >= 0)
+			writeFully(mCursorFd, (const char*) cursor, sizeof(cursor), 0);
+	}
+
+	bool IOTP_Spool::append(const std::string& topic, const std::string& payload, int qos, int priority) {
+		guard g(mLock);
+		if (!mOpen || topic.size() > 0xFFFF)
+			return false;
+		priority = std::max(0, std::min(priority, 255));
+		RecordHeader header;
+		memset(&header, 0, sizeof(header));
+		header.magic = RECORD_MAGIC;
+		header.length = topic.size() + payload.size();
+		header.checksum = checksum(payload.data(), payload.size(), checksum(topic.data(), topic.size()));
+		header.qos = qos;
+		header.priority = priority;
+		header.topicLength = topic.size();
+		unsigned int size = sizeof(header) + header.length;
+
+		if (size > mMaxBytes || !makeRoom(size, priority)) {
+			++mDropped;
+			return false;
+		}
+		if (mTailOffset > 0 && mTailOffset + size > mSegmentBytes && !startSegment())
+			return false;
+
+		std::string record;
+		record.reserve(size);
+		record.append((const char*) &header, sizeof(header));
+		record.append(topic);
+		record.append(payload);
+		int fd = segmentFd(mTailSegment);
+		if (fd < 0 || !writeFully(fd, record.data(), record.size(), mTailOffset))
+			return false;
+
+		Entry e = { mTailSegment, mTailOffset, size, priority, false };
+		mByPriority[priority].push_back(mFirstSeq + mEntries.size());
+		mEntries.push_back(e);
+		++mCount;
+		mBytes += size;
+		mTailOffset += size;
+		return true;
+	}
+
+	bool IOTP_Spool::front(Record& record) {
+		guard g(mLock);
+		if (mEntries.empty())
+			return false;
+		const Entry& e = mEntries.front();
+		int fd = segmentFd(e.segment);
+		std::string buf(e.size, '\0');
+		if (fd < 0 || !readFully(fd, &buf[0], e.size, e.offset))
+			return false;
+		RecordHeader header;
+		memcpy(&header, buf.data(), sizeof(header));
+		record.topic.assign(buf, sizeof(header), header.topicLength);
+		record.payload.assign(buf, sizeof(header) + header.topicLength, header.length - header.topicLength);
+		record.qos = header.qos;
+		record.priority = header.priority;
+		mInflightSeq = mFirstSeq;
+		return true;
+	}
+
+	void IOTP_Spool::pop() {
+		guard g(mLock);
+		// the record returned by front() may have been dropped to make room meanwhile
+		if (mEntries.empty() || mInflightSeq != mFirstSeq)
+			return;
+		Entry& e = mEntries.front();
+		std::deque<unsigned long long>& bucket = mByPriority[e.priority];
+		bucket.pop_front();
+		if (bucket.empty())
+			mByPriority.erase(e.priority);
+		e.dropped = true;
+		--mCount;
+		mBytes -= e.size;
+		mInflightSeq = ~0ULL;
+		advance();
+	}
+
+	bool IOTP_Spool::empty() {
+		guard g(mLock);
+		return mCount == 0;
+	}
+
+	size_t IOTP_Spool::count() {
+		guard g(mLock);
+		return mCount;
+	}
+
+	unsigned long long IOTP_Spool::bytes() {
+		guard g(mLock);
+		return mBytes;
+	}
+
+	unsigned long long IOTP_Spool::dropped() {
+		guard g(mLock);
+		return mDropped;
+	}
+}
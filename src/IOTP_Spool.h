@@ -0,0 +1,146 @@
+/*******************************************************************************
+ * Copyright (c) 2017 IBM Corp.
+ *
+ * All rights reserved. This program and the accompanying materials
+ * are made available under the terms of the Eclipse Public License v1.0
+ * and Eclipse Distribution License v1.0 which accompany this distribution.
+ *
+ * The Eclipse Public License is available at
+ *    http://www.eclipse.org/legal/epl-v10.html
+ * and the Eclipse Distribution License is available at
+ *   http://www.eclipse.org/org/documents/edl-v10.php.
+ *
+ * Contributors:
+ *    Disk backed store-and-forward spool for offline publishing
+ *******************************************************************************/
+
+#ifndef IOTP_SPOOL_H_
+#define IOTP_SPOOL_H_
+
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+
+namespace Watson_IOTP {
+
+/**
+ * Store-and-forward spool for events published while the client is offline.
+ *
+ * Records are appended to segment files in the spool directory and survive a restart of the
+ * process. Records are read back in the order they were written and removed once delivered.
+ * A record is only removed after its delivery is confirmed, so one whose confirmation is lost
+ * or late, or a crash between delivery and pop(), has it sent again: delivery is at least
+ * once and the receiver may see duplicates.
+ * When an append would take the live records over the byte cap, the drop policy decides
+ * which record is discarded: the oldest one, the one with the lowest priority (oldest first
+ * among equal priorities), or the new one.
+ */
+class IOTP_Spool {
+public:
+	typedef std::shared_ptr<IOTP_Spool> ptr_t;
+
+	enum DropPolicy { DROP_OLDEST, DROP_LOWEST_PRIORITY, DROP_NEWEST };
+
+	/** A spooled message */
+	struct Record {
+		std::string topic;
+		std::string payload;
+		int qos;
+		int priority;
+	};
+
+	static const unsigned long DEFAULT_SEGMENT_BYTES = 4 * 1024 * 1024;
+
+	/**
+	 * Constructor of an IOTP_Spool. Opens the spool in the given directory, creating it
+	 * if needed, and recovers any records left by a previous run.
+	 * @param directory - directory holding the segment files
+	 * @param maxBytes - cap on the bytes of the records held
+	 * @param policy - which record to drop when the cap is reached
+	 * @param segmentBytes - size after which a new segment file is started
+	 */
+	IOTP_Spool(const std::string& directory, unsigned long long maxBytes, DropPolicy policy,
+			unsigned long segmentBytes = DEFAULT_SEGMENT_BYTES);
+
+	~IOTP_Spool();
+
+	/**
+	 * Append a message to the spool.
+	 * @return false if the message was dropped or could not be written
+	 */
+	bool append(const std::string& topic, const std::string& payload, int qos, int priority = 0);
+
+	/**
+	 * Read the oldest record without removing it.
+	 * @return false if the spool is empty
+	 */
+	bool front(Record& record);
+
+	/**
+	 * Remove the oldest record, after it has been delivered. Until then front() returns it
+	 * again, also after a restart.
+	 */
+	void pop();
+
+	bool isOpen() const { return mOpen; }
+	bool empty();
+	size_t count();
+	unsigned long long bytes();
+	unsigned long long dropped();
+
+	/**
+	 * Convert a drop policy name, "oldest", "lowest-priority" or "newest", to its value.
+	 * Unknown names map to DROP_OLDEST.
+	 */
+	static DropPolicy toDropPolicy(const std::string& name);
+
+private:
+	struct Entry {
+		unsigned long long segment;
+		unsigned long long offset;
+		unsigned int size;
+		int priority;
+		bool dropped;
+	};
+
+	typedef std::unique_lock<std::mutex> guard;
+
+	bool recover();
+	bool scanSegment(unsigned long long segment, unsigned long long offset);
+	int segmentFd(unsigned long long segment);
+	std::string segmentPath(unsigned long long segment) const;
+	bool startSegment();
+	bool makeRoom(unsigned int size, int priority);
+	void dropEntry(unsigned long long seq);
+	void advance();
+	void saveCursor();
+
+	std::string mDirectory;
+	unsigned long long mMaxBytes;
+	DropPolicy mPolicy;
+	unsigned long mSegmentBytes;
+	bool mOpen;
+
+	std::mutex mLock;
+	std::deque<Entry> mEntries;				// live and dropped records, oldest first
+	unsigned long long mFirstSeq;			// sequence number of mEntries.front()
+	unsigned long long mInflightSeq;		// sequence number of the record returned by front()
+	std::map<int, std::deque<unsigned long long> > mByPriority;	// live sequence numbers per priority
+	std::map<unsigned long long, int> mSegments;	// open segment files
+	unsigned long long mTailSegment;
+	unsigned long long mTailOffset;
+	unsigned long long mHeadSegment;		// read cursor, persisted in the cursor file
+	unsigned long long mHeadOffset;
+	int mCursorFd;
+	size_t mCount;
+	unsigned long long mBytes;
+	unsigned long long mDropped;
+};
+
+typedef IOTP_Spool::ptr_t iotp_spool_ptr;
+
+}
+
+#endif /* IOTP_SPOOL_H_ */
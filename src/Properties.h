@@ -14,6 +14,15 @@
  *    Hari Prasada Reddy - initial API and implementation and/or initial documentation
  *    Lokesh K Haralakatta - Added required members amd methods for Secure Connetion
  *    Lokesh K Haralakatta - Added custom port support
+ *    Added offline buffering and spool settings
+ *    Added persistence settings
+ *    Added gateway shard count
+ *    Added in-flight window settings
+ *    Added event rate limit settings
+ *    Added latest-value coalescing setting
+ *    Added windowed aggregation settings
+ *    Added deadband filter settings
+ *    Added payload compression settings
  *******************************************************************************/
 
 #ifndef SRC_PROPERTIES_H_
@@ -34,11 +43,41 @@ private:
 	std::string keyPassPhrase;
 	int port;
 	bool useCerts;
+	int maxBufferedMessages;
+	std::string spoolDirectory;
+	unsigned long long spoolMaxBytes;
+	std::string spoolDropPolicy;
+	int spoolDrainRate;
+	std::string persistenceType;
+	std::string persistenceDirectory;
+	int persistenceSnapshotInterval;
+	int gatewayShards;
+	std::string inflightControl;
+	int maxInflight;
+	int rateLimit;
+	int rateBurst;
+	std::string rateLimitPolicy;
+	std::string rateLimitEvents;
+	std::string coalesceEvents;
+	int aggregateWindow;
+	int aggregateSlide;
+	std::string aggregateEvents;
+	std::string deadbandEvents;
+	int deadbandHeartbeat;
+	std::string compression;
+	int compressionThreshold;
+	int compressionTrainSamples;
 
 public:
 	Properties(): orgId(""), domain("internetofthings.ibmcloud.com"), deviceType(""), deviceId(""),
 	authMethod(""), authToken(""), port(8883),useCerts(false), trustStore(""),keyStore(""),
-	privateKey(""),keyPassPhrase("") {}
+	privateKey(""),keyPassPhrase(""), maxBufferedMessages(0), spoolDirectory(""),
+	spoolMaxBytes(64 * 1024 * 1024), spoolDropPolicy("oldest"), spoolDrainRate(100),
+	persistenceType("default"), persistenceDirectory(""), persistenceSnapshotInterval(1000), gatewayShards(1),
+	inflightControl("none"), maxInflight(10), rateLimit(0), rateBurst(0), rateLimitPolicy("drop"), rateLimitEvents(""),
+	coalesceEvents(""), aggregateWindow(0), aggregateSlide(0), aggregateEvents(""),
+	deadbandEvents(""), deadbandHeartbeat(0), compression("none"), compressionThreshold(256),
+	compressionTrainSamples(0) {}
 
 	std::string getorgId(){ return orgId;}
 	std::string getdomain(){ return domain;}
@@ -52,6 +91,30 @@ public:
 	std::string getkeyStore(){ return keyStore;}
 	std::string getprivateKey(){ return privateKey;}
 	std::string getkeyPassPhrase(){ return keyPassPhrase;}
+	int getmaxBufferedMessages(){ return maxBufferedMessages;}
+	std::string getspoolDirectory(){ return spoolDirectory;}
+	unsigned long long getspoolMaxBytes(){ return spoolMaxBytes;}
+	std::string getspoolDropPolicy(){ return spoolDropPolicy;}
+	int getspoolDrainRate(){ return spoolDrainRate;}
+	std::string getpersistenceType(){ return persistenceType;}
+	std::string getpersistenceDirectory(){ return persistenceDirectory;}
+	int getpersistenceSnapshotInterval(){ return persistenceSnapshotInterval;}
+	int getgatewayShards(){ return gatewayShards;}
+	std::string getinflightControl(){ return inflightControl;}
+	int getmaxInflight(){ return maxInflight;}
+	int getrateLimit(){ return rateLimit;}
+	int getrateBurst(){ return rateBurst;}
+	std::string getrateLimitPolicy(){ return rateLimitPolicy;}
+	std::string getrateLimitEvents(){ return rateLimitEvents;}
+	std::string getcoalesceEvents(){ return coalesceEvents;}
+	int getaggregateWindow(){ return aggregateWindow;}
+	int getaggregateSlide(){ return aggregateSlide;}
+	std::string getaggregateEvents(){ return aggregateEvents;}
+	std::string getdeadbandEvents(){ return deadbandEvents;}
+	int getdeadbandHeartbeat(){ return deadbandHeartbeat;}
+	std::string getcompression(){ return compression;}
+	int getcompressionThreshold(){ return compressionThreshold;}
+	int getcompressionTrainSamples(){ return compressionTrainSamples;}
 
 	void setorgId(const std::string& org){ orgId = org;}
 	void setdomain(const std::string& domainName){ domain = domainName;}
@@ -65,6 +128,30 @@ public:
 	void setkeyStore(const std::string& keystore){ keyStore = keystore;}
 	void setprivateKey(const std::string& privatekey){ privateKey = privatekey;}
 	void setkeyPassPhrase(const std::string& passphrase){ keyPassPhrase = passphrase;}
+	void setmaxBufferedMessages(const int& count){ maxBufferedMessages = count;}
+	void setspoolDirectory(const std::string& directory){ spoolDirectory = directory;}
+	void setspoolMaxBytes(const unsigned long long& bytes){ spoolMaxBytes = bytes;}
+	void setspoolDropPolicy(const std::string& policy){ spoolDropPolicy = policy;}
+	void setspoolDrainRate(const int& rate){ spoolDrainRate = rate;}
+	void setpersistenceType(const std::string& type){ persistenceType = type;}
+	void setpersistenceDirectory(const std::string& directory){ persistenceDirectory = directory;}
+	void setpersistenceSnapshotInterval(const int& interval){ persistenceSnapshotInterval = interval;}
+	void setgatewayShards(const int& shards){ gatewayShards = shards;}
+	void setinflightControl(const std::string& control){ inflightControl = control;}
+	void setmaxInflight(const int& count){ maxInflight = count;}
+	void setrateLimit(const int& rate){ rateLimit = rate;}
+	void setrateBurst(const int& burst){ rateBurst = burst;}
+	void setrateLimitPolicy(const std::string& policy){ rateLimitPolicy = policy;}
+	void setrateLimitEvents(const std::string& limits){ rateLimitEvents = limits;}
+	void setcoalesceEvents(const std::string& events){ coalesceEvents = events;}
+	void setaggregateWindow(const int& window){ aggregateWindow = window;}
+	void setaggregateSlide(const int& slide){ aggregateSlide = slide;}
+	void setaggregateEvents(const std::string& events){ aggregateEvents = events;}
+	void setdeadbandEvents(const std::string& events){ deadbandEvents = events;}
+	void setdeadbandHeartbeat(const int& seconds){ deadbandHeartbeat = seconds;}
+	void setcompression(const std::string& codec){ compression = codec;}
+	void setcompressionThreshold(const int& bytes){ compressionThreshold = bytes;}
+	void setcompressionTrainSamples(const int& count){ compressionTrainSamples = count;}
 
 };
 
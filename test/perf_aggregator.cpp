@@ -0,0 +1,184 @@
+/*******************************************************************************
+ * Copyright (c) 2017 IBM Corp.
+ *
+ * All rights reserved. This program and the accompanying materials
+ * are made available under the terms of the Eclipse Public License v1.0
+ * and Eclipse Distribution License v1.0 which accompany this distribution.
+ *
+ * The Eclipse Public License is available at
+ *    http://www.eclipse.org/legal/epl-v10.html
+ * and the Eclipse Distribution License is available at
+ *   http://www.eclipse.org/org/documents/edl-v10.php.
+ *
+ * Contributors:
+ *    Benchmark for the windowed aggregation of gateway telemetry
+ *******************************************************************************/
+
+/*
+ * Measures the aggregation kernel over a buffer of samples against a plain loop, then feeds
+ * simulated telemetry of a number of devices, one sample at a time and in batches, through
+ * tumbling and sliding windows and reports the samples aggregated a second and how many
+ * events are published in place of the samples. The first window of each run is checked
+ * against a plain computation, and the windows still open at the end are flushed and checked,
+ * with tumbling windows, to hold every sample the closed windows did not.
+ *
+ * usage: perf_aggregator [devices] [samples per device]
+ */
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "IOTP_Aggregator.h"
+
+using namespace Watson_IOTP;
+
+typedef std::chrono::steady_clock steady;
+
+static double seconds(steady::time_point start) {
+	return std::chrono::duration<double>(steady::now() - start).count();
+}
+
+static IOTP_Aggregator::Stats plain(const double* values, size_t count) {
+	IOTP_Aggregator::Stats stats = { values[0], values[0], 0, values[count - 1], count };
+	double sum = 0;
+	for (size_t i = 0; i < count; ++i) {
+		if (values[i] < stats.min)
+			stats.min = values[i];
+		if (values[i] > stats.max)
+			stats.max = values[i];
+		sum += values[i];
+	}
+	stats.mean = sum / count;
+	return stats;
+}
+
+static bool same(const IOTP_Aggregator::Stats& a, const IOTP_Aggregator::Stats& b) {
+	return a.min == b.min && a.max == b.max && a.last == b.last && a.count == b.count &&
+			std::fabs(a.mean - b.mean) <= 1e-9 * std::fabs(b.mean) + 1e-12;
+}
+
+static void kernel(const std::vector<double>& values) {
+	const int rounds = 200;
+	volatile double sink = 0;
+
+	steady::time_point start = steady::now();
+	for (int r = 0; r < rounds; ++r)
+		sink = sink + IOTP_Aggregator::aggregate(values.data(), values.size()).mean;
+	double vectorized = seconds(start);
+
+	start = steady::now();
+	for (int r = 0; r < rounds; ++r)
+		sink = sink + plain(values.data(), values.size()).mean;
+	double loop = seconds(start);
+
+	printf("kernel over %zu samples: %8.0f M samples/s, plain loop %8.0f M samples/s, %s\n", values.size(),
+			rounds * values.size() / vectorized / 1e6, rounds * values.size() / loop / 1e6,
+			same(IOTP_Aggregator::aggregate(values.data(), values.size()),
+					plain(values.data(), values.size())) ? "same result" : "RESULTS DIFFER");
+}
+
+// The temperature samples of a device in a list of windows
+static uint64_t temperatures(const std::vector<IOTP_Aggregator::Window>& windows, const std::string& deviceId) {
+	uint64_t count = 0;
+	for (size_t w = 0; w < windows.size(); ++w)
+		if (windows[w].deviceId == deviceId)
+			for (size_t f = 0; f < windows[w].fields.size(); ++f)
+				if (windows[w].fields[f].name == "temperature")
+					count += windows[w].fields[f].stats.count;
+	return count;
+}
+
+/*
+ * Each device sends a temperature and a humidity sample every millisecond of simulated time,
+ * the windows close as the simulated time passes their end.
+ */
+static bool telemetry(const char* name, int64_t window, int64_t slide, int devices, int samples, int batch) {
+	IOTP_Aggregator aggregator(window, slide);
+	std::vector<IOTP_Aggregator::Window> closed;
+	std::vector<std::string> ids;
+	std::vector<double> temperature(batch), humidity(batch);
+	std::vector<int64_t> times(batch);
+	std::vector<double> firstWindow;
+	std::mt19937 random(42);
+	std::normal_distribution<double> noise(0, 0.5);
+	const int64_t epoch = 1500000000000LL;
+	int64_t firstEnd = (epoch / aggregator.slide() + 1) * aggregator.slide();
+	size_t windows = 0;
+	uint64_t fed = 0, counted = 0;
+	bool checked = false, correct = true;
+
+	for (int d = 0; d < devices; ++d)
+		ids.push_back("sensor" + std::to_string(d));
+
+	steady::time_point start = steady::now();
+	for (int s = 0; s < samples; s += batch) {
+		for (int i = 0; i < batch; ++i) {
+			times[i] = epoch + s + i;
+			temperature[i] = 20 + noise(random);
+			humidity[i] = 50 + noise(random);
+		}
+		for (int d = 0; d < devices; ++d) {
+			if (batch == 1) {
+				aggregator.add("sensor", ids[d], "status", "temperature", temperature[0], times[0]);
+				aggregator.add("sensor", ids[d], "status", "humidity", humidity[0], times[0]);
+			}
+			else {
+				aggregator.add("sensor", ids[d], "status", "temperature", temperature.data(), times.data(), batch);
+				aggregator.add("sensor", ids[d], "status", "humidity", humidity.data(), times.data(), batch);
+			}
+		}
+		fed += batch;
+		// device 0's temperatures of the first window, to check its aggregate with
+		for (int i = 0; i < batch; ++i)
+			if (times[i] < firstEnd && times[i] >= firstEnd - window)
+				firstWindow.push_back(temperature[i]);
+
+		closed.clear();
+		windows += aggregator.close(times[batch - 1] + 1, closed);
+		counted += temperatures(closed, ids[0]);
+		for (size_t w = 0; w < closed.size() && !checked; ++w) {
+			if (closed[w].deviceId == ids[0]) {
+				for (size_t f = 0; f < closed[w].fields.size(); ++f)
+					if (closed[w].fields[f].name == "temperature")
+						correct = same(closed[w].fields[f].stats, plain(firstWindow.data(), firstWindow.size()));
+				checked = true;
+			}
+		}
+	}
+	double elapsed = seconds(start);
+	double total = 2.0 * devices * samples;
+
+	closed.clear();
+	aggregator.flush(closed);
+	counted += temperatures(closed, ids[0]);
+	bool kept = slide != 0 || counted == fed;
+
+	printf("%-22s batch %5d: %7.2f M samples/s, %9.0f samples in, %7zu events out (%5.0f:1)%s%s\n", name, batch,
+			total / elapsed / 1e6, total, windows, total / (windows ? windows : 1),
+			checked && correct ? "" : ", FIRST WINDOW WRONG", kept ? "" : ", SAMPLES LOST");
+	return checked && correct && kept;
+}
+
+int main(int argc, char** argv) {
+	int devices = (argc > 1) ? atoi(argv[1]) : 100;
+	int samples = (argc > 2) ? atoi(argv[2]) : 20000;
+
+	std::vector<double> values(1 << 16);
+	std::mt19937 random(7);
+	std::uniform_real_distribution<double> uniform(-40, 60);
+	for (size_t i = 0; i < values.size(); ++i)
+		values[i] = uniform(random);
+	kernel(values);
+
+	printf("\n%d devices, 2 fields, a sample per field every ms for %d ms\n", devices, samples);
+	bool ok = telemetry("tumbling 1 s", 1000, 0, devices, samples, 1);
+	ok = telemetry("tumbling 1 s", 1000, 0, devices, samples, 1000) && ok;
+	ok = telemetry("sliding 10 s every 1 s", 10000, 1000, devices, samples, 1) && ok;
+	ok = telemetry("sliding 10 s every 1 s", 10000, 1000, devices, samples, 1000) && ok;
+	return ok ? 0 : 1;
+}
@@ -0,0 +1,208 @@
+/*******************************************************************************
+ * Copyright (c) 2017 IBM Corp.
+ *
+ * All rights reserved. This program and the accompanying materials
+ * are made available under the terms of the Eclipse Public License v1.0
+ * and Eclipse Distribution License v1.0 which accompany this distribution.
+ *
+ * The Eclipse Public License is available at
+ *    http://www.eclipse.org/legal/epl-v10.html
+ * and the Eclipse Distribution License is available at
+ *   http://www.eclipse.org/org/documents/edl-v10.php.
+ *
+ * Contributors:
+ *    Benchmark for the asynchronous log4cpp appender
+ *******************************************************************************/
+
+/*
+ * Four threads log through a category to a file, and to a sink that stalls 200 us on every
+ * write the way a busy disk does, with the appender called on the logging threads and behind
+ * an AsyncAppender blocking or dropping when its ring is full. Checks that every line logged
+ * is written, or counted as dropped, also when the AsyncAppender is closed while the threads
+ * are still logging, and reports events a second and the time a call to log took that 99
+ * calls in 100 were within.
+ *
+ * usage: perf_async_appender [events per thread]
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <log4cpp/AsyncAppender.hh>
+#include <log4cpp/Category.hh>
+#include <log4cpp/FileAppender.hh>
+#include <log4cpp/PatternLayout.hh>
+
+using namespace log4cpp;
+
+typedef std::chrono::steady_clock Clock;
+
+static const int THREADS = 4;
+static const char* FILE_NAME = "perf_async_appender.log";
+
+// Writes nowhere, slowly, counting the lines it is given
+class StallingAppender : public LayoutAppender {
+public:
+	explicit StallingAppender(const std::string& name) : LayoutAppender(name), lines(0) {}
+	virtual void close() {}
+	std::atomic<unsigned long> lines;
+
+protected:
+	virtual void _append(const LoggingEvent& event) {
+		std::string text = _getLayout().format(event);
+		std::this_thread::sleep_for(std::chrono::microseconds(200));
+		unsigned long count = 0;
+		for (size_t i = 0; i < text.size(); ++i)
+			count += text[i] == '\n';
+		lines += count;
+	}
+};
+
+static Layout* layout() {
+	PatternLayout* layout = new PatternLayout();
+	layout->setConversionPattern("%d [%p] %m%n");
+	return layout;
+}
+
+static unsigned long fileLines() {
+	std::ifstream file(FILE_NAME);
+	std::string line;
+	unsigned long lines = 0;
+	while (std::getline(file, line))
+		++lines;
+	return lines;
+}
+
+struct Result {
+	double eventsPerSecond;
+	double p99Ms;
+};
+
+static Result run(Category& category, int count) {
+	std::vector<std::thread> threads;
+	std::vector<double> calls(THREADS * (size_t)count);
+	Clock::time_point start = Clock::now();
+	for (int t = 0; t < THREADS; ++t) {
+		threads.push_back(std::thread([&category, &calls, t, count]() {
+			double* ms = &calls[t * (size_t)count];
+			for (int i = 0; i < count; ++i) {
+				Clock::time_point before = Clock::now();
+				category.info("device %d published event %d rc=%d", t, i, 0);
+				ms[i] = std::chrono::duration<double, std::milli>(Clock::now() - before).count();
+			}
+		}));
+	}
+	for (size_t t = 0; t < threads.size(); ++t)
+		threads[t].join();
+	Result result;
+	result.eventsPerSecond = calls.size() / std::chrono::duration<double>(Clock::now() - start).count();
+	std::vector<double>::iterator p99 = calls.begin() + calls.size() * 99 / 100;
+	std::nth_element(calls.begin(), p99, calls.end());
+	result.p99Ms = *p99;
+	return result;
+}
+
+static void print(const char* sink, const char* appender, const Result& result, unsigned long written,
+		unsigned long dropped, unsigned long expected) {
+	bool same = written + dropped == expected;
+	printf("%-8s %-14s %12.0f %10.4f %10lu %10lu%s\n", sink, appender, result.eventsPerSecond,
+			result.p99Ms, written, dropped, same ? "" : "  LINES LOST");
+}
+
+int main(int argc, char** argv) {
+	int count = (argc > 1) ? atoi(argv[1]) : 20000;
+	int stalledCount = count / 20;
+	Category& category = Category::getInstance("perf");
+	category.setAdditivity(false);
+	category.setPriority(Priority::INFO);
+	bool ok = true;
+
+	printf("%d threads, %d events each to the file, %d to the stalling sink\n", THREADS, count, stalledCount);
+	printf("%-8s %-14s %12s %10s %10s %10s\n", "sink", "appender", "events/s", "p99 ms", "written", "dropped");
+
+	{
+		remove(FILE_NAME);
+		FileAppender file("file", FILE_NAME, false);
+		file.setLayout(layout());
+		category.addAppender(file);
+		Result result = run(category, count);
+		category.removeAllAppenders();
+		file.close();
+		unsigned long written = fileLines();
+		ok = ok && written == (unsigned long)THREADS * count;
+		print("file", "direct", result, written, 0, THREADS * count);
+	}
+	{
+		remove(FILE_NAME);
+		FileAppender file("file", FILE_NAME, false);
+		AsyncAppender async("async", file);
+		async.setLayout(layout());
+		category.addAppender(async);
+		Result result = run(category, count);
+		category.removeAllAppenders();
+		async.close();
+		unsigned long written = fileLines();
+		ok = ok && written == (unsigned long)THREADS * count;
+		print("file", "async block", result, written, async.getDropped(), THREADS * count);
+	}
+	{
+		StallingAppender stalling("stalling");
+		stalling.setLayout(layout());
+		category.addAppender(stalling);
+		Result result = run(category, stalledCount);
+		category.removeAllAppenders();
+		ok = ok && stalling.lines == (unsigned long)THREADS * stalledCount;
+		print("stalling", "direct", result, stalling.lines, 0, THREADS * stalledCount);
+	}
+	const AsyncAppender::OverflowPolicy policies[] = { AsyncAppender::BLOCK, AsyncAppender::DROP };
+	for (int p = 0; p < 2; ++p) {
+		StallingAppender stalling("stalling");
+		AsyncAppender async("async", stalling, 1024, policies[p]);
+		async.setLayout(layout());
+		category.addAppender(async);
+		Result result = run(category, stalledCount);
+		category.removeAllAppenders();
+		async.close();
+		ok = ok && stalling.lines + async.getDropped() == (unsigned long)THREADS * stalledCount;
+		print("stalling", p ? "async drop" : "async block", result, stalling.lines, async.getDropped(),
+				THREADS * stalledCount);
+	}
+	for (int round = 0; round < 20; ++round) {
+		// closed under the logging threads: an event is written or counted, never lost
+		StallingAppender stalling("stalling");
+		AsyncAppender async("async", stalling, 64, policies[round % 2]);
+		async.setLayout(layout());
+		category.addAppender(async);
+		std::atomic<bool> stop(false);
+		std::atomic<unsigned long> logged(0);
+		std::vector<std::thread> threads;
+		for (int t = 0; t < THREADS; ++t) {
+			threads.push_back(std::thread([&category, &stop, &logged, t]() {
+				while (!stop) {
+					category.info("device %d published event rc=%d", t, 0);
+					++logged;
+				}
+			}));
+		}
+		std::this_thread::sleep_for(std::chrono::milliseconds(5));
+		async.close();
+		stop = true;
+		for (size_t t = 0; t < threads.size(); ++t)
+			threads[t].join();
+		category.removeAllAppenders();
+		if (stalling.lines + async.getDropped() != logged) {
+			printf("closed while logging: %lu logged, %lu written, %lu dropped  LINES LOST\n",
+					(unsigned long)logged, (unsigned long)stalling.lines, async.getDropped());
+			ok = false;
+		}
+	}
+	remove(FILE_NAME);
+	return ok ? 0 : 1;
+}
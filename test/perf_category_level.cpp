@@ -0,0 +1,141 @@
+/*******************************************************************************
+ * Copyright (c) 2017 IBM Corp.
+ *
+ * All rights reserved. This program and the accompanying materials
+ * are made available under the terms of the Eclipse Public License v1.0
+ * and Eclipse Distribution License v1.0 which accompany this distribution.
+ *
+ * The Eclipse Public License is available at
+ *    http://www.eclipse.org/legal/epl-v10.html
+ * and the Eclipse Distribution License is available at
+ *   http://www.eclipse.org/org/documents/edl-v10.php.
+ *
+ * Contributors:
+ *    Benchmark for the log4cpp category level checks and lookups
+ *******************************************************************************/
+
+/*
+ * Sixteen threads log at DEBUG to a category four levels below the root, which is at INFO,
+ * and look up Category::getInstance("clogger") the way each client does, as log4cpp did
+ * before, walking the category chain for the level and taking a mutex for a std::map lookup,
+ * and as it does now, with the level resolved into an atomic and the lookup reading the
+ * published categories without a lock. Checks that the levels follow setPriority() anywhere
+ * up the chain and that a lookup gives the category made, and reports calls a second.
+ *
+ * usage: perf_category_level [calls per thread]
+ */
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <log4cpp/Category.hh>
+
+using namespace log4cpp;
+
+typedef std::chrono::steady_clock Clock;
+
+static const int THREADS = 16;
+
+// The chained priority as Category::getChainedPriority() found it
+static Priority::Value walkChain(const Category& category) {
+	const Category* c = &category;
+	while (c->getPriority() >= Priority::NOTSET)
+		c = c->getParent();
+	return c->getPriority();
+}
+
+// The lookup as HierarchyMaintainer::getInstance() made it, for a category that exists
+struct LockedMap {
+	std::mutex mutex;
+	std::map<std::string, Category*> categories;
+
+	Category& getInstance(const std::string& name) {
+		std::lock_guard<std::mutex> lock(mutex);
+		return *categories[name];
+	}
+};
+
+template <typename Call>
+static double run(int count, Call call) {
+	std::vector<std::thread> threads;
+	Clock::time_point start = Clock::now();
+	for (int t = 0; t < THREADS; ++t) {
+		threads.push_back(std::thread([count, &call]() {
+			for (int i = 0; i < count; ++i)
+				call(i);
+		}));
+	}
+	for (size_t t = 0; t < threads.size(); ++t)
+		threads[t].join();
+	return (double)THREADS * count / std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+static bool check(const char* what, bool same) {
+	if (!same)
+		printf("%s: WRONG\n", what);
+	return same;
+}
+
+int main(int argc, char** argv) {
+	int count = (argc > 1) ? atoi(argv[1]) : 2000000;
+	Category& root = Category::getRoot();
+	Category& device = Category::getInstance("iotp.device.client.events");
+	Category& clogger = Category::getInstance("clogger");
+	root.setPriority(Priority::INFO);
+	bool ok = true;
+
+	std::string names[] = { "clogger", "iotp.device.client.events" };
+	LockedMap locked;
+	for (int n = 0; n < 2; ++n)
+		locked.categories[names[n]] = &Category::getInstance(names[n]);
+
+	std::atomic<unsigned long> enabled(0);
+	double walkRate = run(count, [&device, &enabled](int) {
+		if (walkChain(device) >= Priority::DEBUG)
+			++enabled;
+	});
+	double atomicRate = run(count, [&device](int) {
+		device.debug("device %s published event %d", "d1", 0);
+	});
+	double lockedRate = run(count / 4, [&locked](int) {
+		if (locked.getInstance("clogger").getPriority() == Priority::DEBUG)
+			abort();
+	});
+	double publishedRate = run(count / 4, [](int) {
+		if (Category::getInstance("clogger").getPriority() == Priority::DEBUG)
+			abort();
+	});
+	ok = check("debug enabled at INFO", enabled == 0 && !device.isDebugEnabled()) && ok;
+
+	// the level follows a change anywhere up the chain, and a category made after it
+	Category& client = Category::getInstance("iotp.device.client");
+	root.setPriority(Priority::DEBUG);
+	ok = check("root at DEBUG", device.isDebugEnabled() && clogger.isDebugEnabled()) && ok;
+	client.setPriority(Priority::WARN);
+	ok = check("client at WARN", !device.isInfoEnabled() && device.isWarnEnabled()
+			&& clogger.isDebugEnabled()) && ok;
+	ok = check("new below client", !Category::getInstance("iotp.device.client.commands").isInfoEnabled()) && ok;
+	device.setPriority(Priority::ERROR);
+	client.setPriority(Priority::NOTSET);
+	ok = check("device at ERROR", !device.isWarnEnabled() && device.isErrorEnabled()
+			&& Category::getInstance("iotp.device.client.commands").isDebugEnabled()) && ok;
+	for (int n = 0; n < 2; ++n)
+		ok = check("lookup", &Category::getInstance(names[n]) == locked.categories[names[n]]
+				&& Category::exists(names[n]) == locked.categories[names[n]]) && ok;
+	ok = check("missing", Category::exists("iotp.missing") == NULL) && ok;
+
+	printf("%d threads, %d level checks and %d lookups each\n", THREADS, count, count / 4);
+	printf("%-10s %-26s %14s\n", "call", "path", "calls/s");
+	printf("%-10s %-26s %14.0f\n", "DEBUG", "walk the chain", walkRate);
+	printf("%-10s %-26s %14.0f\n", "DEBUG", "atomic chained priority", atomicRate);
+	printf("%-10s %-26s %14.0f\n", "lookup", "mutex, std::map", lockedRate);
+	printf("%-10s %-26s %14.0f\n", "lookup", "published, no lock", publishedRate);
+	return ok ? 0 : 1;
+}
@@ -0,0 +1,362 @@
+/*******************************************************************************
+ * Copyright (c) 2017 IBM Corp.
+ *
+ * All rights reserved. This program and the accompanying materials
+ * are made available under the terms of the Eclipse Public License v1.0
+ * and Eclipse Distribution License v1.0 which accompany this distribution.
+ *
+ * The Eclipse Public License is available at
+ *    http://www.eclipse.org/legal/epl-v10.html
+ * and the Eclipse Distribution License is available at
+ *   http://www.eclipse.org/org/documents/edl-v10.php.
+ *
+ * Contributors:
+ *    Benchmark for latest-value coalescing of queued publishes
+ *******************************************************************************/
+
+/*
+ * A number of devices each publish their state at a fixed rate, QoS1, to a minimal broker on
+ * the loopback interface that takes a service time over each publish, so more is offered than
+ * the connection carries.  Without coalescing every value is queued and sent, each one later
+ * than the last.  With coalescing a device has at most one value queued, replaced by each new
+ * one.  Reports the values the broker received, how many updates of the device each one was
+ * behind when it arrived, how old the values were, and how long after publishing stopped the
+ * final value of every device arrived.
+ *
+ * usage: perf_coalesce [devices] [updates per second per device] [seconds] [service us]
+ */
+
+#include "MQTTAsync.h"
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+#define MAX_DEVICES 1000
+
+/* what the broker saw, against the latest value each device published */
+
+static volatile int latest[MAX_DEVICES];
+static volatile int arrived[MAX_DEVICES];
+static long received_count, behind_total;
+static double age_total, age_max;
+static int64_t last_arrival;
+
+static int64_t now_us(void);
+
+/* payload: "<device> <sequence> <microseconds published>" */
+static void received(const unsigned char* payload, size_t length)
+{
+	char text[64];
+	int device, seq;
+	long long published;
+	double age;
+
+	if (length >= sizeof(text))
+		length = sizeof(text) - 1;
+	memcpy(text, payload, length);
+	text[length] = '\0';
+	if (sscanf(text, "%d %d %lld", &device, &seq, &published) != 3 || device < 0 || device >= MAX_DEVICES)
+		return;
+	last_arrival = now_us();
+	age = (last_arrival - published) / 1000.0;
+	++received_count;
+	behind_total += latest[device] - seq;
+	age_total += age;
+	if (age > age_max)
+		age_max = age;
+	arrived[device] = seq;
+}
+
+static long service_us;
+
+static int64_t now_us(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static void send_all(int fd, const unsigned char* data, size_t length)
+{
+	while (length > 0)
+	{
+		ssize_t n = send(fd, data, length, MSG_NOSIGNAL);
+		if (n <= 0)
+			return;
+		data += n;
+		length -= n;
+	}
+}
+
+/* acks go out one at a time, Nagle would hold them for a delayed ack */
+static int no_delay(int fd)
+{
+	int on = 1;
+
+	setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+	return fd;
+}
+
+static int listen_loopback(int* port)
+{
+	int fd = socket(AF_INET, SOCK_STREAM, 0);
+	struct sockaddr_in addr;
+	socklen_t len = sizeof(addr);
+
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	if (bind(fd, (struct sockaddr*)&addr, sizeof(addr)) != 0 || listen(fd, 16) != 0)
+	{
+		perror("listen");
+		return -1;
+	}
+	getsockname(fd, (struct sockaddr*)&addr, &len);
+	*port = ntohs(addr.sin_port);
+	return fd;
+}
+
+/* broker: CONNECT, SUBSCRIBE, PINGREQ and QoS 1 PUBLISH, each publish taking the service time */
+
+static void* broker_connection(void* arg)
+{
+	int fd = (int)(intptr_t)arg;
+	unsigned char* in = malloc(256 * 1024);
+	size_t used = 0;
+
+	for (;;)
+	{
+		size_t pos = 0;
+		ssize_t n = recv(fd, in + used, 256 * 1024 - used, 0);
+
+		if (n <= 0)
+			break;
+		used += n;
+		while (used - pos >= 2)
+		{
+			size_t length = 0, header = 1;
+			int shift = 0, complete = 0, type = in[pos] >> 4;
+			const unsigned char* body;
+
+			while (pos + header < used && header <= 4)
+			{
+				unsigned char c = in[pos + header++];
+				length += (size_t)(c & 0x7f) << shift;
+				shift += 7;
+				if ((c & 0x80) == 0)
+				{
+					complete = 1;
+					break;
+				}
+			}
+			if (!complete || used - pos < header + length)
+				break;
+			body = in + pos + header;
+			if (type == 1)
+			{
+				unsigned char connack[] = { 0x20, 2, 0, 0 };
+				send_all(fd, connack, sizeof(connack));
+			}
+			else if (type == 3 && ((in[pos] >> 1) & 3))
+			{
+				size_t topic = (body[0] << 8) | body[1];
+				unsigned char puback[] = { 0x40, 2, body[2 + topic], body[3 + topic] };
+				usleep(service_us);
+				received(body + 4 + topic, length - 4 - topic);
+				send_all(fd, puback, sizeof(puback));
+			}
+			else if (type == 8)
+			{
+				unsigned char suback[] = { 0x90, 3, body[0], body[1], 1 };
+				send_all(fd, suback, sizeof(suback));
+			}
+			else if (type == 12)
+			{
+				unsigned char pingresp[] = { 0xd0, 0 };
+				send_all(fd, pingresp, sizeof(pingresp));
+			}
+			pos += header + length;
+		}
+		memmove(in, in + pos, used - pos);
+		used -= pos;
+	}
+	free(in);
+	close(fd);
+	return NULL;
+}
+
+static void* broker(void* arg)
+{
+	int listener = (int)(intptr_t)arg, fd;
+
+	while ((fd = accept(listener, NULL, NULL)) >= 0)
+	{
+		pthread_t thread;
+		pthread_create(&thread, NULL, broker_connection, (void*)(intptr_t)no_delay(fd));
+		pthread_detach(thread);
+	}
+	return NULL;
+}
+
+
+
+/* client */
+
+static volatile int connected = 0;
+static volatile long completed = 0, superseded = 0;
+
+static void onConnect(void* context, MQTTAsync_successData* response)
+{
+	(void)context;
+	(void)response;
+	connected = 1;
+}
+
+static void onConnectFailure(void* context, MQTTAsync_failureData* response)
+{
+	(void)context;
+	(void)response;
+	connected = -1;
+}
+
+static void onPublish(void* context, MQTTAsync_successData* response)
+{
+	(void)context;
+	(void)response;
+	++completed;
+}
+
+static void onPublishFailure(void* context, MQTTAsync_failureData* response)
+{
+	(void)context;
+	if (response->code == MQTTASYNC_SUPERSEDED)
+		++superseded;
+	++completed;
+}
+
+static MQTTAsync start(const char* uri)
+{
+	MQTTAsync client;
+	MQTTAsync_connectOptions opts = MQTTAsync_connectOptions_initializer;
+
+	MQTTAsync_create(&client, uri, "perf_coalesce", MQTTCLIENT_PERSISTENCE_NONE, NULL);
+	opts.cleansession = 1;
+	opts.onSuccess = onConnect;
+	opts.onFailure = onConnectFailure;
+	opts.inflightControl = MQTTASYNC_INFLIGHT_FIXED;
+	opts.maxInflight = 10;
+	connected = 0;
+	MQTTAsync_connect(client, &opts);
+	while (connected == 0)
+		usleep(1000);
+	if (connected < 0)
+	{
+		fprintf(stderr, "connect failed\n");
+		MQTTAsync_destroy(&client);
+		return NULL;
+	}
+	return client;
+}
+
+static void stop(MQTTAsync* client)
+{
+	MQTTAsync_disconnectOptions dopts = MQTTAsync_disconnectOptions_initializer;
+
+	MQTTAsync_disconnect(*client, &dopts);
+	usleep(100000);
+	MQTTAsync_destroy(client);
+}
+
+static int run(const char* uri, int coalesce, int devices, int rate, double seconds)
+{
+	MQTTAsync client = start(uri);
+	int64_t start_time, stopped, interval = 1000000 / ((int64_t)rate * devices), next;
+	long published = 0;
+	int device = 0, seq = 0, i, done;
+
+	if (client == NULL)
+		return 1;
+	memset((void*)latest, '\0', sizeof(latest));
+	memset((void*)arrived, '\0', sizeof(arrived));
+	received_count = behind_total = 0;
+	age_total = age_max = 0;
+	completed = superseded = 0;
+
+	start_time = next = now_us();
+	while (now_us() - start_time < seconds * 1000000)
+	{
+		MQTTAsync_responseOptions ropts = MQTTAsync_responseOptions_initializer;
+		char topic[64], payload[64];
+		int64_t t;
+
+		if (device == 0)
+			++seq;
+		snprintf(topic, sizeof(topic), "iot-2/type/sensor/id/d%d/evt/state/fmt/json", device);
+		latest[device] = seq;
+		snprintf(payload, sizeof(payload), "%d %d %lld", device, seq, (long long)now_us());
+		ropts.onSuccess = onPublish;
+		ropts.onFailure = onPublishFailure;
+		ropts.coalesce = coalesce;
+		if (MQTTAsync_send(client, topic, (int)strlen(payload), payload, 1, 0, &ropts) == MQTTASYNC_SUCCESS)
+			++published;
+		device = (device + 1) % devices;
+		next += interval;
+		if ((t = next - now_us()) > 0)
+			usleep(t);
+	}
+	stopped = now_us();
+
+	/* until the final value of every device has arrived */
+	do
+	{
+		usleep(1000);
+		for (done = 1, i = 0; i < devices; ++i)
+			if (arrived[i] != latest[i])
+				done = 0;
+	} while (!done && now_us() - stopped < 300 * 1000000LL);
+	while (completed < published && now_us() - stopped < 300 * 1000000LL)
+		usleep(1000);
+
+	printf("%-12s %9ld %9ld %9ld %12.1f %12.1f %12.1f %14.1f\n", coalesce ? "coalesced" : "every value",
+			published, superseded, received_count, received_count ? (double)behind_total / received_count : 0.0,
+			received_count ? age_total / received_count : 0.0, age_max, (last_arrival - stopped) / 1000.0);
+	stop(&client);
+	return !done;
+}
+
+int main(int argc, char** argv)
+{
+	int devices = (argc > 1) ? atoi(argv[1]) : 20;
+	int rate = (argc > 2) ? atoi(argv[2]) : 50;
+	double seconds = (argc > 3) ? atof(argv[3]) : 3.0;
+	int listener, port, rc = 0;
+	pthread_t thread;
+	char uri[64];
+
+	service_us = (argc > 4) ? atol(argv[4]) : 2000;
+	if (devices > MAX_DEVICES)
+		devices = MAX_DEVICES;
+	if ((listener = listen_loopback(&port)) < 0)
+		return 1;
+	pthread_create(&thread, NULL, broker, (void*)(intptr_t)listener);
+	snprintf(uri, sizeof(uri), "tcp://127.0.0.1:%d", port);
+
+	printf("%d devices, %d updates/s each for %.1f s, QoS1, %ld us per publish at the broker (%ld/s)\n",
+			devices, rate, seconds, service_us, service_us ? 1000000 / service_us : 0);
+	printf("%-12s %9s %9s %9s %12s %12s %12s %14s\n", "", "published", "replaced", "received", "avg behind",
+			"avg age ms", "max age ms", "final after ms");
+	rc += run(uri, 0, devices, rate, seconds);
+	rc += run(uri, 1, devices, rate, seconds);
+	return rc != 0;
+}
@@ -0,0 +1,130 @@
+/*******************************************************************************
+ * Copyright (c) 2017 IBM Corp.
+ *
+ * All rights reserved. This program and the accompanying materials
+ * are made available under the terms of the Eclipse Public License v1.0
+ * and Eclipse Distribution License v1.0 which accompany this distribution.
+ *
+ * The Eclipse Public License is available at
+ *    http://www.eclipse.org/legal/epl-v10.html
+ * and the Eclipse Distribution License is available at
+ *   http://www.eclipse.org/org/documents/edl-v10.php.
+ *
+ * Contributors:
+ *    Benchmark for payload compression
+ *******************************************************************************/
+
+/*
+ * Compresses a stream of json telemetry events, a gps fix with a handful of sensor readings
+ * and every fourth one a short heartbeat below the threshold, with zlib and, when built with
+ * it, zstd: each without a dictionary and with one trained from the first events. A second
+ * compressor, given the dictionary as a receiver would be, decompresses every event and
+ * checks it. Reports the bytes saved and the CPU time a message takes to compress and to
+ * decompress.
+ *
+ * usage: perf_compression [events] [training samples]
+ */
+
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "IOTP_Compressor.h"
+
+using namespace Watson_IOTP;
+
+static const char* TOPIC = "iot-2/evt/status/fmt/json";
+
+static std::string event(std::mt19937& random, int seq) {
+	std::uniform_real_distribution<double> unit(0, 1);
+	char buffer[512];
+	if (seq % 4 == 3) {
+		snprintf(buffer, sizeof(buffer), "{\"d\":{\"alive\":true,\"seq\":%d}}", seq);
+		return buffer;
+	}
+	snprintf(buffer, sizeof(buffer),
+			"{\"d\":{\"seq\":%d,\"lat\":%.6f,\"lon\":%.6f,\"speed\":%.1f,\"heading\":%d,"
+			"\"temperature\":%.2f,\"humidity\":%d,\"pressure\":%.1f,\"battery\":%.3f,"
+			"\"status\":\"%s\",\"vibration\":[%d,%d,%d,%d]},\"ts\":%lld}",
+			seq, 52.3 + unit(random) / 100, 4.8 + unit(random) / 100, unit(random) * 120, (int)(unit(random) * 360),
+			18 + unit(random) * 10, (int)(unit(random) * 100), 1000 + unit(random) * 30, 3.3 + unit(random),
+			(seq % 10 == 0) ? "charging" : "ok", (int)(unit(random) * 2000) - 1000, (int)(unit(random) * 2000) - 1000,
+			(int)(unit(random) * 2000) - 1000, (int)(unit(random) * 2000) - 1000, 1500000000000LL + seq * 1000LL);
+	return buffer;
+}
+
+static double cpuSeconds() {
+	struct timespec now;
+	clock_gettime(CLOCK_THREAD_CPUTIME_ID, &now);
+	return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+static bool run(const char* name, IOTP_Compressor::Codec codec, int trainSamples, const std::vector<std::string>& events) {
+	IOTP_Compressor sender(codec, 128, trainSamples);
+	IOTP_Compressor receiver(IOTP_Compressor::NONE);
+	std::vector<std::string> topics(events.size()), payloads(events.size());
+	double bytesIn = 0, bytesOut = 0;
+
+	double start = cpuSeconds();
+	for (size_t i = 0; i < events.size(); ++i) {
+		topics[i] = TOPIC;
+		payloads[i] = events[i];
+		sender.compress(topics[i], payloads[i]);
+	}
+	double compressing = cpuSeconds() - start;
+
+	uint32_t id = sender.dictionaryId();
+	if (id != 0)
+		receiver.addDictionary(codec, sender.dictionary(id));
+
+	int failed = 0;
+	start = cpuSeconds();
+	for (size_t i = 0; i < events.size(); ++i) {
+		if (IOTP_Compressor::isCompressed(topics[i]) && !receiver.decompress(topics[i], payloads[i]))
+			++failed;
+	}
+	double decompressing = cpuSeconds() - start;
+
+	for (size_t i = 0; i < events.size(); ++i) {
+		if (topics[i] != TOPIC || payloads[i] != events[i])
+			++failed;
+	}
+
+	IOTP_Compressor::Stats stats = sender.stats();
+	for (const std::string& e : events)
+		bytesIn += e.size();
+	bytesOut = bytesIn - stats.bytesIn + stats.bytesOut;
+	printf("%-12s %6llu %6llu %8.1f %8.1f %7.1f%% %10.2f %10.2f %8u%s\n", name,
+			(unsigned long long)stats.compressed, (unsigned long long)stats.skipped,
+			stats.compressed ? (double)stats.bytesIn / stats.compressed : 0.0,
+			stats.compressed ? (double)stats.bytesOut / stats.compressed : 0.0,
+			100 * (1 - bytesOut / bytesIn), 1e6 * compressing / events.size(), 1e6 * decompressing / events.size(),
+			(unsigned)(id ? sender.dictionary(id).size() : 0), failed ? "  ROUND TRIP FAILED" : "");
+	return failed == 0;
+}
+
+int main(int argc, char** argv) {
+	int count = (argc > 1) ? atoi(argv[1]) : 20000;
+	int samples = (argc > 2) ? atoi(argv[2]) : 500;
+
+	std::mt19937 random(3);
+	std::vector<std::string> events;
+	for (int i = 0; i < count; ++i)
+		events.push_back(event(random, i));
+
+	printf("%d events, threshold 128 bytes, dictionaries trained from %d events\n", count, samples);
+	printf("%-12s %6s %6s %8s %8s %8s %10s %10s %8s\n", "codec", "comp", "skip", "in/msg", "out/msg", "saved",
+			"us/compr", "us/decomp", "dict");
+	bool ok = run("zlib", IOTP_Compressor::ZLIB, 0, events);
+	ok = run("zlib+dict", IOTP_Compressor::ZLIB, samples, events) && ok;
+	if (IOTP_Compressor::available(IOTP_Compressor::ZSTD)) {
+		ok = run("zstd", IOTP_Compressor::ZSTD, 0, events) && ok;
+		ok = run("zstd+dict", IOTP_Compressor::ZSTD, samples, events) && ok;
+	}
+	else
+		printf("zstd not built\n");
+	return ok ? 0 : 1;
+}
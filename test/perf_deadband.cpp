@@ -0,0 +1,117 @@
+/*******************************************************************************
+ * Copyright (c) 2017 IBM Corp.
+ *
+ * All rights reserved. This program and the accompanying materials
+ * are made available under the terms of the Eclipse Public License v1.0
+ * and Eclipse Distribution License v1.0 which accompany this distribution.
+ *
+ * The Eclipse Public License is available at
+ *    http://www.eclipse.org/legal/epl-v10.html
+ * and the Eclipse Distribution License is available at
+ *   http://www.eclipse.org/org/documents/edl-v10.php.
+ *
+ * Contributors:
+ *    Benchmark for the deadband filter
+ *******************************************************************************/
+
+/*
+ * Runs simulated status events of a number of devices through the deadband filter, once a
+ * second for an hour of simulated time: a temperature drifting slowly with sensor noise, with
+ * a deadband of 0.5, and a humidity with a deadband of 2%, and a heartbeat of a minute.
+ * Reports the share of events published, the largest difference between a device's value and
+ * the last value published for it, and the time taken to filter an event. Checks that a field
+ * with a relative band that stays at 0 is published only the first time and for heartbeats.
+ *
+ * usage: perf_deadband [devices] [seconds simulated]
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "IOTP_Deadband.h"
+
+using namespace Watson_IOTP;
+
+int main(int argc, char** argv) {
+	int devices = (argc > 1) ? atoi(argv[1]) : 1000;
+	int seconds = (argc > 2) ? atoi(argv[2]) : 3600;
+
+	IOTP_Deadband deadband(60 * 1000);
+	std::string rejected = deadband.configure("status:temperature=0.5|humidity=2%");
+	if (rejected.size() > 0) {
+		fprintf(stderr, "rejected %s\n", rejected.c_str());
+		return 1;
+	}
+
+	std::mt19937 random(11);
+	std::normal_distribution<double> drift(0, 0.02), noise(0, 0.1);
+	std::vector<std::string> keys;
+	std::vector<double> temperature(devices), humidity(devices), sentTemperature(devices), sentHumidity(devices);
+	for (int d = 0; d < devices; ++d) {
+		keys.push_back("status" + std::to_string(d));
+		temperature[d] = 20 + d % 10;
+		humidity[d] = 40 + d % 20;
+	}
+
+	std::vector<IOTP_Deadband::Sample> samples(2);
+	samples[0].field = "temperature";
+	samples[1].field = "humidity";
+	double worstTemperature = 0, worstHumidity = 0;
+	long events = 0, published = 0;
+	std::chrono::steady_clock::duration filtering(0);
+
+	for (int s = 0; s < seconds; ++s) {
+		for (int d = 0; d < devices; ++d) {
+			temperature[d] += drift(random);
+			humidity[d] += 5 * drift(random);
+			samples[0].value = temperature[d] + noise(random);
+			samples[1].value = humidity[d] + noise(random);
+
+			std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+			bool publish = deadband.pass(keys[d], "status", samples, (int64_t)s * 1000);
+			filtering += std::chrono::steady_clock::now() - start;
+
+			++events;
+			if (publish) {
+				++published;
+				sentTemperature[d] = samples[0].value;
+				sentHumidity[d] = samples[1].value;
+			}
+			worstTemperature = std::max(worstTemperature, std::fabs(samples[0].value - sentTemperature[d]));
+			worstHumidity = std::max(worstHumidity, std::fabs(samples[1].value - sentHumidity[d]) / sentHumidity[d]);
+		}
+	}
+
+	// with a relative band a reading of 0 is a band of 0, which only a change moves out of
+	IOTP_Deadband zero(60 * 1000);
+	zero.configure("status:humidity=2%");
+	std::vector<IOTP_Deadband::Sample> dry(1);
+	dry[0].field = "humidity";
+	dry[0].value = 0;
+	int dryPublished = 0;
+	for (int s = 0; s < 120; ++s)
+		dryPublished += zero.pass("dry", "status", dry, (int64_t)s * 1000);
+	dry[0].value = 0.1;
+	bool dryMoved = zero.pass("dry", "status", dry, 120 * 1000);
+	bool ok = dryPublished == 2 && dryMoved;
+	if (!ok)
+		printf("humidity at 0 with a band of 2%%: published %d times in 2 minutes, %s after a change: WRONG\n",
+				dryPublished, dryMoved ? "published" : "suppressed");
+
+	IOTP_Deadband::Stats stats = deadband.stats();
+	printf("%d devices, an event a second for %d s: %ld events\n", devices, seconds, events);
+	printf("published %ld (%.1f%%): %llu moved, %llu heartbeats; suppressed %llu (%.1f%%)\n", published,
+			100.0 * published / events, (unsigned long long)stats.passed, (unsigned long long)stats.heartbeats,
+			(unsigned long long)stats.suppressed, 100.0 * stats.suppressed / events);
+	printf("largest error of the last published value: temperature %.3f (band 0.5), humidity %.2f%% (band 2%%)\n",
+			worstTemperature, 100 * worstHumidity);
+	printf("%.0f ns to filter an event\n",
+			std::chrono::duration<double, std::nano>(filtering).count() / events);
+	return ok ? 0 : 1;
+}
@@ -0,0 +1,148 @@
+/*******************************************************************************
+ * Copyright (c) 2017 IBM Corp.
+ *
+ * All rights reserved. This program and the accompanying materials
+ * are made available under the terms of the Eclipse Public License v1.0
+ * and Eclipse Distribution License v1.0 which accompany this distribution.
+ *
+ * The Eclipse Public License is available at
+ *    http://www.eclipse.org/legal/epl-v10.html
+ * and the Eclipse Distribution License is available at
+ *   http://www.eclipse.org/org/documents/edl-v10.php.
+ *
+ * Contributors:
+ *    Benchmark for the field descriptions of the device model
+ *******************************************************************************/
+
+/*
+ * Moves a device location and writes it after every move, and writes the device info a
+ * manage request carries, as the types did when each kept a Json::Value rebuilt on every
+ * change, and from their field descriptions. Checks that both give the same text and that
+ * what is written reads back to the same object, and reports updates a second and the bytes
+ * each object keeps.
+ *
+ * usage: perf_device_fields [updates]
+ */
+
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+#include <string>
+
+#include "IOTP_Device.h"
+
+using namespace Watson_IOTP;
+
+static double cpuSeconds() {
+	struct timespec now;
+	clock_gettime(CLOCK_THREAD_CPUTIME_ID, &now);
+	return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+// A location the way IOTP_DeviceLocation kept one, its json rebuilt on every move
+struct CachedLocation {
+	double latitude, longitude, elevation, accuracy;
+	time_t measuredDateTime;
+	Json::Value json;
+
+	void setLocation(double lat, double lon, double elev) {
+		char measured[sizeof "YYYY-MM-DDTHH:MM:SSZ"];
+		struct tm utc;
+		latitude = lat;
+		longitude = lon;
+		elevation = elev;
+		time(&measuredDateTime);
+		strftime(measured, sizeof measured, "%FT%TZ", gmtime_r(&measuredDateTime, &utc));
+		json["latitude"] = latitude;
+		json["longitude"] = longitude;
+		json["elevation"] = elevation;
+		json["accuracy"] = accuracy;
+		json["measuredDateTime"] = measured;
+	}
+};
+
+static std::string fastWrite(const Json::Value& value) {
+	static Json::FastWriter writer;
+	std::string text = writer.write(value);
+	text.erase(text.size() - 1);
+	return text;
+}
+
+static std::string write(const IOTP_DeviceLocation& location) {
+	std::string text;
+	IOTP_JsonWriter writer(text);
+	location.write(writer);
+	return text;
+}
+
+static std::string write(const IOTP_DeviceInfo& info) {
+	std::string text;
+	IOTP_JsonWriter writer(text);
+	info.write(writer);
+	return text;
+}
+
+static double latitude(int seq) { return 52.3702157 + seq * 1e-6; }
+static double longitude(int seq) { return 4.8951679 - seq * 1e-6; }
+static double elevation(int seq) { return 12.5 + (seq % 100) * 0.1; }
+
+int main(int argc, char** argv) {
+	int count = (argc > 1) ? atoi(argv[1]) : 500000;
+	bool ok = true;
+
+	CachedLocation cached;
+	cached.accuracy = 4.0;
+	IOTP_DeviceLocation location(0, 0, 0, 4.0);
+	std::string out;
+
+	double start = cpuSeconds();
+	for (int i = 0; i < count; ++i) {
+		cached.setLocation(latitude(i), longitude(i), elevation(i));
+		out = fastWrite(cached.json);
+	}
+	double cachedRate = count / (cpuSeconds() - start);
+
+	start = cpuSeconds();
+	for (int i = 0; i < count; ++i) {
+		location.setLocation(latitude(i), longitude(i), elevation(i));
+		out.clear();
+		IOTP_JsonWriter writer(out);
+		location.write(writer);
+	}
+	double fieldsRate = count / (cpuSeconds() - start);
+
+	int mismatched = 0;
+	for (int i = 0; i < count; i += 997) {
+		cached.setLocation(latitude(i), longitude(i), elevation(i));
+		location.setLocation(latitude(i), longitude(i), elevation(i));
+		std::string text = write(location);
+		if ((text != fastWrite(cached.json) || text != fastWrite(location.toJsonValue())
+				|| text != write(IOTP_DeviceLocation(location.toJsonValue()))) && mismatched++ == 0)
+			printf("location differs:\n  %s\n  %s\n", fastWrite(cached.json).c_str(), text.c_str());
+	}
+	ok = ok && mismatched == 0;
+
+	IOTP_DeviceInfo info("10087", "IBM", "7865", "A", "My RasPi3 Device", "1.0.0", "1.0", "Bangalore");
+	start = cpuSeconds();
+	for (int i = 0; i < count; ++i)
+		out = fastWrite(info.toJsonValue());
+	double infoValueRate = count / (cpuSeconds() - start);
+	start = cpuSeconds();
+	for (int i = 0; i < count; ++i)
+		out = write(info);
+	double infoFieldsRate = count / (cpuSeconds() - start);
+	bool infoSame = write(info) == fastWrite(info.toJsonValue())
+			&& write(IOTP_DeviceInfo(info.toJsonValue())) == write(info);
+	ok = ok && infoSame;
+
+	printf("%d updates each\n", count);
+	printf("%-10s %-20s %12s %14s\n", "object", "writer", "updates/s", "object bytes");
+	printf("%-10s %-20s %12.0f %14u\n", "location", "cached Json::Value", cachedRate,
+			(unsigned)sizeof(CachedLocation));
+	printf("%-10s %-20s %12.0f %14u%s\n", "location", "fields", fieldsRate,
+			(unsigned)sizeof(IOTP_DeviceLocation), mismatched ? "  OUTPUT DIFFERS" : "");
+	printf("%-10s %-20s %12.0f %14s\n", "info", "toJsonValue", infoValueRate, "");
+	printf("%-10s %-20s %12.0f %14u%s\n", "info", "fields", infoFieldsRate,
+			(unsigned)sizeof(IOTP_DeviceInfo), infoSame ? "" : "  OUTPUT DIFFERS");
+	return ok ? 0 : 1;
+}
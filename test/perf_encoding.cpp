@@ -0,0 +1,119 @@
+/*******************************************************************************
+ * Copyright (c) 2017 IBM Corp.
+ *
+ * All rights reserved. This program and the accompanying materials
+ * are made available under the terms of the Eclipse Public License v1.0
+ * and Eclipse Distribution License v1.0 which accompany this distribution.
+ *
+ * The Eclipse Public License is available at
+ *    http://www.eclipse.org/legal/epl-v10.html
+ * and the Eclipse Distribution License is available at
+ *   http://www.eclipse.org/org/documents/edl-v10.php.
+ *
+ * Contributors:
+ *    Benchmark for the CBOR and MessagePack encodings
+ *******************************************************************************/
+
+/*
+ * Encodes and decodes telemetry events as json, with the FastWriter and Reader, and as CBOR
+ * and MessagePack. The events are a gps fix with readings of a handful of sensors: doubles,
+ * small and large integers, a string and an array of samples. Reports the encoded size,
+ * and the events and megabytes of json a second each encoding and decoding handles, and
+ * checks that the binary encodings give back the values they were given.
+ *
+ * usage: perf_encoding [events] [rounds]
+ */
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "IOTP_Encoding.h"
+
+using namespace Watson_IOTP;
+
+static Json::Value event(std::mt19937& random, int seq) {
+	std::uniform_real_distribution<double> unit(0, 1);
+	Json::Value d(Json::objectValue);
+	d["seq"] = seq;
+	d["lat"] = 52.3 + unit(random) / 100;
+	d["lon"] = 4.8 + unit(random) / 100;
+	d["speed"] = (double)(int)(unit(random) * 1200) / 10;
+	d["temperature"] = 18 + (double)(int)(unit(random) * 100) / 4;
+	d["humidity"] = (int)(unit(random) * 100);
+	d["battery"] = 3.3 + unit(random);
+	d["status"] = (seq % 10 == 0) ? "charging" : "ok";
+	Json::Value& samples = d["vibration"] = Json::Value(Json::arrayValue);
+	for (int i = 0; i < 8; ++i)
+		samples.append((int)(unit(random) * 2000) - 1000);
+	Json::Value root(Json::objectValue);
+	root["d"] = d;
+	root["ts"] = (Json::Int64)1500000000000LL + seq * 1000;
+	return root;
+}
+
+int main(int argc, char** argv) {
+	int count = (argc > 1) ? atoi(argv[1]) : 10000;
+	int rounds = (argc > 2) ? atoi(argv[2]) : 10;
+
+	std::mt19937 random(5);
+	std::vector<Json::Value> events;
+	for (int i = 0; i < count; ++i)
+		events.push_back(event(random, i));
+
+	const IOTP_Encoding::Format formats[] = { IOTP_Encoding::JSON, IOTP_Encoding::CBOR, IOTP_Encoding::MSGPACK };
+	double jsonBytes = 0;
+	printf("%d events, %d rounds\n", count, rounds);
+	printf("%-8s %10s %12s %10s %12s %10s\n", "format", "bytes/evt", "encode ev/s", "MB/s", "decode ev/s", "MB/s");
+
+	for (IOTP_Encoding::Format format : formats) {
+		std::vector<std::string> payloads(count);
+		Json::FastWriter fastWriter;
+		Json::Reader reader;
+
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		for (int r = 0; r < rounds; ++r) {
+			for (int i = 0; i < count; ++i) {
+				if (format == IOTP_Encoding::JSON)
+					payloads[i] = fastWriter.write(events[i]);
+				else {
+					payloads[i].clear();
+					IOTP_Encoding::encode(events[i], format, payloads[i]);
+				}
+			}
+		}
+		double encoding = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+		double bytes = 0;
+		for (const std::string& payload : payloads)
+			bytes += payload.size();
+		if (format == IOTP_Encoding::JSON)
+			jsonBytes = bytes;
+
+		Json::Value value;
+		int failed = 0;
+		start = std::chrono::steady_clock::now();
+		for (int r = 0; r < rounds; ++r) {
+			for (int i = 0; i < count; ++i) {
+				bool decoded = (format == IOTP_Encoding::JSON) ?
+						reader.parse(payloads[i], value, false) :
+						IOTP_Encoding::decode(payloads[i], format, value);
+				if (!decoded || (format != IOTP_Encoding::JSON && r == 0 && !(value == events[i])))
+					++failed;
+			}
+		}
+		double decoding = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+		double total = (double)count * rounds;
+		printf("%-8s %10.1f %12.0f %10.1f %12.0f %10.1f   %.0f%% of json%s\n", IOTP_Encoding::toName(format),
+				bytes / count, total / encoding, jsonBytes * rounds / encoding / 1e6,
+				total / decoding, jsonBytes * rounds / decoding / 1e6, 100 * bytes / jsonBytes,
+				failed ? "  ROUND TRIP FAILED" : "");
+		if (failed)
+			return 1;
+	}
+	return 0;
+}
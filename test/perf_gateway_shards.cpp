@@ -0,0 +1,247 @@
+/*******************************************************************************
+ * Copyright (c) 2017 IBM Corp.
+ *
+ * All rights reserved. This program and the accompanying materials
+ * are made available under the terms of the Eclipse Public License v1.0
+ * and Eclipse Distribution License v1.0 which accompany this distribution.
+ *
+ * The Eclipse Public License is available at
+ *    http://www.eclipse.org/legal/epl-v10.html
+ * and the Eclipse Distribution License is available at
+ *   http://www.eclipse.org/org/documents/edl-v10.php.
+ *
+ * Contributors:
+ *    Throughput benchmark for the sharded gateway client
+ *******************************************************************************/
+
+/*
+ * Publishes QoS1 events for a set of attached devices over 1, 2, 4 ... connections, each
+ * device on the connection the consistent hash ring gives it, as a sharded gateway does, and
+ * reports the aggregate rate at which the events are acknowledged.  It also reports how
+ * evenly the devices spread and how many of them move when the number of connections grows.
+ *
+ * Without a broker URI a minimal broker is started on the loopback interface.  It acks each
+ * connection's publishes no faster than one per service time, standing in for the ceiling a
+ * real broker's per-session queue puts on one connection.
+ *
+ * usage: perf_gateway_shards [devices] [messages] [max shards] [service us] [broker URI]
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "mqtt/async_client.h"
+#include "IOTP_HashRing.h"
+
+using namespace Watson_IOTP;
+
+typedef std::chrono::steady_clock steady;
+
+static double seconds(steady::time_point start) {
+	return std::chrono::duration<double>(steady::now() - start).count();
+}
+
+static void reply(int fd, const unsigned char* packet, size_t length) {
+	while (length > 0) {
+		ssize_t n = send(fd, packet, length, MSG_NOSIGNAL);
+		if (n <= 0)
+			return;
+		packet += n;
+		length -= n;
+	}
+}
+
+/* one broker connection: CONNECT, SUBSCRIBE, PINGREQ and QoS 0/1 PUBLISH are enough here */
+static void serve(int fd, long serviceUs) {
+	std::vector<unsigned char> in;
+	std::deque<unsigned short> acks;
+	std::chrono::microseconds service(serviceUs);
+	steady::time_point next = steady::now();
+	unsigned char buf[64 * 1024];
+	bool open = true;
+
+	while (open) {
+		struct pollfd pfd = { fd, POLLIN, 0 };
+		int timeout = 100;
+		if (!acks.empty())
+			timeout = std::max(0L, (long)std::chrono::duration_cast<std::chrono::milliseconds>(next - steady::now()).count());
+		if (poll(&pfd, 1, timeout) > 0) {
+			ssize_t n = recv(fd, buf, sizeof(buf), 0);
+			if (n <= 0)
+				break;
+			in.insert(in.end(), buf, buf + n);
+		}
+
+		size_t pos = 0;
+		while (in.size() - pos >= 2) {
+			size_t length = 0, header = 1;
+			int shift = 0;
+			bool complete = false;
+			while (pos + header < in.size() && header <= 4) {
+				unsigned char c = in[pos + header++];
+				length += (size_t)(c & 0x7f) << shift;
+				shift += 7;
+				if ((c & 0x80) == 0) {
+					complete = true;
+					break;
+				}
+			}
+			if (!complete || in.size() - pos < header + length)
+				break;
+			const unsigned char* body = &in[pos + header];
+			int type = in[pos] >> 4;
+			if (type == 1) {
+				unsigned char connack[] = { 0x20, 2, 0, 0 };
+				reply(fd, connack, sizeof(connack));
+			}
+			else if (type == 3) {
+				if ((in[pos] >> 1) & 3) {
+					size_t topic = (body[0] << 8) | body[1];
+					acks.push_back((body[2 + topic] << 8) | body[3 + topic]);
+				}
+			}
+			else if (type == 8) {
+				unsigned char suback[] = { 0x90, 3, body[0], body[1], 1 };
+				reply(fd, suback, sizeof(suback));
+			}
+			else if (type == 12) {
+				unsigned char pingresp[] = { 0xd0, 0 };
+				reply(fd, pingresp, sizeof(pingresp));
+			}
+			else if (type == 14)
+				open = false;
+			pos += header + length;
+		}
+		in.erase(in.begin(), in.begin() + pos);
+
+		// release the acks that are due, allowing a short burst to make up for late wakeups
+		steady::time_point now = steady::now();
+		if (next < now - 10 * service)
+			next = now - 10 * service;
+		std::vector<unsigned char> out;
+		while (!acks.empty() && next <= now) {
+			unsigned char puback[] = { 0x40, 2, (unsigned char)(acks.front() >> 8), (unsigned char)acks.front() };
+			out.insert(out.end(), puback, puback + sizeof(puback));
+			acks.pop_front();
+			next += service;
+		}
+		if (!out.empty())
+			reply(fd, out.data(), out.size());
+	}
+	close(fd);
+}
+
+static int startBroker(long serviceUs) {
+	int fd = socket(AF_INET, SOCK_STREAM, 0);
+	struct sockaddr_in addr;
+	socklen_t len = sizeof(addr);
+
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	if (bind(fd, (struct sockaddr*)&addr, sizeof(addr)) != 0 || listen(fd, 64) != 0) {
+		perror("broker");
+		return -1;
+	}
+	getsockname(fd, (struct sockaddr*)&addr, &len);
+	std::thread([fd, serviceUs] {
+		int client;
+		while ((client = accept(fd, NULL, NULL)) >= 0)
+			std::thread(serve, client, serviceUs).detach();
+	}).detach();
+	return ntohs(addr.sin_port);
+}
+
+static int run(const std::string& uri, int shards, int devices, int messages) {
+	IOTP_HashRing ring(shards);
+	std::vector<std::unique_ptr<mqtt::async_client> > clients;
+	std::vector<std::string> topics;
+	std::vector<int> shardOf, perShard(shards, 0);
+	std::vector<mqtt::idelivery_token_ptr> last(shards);
+	std::string payload = "{\"d\":{\"temperature\":21.5,\"humidity\":40,\"status\":\"ok\"}}";
+	mqtt::connect_options options;
+
+	for (int d = 0; d < devices; ++d) {
+		std::string id = "dev" + std::to_string(d);
+		topics.push_back("iot-2/type/sensor/id/" + id + "/evt/status/fmt/json");
+		shardOf.push_back(ring.shardFor("sensor", id));
+		++perShard[shardOf.back()];
+	}
+
+	options.set_clean_session(true);
+	for (int shard = 0; shard < shards; ++shard) {
+		std::string clientId = "g:bench:gateway:gw1" + (shard ? "-" + std::to_string(shard) : std::string());
+		clients.emplace_back(new mqtt::async_client(uri, clientId, (mqtt::iclient_persistence*)nullptr));
+		clients.back()->connect(options)->wait_for_completion(10000);
+	}
+
+	steady::time_point start = steady::now();
+	for (int i = 0; i < messages; ++i) {
+		int d = i % devices;
+		last[shardOf[d]] = clients[shardOf[d]]->publish(topics[d], payload.data(), payload.size(), 1, false);
+	}
+	int rc = 0;
+	for (int shard = 0; shard < shards; ++shard) {
+		try {
+			if (last[shard])
+				last[shard]->wait_for_completion(120000);
+		}
+		catch (const mqtt::exception& e) {
+			fprintf(stderr, "shard %d: %s\n", shard, e.what());
+			rc = 1;
+		}
+	}
+	double elapsed = seconds(start);
+
+	printf("%3d connections: %9.0f msgs/s   devices per connection %d..%d\n", shards, messages / elapsed,
+			*std::min_element(perShard.begin(), perShard.end()), *std::max_element(perShard.begin(), perShard.end()));
+	for (size_t shard = 0; shard < clients.size(); ++shard)
+		clients[shard]->disconnect()->wait_for_completion(10000);
+	return rc;
+}
+
+int main(int argc, char** argv) {
+	int devices = (argc > 1) ? atoi(argv[1]) : 1000;
+	int messages = (argc > 2) ? atoi(argv[2]) : 20000;
+	int maxShards = (argc > 3) ? atoi(argv[3]) : 8;
+	long serviceUs = (argc > 4) ? atol(argv[4]) : 200;
+	std::string uri = (argc > 5) ? argv[5] : "";
+	int rc = 0;
+
+	if (uri.empty()) {
+		int port = startBroker(serviceUs);
+		if (port < 0)
+			return 1;
+		uri = "tcp://127.0.0.1:" + std::to_string(port);
+		printf("local broker, %ld us per ack on each connection\n", serviceUs);
+	}
+	printf("%d devices, %d QoS1 messages\n", devices, messages);
+	for (int shards = 1; shards <= maxShards; shards *= 2)
+		rc += run(uri, shards, devices, messages);
+
+	// consistent hashing: going from N to N+1 connections moves about 1/(N+1) of the devices
+	for (int shards = 1; shards < maxShards; shards *= 2) {
+		IOTP_HashRing before(shards), after(shards + 1);
+		int moved = 0;
+		for (int d = 0; d < devices; ++d) {
+			std::string id = "dev" + std::to_string(d);
+			moved += before.shardFor("sensor", id) != after.shardFor("sensor", id);
+		}
+		printf("%3d -> %3d connections: %5.1f%% of devices moved\n", shards, shards + 1, 100.0 * moved / devices);
+	}
+	return rc != 0;
+}
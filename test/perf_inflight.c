@@ -0,0 +1,418 @@
+/*******************************************************************************
+ * Copyright (c) 2017 IBM Corp.
+ *
+ * All rights reserved. This program and the accompanying materials
+ * are made available under the terms of the Eclipse Public License v1.0
+ * and Eclipse Distribution License v1.0 which accompany this distribution.
+ *
+ * The Eclipse Public License is available at
+ *    http://www.eclipse.org/legal/epl-v10.html
+ * and the Eclipse Distribution License is available at
+ *   http://www.eclipse.org/org/documents/edl-v10.php.
+ *
+ * Contributors:
+ *    Benchmark for the in-flight window over a slow link
+ *******************************************************************************/
+
+/*
+ * Publishes QoS1 messages to a minimal broker on the loopback interface through a shim that
+ * delays each direction and limits the upstream rate, as netem does, and reports the rate at
+ * which they are acknowledged and how long data queues in the shim.  It runs once with no
+ * in-flight limit, once with a fixed window and once with the adaptive window.  A queue of
+ * seconds in the shim is the bufferbloat that delays pings and commands on a cellular link.
+ *
+ * usage: perf_inflight [messages] [payload bytes] [delay ms each way] [upstream bytes/s] [fixed window]
+ */
+
+#include "MQTTAsync.h"
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+static int64_t now_us(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static void send_all(int fd, const unsigned char* data, size_t length)
+{
+	while (length > 0)
+	{
+		ssize_t n = send(fd, data, length, MSG_NOSIGNAL);
+		if (n <= 0)
+			return;
+		data += n;
+		length -= n;
+	}
+}
+
+/* the shim forwards small packets on their due time, Nagle would hold them for a delayed ack */
+static int no_delay(int fd)
+{
+	int on = 1;
+
+	setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+	return fd;
+}
+
+static int listen_loopback(int* port)
+{
+	int fd = socket(AF_INET, SOCK_STREAM, 0);
+	struct sockaddr_in addr;
+	socklen_t len = sizeof(addr);
+
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	if (bind(fd, (struct sockaddr*)&addr, sizeof(addr)) != 0 || listen(fd, 16) != 0)
+	{
+		perror("listen");
+		return -1;
+	}
+	getsockname(fd, (struct sockaddr*)&addr, &len);
+	*port = ntohs(addr.sin_port);
+	return fd;
+}
+
+static int connect_loopback(int port)
+{
+	int fd = socket(AF_INET, SOCK_STREAM, 0);
+	struct sockaddr_in addr;
+
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	addr.sin_port = htons(port);
+	if (connect(fd, (struct sockaddr*)&addr, sizeof(addr)) != 0)
+	{
+		close(fd);
+		return -1;
+	}
+	return fd;
+}
+
+
+/* broker: CONNECT, SUBSCRIBE, PINGREQ and QoS 0/1 PUBLISH, answered at once */
+
+static void* broker_connection(void* arg)
+{
+	int fd = (int)(intptr_t)arg;
+	unsigned char* in = malloc(256 * 1024);
+	size_t used = 0;
+
+	for (;;)
+	{
+		size_t pos = 0;
+		ssize_t n = recv(fd, in + used, 256 * 1024 - used, 0);
+
+		if (n <= 0)
+			break;
+		used += n;
+		while (used - pos >= 2)
+		{
+			size_t length = 0, header = 1;
+			int shift = 0, complete = 0, type = in[pos] >> 4;
+			const unsigned char* body;
+
+			while (pos + header < used && header <= 4)
+			{
+				unsigned char c = in[pos + header++];
+				length += (size_t)(c & 0x7f) << shift;
+				shift += 7;
+				if ((c & 0x80) == 0)
+				{
+					complete = 1;
+					break;
+				}
+			}
+			if (!complete || used - pos < header + length)
+				break;
+			body = in + pos + header;
+			if (type == 1)
+			{
+				unsigned char connack[] = { 0x20, 2, 0, 0 };
+				send_all(fd, connack, sizeof(connack));
+			}
+			else if (type == 3 && ((in[pos] >> 1) & 3))
+			{
+				size_t topic = (body[0] << 8) | body[1];
+				unsigned char puback[] = { 0x40, 2, body[2 + topic], body[3 + topic] };
+				send_all(fd, puback, sizeof(puback));
+			}
+			else if (type == 8)
+			{
+				unsigned char suback[] = { 0x90, 3, body[0], body[1], 1 };
+				send_all(fd, suback, sizeof(suback));
+			}
+			else if (type == 12)
+			{
+				unsigned char pingresp[] = { 0xd0, 0 };
+				send_all(fd, pingresp, sizeof(pingresp));
+			}
+			pos += header + length;
+		}
+		memmove(in, in + pos, used - pos);
+		used -= pos;
+	}
+	free(in);
+	close(fd);
+	return NULL;
+}
+
+static void* broker(void* arg)
+{
+	int listener = (int)(intptr_t)arg, fd;
+
+	while ((fd = accept(listener, NULL, NULL)) >= 0)
+	{
+		pthread_t thread;
+		pthread_create(&thread, NULL, broker_connection, (void*)(intptr_t)no_delay(fd));
+		pthread_detach(thread);
+	}
+	return NULL;
+}
+
+
+/* shim: each chunk read leaves the link once the ones before it have, at the link rate, and
+   arrives the delay after that */
+
+typedef struct chunk
+{
+	struct chunk* next;
+	int64_t due;
+	size_t length;
+	unsigned char data[4096];
+} chunk;
+
+typedef struct
+{
+	int from, to;
+	int64_t delay;
+	long rate;			/* bytes per second, 0 for no limit */
+	int64_t queued;		/* microseconds chunks waited to get on the link, summed */
+	int64_t max_queued;
+	long chunks;
+} pipe_state;
+
+static pipe_state upstream, downstream;
+static int shim_broker_port;
+
+static void* shim_pipe(void* arg)
+{
+	pipe_state* p = arg;
+	chunk* head = NULL;
+	chunk** tail = &head;
+	int64_t link_free = 0;
+	int open = 1;
+
+	while (open || head)
+	{
+		struct pollfd pfd = { p->from, POLLIN, 0 };
+		int64_t now = now_us();
+		int timeout = 100;
+
+		if (head)
+			timeout = (head->due > now) ? (int)((head->due - now + 999) / 1000) : 0;
+		if (open && poll(&pfd, 1, timeout) > 0)
+		{
+			chunk* c = malloc(sizeof(chunk));
+			ssize_t n = recv(p->from, c->data, sizeof(c->data), 0);
+
+			now = now_us();
+			if (n <= 0)
+			{
+				free(c);
+				open = 0;
+			}
+			else
+			{
+				int64_t start = (link_free > now) ? link_free : now;
+
+				c->length = n;
+				link_free = start + (p->rate ? (int64_t)n * 1000000 / p->rate : 0);
+				c->due = link_free + p->delay;
+				c->next = NULL;
+				*tail = c;
+				tail = &c->next;
+				p->queued += start - now;
+				if (start - now > p->max_queued)
+					p->max_queued = start - now;
+				++p->chunks;
+			}
+		}
+		else if (!open && head)
+			usleep((head->due > now) ? (useconds_t)(head->due - now) : 0);
+
+		now = now_us();
+		while (head && head->due <= now)
+		{
+			chunk* c = head;
+			send_all(p->to, c->data, c->length);
+			head = c->next;
+			if (head == NULL)
+				tail = &head;
+			free(c);
+		}
+	}
+	shutdown(p->to, SHUT_WR);
+	return NULL;
+}
+
+static void* shim(void* arg)
+{
+	int listener = (int)(intptr_t)arg, client;
+
+	while ((client = accept(listener, NULL, NULL)) >= 0)
+	{
+		pthread_t up, down;
+		int server = no_delay(connect_loopback(shim_broker_port));
+
+		no_delay(client);
+		upstream.from = downstream.to = client;
+		upstream.to = downstream.from = server;
+		upstream.queued = upstream.max_queued = upstream.chunks = 0;
+		pthread_create(&up, NULL, shim_pipe, &upstream);
+		pthread_create(&down, NULL, shim_pipe, &downstream);
+		pthread_join(up, NULL);
+		pthread_join(down, NULL);
+		close(client);
+		close(server);
+	}
+	return NULL;
+}
+
+
+/* client */
+
+static volatile int connected = 0;
+static volatile int acked = 0;
+
+static void onConnect(void* context, MQTTAsync_successData* response)
+{
+	(void)context;
+	(void)response;
+	connected = 1;
+}
+
+static void onConnectFailure(void* context, MQTTAsync_failureData* response)
+{
+	(void)context;
+	(void)response;
+	connected = -1;
+}
+
+static void onPublish(void* context, MQTTAsync_successData* response)
+{
+	(void)context;
+	(void)response;
+	++acked;
+}
+
+static int run(const char* uri, const char* name, int control, int maxInflight, int messages, int payloadLength)
+{
+	MQTTAsync client;
+	MQTTAsync_connectOptions opts = MQTTAsync_connectOptions_initializer;
+	MQTTAsync_disconnectOptions dopts = MQTTAsync_disconnectOptions_initializer;
+	MQTTAsync_inflightStats stats = MQTTAsync_inflightStats_initializer;
+	char* payload = malloc(payloadLength);
+	int64_t start, elapsed;
+	int i, rc = 0, window = 0;
+
+	memset(payload, 'x', payloadLength);
+	MQTTAsync_create(&client, uri, "perf_inflight", MQTTCLIENT_PERSISTENCE_NONE, NULL);
+	opts.cleansession = 1;
+	opts.keepAliveInterval = 60;
+	opts.onSuccess = onConnect;
+	opts.onFailure = onConnectFailure;
+	opts.inflightControl = control;
+	opts.maxInflight = maxInflight;
+	connected = acked = 0;
+	MQTTAsync_connect(client, &opts);
+	while (connected == 0)
+		usleep(1000);
+	if (connected < 0)
+	{
+		fprintf(stderr, "%s: connect failed\n", name);
+		rc = 1;
+		goto exit;
+	}
+
+	start = now_us();
+	for (i = 0; i < messages; ++i)
+	{
+		MQTTAsync_responseOptions ropts = MQTTAsync_responseOptions_initializer;
+		ropts.onSuccess = onPublish;
+		MQTTAsync_send(client, "iot-2/evt/status/fmt/json", payloadLength, payload, 1, 0, &ropts);
+	}
+	while (acked < messages && now_us() - start < 120 * 1000000LL)
+	{
+		usleep(10000);
+		MQTTAsync_getInflightStats(client, &stats);
+		if (stats.window > window)
+			window = stats.window;
+	}
+	elapsed = now_us() - start;
+	MQTTAsync_getInflightStats(client, &stats);
+
+	printf("%-14s %7.0f msgs/s   link queue avg %6.1f ms max %7.1f ms", name, acked * 1e6 / elapsed,
+			upstream.chunks ? upstream.queued / 1000.0 / upstream.chunks : 0.0, upstream.max_queued / 1000.0);
+	if (control == MQTTASYNC_INFLIGHT_ADAPTIVE)
+		printf("\n               window %d (max %d)  rtt %.1f ms  min rtt %.1f ms  pacing %d msgs/s  cuts %u delay %u loss",
+				stats.window, window, stats.rtt / 1000.0, stats.minRtt / 1000.0, stats.pacingRate, stats.delays, stats.losses);
+	printf("\n");
+	if (acked < messages)
+	{
+		fprintf(stderr, "%s: %d of %d acknowledged\n", name, acked, messages);
+		rc = 1;
+	}
+
+	MQTTAsync_disconnect(client, &dopts);
+	usleep(200000);
+exit:
+	MQTTAsync_destroy(&client);
+	free(payload);
+	return rc;
+}
+
+int main(int argc, char** argv)
+{
+	int messages = (argc > 1) ? atoi(argv[1]) : 1000;
+	int payloadLength = (argc > 2) ? atoi(argv[2]) : 200;
+	int delayMs = (argc > 3) ? atoi(argv[3]) : 20;
+	long rate = (argc > 4) ? atol(argv[4]) : 100000;
+	int fixed = (argc > 5) ? atoi(argv[5]) : 10;
+	int brokerListener, shimListener, shimPort, rc = 0;
+	pthread_t thread;
+	char uri[64];
+
+	if ((brokerListener = listen_loopback(&shim_broker_port)) < 0 || (shimListener = listen_loopback(&shimPort)) < 0)
+		return 1;
+	pthread_create(&thread, NULL, broker, (void*)(intptr_t)brokerListener);
+	pthread_create(&thread, NULL, shim, (void*)(intptr_t)shimListener);
+	upstream.delay = downstream.delay = delayMs * 1000LL;
+	upstream.rate = rate;
+	snprintf(uri, sizeof(uri), "tcp://127.0.0.1:%d", shimPort);
+
+	printf("%d QoS1 messages of %d bytes, %d ms each way, upstream %ld bytes/s\n", messages, payloadLength, delayMs, rate);
+	rc += run(uri, "no limit", MQTTASYNC_INFLIGHT_NONE, 10, messages, payloadLength);
+	{
+		char name[32];
+		snprintf(name, sizeof(name), "fixed %d", fixed);
+		rc += run(uri, name, MQTTASYNC_INFLIGHT_FIXED, fixed, messages, payloadLength);
+	}
+	rc += run(uri, "adaptive", MQTTASYNC_INFLIGHT_ADAPTIVE, 1000, messages, payloadLength);
+	return rc != 0;
+}
@@ -0,0 +1,169 @@
+/*******************************************************************************
+ * Copyright (c) 2017 IBM Corp.
+ *
+ * All rights reserved. This program and the accompanying materials
+ * are made available under the terms of the Eclipse Public License v1.0
+ * and Eclipse Distribution License v1.0 which accompany this distribution.
+ *
+ * The Eclipse Public License is available at
+ *    http://www.eclipse.org/legal/epl-v10.html
+ * and the Eclipse Distribution License is available at
+ *   http://www.eclipse.org/org/documents/edl-v10.php.
+ *
+ * Contributors:
+ *    Benchmark for Json::Value documents in an arena
+ ******************************************************************************/
+
+/*
+ * Parses the payloads a device receives, a command, an iotdm-1/device/update request and a
+ * command carrying a schedule, reads a field of each and drops the document, then builds the
+ * Json::Value of a location update and copies it as a message is. Each is done with the
+ * storage of the values on the heap, and in the arena of the thread released after every
+ * message the way the client does. Reports messages a second and the mallocs a message takes,
+ * every one counted whether from jsoncpp or operator new.
+ *
+ * usage: perf_json_arena [messages]
+ */
+
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+#include <string>
+
+#include "IOTP_JsonScanner.h"
+
+using namespace Watson_IOTP;
+
+extern "C" {
+void* __libc_malloc(size_t size);
+void* __libc_calloc(size_t count, size_t size);
+void* __libc_realloc(void* p, size_t size);
+void __libc_free(void* p);
+
+static unsigned long long mallocs;
+
+void* malloc(size_t size) {
+	++mallocs;
+	return __libc_malloc(size);
+}
+
+void* calloc(size_t count, size_t size) {
+	++mallocs;
+	return __libc_calloc(count, size);
+}
+
+void* realloc(void* p, size_t size) {
+	++mallocs;
+	return __libc_realloc(p, size);
+}
+
+void free(void* p) {
+	__libc_free(p);
+}
+}
+
+static double cpuSeconds() {
+	struct timespec now;
+	clock_gettime(CLOCK_THREAD_CPUTIME_ID, &now);
+	return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+static std::string schedule() {
+	std::string text = "{\"d\":{\"schedule\":[";
+	char entry[160];
+	for (int i = 0; i < 96; ++i) {
+		snprintf(entry, sizeof(entry), "%s{\"at\":\"2017-03-01T%02d:%02d:00Z\",\"setpoint\":%.2f,\"fan\":%s,\"label\":\"slot %d\"}",
+				i ? "," : "", i / 4, (i % 4) * 15, 18 + (i % 13) * 0.25, (i % 2) ? "true" : "false", i);
+		text += entry;
+	}
+	return text + "]}}";
+}
+
+static const std::string COMMAND =
+	"{\"d\":{\"rate\":10,\"mode\":\"eco\",\"target\":21.5,\"fan\":true,\"zones\":[\"north\",\"east\"]},"
+	"\"ts\":\"2017-03-01T10:15:30.123Z\"}";
+static const std::string UPDATE =
+	"{\"reqId\":\"f38faafc-53de-47a8-a940-e697552c3194\",\"d\":{\"fields\":[{\"field\":\"location\","
+	"\"value\":{\"latitude\":52.3702157,\"longitude\":4.8951679,\"elevation\":12.5,"
+	"\"measuredDateTime\":\"2017-03-01T10:15:30Z\",\"accuracy\":4}},{\"field\":\"metadata\","
+	"\"value\":{\"owner\":\"fleet north\",\"notes\":\"line one\"}}]}}";
+static const std::string SCHEDULE = schedule();
+
+static double sink;
+
+static void parse(const std::string& text) {
+	Json::Value root;
+	IOTP_JsonScanner::parse(text, root);
+	sink += root["d"].size();
+}
+
+static void location(int seq) {
+	Json::Value data;
+	data["latitude"] = 52.3702157 + seq * 1e-6;
+	data["longitude"] = 4.8951679 - seq * 1e-6;
+	data["elevation"] = 12.5;
+	data["accuracy"] = 4.0;
+	data["measuredDateTime"] = "2017-03-01T10:15:30Z";
+	Json::Value message;
+	message["d"] = data;
+	message["reqId"] = "1500000000";
+	sink += message.size();
+}
+
+struct Workload {
+	const char* name;
+	void (*run)(int seq);
+};
+
+static void command(int) { parse(COMMAND); }
+static void update(int) { parse(UPDATE); }
+static void scheduleCommand(int) { parse(SCHEDULE); }
+
+int main(int argc, char** argv) {
+	int count = (argc > 1) ? atoi(argv[1]) : 100000;
+	const Workload workloads[] = {
+		{ "command", command },
+		{ "update", update },
+		{ "schedule", scheduleCommand },
+		{ "location", location },
+	};
+
+	printf("%d messages each\n", count);
+	printf("%-10s %-8s %12s %10s %12s\n", "message", "storage", "msgs/s", "mallocs", "arena bytes");
+	for (const Workload& workload : workloads) {
+		// once before measuring, for the thread's buffers and the blocks of its arena
+		workload.run(0);
+		{
+			Json::Arena::Scope scope(Json::Arena::forThread());
+			workload.run(0);
+		}
+		size_t arenaBytes = Json::Arena::forThread().allocated();
+		Json::Arena::forThread().release();
+
+		unsigned long long before = mallocs;
+		double start = cpuSeconds();
+		for (int i = 0; i < count; ++i)
+			workload.run(i);
+		double heapSeconds = cpuSeconds() - start;
+		unsigned long long heapMallocs = mallocs - before;
+
+		Json::Arena& arena = Json::Arena::forThread();
+		before = mallocs;
+		start = cpuSeconds();
+		for (int i = 0; i < count; ++i) {
+			{
+				Json::Arena::Scope scope(arena);
+				workload.run(i);
+			}
+			arena.release();
+		}
+		double arenaSeconds = cpuSeconds() - start;
+		unsigned long long arenaMallocs = mallocs - before;
+
+		printf("%-10s %-8s %12.0f %10.2f %12s\n", workload.name, "heap", count / heapSeconds,
+				(double)heapMallocs / count, "");
+		printf("%-10s %-8s %12.0f %10.2f %12u\n", "", "arena", count / arenaSeconds,
+				(double)arenaMallocs / count, (unsigned)arenaBytes);
+	}
+	return sink == 0;
+}
@@ -0,0 +1,153 @@
+/*******************************************************************************
+ * Copyright (c) 2017 IBM Corp.
+ *
+ * All rights reserved. This program and the accompanying materials
+ * are made available under the terms of the Eclipse Public License v1.0
+ * and Eclipse Distribution License v1.0 which accompany this distribution.
+ *
+ * The Eclipse Public License is available at
+ *    http://www.eclipse.org/legal/epl-v10.html
+ * and the Eclipse Distribution License is available at
+ *   http://www.eclipse.org/org/documents/edl-v10.php.
+ *
+ * Contributors:
+ *    Benchmark for the formatting of numbers in json
+ *******************************************************************************/
+
+/*
+ * Writes arrays of 10000 numbers, GPS coordinates of 7 decimals, sensor readings of 2,
+ * doubles of any bit pattern and counters, with snprintf("%.17g") as jsoncpp used to, and
+ * with Json::FastWriter and IOTP_JsonWriter, which write the fewest digits that read back as
+ * the number. Checks that every number reads back the same and reports numbers a second and
+ * the bytes written.
+ *
+ * usage: perf_json_doubles [rounds]
+ */
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <string>
+#include <vector>
+
+#include "IOTP_JsonWriter.h"
+
+using namespace Watson_IOTP;
+
+static double cpuSeconds() {
+	struct timespec now;
+	clock_gettime(CLOCK_THREAD_CPUTIME_ID, &now);
+	return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+static const int COUNT = 10000;
+
+struct Numbers {
+	const char* name;
+	Json::Value array;
+};
+
+// xorshift, for the same numbers on every run
+static unsigned long long nextRandom(unsigned long long& state) {
+	state ^= state << 13;
+	state ^= state >> 7;
+	state ^= state << 17;
+	return state;
+}
+
+static std::vector<Numbers> numbers() {
+	std::vector<Numbers> list(4);
+	unsigned long long state = 88172645463325252ULL;
+	list[0].name = "gps";
+	list[1].name = "sensor";
+	list[2].name = "any bits";
+	list[3].name = "counter";
+	for (int i = 0; i < COUNT; ++i) {
+		list[0].array.append((i % 2 ? 4.0 : 52.0) + (double)(nextRandom(state) % 10000000) / 1e7);
+		list[1].array.append((double)(nextRandom(state) % 10000) / 100 - 20);
+		double any;
+		do {
+			unsigned long long bits = nextRandom(state);
+			memcpy(&any, &bits, sizeof(any));
+		} while (any != any || any - any != 0);
+		list[2].array.append(any);
+		list[3].array.append((Json::LargestInt)(nextRandom(state) % 100000000000ULL));
+	}
+	return list;
+}
+
+static void writePrintf(const Json::Value& array, std::string& out) {
+	out.clear();
+	out += '[';
+	char buffer[32];
+	for (Json::ArrayIndex i = 0; i < array.size(); ++i) {
+		if (i)
+			out += ',';
+		const Json::Value& number = array[i];
+		int length = number.isDouble() ? snprintf(buffer, sizeof(buffer), "%.17g", number.asDouble())
+				: snprintf(buffer, sizeof(buffer), "%lld", (long long)number.asLargestInt());
+		out.append(buffer, length);
+	}
+	out += ']';
+}
+
+static void writeFast(const Json::Value& array, std::string& out) {
+	static Json::FastWriter writer;
+	out = writer.write(array);
+}
+
+static void writeStreaming(const Json::Value& array, std::string& out) {
+	out.clear();
+	IOTP_JsonWriter writer(out);
+	writer.beginArray();
+	for (Json::ArrayIndex i = 0; i < array.size(); ++i)
+		writer.value(array[i]);
+	writer.endArray();
+}
+
+// Every number of the text reads back as the one of the array
+static bool readsBack(const Json::Value& array, const std::string& text) {
+	const char* p = text.c_str() + 1;
+	for (Json::ArrayIndex i = 0; i < array.size(); ++i) {
+		char* end;
+		double number = strtod(p, &end);
+		if (end == p || number != array[i].asDouble())
+			return false;
+		p = end + 1;
+	}
+	return true;
+}
+
+int main(int argc, char** argv) {
+	int rounds = (argc > 1) ? atoi(argv[1]) : 50;
+	std::vector<Numbers> list = numbers();
+	struct Writer {
+		const char* name;
+		void (*write)(const Json::Value&, std::string&);
+	} writers[] = {
+		{ "%.17g", writePrintf },
+		{ "FastWriter", writeFast },
+		{ "streaming", writeStreaming },
+	};
+
+	printf("%d numbers an array, %d rounds\n", COUNT, rounds);
+	printf("%-10s %-12s %12s %10s %8s\n", "numbers", "writer", "numbers/s", "bytes", "");
+	bool ok = true;
+	std::string out;
+	for (const Numbers& set : list) {
+		for (const Writer& writer : writers) {
+			writer.write(set.array, out);
+			bool same = readsBack(set.array, out);
+			ok = ok && same;
+			size_t bytes = out.size();
+			double start = cpuSeconds();
+			for (int r = 0; r < rounds; ++r)
+				writer.write(set.array, out);
+			double seconds = cpuSeconds() - start;
+			printf("%-10s %-12s %12.0f %10u %8s\n", set.name, writer.name, COUNT * (double)rounds / seconds,
+					(unsigned)bytes, same ? "" : "DIFFERS");
+		}
+	}
+	return ok ? 0 : 1;
+}
@@ -0,0 +1,131 @@
+/*******************************************************************************
+ * Copyright (c) 2017 IBM Corp.
+ *
+ * All rights reserved. This program and the accompanying materials
+ * are made available under the terms of the Eclipse Public License v1.0
+ * and Eclipse Distribution License v1.0 which accompany this distribution.
+ *
+ * The Eclipse Public License is available at
+ *    http://www.eclipse.org/legal/epl-v10.html
+ * and the Eclipse Distribution License is available at
+ *   http://www.eclipse.org/org/documents/edl-v10.php.
+ *
+ * Contributors:
+ *    Benchmark for the storage of Json::Value objects
+ *******************************************************************************/
+
+/*
+ * Builds objects of 5, 15 and 30 members the size of device payloads, a few strings among
+ * numbers, then looks up every member, iterates over them and copies the object. Reports
+ * the nanoseconds and heap allocations each takes, for the storage jsoncpp is built with:
+ * std::map, or the sorted vector of -Duse_flat_json_objects=ON (JSON_USE_FLAT_MAP).
+ *
+ * usage: perf_json_objects [rounds]
+ */
+
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+#include <new>
+#include <string>
+#include <vector>
+
+#include "json/json.h"
+
+static unsigned long long allocations;
+
+void* operator new(size_t size) {
+	++allocations;
+	void* p = malloc(size ? size : 1);
+	if (p == NULL)
+		throw std::bad_alloc();
+	return p;
+}
+
+void operator delete(void* p) noexcept {
+	free(p);
+}
+
+static double cpuSeconds() {
+	struct timespec now;
+	clock_gettime(CLOCK_THREAD_CPUTIME_ID, &now);
+	return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+static const char* const NAMES[] = {
+	"temperature", "humidity", "pressure", "battery", "status", "lat", "lon", "speed", "heading",
+	"altitude", "rssi", "snr", "uptime", "firmware", "seq", "co2", "voc", "pm25", "pm10", "noise",
+	"lux", "uv", "windSpeed", "windDir", "rain", "soil", "door", "motion", "vibration", "tilt"
+};
+
+static void build(Json::Value& object, int members, int seq) {
+	object = Json::Value(Json::objectValue);
+	for (int i = 0; i < members; ++i) {
+		if (i % 5 == 4)
+			object[NAMES[i]] = "ok";
+		else
+			object[NAMES[i]] = seq + i * 0.5;
+	}
+}
+
+struct Result {
+	double nanoseconds;
+	double allocations;
+};
+
+template <typename Operation>
+static Result measure(int rounds, Operation operation) {
+	unsigned long long before = allocations;
+	double start = cpuSeconds();
+	for (int i = 0; i < rounds; ++i)
+		operation(i);
+	Result result = { 1e9 * (cpuSeconds() - start) / rounds, (double)(allocations - before) / rounds };
+	return result;
+}
+
+int main(int argc, char** argv) {
+	int rounds = (argc > 1) ? atoi(argv[1]) : 200000;
+#ifdef JSON_USE_FLAT_MAP
+	const char* storage = "sorted vector";
+#else
+	const char* storage = "std::map";
+#endif
+	printf("objects stored in a %s, %d rounds\n", storage, rounds);
+	printf("%-8s %-8s %10s %10s\n", "members", "op", "ns/op", "allocs/op");
+
+	double sink = 0;
+	const int sizes[] = { 5, 15, 30 };
+	for (int members : sizes) {
+		Json::Value object;
+		Result built = measure(rounds, [&](int i) {
+			build(object, members, i);
+		});
+
+		const Json::Value& constObject = object;
+		Result lookedUp = measure(rounds, [&](int) {
+			for (int m = 0; m < members; ++m) {
+				const Json::Value& member = constObject[NAMES[m]];
+				if (member.isDouble())
+					sink += member.asDouble();
+			}
+		});
+
+		Result iterated = measure(rounds, [&](int) {
+			for (Json::Value::const_iterator it = constObject.begin(); it != constObject.end(); ++it) {
+				if ((*it).isDouble())
+					sink += (*it).asDouble();
+			}
+		});
+
+		Result copied = measure(rounds, [&](int) {
+			Json::Value copy(constObject);
+			sink += copy.size();
+		});
+
+		const char* names[] = { "build", "lookup", "iterate", "copy" };
+		Result results[] = { built, lookedUp, iterated, copied };
+		for (int r = 0; r < 4; ++r)
+			printf("%-8d %-8s %10.1f %10.1f\n", members, names[r], results[r].nanoseconds, results[r].allocations);
+	}
+	return sink == 0;
+}
@@ -0,0 +1,136 @@
+/*******************************************************************************
+ * Copyright (c) 2017 IBM Corp.
+ *
+ * All rights reserved. This program and the accompanying materials
+ * are made available under the terms of the Eclipse Public License v1.0
+ * and Eclipse Distribution License v1.0 which accompany this distribution.
+ *
+ * The Eclipse Public License is available at
+ *    http://www.eclipse.org/legal/epl-v10.html
+ * and the Eclipse Distribution License is available at
+ *   http://www.eclipse.org/org/documents/edl-v10.php.
+ *
+ * Contributors:
+ *    Benchmark for the vectorized json scanner
+ *******************************************************************************/
+
+/*
+ * Parses the payloads a device receives, a command, the platform's response to a management
+ * request, iotdm-1/device/update and iotdm-1/observe requests and a command carrying a
+ * schedule of setpoints, with Json::Reader and with IOTP_JsonScanner at each instruction set
+ * the processor has. Checks that both give the same Json::Value and reports parsed MB/s, and
+ * for the scanner the MB/s of the first pass alone.
+ *
+ * usage: perf_json_scanner [seconds per run]
+ */
+
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+#include <string>
+#include <vector>
+
+#include "IOTP_JsonScanner.h"
+
+using namespace Watson_IOTP;
+
+struct Payload {
+	const char* name;
+	std::string text;
+};
+
+static std::vector<Payload> payloads() {
+	std::vector<Payload> list;
+	list.push_back({ "command",
+		"{\"d\":{\"rate\":10,\"mode\":\"eco\",\"target\":21.5,\"fan\":true,\"zones\":[\"north\",\"east\"]},"
+		"\"ts\":\"2017-03-01T10:15:30.123Z\"}" });
+	list.push_back({ "response", "{\"rc\":200,\"reqId\":\"1488363330127\"}" });
+	list.push_back({ "update",
+		"{\"reqId\":\"f38faafc-53de-47a8-a940-e697552c3194\",\"d\":{\"fields\":[{\"field\":\"location\","
+		"\"value\":{\"latitude\":52.3702157,\"longitude\":4.8951679,\"elevation\":12.5,"
+		"\"measuredDateTime\":\"2017-03-01T10:15:30Z\",\"accuracy\":4}},{\"field\":\"metadata\","
+		"\"value\":{\"owner\":\"fleet \\\"north\\\"\",\"notes\":\"line one\\nline two\"}}]}}" });
+	list.push_back({ "observe",
+		"{\"reqId\":\"909b477c-cd37-4bee-83fa-1d568664fbe8\",\"d\":{\"fields\":[{\"field\":\"mgmt.firmware\"}]}}" });
+
+	std::string schedule = "{\"d\":{\"schedule\":[";
+	char entry[160];
+	for (int i = 0; i < 96; ++i) {
+		snprintf(entry, sizeof(entry), "%s{\"at\":\"2017-03-01T%02d:%02d:00Z\",\"setpoint\":%.2f,\"fan\":%s,\"label\":\"slot %d\"}",
+				i ? "," : "", i / 4, (i % 4) * 15, 18 + (i % 13) * 0.25, (i % 2) ? "true" : "false", i);
+		schedule += entry;
+	}
+	schedule += "]}}";
+	list.push_back({ "schedule", schedule });
+	return list;
+}
+
+static double cpuSeconds() {
+	struct timespec now;
+	clock_gettime(CLOCK_THREAD_CPUTIME_ID, &now);
+	return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+// Runs the parse for about the given time and returns MB/s
+template <typename Parse>
+static double measure(const std::string& text, double seconds, Parse parse) {
+	long iterations = 0;
+	double start = cpuSeconds(), elapsed;
+	do {
+		for (int i = 0; i < 256; ++i)
+			parse();
+		iterations += 256;
+		elapsed = cpuSeconds() - start;
+	} while (elapsed < seconds);
+	return text.size() * (double)iterations / elapsed / 1e6;
+}
+
+int main(int argc, char** argv) {
+	double seconds = (argc > 1) ? atof(argv[1]) : 0.3;
+	std::vector<Payload> list = payloads();
+	IOTP_JsonScanner::Level best = IOTP_JsonScanner::level();
+
+	std::vector<IOTP_JsonScanner::Level> levels;
+	for (int level = IOTP_JsonScanner::SCALAR; level <= IOTP_JsonScanner::AVX2; ++level) {
+		if (IOTP_JsonScanner::setLevel((IOTP_JsonScanner::Level)level))
+			levels.push_back((IOTP_JsonScanner::Level)level);
+	}
+	printf("scanner uses %s\n", IOTP_JsonScanner::toName(best));
+	printf("%-10s %6s %-12s %10s %10s %8s\n", "payload", "bytes", "parser", "parse MB/s", "index MB/s", "speedup");
+
+	bool ok = true;
+	for (const Payload& payload : list) {
+		const std::string& text = payload.text;
+		Json::Reader reader;
+		Json::Value expected;
+		if (!reader.parse(text, expected)) {
+			printf("%s: Json::Reader cannot parse it\n", payload.name);
+			ok = false;
+			continue;
+		}
+		double readerRate = measure(text, seconds, [&]() {
+			Json::Value root;
+			reader.parse(text, root);
+		});
+		printf("%-10s %6u %-12s %10.1f %10s %8s\n", payload.name, (unsigned)text.size(), "Json::Reader", readerRate, "", "");
+
+		for (IOTP_JsonScanner::Level level : levels) {
+			IOTP_JsonScanner::setLevel(level);
+			Json::Value root;
+			bool same = IOTP_JsonScanner::parse(text, root) && root == expected;
+			ok = ok && same;
+			double parseRate = measure(text, seconds, [&]() {
+				Json::Value parsed;
+				IOTP_JsonScanner::parse(text, parsed);
+			});
+			std::vector<uint32_t> offsets;
+			double indexRate = measure(text, seconds, [&]() {
+				IOTP_JsonScanner::index(text.data(), text.size(), offsets);
+			});
+			printf("%-10s %6s %-12s %10.1f %10.1f %7.2fx%s\n", "", "", IOTP_JsonScanner::toName(level), parseRate,
+					indexRate, parseRate / readerRate, same ? "" : "  DIFFERENT VALUE");
+		}
+	}
+	IOTP_JsonScanner::setLevel(best);
+	return ok ? 0 : 1;
+}
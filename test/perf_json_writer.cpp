@@ -0,0 +1,287 @@
+/*******************************************************************************
+ * Copyright (c) 2017 IBM Corp.
+ *
+ * All rights reserved. This program and the accompanying materials
+ * are made available under the terms of the Eclipse Public License v1.0
+ * and Eclipse Distribution License v1.0 which accompany this distribution.
+ *
+ * The Eclipse Public License is available at
+ *    http://www.eclipse.org/legal/epl-v10.html
+ * and the Eclipse Distribution License is available at
+ *   http://www.eclipse.org/org/documents/edl-v10.php.
+ *
+ * Contributors:
+ *    Benchmark for the streaming json writer
+ *******************************************************************************/
+
+/*
+ * Writes the device management messages the client sends, manage, location update, log
+ * entry, error code and the response to a command, the way the client used to, as a
+ * Json::Value wrapped with the reqId and written with Json::FastWriter, and with
+ * IOTP_JsonWriter into a reused buffer, the device info, location and log entry by their own
+ * write(). Checks that both give the same text, and that objects and arrays nested deeper
+ * than 64 are written right, and reports the bytes written a second and the heap allocations
+ * a message takes.
+ *
+ * usage: perf_json_writer [messages]
+ */
+
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+#include <new>
+#include <string>
+#include <vector>
+
+#include "IOTP_Device.h"
+#include "IOTP_JsonWriter.h"
+
+using namespace Watson_IOTP;
+
+static unsigned long long allocations;
+
+void* operator new(size_t size) {
+	++allocations;
+	void* p = malloc(size ? size : 1);
+	if (p == NULL)
+		throw std::bad_alloc();
+	return p;
+}
+
+void operator delete(void* p) noexcept {
+	free(p);
+}
+
+static double cpuSeconds() {
+	struct timespec now;
+	clock_gettime(CLOCK_THREAD_CPUTIME_ID, &now);
+	return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+struct Message {
+	const char* name;
+	Json::Value (*build)(int seq);
+	void (*write)(IOTP_JsonWriter& writer, int seq);
+};
+
+static std::string reqId(int seq) {
+	char id[16];
+	snprintf(id, sizeof(id), "%d", 1500000000 + seq);
+	return id;
+}
+
+static Json::Value wrap(const Json::Value& data, int seq) {
+	Json::Value message;
+	message["d"] = data;
+	message["reqId"] = reqId(seq);
+	return message;
+}
+
+static void wrapped(IOTP_JsonWriter& writer, int seq, void (*writeData)(IOTP_JsonWriter&, int)) {
+	char id[16];
+	snprintf(id, sizeof(id), "%d", 1500000000 + seq);
+	writer.beginObject().key("d");
+	writeData(writer, seq);
+	writer.member("reqId", (const char*)id).endObject();
+}
+
+static Json::Value buildManage(int seq) {
+	Json::Value data;
+	data["lifetime"] = 3600;
+	data["supports"]["deviceActions"] = true;
+	data["supports"]["firmwareActions"] = true;
+	Json::Value& info = data["deviceInfo"];
+	info["serialNumber"] = "10087";
+	info["manufacturer"] = "IBM";
+	info["model"] = "7865";
+	info["deviceClass"] = "A";
+	info["description"] = "My RasPi Device";
+	info["fwVersion"] = "1.0.0";
+	info["hwVersion"] = "1.0";
+	info["descriptiveLocation"] = "EGL C";
+	return wrap(data, seq);
+}
+
+// as IOTP_DeviceClient::manage() writes it
+static void writeManageData(IOTP_JsonWriter& writer, int) {
+	static const IOTP_DeviceInfo info("10087", "IBM", "7865", "A", "My RasPi Device", "1.0.0", "1.0", "EGL C");
+	writer.beginObject().key("deviceInfo");
+	info.write(writer);
+	writer.member("lifetime", 3600)
+		.key("supports").beginObject()
+			.member("deviceActions", true)
+			.member("firmwareActions", true)
+		.endObject()
+		.endObject();
+}
+
+static void writeManage(IOTP_JsonWriter& writer, int seq) {
+	wrapped(writer, seq, writeManageData);
+}
+
+// the locations cycle, so that the objects are made before the clock starts
+static const int LOCATIONS = 1000;
+static std::vector<IOTP_DeviceLocation> locations;
+
+static Json::Value locationData(int seq) {
+	Json::Value data;
+	data["latitude"] = 52.3702157 + (seq % LOCATIONS) * 1e-6;
+	data["longitude"] = 4.8951679 - (seq % LOCATIONS) * 1e-6;
+	data["elevation"] = 12.5 + (seq % 100);
+	data["accuracy"] = 4.0;
+	data["measuredDateTime"] = "2017-03-01T10:15:30Z";
+	return data;
+}
+
+static Json::Value buildLocation(int seq) {
+	return wrap(locationData(seq), seq);
+}
+
+static void writeLocationData(IOTP_JsonWriter& writer, int seq) {
+	locations[seq % LOCATIONS].write(writer);
+}
+
+static void writeLocation(IOTP_JsonWriter& writer, int seq) {
+	wrapped(writer, seq, writeLocationData);
+}
+
+static Json::Value buildLog(int seq) {
+	Json::Value data;
+	data["message"] = "Battery low, switching to power save";
+	data["severity"] = seq % 3;
+	data["data"] = "voltage=3.1\tthreshold=3.3";
+	data["timestamp"] = "2017-03-01T10:15:30Z";
+	return wrap(data, seq);
+}
+
+static void writeLogData(IOTP_JsonWriter& writer, int seq) {
+	static std::string message = "Battery low, switching to power save";
+	static std::string timestamp = "2017-03-01T10:15:30Z";
+	static const IOTP_DeviceLog logs[] = {
+		IOTP_DeviceLog(message, timestamp, 0, "voltage=3.1\tthreshold=3.3"),
+		IOTP_DeviceLog(message, timestamp, 1, "voltage=3.1\tthreshold=3.3"),
+		IOTP_DeviceLog(message, timestamp, 2, "voltage=3.1\tthreshold=3.3"),
+	};
+	logs[seq % 3].write(writer);
+}
+
+static void writeLog(IOTP_JsonWriter& writer, int seq) {
+	wrapped(writer, seq, writeLogData);
+}
+
+static Json::Value buildErrorCode(int seq) {
+	Json::Value data;
+	data["errorCode"] = seq % 512;
+	return wrap(data, seq);
+}
+
+static void writeErrorCodeData(IOTP_JsonWriter& writer, int seq) {
+	writer.beginObject().member("errorCode", seq % 512).endObject();
+}
+
+static void writeErrorCode(IOTP_JsonWriter& writer, int seq) {
+	wrapped(writer, seq, writeErrorCodeData);
+}
+
+static Json::Value buildResponse(int seq) {
+	Json::Value response;
+	response["rc"] = 202;
+	response["reqId"] = reqId(seq);
+	return response;
+}
+
+static void writeResponse(IOTP_JsonWriter& writer, int seq) {
+	char id[16];
+	snprintf(id, sizeof(id), "%d", 1500000000 + seq);
+	writer.beginObject().member("rc", 202).member("reqId", (const char*)id).endObject();
+}
+
+static bool run(const Message& message, int count) {
+	Json::FastWriter fastWriter;
+	std::string buffer;
+	size_t bytes[2] = { 0, 0 };
+	double seconds[2];
+	unsigned long long allocated[2];
+
+	unsigned long long before = allocations;
+	double start = cpuSeconds();
+	for (int i = 0; i < count; ++i)
+		bytes[0] += fastWriter.write(message.build(i)).size();
+	seconds[0] = cpuSeconds() - start;
+	allocated[0] = allocations - before;
+
+	before = allocations;
+	start = cpuSeconds();
+	for (int i = 0; i < count; ++i) {
+		buffer.clear();
+		IOTP_JsonWriter writer(buffer);
+		message.write(writer, i);
+		bytes[1] += buffer.size();
+	}
+	seconds[1] = cpuSeconds() - start;
+	allocated[1] = allocations - before;
+
+	// FastWriter ends every document with a newline
+	int mismatched = 0;
+	for (int i = 0; i < count; i += 97) {
+		std::string expected = fastWriter.write(message.build(i));
+		expected.erase(expected.size() - 1);
+		buffer.clear();
+		IOTP_JsonWriter writer(buffer);
+		message.write(writer, i);
+		if (buffer != expected) {
+			if (mismatched++ == 0)
+				printf("%s differs:\n  %s\n  %s\n", message.name, expected.c_str(), buffer.c_str());
+		}
+	}
+
+	for (int w = 0; w < 2; ++w) {
+		printf("%-10s %-12s %8.1f %10.0f %10.1f %10.2f%s\n", message.name, w ? "streaming" : "FastWriter",
+				(double)bytes[w] / count, count / seconds[w], bytes[w] / seconds[w] / 1e6, (double)allocated[w] / count,
+				(w && mismatched) ? "  OUTPUT DIFFERS" : "");
+	}
+	return mismatched == 0;
+}
+
+// Arrays nested to a depth, each with an empty array and a number in it, past the 64 levels
+// the writer keeps without a stack of its own
+static bool deep(int depth) {
+	Json::Value value(Json::arrayValue);
+	for (int i = 0; i < depth; ++i) {
+		Json::Value outer(Json::arrayValue);
+		outer.append(Json::Value(Json::arrayValue));
+		outer.append(value);
+		outer.append(i);
+		value.swap(outer);
+	}
+	Json::FastWriter fastWriter;
+	std::string expected = fastWriter.write(value);
+	expected.erase(expected.size() - 1);
+	std::string text;
+	IOTP_JsonWriter(text).value(value);
+	if (text == expected)
+		return true;
+	printf("nested %d deep differs:\n  %s\n  %s\n", depth, expected.c_str(), text.c_str());
+	return false;
+}
+
+int main(int argc, char** argv) {
+	int count = (argc > 1) ? atoi(argv[1]) : 200000;
+	for (int i = 0; i < LOCATIONS; ++i)
+		locations.push_back(IOTP_DeviceLocation(locationData(i)));
+	const Message messages[] = {
+		{ "manage", buildManage, writeManage },
+		{ "location", buildLocation, writeLocation },
+		{ "log", buildLog, writeLog },
+		{ "errorCode", buildErrorCode, writeErrorCode },
+		{ "response", buildResponse, writeResponse },
+	};
+
+	printf("%d messages each\n", count);
+	printf("%-10s %-12s %8s %10s %10s %10s\n", "message", "writer", "bytes", "msgs/s", "MB/s", "allocs");
+	bool ok = true;
+	for (const Message& message : messages)
+		ok = run(message, count) && ok;
+	ok = deep(63) && deep(64) && deep(65) && deep(200) && ok;
+	return ok ? 0 : 1;
+}
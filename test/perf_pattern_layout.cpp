@@ -0,0 +1,125 @@
+/*******************************************************************************
+ * Copyright (c) 2017 IBM Corp.
+ *
+ * All rights reserved. This program and the accompanying materials
+ * are made available under the terms of the Eclipse Public License v1.0
+ * and Eclipse Distribution License v1.0 which accompany this distribution.
+ *
+ * The Eclipse Public License is available at
+ *    http://www.eclipse.org/legal/epl-v10.html
+ * and the Eclipse Distribution License is available at
+ *   http://www.eclipse.org/org/documents/edl-v10.php.
+ *
+ * Contributors:
+ *    Benchmark for the compiled log4cpp PatternLayout
+ *******************************************************************************/
+
+/*
+ * Formats events with the pattern of samples/log4cpp.properties, "%d [%p] %m%n", the way
+ * PatternLayout did before it compiled its pattern, with an ostringstream and a strftime of
+ * the date for every event, and with PatternLayout::format() and appendFormatted() into a
+ * buffer kept between events. Checks that all of them give the same text, and with the
+ * format modifiers and the other conversions too, and reports events a second.
+ *
+ * usage: perf_pattern_layout [events]
+ */
+
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+#include <iomanip>
+#include <sstream>
+#include <string>
+
+#include <log4cpp/LoggingEvent.hh>
+#include <log4cpp/PatternLayout.hh>
+#include <log4cpp/Priority.hh>
+
+using namespace log4cpp;
+
+static double cpuSeconds() {
+	struct timespec now;
+	clock_gettime(CLOCK_THREAD_CPUTIME_ID, &now);
+	return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+// The part of the ISO8601 date format after %l, which the old component formatted too
+static const std::string afterMillis;
+
+// "%d [%p] %m%n" as the components of the old PatternLayout wrote it
+static std::string streamFormat(const LoggingEvent& event) {
+	std::ostringstream message;
+	std::time_t t = event.timeStamp.getSeconds();
+	struct std::tm currentTime;
+	localtime_r(&t, &currentTime);
+	char formatted[100];
+	std::strftime(formatted, sizeof(formatted), "%Y-%m-%d %H:%M:%S,", &currentTime);
+	message << formatted;
+	std::ostringstream millis;
+	millis << std::setw(3) << std::setfill('0') << event.timeStamp.getMilliSeconds();
+	message << millis.str();
+	std::strftime(formatted, sizeof(formatted), afterMillis.c_str(), &currentTime);
+	message << formatted;
+	message << " [" << Priority::getPriorityName(event.priority) << "] " << event.message << std::endl;
+	return message.str();
+}
+
+static std::string layoutFormat(const char* pattern, const LoggingEvent& event) {
+	PatternLayout layout;
+	layout.setConversionPattern(pattern);
+	return layout.format(event);
+}
+
+static bool check(const char* pattern, const LoggingEvent& event, const std::string& expected) {
+	std::string text = layoutFormat(pattern, event);
+	if (text == expected)
+		return true;
+	printf("'%s' gives '%s', not '%s'\n", pattern, text.c_str(), expected.c_str());
+	return false;
+}
+
+int main(int argc, char** argv) {
+	int count = (argc > 1) ? atoi(argv[1]) : 500000;
+	const char* pattern = "%d [%p] %m%n";
+	PatternLayout layout;
+	layout.setConversionPattern(pattern);
+	LoggingEvent event("perf.device", "device d1 published event status rc=0", "", Priority::INFO);
+	std::string out;
+	size_t length = 0;
+
+	double start = cpuSeconds();
+	for (int i = 0; i < count; ++i)
+		length += streamFormat(event).size();
+	double streamRate = count / (cpuSeconds() - start);
+
+	start = cpuSeconds();
+	for (int i = 0; i < count; ++i)
+		length += layout.format(event).size();
+	double formatRate = count / (cpuSeconds() - start);
+
+	start = cpuSeconds();
+	for (int i = 0; i < count; ++i) {
+		out.clear();
+		layout.appendFormatted(event, out);
+		length += out.size();
+	}
+	double appendRate = count / (cpuSeconds() - start);
+
+	bool same = layout.format(event) == streamFormat(event) && out == streamFormat(event);
+	if (!same)
+		printf("formats differ:\n  %s  %s", streamFormat(event).c_str(), out.c_str());
+	bool ok = same;
+	ok = check("%-10p|%5p|%.3m|%c{1}|%c|%%|%x", event,
+			"INFO      | INFO|dev|device|perf.device|%|") && ok;
+	ok = check("%-5.2m|%20.3m|%3.10p", event, "de   |                 dev|INFO") && ok;
+	ok = check("%R", event, std::to_string((long long)event.timeStamp.getSeconds())) && ok;
+	ok = check("%d{%H:%M:%S} %d{%Y}", event, layoutFormat("%d{%H:%M:%S}", event) + " "
+			+ layoutFormat("%d{%Y}", event)) && ok;
+
+	printf("%d events of \"%s\", %lu bytes\n", count, pattern, (unsigned long)length);
+	printf("%-24s %12s\n", "formatter", "events/s");
+	printf("%-24s %12.0f\n", "ostringstream, strftime", streamRate);
+	printf("%-24s %12.0f%s\n", "format()", formatRate, same ? "" : "  OUTPUT DIFFERS");
+	printf("%-24s %12.0f%s\n", "appendFormatted()", appendRate, same ? "" : "  OUTPUT DIFFERS");
+	return ok ? 0 : 1;
+}
@@ -0,0 +1,194 @@
+/*******************************************************************************
+ * Copyright (c) 2017 IBM Corp.
+ *
+ * All rights reserved. This program and the accompanying materials
+ * are made available under the terms of the Eclipse Public License v1.0
+ * and Eclipse Distribution License v1.0 which accompany this distribution.
+ *
+ * The Eclipse Public License is available at
+ *    http://www.eclipse.org/legal/epl-v10.html
+ * and the Eclipse Distribution License is available at
+ *   http://www.eclipse.org/org/documents/edl-v10.php.
+ *
+ * Contributors:
+ *    Benchmark for payload templates
+ *******************************************************************************/
+
+/*
+ * Writes the location updates of a tracker reporting every 100 ms, and a status event, three
+ * ways: as a Json::Value rebuilt for each update and written with Json::FastWriter, with
+ * IOTP_JsonWriter formatting the time with strftime each time, and by filling the slots of
+ * an IOTP_PayloadTemplate. Checks that all three give the same text and reports updates a
+ * second on one core.
+ *
+ * usage: perf_payload_template [updates]
+ */
+
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+#include <string>
+
+#include "IOTP_JsonWriter.h"
+#include "IOTP_PayloadTemplate.h"
+
+using namespace Watson_IOTP;
+
+static double cpuSeconds() {
+	struct timespec now;
+	clock_gettime(CLOCK_THREAD_CPUTIME_ID, &now);
+	return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+static const time_t START = 1488363330;
+
+struct Update {
+	double latitude;
+	double longitude;
+	double elevation;
+	double accuracy;
+	time_t measured;
+	int seq;
+};
+
+static Update update(int seq) {
+	Update u = { 52.3702157 + seq * 1e-6, 4.8951679 - seq * 1e-6, 12.5 + (seq % 100) * 0.1, 4.0,
+			START + seq / 10, seq };
+	return u;
+}
+
+static std::string reqId(int seq) {
+	char id[16];
+	snprintf(id, sizeof(id), "%d", 1500000000 + seq);
+	return id;
+}
+
+static void locationValue(const Update& u, std::string& out) {
+	char measured[sizeof "YYYY-MM-DDTHH:MM:SSZ"];
+	struct tm utc;
+	strftime(measured, sizeof measured, "%FT%TZ", gmtime_r(&u.measured, &utc));
+	Json::Value data;
+	data["latitude"] = u.latitude;
+	data["longitude"] = u.longitude;
+	data["elevation"] = u.elevation;
+	data["accuracy"] = u.accuracy;
+	data["measuredDateTime"] = measured;
+	Json::Value message;
+	message["d"] = data;
+	message["reqId"] = reqId(u.seq);
+	static Json::FastWriter writer;
+	out = writer.write(message);
+	out.erase(out.size() - 1);
+}
+
+static void locationStreaming(const Update& u, std::string& out) {
+	char measured[sizeof "YYYY-MM-DDTHH:MM:SSZ"];
+	struct tm utc;
+	strftime(measured, sizeof measured, "%FT%TZ", gmtime_r(&u.measured, &utc));
+	out.clear();
+	IOTP_JsonWriter writer(out);
+	writer.beginObject().key("d").beginObject()
+		.member("accuracy", u.accuracy)
+		.member("elevation", u.elevation)
+		.member("latitude", u.latitude)
+		.member("longitude", u.longitude)
+		.member("measuredDateTime", (const char*)measured)
+		.endObject()
+		.member("reqId", reqId(u.seq))
+		.endObject();
+}
+
+static void locationTemplate(const Update& u, std::string& out) {
+	static IOTP_PayloadTemplate location("{\"d\":{\"accuracy\":$accuracy,\"elevation\":$elevation,"
+			"\"latitude\":$latitude,\"longitude\":$longitude,\"measuredDateTime\":$measured},\"reqId\":$reqId}");
+	static const int accuracy = location.slot("accuracy"), elevation = location.slot("elevation"),
+			latitude = location.slot("latitude"), longitude = location.slot("longitude"),
+			measured = location.slot("measured"), id = location.slot("reqId");
+	location.set(accuracy, u.accuracy);
+	location.set(elevation, u.elevation);
+	location.set(latitude, u.latitude);
+	location.set(longitude, u.longitude);
+	location.setTime(measured, u.measured);
+	location.set(id, reqId(u.seq));
+	out = location.render();
+}
+
+static void statusValue(const Update& u, std::string& out) {
+	Json::Value data;
+	data["battery"] = 87.5 - (u.seq % 500) * 0.01;
+	data["speed"] = (u.seq % 130) * 1.0;
+	data["state"] = (u.seq % 2) ? "driving" : "idle";
+	data["odometer"] = 120000 + u.seq;
+	Json::Value message;
+	message["d"] = data;
+	message["ts"] = (Json::LargestInt)(START + u.seq / 10);
+	static Json::FastWriter writer;
+	out = writer.write(message);
+	out.erase(out.size() - 1);
+}
+
+static void statusStreaming(const Update& u, std::string& out) {
+	out.clear();
+	IOTP_JsonWriter writer(out);
+	writer.beginObject().key("d").beginObject()
+		.member("battery", 87.5 - (u.seq % 500) * 0.01)
+		.member("odometer", 120000 + u.seq)
+		.member("speed", (u.seq % 130) * 1.0)
+		.member("state", (u.seq % 2) ? "driving" : "idle")
+		.endObject()
+		.member("ts", (long long)(START + u.seq / 10))
+		.endObject();
+}
+
+static void statusTemplate(const Update& u, std::string& out) {
+	static IOTP_PayloadTemplate status(
+			"{\"d\":{\"battery\":$battery,\"odometer\":$odometer,\"speed\":$speed,\"state\":$state},\"ts\":$ts}");
+	status.set(0, 87.5 - (u.seq % 500) * 0.01);
+	status.set(1, 120000 + u.seq);
+	status.set(2, (u.seq % 130) * 1.0);
+	status.set(3, (u.seq % 2) ? "driving" : "idle");
+	status.set(4, (long long)(START + u.seq / 10));
+	out = status.render();
+}
+
+struct Payload {
+	const char* name;
+	void (*write[3])(const Update&, std::string&);
+};
+
+int main(int argc, char** argv) {
+	int count = (argc > 1) ? atoi(argv[1]) : 500000;
+	const Payload payloads[] = {
+		{ "location", { locationValue, locationStreaming, locationTemplate } },
+		{ "status", { statusValue, statusStreaming, statusTemplate } },
+	};
+	const char* writers[] = { "Json::Value", "streaming", "template" };
+
+	printf("%d updates each\n", count);
+	printf("%-10s %-12s %12s %8s\n", "payload", "writer", "updates/s", "bytes");
+	bool ok = true;
+	std::string out, expected;
+	for (const Payload& payload : payloads) {
+		double rates[3];
+		for (int w = 0; w < 3; ++w) {
+			double start = cpuSeconds();
+			for (int i = 0; i < count; ++i)
+				payload.write[w](update(i), out);
+			rates[w] = count / (cpuSeconds() - start);
+		}
+		int mismatched = 0;
+		for (int i = 0; i < count; i += 997) {
+			payload.write[0](update(i), expected);
+			for (int w = 1; w < 3; ++w) {
+				payload.write[w](update(i), out);
+				if (out != expected && mismatched++ == 0)
+					printf("%s differs:\n  %s\n  %s\n", payload.name, expected.c_str(), out.c_str());
+			}
+		}
+		ok = ok && mismatched == 0;
+		for (int w = 0; w < 3; ++w)
+			printf("%-10s %-12s %12.0f %8u%s\n", payload.name, writers[w], rates[w], (unsigned)out.size(),
+					(w && mismatched) ? "  OUTPUT DIFFERS" : "");
+	}
+	return ok ? 0 : 1;
+}
@@ -0,0 +1,174 @@
+/*******************************************************************************
+ * Copyright (c) 2017 IBM Corp.
+ *
+ * All rights reserved. This program and the accompanying materials
+ * are made available under the terms of the Eclipse Public License v1.0
+ * and Eclipse Distribution License v1.0 which accompany this distribution.
+ *
+ * The Eclipse Public License is available at
+ *    http://www.eclipse.org/legal/epl-v10.html
+ * and the Eclipse Distribution License is available at
+ *   http://www.eclipse.org/org/documents/edl-v10.php.
+ *
+ * Contributors:
+ *    Benchmark for the persistence implementations
+ *    in-memory persistence
+ *******************************************************************************/
+
+/*
+ * Drives the default, log-structured and in-memory persistence the way the client does for
+ * QoS1 publishes: each message is put when sent and removed when its PUBACK arrives, with a
+ * window of messages in flight.  Then a store holding a backlog of messages is reopened and
+ * read back, as MQTTPersistence_restore does on startup.
+ *
+ * usage: perf_persistence [messages] [payload bytes] [window] [restore messages] [snapshot interval ms]
+ */
+
+#include "MQTTPersistence.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "Heap.h"
+
+#define CLIENT_ID "perf"
+#define SERVER_URI "localhost:1883"
+
+
+static double now_s(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+
+static void put(MQTTClient_persistence* per, void* handle, int msgid, char* payload, int payloadlen)
+{
+	char key[16];
+	char header[24];
+	char* buffers[2] = { header, payload };
+	int buflens[2] = { sizeof(header), payloadlen };
+
+	sprintf(key, "%s%d", PERSISTENCE_PUBLISH_SENT, msgid);
+	memset(header, 0x32, sizeof(header));
+	per->pput(handle, key, 2, buffers, buflens);
+}
+
+
+static void removekey(MQTTClient_persistence* per, void* handle, int msgid)
+{
+	char key[16];
+
+	sprintf(key, "%s%d", PERSISTENCE_PUBLISH_SENT, msgid);
+	per->premove(handle, key);
+}
+
+
+static int run(const char* label, int type, void* context, int count, int payloadlen, int window, int backlog)
+{
+	MQTTClient_persistence* per = NULL;
+	void* handle = NULL;
+	char* payload = malloc(payloadlen);
+	char** keys = NULL;
+	int nkeys = 0, i, rc = 0;
+	double start, elapsed;
+
+	memset(payload, 'x', payloadlen);
+
+	/* QoS1 publishing: put on send, remove on PUBACK */
+	MQTTPersistence_create(&per, type, context);
+	if (per->popen(&handle, CLIENT_ID, SERVER_URI, per->context) != 0)
+	{
+		fprintf(stderr, "%s: open failed\n", label);
+		return 1;
+	}
+	start = now_s();
+	for (i = 0; i < count; ++i)
+	{
+		put(per, handle, i, payload, payloadlen);
+		if (i >= window)
+			removekey(per, handle, i - window);
+	}
+	for (i = (count > window) ? count - window : 0; i < count; ++i)
+		removekey(per, handle, i);
+	elapsed = now_s() - start;
+	printf("%-8s qos1    %8d msgs %5d bytes window %3d: %9.0f msgs/s\n", label, count, payloadlen, window,
+			count / elapsed);
+
+	/* restore of a backlog */
+	for (i = 0; i < backlog; ++i)
+		put(per, handle, i, payload, payloadlen);
+	per->pclose(handle);
+
+	start = now_s();
+	per->popen(&handle, CLIENT_ID, SERVER_URI, per->context);
+	per->pkeys(handle, &keys, &nkeys);
+	for (i = 0; i < nkeys; ++i)
+	{
+		char* buffer = NULL;
+		int buflen = 0;
+
+		if (per->pget(handle, keys[i], &buffer, &buflen) == 0)
+			free(buffer);
+		else
+			++rc;
+	}
+	elapsed = now_s() - start;
+	printf("%-8s restore %8d msgs %5d bytes:            %9.1f ms\n", label, nkeys, payloadlen, elapsed * 1e3);
+	if (nkeys != backlog)
+		++rc;
+
+	for (i = 0; i < nkeys; ++i)
+	{
+		per->premove(handle, keys[i]);
+		free(keys[i]);
+	}
+	if (keys)
+		free(keys);
+	per->pclose(handle);
+	if (type == MQTTCLIENT_PERSISTENCE_MEMORY)
+	{
+		free((char*)((MQTTClient_memoryPersistenceOptions*)per->context)->directory);
+		free(per->context);
+	}
+	else if (per->context && strcmp(per->context, ".") != 0)
+		free(per->context);
+	free(per);
+	free(payload);
+	return rc;
+}
+
+
+int main(int argc, char** argv)
+{
+	int count = (argc > 1) ? atoi(argv[1]) : 20000;
+	int payloadlen = (argc > 2) ? atoi(argv[2]) : 128;
+	int window = (argc > 3) ? atoi(argv[3]) : 10;
+	int backlog = (argc > 4) ? atoi(argv[4]) : 10000;
+	int interval = (argc > 5) ? atoi(argv[5]) : 1000;
+	char dir[] = "/tmp/perf_persistence_XXXXXX";
+	MQTTClient_memoryPersistenceOptions options = MQTTClient_memoryPersistenceOptions_initializer;
+	int rc = 0;
+
+	if (mkdtemp(dir) == NULL)
+	{
+		perror("mkdtemp");
+		return 1;
+	}
+	Heap_initialize();
+	rc += run("default", MQTTCLIENT_PERSISTENCE_DEFAULT, dir, count, payloadlen, window, backlog);
+	rc += run("log", MQTTCLIENT_PERSISTENCE_LOG, dir, count, payloadlen, window, backlog);
+	options.directory = dir;
+	options.interval = interval;
+	rc += run("memory", MQTTCLIENT_PERSISTENCE_MEMORY, &options, count, payloadlen, window, backlog);
+	Heap_terminate();
+	rmdir(dir);
+	if (rc)
+		fprintf(stderr, "%d errors\n", rc);
+	return rc != 0;
+}
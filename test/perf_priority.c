@@ -0,0 +1,345 @@
+/*******************************************************************************
+ * Copyright (c) 2017 IBM Corp.
+ *
+ * All rights reserved. This program and the accompanying materials
+ * are made available under the terms of the Eclipse Public License v1.0
+ * and Eclipse Distribution License v1.0 which accompany this distribution.
+ *
+ * The Eclipse Public License is available at
+ *    http://www.eclipse.org/legal/epl-v10.html
+ * and the Eclipse Distribution License is available at
+ *   http://www.eclipse.org/org/documents/edl-v10.php.
+ *
+ * Contributors:
+ *    Benchmark for the priority lanes of the command queue
+ *******************************************************************************/
+
+/*
+ * Queues a burst of bulk QoS1 telemetry to a minimal broker on the loopback interface that
+ * takes a service time over each publish, then sends a management reply and reports how long
+ * the reply takes to be acknowledged on each lane.  On the bulk lane the reply waits behind all
+ * of the telemetry queued before it, as in a single queue.  On the normal lane it gets a share
+ * of the connection weighted against the telemetry, on the high lane it goes next.  A second
+ * pass queues normal and bulk publishes together and reports the share each lane gets.
+ *
+ * usage: perf_priority [bulk messages] [service us] [window]
+ */
+
+#include "MQTTAsync.h"
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+static long service_us;
+
+static int64_t now_us(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static void send_all(int fd, const unsigned char* data, size_t length)
+{
+	while (length > 0)
+	{
+		ssize_t n = send(fd, data, length, MSG_NOSIGNAL);
+		if (n <= 0)
+			return;
+		data += n;
+		length -= n;
+	}
+}
+
+/* acks go out one at a time, Nagle would hold them for a delayed ack */
+static int no_delay(int fd)
+{
+	int on = 1;
+
+	setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+	return fd;
+}
+
+static int listen_loopback(int* port)
+{
+	int fd = socket(AF_INET, SOCK_STREAM, 0);
+	struct sockaddr_in addr;
+	socklen_t len = sizeof(addr);
+
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	if (bind(fd, (struct sockaddr*)&addr, sizeof(addr)) != 0 || listen(fd, 16) != 0)
+	{
+		perror("listen");
+		return -1;
+	}
+	getsockname(fd, (struct sockaddr*)&addr, &len);
+	*port = ntohs(addr.sin_port);
+	return fd;
+}
+
+/* broker: CONNECT, SUBSCRIBE, PINGREQ and QoS 0/1 PUBLISH, each publish taking the service time */
+
+static void* broker_connection(void* arg)
+{
+	int fd = (int)(intptr_t)arg;
+	unsigned char* in = malloc(256 * 1024);
+	size_t used = 0;
+
+	for (;;)
+	{
+		size_t pos = 0;
+		ssize_t n = recv(fd, in + used, 256 * 1024 - used, 0);
+
+		if (n <= 0)
+			break;
+		used += n;
+		while (used - pos >= 2)
+		{
+			size_t length = 0, header = 1;
+			int shift = 0, complete = 0, type = in[pos] >> 4;
+			const unsigned char* body;
+
+			while (pos + header < used && header <= 4)
+			{
+				unsigned char c = in[pos + header++];
+				length += (size_t)(c & 0x7f) << shift;
+				shift += 7;
+				if ((c & 0x80) == 0)
+				{
+					complete = 1;
+					break;
+				}
+			}
+			if (!complete || used - pos < header + length)
+				break;
+			body = in + pos + header;
+			if (type == 1)
+			{
+				unsigned char connack[] = { 0x20, 2, 0, 0 };
+				send_all(fd, connack, sizeof(connack));
+			}
+			else if (type == 3 && ((in[pos] >> 1) & 3))
+			{
+				size_t topic = (body[0] << 8) | body[1];
+				unsigned char puback[] = { 0x40, 2, body[2 + topic], body[3 + topic] };
+				usleep(service_us);
+				send_all(fd, puback, sizeof(puback));
+			}
+			else if (type == 8)
+			{
+				unsigned char suback[] = { 0x90, 3, body[0], body[1], 1 };
+				send_all(fd, suback, sizeof(suback));
+			}
+			else if (type == 12)
+			{
+				unsigned char pingresp[] = { 0xd0, 0 };
+				send_all(fd, pingresp, sizeof(pingresp));
+			}
+			pos += header + length;
+		}
+		memmove(in, in + pos, used - pos);
+		used -= pos;
+	}
+	free(in);
+	close(fd);
+	return NULL;
+}
+
+static void* broker(void* arg)
+{
+	int listener = (int)(intptr_t)arg, fd;
+
+	while ((fd = accept(listener, NULL, NULL)) >= 0)
+	{
+		pthread_t thread;
+		pthread_create(&thread, NULL, broker_connection, (void*)(intptr_t)no_delay(fd));
+		pthread_detach(thread);
+	}
+	return NULL;
+}
+
+
+
+/* client */
+
+static volatile int connected = 0;
+static volatile int acked[3];
+static volatile int64_t reply_acked = 0;
+static volatile int normal_started_at = 0;
+static volatile int normal_done_at = 0;
+
+static void onConnect(void* context, MQTTAsync_successData* response)
+{
+	(void)context;
+	(void)response;
+	connected = 1;
+}
+
+static void onConnectFailure(void* context, MQTTAsync_failureData* response)
+{
+	(void)context;
+	(void)response;
+	connected = -1;
+}
+
+static void onPublish(void* context, MQTTAsync_successData* response)
+{
+	(void)response;
+	++acked[(int)(intptr_t)context];
+}
+
+static void onReply(void* context, MQTTAsync_successData* response)
+{
+	(void)context;
+	(void)response;
+	reply_acked = now_us();
+}
+
+static void onNormal(void* context, MQTTAsync_successData* response)
+{
+	(void)response;
+	if (++acked[MQTTASYNC_PRIORITY_NORMAL] == 1)
+		normal_started_at = acked[MQTTASYNC_PRIORITY_BULK];
+	if (acked[MQTTASYNC_PRIORITY_NORMAL] == (int)(intptr_t)context)
+		normal_done_at = acked[MQTTASYNC_PRIORITY_BULK];
+}
+
+static int publish(MQTTAsync client, int lane, int reply, MQTTAsync_onSuccess* onSuccess, void* context)
+{
+	MQTTAsync_responseOptions ropts = MQTTAsync_responseOptions_initializer;
+	char payload[200];
+
+	memset(payload, 'x', sizeof(payload));
+	ropts.onSuccess = onSuccess;
+	ropts.context = context;
+	ropts.priority = lane;
+	return MQTTAsync_send(client, reply ? "iotdevice-1/response" : "iot-2/evt/status/fmt/json",
+			reply ? 40 : sizeof(payload), payload, 1, 0, &ropts);
+}
+
+static MQTTAsync start(const char* uri, int window)
+{
+	MQTTAsync client;
+	MQTTAsync_connectOptions opts = MQTTAsync_connectOptions_initializer;
+
+	MQTTAsync_create(&client, uri, "perf_priority", MQTTCLIENT_PERSISTENCE_NONE, NULL);
+	opts.cleansession = 1;
+	opts.onSuccess = onConnect;
+	opts.onFailure = onConnectFailure;
+	opts.inflightControl = MQTTASYNC_INFLIGHT_FIXED;
+	opts.maxInflight = window;
+	connected = 0;
+	memset((void*)acked, '\0', sizeof(acked));
+	reply_acked = 0;
+	normal_started_at = normal_done_at = 0;
+	MQTTAsync_connect(client, &opts);
+	while (connected == 0)
+		usleep(1000);
+	if (connected < 0)
+	{
+		fprintf(stderr, "connect failed\n");
+		MQTTAsync_destroy(&client);
+		return NULL;
+	}
+	return client;
+}
+
+static void stop(MQTTAsync* client)
+{
+	MQTTAsync_disconnectOptions dopts = MQTTAsync_disconnectOptions_initializer;
+
+	MQTTAsync_disconnect(*client, &dopts);
+	usleep(100000);
+	MQTTAsync_destroy(client);
+}
+
+static int wait_for(volatile int* count, int target)
+{
+	int64_t start = now_us();
+
+	while (*count < target && now_us() - start < 120 * 1000000LL)
+		usleep(1000);
+	return *count >= target;
+}
+
+/* the reply is queued behind the burst, once the burst is flowing; on the bulk lane it waits
+   its turn in one queue with the telemetry, as every command did before there were lanes */
+static int reply_latency(const char* uri, int lane, int messages, int window)
+{
+	MQTTAsync client = start(uri, window);
+	int64_t sent;
+	int i;
+
+	if (client == NULL)
+		return 1;
+	for (i = 0; i < messages; ++i)
+		publish(client, MQTTASYNC_PRIORITY_BULK, 0, onPublish, (void*)(intptr_t)MQTTASYNC_PRIORITY_BULK);
+	wait_for(&acked[MQTTASYNC_PRIORITY_BULK], window);
+	sent = now_us();
+	publish(client, lane, 1, onReply, NULL);
+	while (reply_acked == 0 && now_us() - sent < 120 * 1000000LL)
+		usleep(100);
+	printf("reply on the %-6s lane: acknowledged after %8.1f ms, %5d bulk messages still queued\n",
+			(lane == MQTTASYNC_PRIORITY_HIGH) ? "high" : (lane == MQTTASYNC_PRIORITY_BULK) ? "bulk" : "normal",
+			(reply_acked - sent) / 1000.0,
+			messages - acked[MQTTASYNC_PRIORITY_BULK]);
+	wait_for(&acked[MQTTASYNC_PRIORITY_BULK], messages);
+	stop(&client);
+	return reply_acked == 0;
+}
+
+/* normal and bulk publishes of the same size queued together */
+static int lane_share(const char* uri, int messages, int window)
+{
+	MQTTAsync client = start(uri, window);
+	int i, bulk, normal = messages / 4;
+
+	if (client == NULL)
+		return 1;
+	for (i = 0; i < messages; ++i)
+		publish(client, MQTTASYNC_PRIORITY_BULK, 0, onPublish, (void*)(intptr_t)MQTTASYNC_PRIORITY_BULK);
+	for (i = 0; i < normal; ++i)
+		publish(client, MQTTASYNC_PRIORITY_NORMAL, 0, onNormal, (void*)(intptr_t)normal);
+	wait_for(&acked[MQTTASYNC_PRIORITY_NORMAL], normal);
+	bulk = normal_done_at - normal_started_at;
+	printf("%d normal publishes queued behind %d bulk: %d bulk sent alongside, %.1f normal per bulk\n",
+			normal, messages, bulk, bulk ? (double)normal / bulk : (double)normal);
+	wait_for(&acked[MQTTASYNC_PRIORITY_BULK], messages);
+	stop(&client);
+	return acked[MQTTASYNC_PRIORITY_NORMAL] < normal;
+}
+
+int main(int argc, char** argv)
+{
+	int messages = (argc > 1) ? atoi(argv[1]) : 5000;
+	int window = (argc > 3) ? atoi(argv[3]) : 20;
+	int listener, port, rc = 0;
+	pthread_t thread;
+	char uri[64];
+
+	service_us = (argc > 2) ? atol(argv[2]) : 200;
+	if ((listener = listen_loopback(&port)) < 0)
+		return 1;
+	pthread_create(&thread, NULL, broker, (void*)(intptr_t)listener);
+	snprintf(uri, sizeof(uri), "tcp://127.0.0.1:%d", port);
+
+	printf("%d bulk QoS1 messages, %ld us per publish at the broker, window %d\n", messages, service_us, window);
+	rc += reply_latency(uri, MQTTASYNC_PRIORITY_BULK, messages, window);
+	rc += reply_latency(uri, MQTTASYNC_PRIORITY_NORMAL, messages, window);
+	rc += reply_latency(uri, MQTTASYNC_PRIORITY_HIGH, messages, window);
+	rc += lane_share(uri, messages, window);
+	return rc != 0;
+}
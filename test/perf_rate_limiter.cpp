@@ -0,0 +1,177 @@
+/*******************************************************************************
+ * Copyright (c) 2017 IBM Corp.
+ *
+ * All rights reserved. This program and the accompanying materials
+ * are made available under the terms of the Eclipse Public License v1.0
+ * and Eclipse Distribution License v1.0 which accompany this distribution.
+ *
+ * The Eclipse Public License is available at
+ *    http://www.eclipse.org/legal/epl-v10.html
+ * and the Eclipse Distribution License is available at
+ *   http://www.eclipse.org/org/documents/edl-v10.php.
+ *
+ * Contributors:
+ *    Benchmark for the event rate limits
+ *******************************************************************************/
+
+/*
+ * Measures the cost of taking a token from the event rate limiter with 1, 2, 4 ... publishing
+ * threads, each on its own event type and all on one, next to token buckets behind a mutex.
+ * Then floods one event type well over its limit under each policy and reports how many
+ * events went through against the configured rate, and the counters. Checks that every event
+ * the coalesce policy replaced is given back to the publisher.
+ *
+ * usage: perf_rate_limiter [max threads] [seconds per flood]
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "IOTP_RateLimiter.h"
+
+using namespace Watson_IOTP;
+
+typedef std::chrono::steady_clock steady;
+
+static const int OPS = 1000000;
+
+// the buckets a lock would give: a map of token counts refilled from the elapsed time, under a mutex
+class MutexBuckets {
+public:
+	MutexBuckets(double rate, double burst) : mRate(rate), mBurst(burst) {}
+	bool take(const std::string& key) {
+		std::lock_guard<std::mutex> lck(mLock);
+		steady::time_point now = steady::now();
+		std::unordered_map<std::string, Bucket>::iterator it = mBuckets.find(key);
+		if (it == mBuckets.end())
+			it = mBuckets.insert(std::make_pair(key, Bucket(mBurst, now))).first;
+		Bucket& b = it->second;
+		b.tokens = std::min(mBurst, b.tokens + std::chrono::duration<double>(now - b.last).count() * mRate);
+		b.last = now;
+		if (b.tokens < 1)
+			return false;
+		b.tokens -= 1;
+		return true;
+	}
+private:
+	struct Bucket {
+		Bucket(double t, steady::time_point l) : tokens(t), last(l) {}
+		double tokens;
+		steady::time_point last;
+	};
+	std::mutex mLock;
+	double mRate, mBurst;
+	std::unordered_map<std::string, Bucket> mBuckets;
+};
+
+template <typename F>
+static double nsPerOp(int threads, F f) {
+	std::vector<std::thread> workers;
+	steady::time_point start = steady::now();
+	for (int t = 0; t < threads; ++t)
+		workers.push_back(std::thread(f, t));
+	for (size_t t = 0; t < workers.size(); ++t)
+		workers[t].join();
+	return std::chrono::duration<double, std::nano>(steady::now() - start).count() / ((double)OPS * threads);
+}
+
+static void fastPath(int maxThreads) {
+	IOTP_RateLimiter::Message message = { "iot-2/evt/status/fmt/json", "{}", 0, nullptr };
+	printf("threads   own event type   shared event type   own, mutex   shared, mutex   (ns per event)\n");
+	for (int threads = 1; threads <= maxThreads; threads *= 2) {
+		IOTP_RateLimiter limiter(1e9, 1e6, IOTP_RateLimiter::DROP);
+		MutexBuckets buckets(1e9, 1e6);
+		double own = nsPerOp(threads, [&](int t) {
+			std::string key = "type" + std::to_string(t);
+			for (int i = 0; i < OPS; ++i)
+				limiter.acquire(key, key, message);
+		});
+		double shared = nsPerOp(threads, [&](int) {
+			std::string key = "status";
+			for (int i = 0; i < OPS; ++i)
+				limiter.acquire(key, key, message);
+		});
+		double lockedOwn = nsPerOp(threads, [&](int t) {
+			std::string key = "type" + std::to_string(t);
+			for (int i = 0; i < OPS; ++i)
+				buckets.take(key);
+		});
+		double lockedShared = nsPerOp(threads, [&](int) {
+			std::string key = "status";
+			for (int i = 0; i < OPS; ++i)
+				buckets.take(key);
+		});
+		printf("%7d %16.1f %19.1f %12.1f %15.1f\n", threads, own, shared, lockedOwn, lockedShared);
+	}
+}
+
+static bool flood(IOTP_RateLimiter::Policy policy, const char* name, double seconds) {
+	const double rate = 100, burst = 10;
+	IOTP_RateLimiter limiter(0, 1, policy);
+	std::atomic<bool> done(false);
+	std::atomic<long> sent(0);
+	std::string lastSent, lastPublished;
+
+	limiter.setLimit("status", rate, burst);
+	std::thread flusher([&] {
+		IOTP_RateLimiter::Message held;
+		// after the flood the last held value is still sent, within a token interval
+		while (true) {
+			if (limiter.takeCoalesced(held, std::chrono::milliseconds(50))) {
+				++sent;
+				lastSent = held.payload;
+			}
+			else if (done)
+				break;
+		}
+	});
+
+	steady::time_point start = steady::now();
+	long published = 0, replaced = 0;
+	while (std::chrono::duration<double>(steady::now() - start).count() < seconds) {
+		IOTP_RateLimiter::Message message = { "iot-2/evt/status/fmt/json", std::to_string(published++), 0, &done };
+		IOTP_RateLimiter::Message previous;
+		if (limiter.acquire("status", "status", message, &previous) == IOTP_RateLimiter::SEND)
+			++sent;
+		if (previous.context == &done)
+			++replaced;
+		lastPublished = message.payload;
+		if (policy != IOTP_RateLimiter::BLOCK)
+			std::this_thread::sleep_for(std::chrono::microseconds(100));
+	}
+	double elapsed = std::chrono::duration<double>(steady::now() - start).count();
+	done = true;
+	flusher.join();
+
+	IOTP_RateLimiter::Stats s = limiter.stats();
+	printf("%-9s %8ld published %6ld sent (limit %4.0f)  passed %ld blocked %ld dropped %ld coalesced %ld flushed %ld\n",
+			name, published, (long)sent, rate * elapsed + burst, (long)s.passed, (long)s.blocked, (long)s.dropped,
+			(long)s.coalesced, (long)s.flushed);
+	if (policy == IOTP_RateLimiter::COALESCE)
+		printf("          last value published %s, last value sent %s\n", lastPublished.c_str(), lastSent.c_str());
+	if (replaced != (long)s.coalesced) {
+		printf("          %ld events replaced, %ld given back: WRONG\n", (long)s.coalesced, replaced);
+		return false;
+	}
+	return true;
+}
+
+int main(int argc, char** argv) {
+	int maxThreads = (argc > 1) ? atoi(argv[1]) : 8;
+	double seconds = (argc > 2) ? atof(argv[2]) : 1.0;
+
+	fastPath(maxThreads);
+	printf("\none event type limited to 100/s with bursts of 10, flooded for %.1f s\n", seconds);
+	bool ok = flood(IOTP_RateLimiter::BLOCK, "block", seconds);
+	ok = flood(IOTP_RateLimiter::DROP, "drop", seconds) && ok;
+	ok = flood(IOTP_RateLimiter::COALESCE, "coalesce", seconds) && ok;
+	return ok ? 0 : 1;
+}
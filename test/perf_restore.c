@@ -0,0 +1,242 @@
+/*******************************************************************************
+ * Copyright (c) 2017 IBM Corp.
+ *
+ * All rights reserved. This program and the accompanying materials
+ * are made available under the terms of the Eclipse Public License v1.0
+ * and Eclipse Distribution License v1.0 which accompany this distribution.
+ *
+ * The Eclipse Public License is available at
+ *    http://www.eclipse.org/legal/epl-v10.html
+ * and the Eclipse Distribution License is available at
+ *   http://www.eclipse.org/org/documents/edl-v10.php.
+ *
+ * Contributors:
+ *    Restore-time benchmark for persisted sessions
+ *******************************************************************************/
+
+/*
+ * Fills a persistent store with a backlog of publish commands, as an async client that was
+ * publishing while offline leaves behind, then measures bringing a client back up on it:
+ *
+ *   ordered  - the previous restore: every record read and inserted in order into a list
+ *   create   - MQTTAsync_createWithOptions returning, after which the client can connect
+ *   full     - the whole backlog restored to the command queue by the send thread
+ *
+ * usage: perf_restore [max entries] [max entries for ordered] [log|default]
+ */
+
+#include "MQTTAsync.h"
+#include "MQTTPacket.h"
+#include "MQTTPersistence.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "Heap.h"
+
+#define CLIENT_ID "perf"
+#define SERVER_URI "localhost:1"
+#define TOPIC "iot-2/evt/status/fmt/json"
+#define PAYLOAD_LENGTH 64
+
+typedef struct
+{
+	unsigned int seqno;
+	char* buffer;
+} restored;
+
+
+static double now_s(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+
+/* lays out a publish command the way MQTTAsync_persistCommand does */
+static void populate(int type, char* dir, int count)
+{
+	MQTTClient_persistence* per = NULL;
+	void* handle = NULL;
+	char payload[PAYLOAD_LENGTH];
+	int ctype = PUBLISH, token = 0, payloadlen = PAYLOAD_LENGTH, qos = 1, retained = 0;
+	char* buffers[7] = { (char*)&ctype, (char*)&token, TOPIC, (char*)&payloadlen, payload,
+		(char*)&qos, (char*)&retained };
+	int buflens[7] = { sizeof(int), sizeof(int), sizeof(TOPIC), sizeof(int), PAYLOAD_LENGTH,
+		sizeof(int), sizeof(int) };
+	char key[PERSISTENCE_MAX_KEY_LENGTH + 1];
+	int i;
+
+	memset(payload, 'x', sizeof(payload));
+	MQTTPersistence_create(&per, type, dir);
+	per->popen(&handle, CLIENT_ID, SERVER_URI, per->context);
+	for (i = 1; i <= count; ++i)
+	{
+		token = i;
+		sprintf(key, "%s%d", PERSISTENCE_COMMAND_KEY, i);
+		per->pput(handle, key, 7, buffers, buflens);
+	}
+	per->pclose(handle);
+	if (per->context && strcmp(per->context, ".") != 0)
+		free(per->context);
+	free(per);
+}
+
+
+/* the restore as it was: one get and one ordered insert per record */
+static double ordered(int type, char* dir, int count)
+{
+	MQTTClient_persistence* per = NULL;
+	void* handle = NULL;
+	List* list = ListInitialize();
+	ListElement* current = NULL;
+	char** keys = NULL;
+	int nkeys = 0, i;
+	double start = now_s(), elapsed;
+
+	MQTTPersistence_create(&per, type, dir);
+	per->popen(&handle, CLIENT_ID, SERVER_URI, per->context);
+	per->pkeys(handle, &keys, &nkeys);
+	for (i = 0; i < nkeys; ++i)
+	{
+		restored* r = malloc(sizeof(restored));
+		ListElement* index = NULL;
+		int buflen;
+
+		current = NULL;
+		per->pget(handle, keys[i], &r->buffer, &buflen);
+		r->seqno = atoi(keys[i] + strlen(PERSISTENCE_COMMAND_KEY));
+		while (ListNextElement(list, &current) != NULL && index == NULL)
+		{
+			if (r->seqno < ((restored*)current->content)->seqno)
+				index = current;
+		}
+		ListInsert(list, r, sizeof(restored), index);
+		free(keys[i]);
+	}
+	elapsed = now_s() - start;
+	if (list->count != count)
+		fprintf(stderr, "ordered: %d of %d restored\n", list->count, count);
+
+	current = NULL;
+	while (ListNextElement(list, &current))
+		free(((restored*)current->content)->buffer);
+	ListFree(list);
+	if (keys)
+		free(keys);
+	per->pclose(handle);
+	if (per->context && strcmp(per->context, ".") != 0)
+		free(per->context);
+	free(per);
+	return elapsed;
+}
+
+
+static int pending(MQTTAsync client)
+{
+	MQTTAsync_token* tokens = NULL;
+	int count = 0;
+
+	if (MQTTAsync_getPendingTokens(client, &tokens) == MQTTASYNC_SUCCESS && tokens)
+	{
+		while (tokens[count] != -1)
+			++count;
+		MQTTAsync_free(tokens);
+	}
+	return count;
+}
+
+
+static int streaming(int type, char* dir, int count, double* create, double* full)
+{
+	MQTTAsync client = NULL;
+	MQTTAsync_createOptions options = MQTTAsync_createOptions_initializer;
+	MQTTAsync_connectOptions conn_opts = MQTTAsync_connectOptions_initializer;
+	double start = now_s();
+	int restored = 0;
+
+	options.sendWhileDisconnected = 1;
+	options.maxBufferedMessages = count;
+	if (MQTTAsync_createWithOptions(&client, SERVER_URI, CLIENT_ID, type, dir, &options) != MQTTASYNC_SUCCESS)
+		return -1;
+	*create = now_s() - start;
+
+	/* nothing listens on the port: the connect only starts the send thread */
+	conn_opts.cleansession = 0;
+	MQTTAsync_connect(client, &conn_opts);
+	/* each poll walks the whole queue, so poll less often the longer it is */
+	while ((restored = pending(client)) < count && now_s() - start < 600)
+		usleep(count / 2);
+	*full = now_s() - start;
+	MQTTAsync_destroy(&client);
+	return restored;
+}
+
+
+static void clear(int type, char* dir)
+{
+	MQTTClient_persistence* per = NULL;
+	void* handle = NULL;
+	char** keys = NULL;
+	int nkeys = 0, i;
+
+	MQTTPersistence_create(&per, type, dir);
+	per->popen(&handle, CLIENT_ID, SERVER_URI, per->context);
+	per->pkeys(handle, &keys, &nkeys);
+	for (i = 0; i < nkeys; ++i)
+	{
+		per->premove(handle, keys[i]);
+		free(keys[i]);
+	}
+	if (keys)
+		free(keys);
+	per->pclose(handle);
+	if (per->context && strcmp(per->context, ".") != 0)
+		free(per->context);
+	free(per);
+}
+
+
+int main(int argc, char** argv)
+{
+	int max = (argc > 1) ? atoi(argv[1]) : 1000000;
+	int max_ordered = (argc > 2) ? atoi(argv[2]) : 100000;
+	int type = (argc > 3 && strcmp(argv[3], "default") == 0) ?
+		MQTTCLIENT_PERSISTENCE_DEFAULT : MQTTCLIENT_PERSISTENCE_LOG;
+	char dir[] = "/tmp/perf_restore_XXXXXX";
+	int count, rc = 0;
+
+	if (mkdtemp(dir) == NULL)
+	{
+		perror("mkdtemp");
+		return 1;
+	}
+	printf("%s store, %d byte payloads\n", (type == MQTTCLIENT_PERSISTENCE_LOG) ? "log" : "default",
+			PAYLOAD_LENGTH);
+	for (count = 10000; count <= max; count *= 10)
+	{
+		double create = 0, full = 0;
+		int restored;
+
+		populate(type, dir, count);
+		if (count <= max_ordered)
+			printf("%8d entries  ordered %9.1f ms\n", count, ordered(type, dir, count) * 1e3);
+		else
+			printf("%8d entries  ordered   skipped\n", count);
+		restored = streaming(type, dir, count, &create, &full);
+		printf("%8d entries  create  %9.1f ms  full %9.1f ms\n", count, create * 1e3, full * 1e3);
+		if (restored < count)
+		{
+			fprintf(stderr, "%d of %d commands restored\n", restored, count);
+			++rc;
+		}
+		clear(type, dir);
+	}
+	rmdir(dir);
+	return rc != 0;
+}
@@ -0,0 +1,272 @@
+/*******************************************************************************
+ * Copyright (c) 2017 IBM Corp.
+ *
+ * All rights reserved. This program and the accompanying materials
+ * are made available under the terms of the Eclipse Public License v1.0
+ * and Eclipse Distribution License v1.0 which accompany this distribution.
+ *
+ * The Eclipse Public License is available at
+ *    http://www.eclipse.org/legal/epl-v10.html
+ * and the Eclipse Distribution License is available at
+ *   http://www.eclipse.org/org/documents/edl-v10.php.
+ *
+ * Contributors:
+ *    Loopback benchmark for the MQTT socket layer
+ *******************************************************************************/
+
+/*
+ * Sends PUBLISH sized packets through Socket_putdatas to a loopback echo server and reads
+ * them back the way MQTTPacket_Factory does, reporting socket system calls per message and
+ * round trip latency percentiles.  When built with use_io_uring the run is repeated with
+ * MQTT_C_CLIENT_IO_URING=0 so both backends are compared in one process.
+ *
+ * usage: perf_socket_io [messages] [payload bytes] [window]
+ */
+
+#include "Socket.h"
+#include "SocketBuffer.h"
+#if defined(IO_URING)
+#include "SocketUring.h"
+#endif
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <time.h>
+
+#include "Heap.h"
+
+/* system calls made by the socket layer are counted through the linker's --wrap */
+static long syscalls = 0;
+
+ssize_t __real_recv(int fd, void* buf, size_t len, int flags);
+ssize_t __wrap_recv(int fd, void* buf, size_t len, int flags)
+{
+	++syscalls;
+	return __real_recv(fd, buf, len, flags);
+}
+
+ssize_t __real_writev(int fd, const struct iovec* iov, int count);
+ssize_t __wrap_writev(int fd, const struct iovec* iov, int count)
+{
+	++syscalls;
+	return __real_writev(fd, iov, count);
+}
+
+int __real_select(int nfds, fd_set* r, fd_set* w, fd_set* e, struct timeval* tv);
+int __wrap_select(int nfds, fd_set* r, fd_set* w, fd_set* e, struct timeval* tv)
+{
+	++syscalls;
+	return __real_select(nfds, r, w, e, tv);
+}
+
+long __real_syscall(long number, ...);
+long __wrap_syscall(long number, ...)
+{
+	long a[6];
+	va_list args;
+	int i;
+
+	va_start(args, number);
+	for (i = 0; i < 6; ++i)
+		a[i] = va_arg(args, long);
+	va_end(args);
+	++syscalls;
+	return __real_syscall(number, a[0], a[1], a[2], a[3], a[4], a[5]);
+}
+
+
+static unsigned long long now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (unsigned long long)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+
+static void* echo_server(void* arg)
+{
+	int listener = *(int*)arg, fd;
+	char buf[65536];
+	ssize_t n;
+
+	if ((fd = accept(listener, NULL, NULL)) < 0)
+		return NULL;
+	while ((n = read(fd, buf, sizeof(buf))) > 0)
+	{
+		ssize_t written = 0, w;
+
+		while (written < n && (w = write(fd, buf + written, n - written)) > 0)
+			written += w;
+	}
+	close(fd);
+	return NULL;
+}
+
+
+static int cmp_ull(const void* a, const void* b)
+{
+	unsigned long long x = *(const unsigned long long*)a, y = *(const unsigned long long*)b;
+
+	return (x > y) - (x < y);
+}
+
+
+/**
+ * Read one packet, resuming a previously interrupted read.
+ * @return the packet data once complete, otherwise NULL; *error is set on socket errors
+ */
+static char* read_packet(int sock, size_t* len, int* error)
+{
+	static char header;
+	char c;
+	int multiplier = 1, rc;
+	size_t remaining = 0, actual_len = 0;
+	char* data;
+
+	*error = 0;
+	if ((rc = Socket_getch(sock, &header)) != TCPSOCKET_COMPLETE)
+		goto interrupted;
+	do
+	{
+		if ((rc = Socket_getch(sock, &c)) != TCPSOCKET_COMPLETE)
+			goto interrupted;
+		remaining += (c & 127) * multiplier;
+		multiplier *= 128;
+	} while ((c & 128) != 0);
+	if ((data = Socket_getdata(sock, remaining, &actual_len)) == NULL)
+	{
+		*error = 1;
+		return NULL;
+	}
+	if (actual_len != remaining)
+		return NULL;
+	*len = remaining;
+	return data;
+interrupted:
+	*error = (rc == SOCKET_ERROR);
+	return NULL;
+}
+
+
+static int run(const char* label, int count, int payload, int window)
+{
+	struct sockaddr_in addr;
+	socklen_t addrlen = sizeof(addr);
+	int listener, sock = 0, rc, sent = 0, received = 0, outstanding = 0, error = 0;
+	unsigned long long* latencies = malloc(sizeof(unsigned long long) * count);
+	unsigned long long start, elapsed;
+	long start_syscalls;
+	pthread_t server;
+	struct timeval timeout = {1L, 0L};
+
+	listener = socket(AF_INET, SOCK_STREAM, 0);
+	memset(&addr, '\0', sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	if (bind(listener, (struct sockaddr*)&addr, sizeof(addr)) != 0 || listen(listener, 1) != 0)
+	{
+		perror("listen");
+		return 1;
+	}
+	getsockname(listener, (struct sockaddr*)&addr, &addrlen);
+	pthread_create(&server, NULL, echo_server, &listener);
+
+	Socket_outInitialize();
+	rc = Socket_new("127.0.0.1", ntohs(addr.sin_port), &sock);
+	if (rc != 0 && rc != EINPROGRESS && rc != EWOULDBLOCK)
+	{
+		fprintf(stderr, "connect failed %d\n", rc);
+		return 1;
+	}
+	while (rc != 0 && Socket_getReadySocket(0, &timeout) != sock)
+		; /* wait for the connect to complete */
+
+	start_syscalls = syscalls;
+	start = now_ns();
+	while (received < count && !error)
+	{
+		int ready;
+
+		while (outstanding < window && sent < count && Socket_noPendingWrites(sock))
+		{
+			/* fixed header, 2 byte remaining length, send timestamp, then payload */
+			size_t len = 3 + payload;
+			char* buf = malloc(len);
+			unsigned long long ts = now_ns();
+
+			buf[0] = 0x30;
+			buf[1] = (char)((payload % 128) | 0x80);
+			buf[2] = (char)(payload / 128);
+			memset(&buf[3], 'x', payload);
+			memcpy(&buf[3], &ts, sizeof(ts));
+			if ((rc = Socket_putdatas(sock, buf, len, 0, NULL, NULL, NULL)) == SOCKET_ERROR)
+			{
+				error = 1;
+				break;
+			}
+			if (rc != TCPSOCKET_INTERRUPTED)
+				free(buf); /* otherwise freed by the socket layer once written */
+			++sent;
+			++outstanding;
+		}
+
+		if ((ready = Socket_getReadySocket(0, &timeout)) == sock)
+		{
+			char* data;
+			size_t len = 0;
+
+			while ((data = read_packet(sock, &len, &error)) != NULL)
+			{
+				unsigned long long ts;
+
+				memcpy(&ts, data, sizeof(ts));
+				latencies[received++] = now_ns() - ts;
+				--outstanding;
+			}
+		}
+	}
+	elapsed = now_ns() - start;
+
+	if (error)
+		fprintf(stderr, "%s: socket error after %d messages\n", label, received);
+	else
+	{
+		qsort(latencies, count, sizeof(unsigned long long), cmp_ull);
+		printf("%-8s %8d msgs %5d bytes window %3d: %8.2f syscalls/msg  %9.0f msgs/s  p50 %7.1f us  p99 %7.1f us\n",
+				label, count, payload, window, (double)(syscalls - start_syscalls) / count,
+				count / (elapsed / 1e9), latencies[count / 2] / 1e3, latencies[(count * 99) / 100] / 1e3);
+	}
+
+	Socket_close(sock);
+	Socket_outTerminate();
+	pthread_join(server, NULL);
+	close(listener);
+	free(latencies);
+	return error;
+}
+
+
+int main(int argc, char** argv)
+{
+	int count = (argc > 1) ? atoi(argv[1]) : 20000;
+	int payload = (argc > 2) ? atoi(argv[2]) : 64;
+	int window = (argc > 3) ? atoi(argv[3]) : 16;
+	int rc = 0;
+
+	if (payload < 8)
+		payload = 8;
+	if (payload > 16383)
+		payload = 16383;
+	Heap_initialize();
+#if defined(IO_URING)
+	rc = run("io_uring", count, payload, window);
+	setenv(URING_ENV, "0", 1);
+#endif
+	rc += run("select", count, payload, window);
+	Heap_terminate();
+	return rc;
+}
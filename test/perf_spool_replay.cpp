@@ -0,0 +1,144 @@
+/*******************************************************************************
+ * Copyright (c) 2017 IBM Corp.
+ *
+ * All rights reserved. This program and the accompanying materials
+ * are made available under the terms of the Eclipse Public License v1.0
+ * and Eclipse Distribution License v1.0 which accompany this distribution.
+ *
+ * The Eclipse Public License is available at
+ *    http://www.eclipse.org/legal/epl-v10.html
+ * and the Eclipse Distribution License is available at
+ *   http://www.eclipse.org/org/documents/edl-v10.php.
+ *
+ * Contributors:
+ *    Replay benchmark for the store-and-forward spool
+ *******************************************************************************/
+
+/*
+ * Fills a spool the way a device does while offline, reopens it to measure recovery, then
+ * replays it with front/pop as the drain thread does after a reconnect.  A second pass
+ * overfills a small spool under each drop policy and reports what survived.
+ *
+ * usage: perf_spool_replay [records] [payload bytes]
+ */
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+#include <dirent.h>
+#include <unistd.h>
+
+#include "IOTP_Spool.h"
+
+using namespace Watson_IOTP;
+
+static double seconds(std::chrono::steady_clock::time_point start) {
+	return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+static void removeAll(const std::string& directory) {
+	DIR* dir = opendir(directory.c_str());
+	if (dir == NULL)
+		return;
+	struct dirent* entry;
+	while ((entry = readdir(dir)) != NULL) {
+		if (strcmp(entry->d_name, ".") != 0 && strcmp(entry->d_name, "..") != 0)
+			unlink((directory + "/" + entry->d_name).c_str());
+	}
+	closedir(dir);
+	rmdir(directory.c_str());
+}
+
+static std::string payloadFor(int seq, int size) {
+	std::string payload(size, 'x');
+	snprintf(&payload[0], size, "{\"seq\":%d}", seq);
+	return payload;
+}
+
+static int replay(const std::string& directory, int records, int size) {
+	const std::string topic = "iot-2/evt/status/fmt/json";
+	double mb = (double) records * (size + topic.size()) / (1024 * 1024);
+	int errors = 0;
+
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	{
+		IOTP_Spool spool(directory, 1ULL << 40, IOTP_Spool::DROP_OLDEST);
+		for (int i = 0; i < records; ++i)
+			spool.append(topic, payloadFor(i, size), 1);
+	}
+	double elapsed = seconds(start);
+	printf("append   %8d records %5d bytes: %10.0f records/s %8.1f MB/s\n", records, size,
+			records / elapsed, mb / elapsed);
+
+	start = std::chrono::steady_clock::now();
+	IOTP_Spool spool(directory, 1ULL << 40, IOTP_Spool::DROP_OLDEST);
+	elapsed = seconds(start);
+	printf("recover  %8zu records: %10.1f ms\n", spool.count(), elapsed * 1e3);
+	if (spool.count() != (size_t) records)
+		++errors;
+
+	start = std::chrono::steady_clock::now();
+	IOTP_Spool::Record record;
+	int seq = 0;
+	while (spool.front(record)) {
+		if (record.payload != payloadFor(seq, size))
+			++errors;
+		spool.pop();
+		++seq;
+	}
+	elapsed = seconds(start);
+	printf("replay   %8d records %5d bytes: %10.0f records/s %8.1f MB/s\n", seq, size,
+			seq / elapsed, mb / elapsed);
+	if (seq != records)
+		++errors;
+	return errors;
+}
+
+static void dropPolicy(const std::string& directory, const char* name, int size) {
+	const unsigned long long cap = 1024 * 1024;
+	int records = 3 * cap / size, high = 0;
+
+	removeAll(directory);
+	IOTP_Spool spool(directory, cap, IOTP_Spool::toDropPolicy(name), 256 * 1024);
+	for (int i = 0; i < records; ++i)
+		spool.append("iot-2/evt/status/fmt/json", payloadFor(i, size), 1, (i % 4 == 0) ? 1 : 0);
+
+	IOTP_Spool::Record record;
+	int first = -1, count = 0;
+	while (spool.front(record)) {
+		if (first < 0)
+			first = atoi(record.payload.c_str() + 7);
+		high += record.priority;
+		++count;
+		spool.pop();
+	}
+	printf("%-16s %6d appended %6d kept (%5d high priority) %6llu dropped, oldest kept #%d\n",
+			name, records, count, high, spool.dropped(), first);
+}
+
+int main(int argc, char** argv) {
+	int records = (argc > 1) ? atoi(argv[1]) : 100000;
+	int size = (argc > 2) ? atoi(argv[2]) : 256;
+	char path[] = "/tmp/perf_spool_XXXXXX";
+
+	if (size < 16)
+		size = 16;
+	if (mkdtemp(path) == NULL) {
+		perror("mkdtemp");
+		return 1;
+	}
+	std::string directory = path;
+
+	int errors = replay(directory, records, size);
+	dropPolicy(directory, "oldest", size);
+	dropPolicy(directory, "lowest-priority", size);
+	dropPolicy(directory, "newest", size);
+	removeAll(directory);
+
+	if (errors)
+		fprintf(stderr, "%d replay errors\n", errors);
+	return errors != 0;
+}
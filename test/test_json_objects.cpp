@@ -0,0 +1,184 @@
+/*******************************************************************************
+ * Copyright (c) 2017 IBM Corp.
+ *
+ * All rights reserved. This program and the accompanying materials
+ * are made available under the terms of the Eclipse Public License v1.0
+ * and Eclipse Distribution License v1.0 which accompany this distribution.
+ *
+ * The Eclipse Public License is available at
+ *    http://www.eclipse.org/legal/epl-v10.html
+ * and the Eclipse Distribution License is available at
+ *   http://www.eclipse.org/org/documents/edl-v10.php.
+ *
+ * Contributors:
+ *    Differential test of the sorted vector storage of Json::Value objects
+ *******************************************************************************/
+
+/*
+ * Runs the same random inserts, lookups, erases, copies and comparisons on a Json::FlatMap
+ * and a std::map, and checks after every step that both hold the same members in the same
+ * order. Inserts an element of a FlatMap into it again, at every position and across the
+ * growth of its storage, and checks that the copy is whole. Then appends
+ * elements of arrays to themselves and copies members of objects into them through
+ * Json::Value, with whichever storage jsoncpp is built with. Run it under a memory checker,
+ * and with -Duse_flat_json_objects=ON, to see that nothing freed is read.
+ *
+ * usage: test_json_objects [steps]
+ */
+
+#include <cstdio>
+#include <cstdlib>
+#include <map>
+#include <string>
+
+#include "json/json.h"
+
+typedef Json::FlatMap<Json::Value, Json::Value> Flat;
+typedef std::map<Json::Value, Json::Value> Reference;
+
+static int failures = 0;
+
+static void fail(int step, const char* what) {
+	if (failures++ < 10)
+		printf("step %d: %s\n", step, what);
+}
+
+static bool same(const Flat& flat, const Reference& reference) {
+	if (flat.size() != reference.size())
+		return false;
+	Reference::const_iterator r = reference.begin();
+	for (Flat::const_iterator f = flat.begin(); f != flat.end(); ++f, ++r) {
+		if (!(f->first == r->first) || !(f->second == r->second))
+			return false;
+	}
+	return true;
+}
+
+// Keys of both kinds Value uses, indexes and names, and values that own heap storage
+static Json::Value randomKey() {
+	int n = rand() % 40;
+	if (n < 20)
+		return Json::Value(n);
+	return Json::Value("member" + std::to_string(n));
+}
+
+static Json::Value randomValue(int step) {
+	switch (rand() % 3) {
+	case 0:
+		return Json::Value(step);
+	case 1:
+		return Json::Value("a string long enough to be on the heap, step " + std::to_string(step));
+	default: {
+		Json::Value object;
+		object["step"] = step;
+		object["tags"].append("x");
+		return object;
+	}
+	}
+}
+
+static void differential(int steps) {
+	Flat flat;
+	Reference reference;
+	for (int step = 0; step < steps; ++step) {
+		Json::Value key = randomKey();
+		switch (rand() % 5) {
+		case 0: {
+			// operator[], assigning a new or existing member
+			Json::Value value = randomValue(step);
+			flat[key] = value;
+			reference[key] = value;
+			break;
+		}
+		case 1: {
+			// insert at the lower bound of a key not there yet, a copy of another member
+			if (flat.find(key) != flat.end() || flat.empty())
+				break;
+			Flat::value_type element(key, (flat.begin() + rand() % flat.size())->second);
+			reference.insert(element);
+			flat.insert(flat.lower_bound(key), element);
+			break;
+		}
+		case 2: {
+			Flat::iterator f = flat.find(key);
+			Reference::iterator r = reference.find(key);
+			if ((f == flat.end()) != (r == reference.end()) || (f != flat.end() && !(f->second == r->second)))
+				fail(step, "find differs");
+			break;
+		}
+		case 3:
+			if (flat.erase(key) != reference.erase(key))
+				fail(step, "erase differs");
+			break;
+		default: {
+			Flat copy(flat);
+			if (!(copy == flat) || (copy < flat) || (flat < copy))
+				fail(step, "copy differs");
+			flat = copy;
+			break;
+		}
+		}
+		if (!same(flat, reference)) {
+			fail(step, "members differ");
+			return;
+		}
+	}
+}
+
+// An element of the map inserted again, at its own lower bound, which moves it
+static void selfInsert() {
+	for (int size = 1; size <= 20; ++size) {
+		for (int at = 0; at < size; ++at) {
+			Flat flat;
+			for (int i = 0; i < size; ++i)
+				flat[Json::Value(i)] = randomValue(i);
+			Flat::value_type expected(*(flat.begin() + at));
+			Flat::value_type& alias = *(flat.begin() + at);
+			flat.insert(flat.lower_bound(alias.first), alias);
+			if (flat.size() != (size_t)size + 1 || !((flat.begin() + at)->second == expected.second)
+					|| !((flat.begin() + at + 1)->second == expected.second))
+				fail(size, "an element inserted into its own map differs");
+		}
+	}
+}
+
+// The Json::Value cases that copy from a member while the object or array grows
+static void aliases() {
+	Json::Value array(Json::arrayValue);
+	array.append("the first element, long enough to be on the heap");
+	for (int i = 0; i < 100; ++i)
+		array.append(array[i % array.size()]);
+	for (Json::ArrayIndex i = 0; i < array.size(); ++i) {
+		if (array[i] != array[0]) {
+			fail(i, "array.append(array[n]) differs");
+			break;
+		}
+	}
+
+	Json::Value nested(Json::arrayValue);
+	nested.append(Json::Value(Json::objectValue));
+	nested[0]["name"] = "nested";
+	for (int i = 0; i < 20; ++i)
+		nested.append(nested[0]);
+	if (nested.size() != 21 || nested[20]["name"] != "nested")
+		fail(0, "nested.append(nested[0]) differs");
+
+	Json::Value object(Json::objectValue);
+	object["a"] = "the first member, long enough to be on the heap";
+	for (int i = 0; i < 40; ++i) {
+		Json::Value copy = object["a"];
+		object["m" + std::to_string(i)] = copy;
+	}
+	if (object.size() != 41 || object["m39"] != object["a"])
+		fail(0, "members copied from a member differ");
+}
+
+int main(int argc, char** argv) {
+	int steps = (argc > 1) ? atoi(argv[1]) : 20000;
+	srand(1);
+	differential(steps);
+	selfInsert();
+	aliases();
+	printf("%d steps, %d failures\n", steps, failures);
+	return failures ? 1 : 0;
+}
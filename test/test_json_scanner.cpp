@@ -0,0 +1,118 @@
+/*******************************************************************************
+ * Copyright (c) 2017 IBM Corp.
+ *
+ * All rights reserved. This program and the accompanying materials
+ * are made available under the terms of the Eclipse Public License v1.0
+ * and Eclipse Distribution License v1.0 which accompany this distribution.
+ *
+ * The Eclipse Public License is available at
+ *    http://www.eclipse.org/legal/epl-v10.html
+ * and the Eclipse Distribution License is available at
+ *   http://www.eclipse.org/org/documents/edl-v10.php.
+ *
+ * Contributors:
+ *    Tests for the json scanner on documents cut off anywhere
+ *******************************************************************************/
+
+/*
+ * Cuts a response and a command payload off after every byte, copies what is left into a
+ * buffer of exactly that size, and looks values up in it with IOTP_JsonDocument and parses
+ * it with IOTP_JsonScanner. Checks that no parse of a cut document succeeds, that a document
+ * cut after a key finds nothing, and that the whole documents give their values. Then parses
+ * numbers at the limits of doubles and 64 bit integers with the scanner and Json::Reader and
+ * checks that both take and reject the same ones, with the same values. Run it under a memory
+ * checker to see that nothing past the end of a buffer is read.
+ *
+ * usage: test_json_scanner
+ */
+
+#include <cstdio>
+#include <cstring>
+#include <string>
+
+#include "IOTP_JsonScanner.h"
+#include "json/json.h"
+
+using namespace Watson_IOTP;
+
+static int failures = 0;
+
+static void fail(const char* document, size_t length, const char* what) {
+	if (failures++ < 10)
+		printf("%s cut to %lu bytes: %s\n", document, (unsigned long)length, what);
+}
+
+static const char* const RESPONSE = "{\"rc\":200,\"reqId\":\"a1b2\",\"message\":\"na\\\"me\","
+		"\"d\":{\"fields\":[{\"field\":\"metadata\",\"value\":{\"x\":1.5}}]}}";
+static const char* const COMMAND = "{\"d\":{\"setpoints\":[[1,20.5],[2,21]],\"mode\":\"eco\"}}";
+
+// Each prefix of a document, in a buffer of its own size, through every lookup
+static void truncated(const char* name, const char* text, const char* const* paths, int pathCount) {
+	size_t whole = strlen(text);
+	for (size_t length = 0; length < whole; ++length) {
+		char* buffer = new char[length > 0 ? length : 1];
+		memcpy(buffer, text, length);
+		IOTP_JsonDocument document(buffer, length);
+		for (int p = 0; p < pathCount; ++p) {
+			Json::Value value;
+			document.has(paths[p]);
+			document.get(paths[p], value);
+			// asString() throws for objects and arrays
+			if (!value.isObject() && !value.isArray())
+				document.getString(paths[p], "none");
+			document.getInt(paths[p], -1);
+			document.getDouble(paths[p], -1.0);
+		}
+		Json::Value root;
+		if (IOTP_JsonScanner::parse(buffer, length, root))
+			fail(name, length, "parsed");
+		delete[] buffer;
+	}
+}
+
+// Numbers the scanner decodes itself, against the reader it stands in for
+static void numbers() {
+	const char* documents[] = {
+		"[1e400]", "[-1e400]", "[1.8e308]", "[1.7976931348623157e308]", "[1e-400]", "[4.9e-324]",
+		"[9223372036854775807]", "[-9223372036854775808]", "[18446744073709551615]",
+		"[18446744073709551616]", "[123456789012345678901234567890]", "[0.1]", "[-0]",
+		"{\"d\":{\"x\":1e999}}",
+	};
+	for (size_t i = 0; i < sizeof(documents) / sizeof(documents[0]); ++i) {
+		std::string text = documents[i];
+		Json::Value scanned, read;
+		bool scannedOk = IOTP_JsonScanner::parse(text.data(), text.size(), scanned);
+		Json::Reader reader;
+		bool readOk = reader.parse(text, read);
+		if (scannedOk == readOk && (!readOk || scanned == read))
+			continue;
+		if (failures++ < 10)
+			printf("%s: the scanner %s, the reader %s\n", documents[i], scannedOk ? "takes it" : "rejects it",
+					readOk ? "takes it" : "rejects it");
+	}
+}
+
+int main() {
+	const char* responsePaths[] = { "rc", "reqId", "message", "d", "d/fields/0/value/x", "d/fields/1", "missing" };
+	const char* commandPaths[] = { "d", "d/setpoints/1/0", "d/setpoints/0/1", "d/mode", "d/setpoints/2" };
+	truncated("response", RESPONSE, responsePaths, sizeof(responsePaths) / sizeof(responsePaths[0]));
+	truncated("command", COMMAND, commandPaths, sizeof(commandPaths) / sizeof(commandPaths[0]));
+
+	IOTP_JsonDocument response(RESPONSE, strlen(RESPONSE));
+	if (response.getInt("rc") != 200 || response.getString("reqId") != "a1b2"
+			|| response.getString("message") != "na\"me" || response.getDouble("d/fields/0/value/x") != 1.5
+			|| response.has("d/fields/1") || response.has("missing"))
+		fail("response", strlen(RESPONSE), "values differ");
+	IOTP_JsonDocument command(COMMAND, strlen(COMMAND));
+	if (command.getInt("d/setpoints/1/0") != 2 || command.getDouble("d/setpoints/0/1") != 20.5
+			|| command.getString("d/mode") != "eco" || command.has("d/setpoints/2"))
+		fail("command", strlen(COMMAND), "values differ");
+	IOTP_JsonDocument cut("{\"d\":", 5);
+	if (cut.getString("reqId", "none") != "none" || cut.has("d"))
+		fail("{\"d\":", 5, "found a value");
+
+	numbers();
+
+	printf("%d failures\n", failures);
+	return failures ? 1 : 0;
+}
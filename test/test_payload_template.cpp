@@ -0,0 +1,75 @@
+/*******************************************************************************
+ * Copyright (c) 2017 IBM Corp.
+ *
+ * All rights reserved. This program and the accompanying materials
+ * are made available under the terms of the Eclipse Public License v1.0
+ * and Eclipse Distribution License v1.0 which accompany this distribution.
+ *
+ * The Eclipse Public License is available at
+ *    http://www.eclipse.org/legal/epl-v10.html
+ * and the Eclipse Distribution License is available at
+ *   http://www.eclipse.org/org/documents/edl-v10.php.
+ *
+ * Contributors:
+ *    Tests for the literal text and the slots of payload templates
+ *******************************************************************************/
+
+/*
+ * Compiles shapes whose keys and strings hold escapes, a quote, a backslash, a \u escape and
+ * a $ inside a string, and checks that rendering gives the text between the slots back byte
+ * for byte. Sets slots that exist and slot -1, which slot() gives for a name a shape does not
+ * have, and checks that only the slots that exist change.
+ *
+ * usage: test_payload_template
+ */
+
+#include <cstdio>
+#include <string>
+
+#include "IOTP_PayloadTemplate.h"
+
+using namespace Watson_IOTP;
+
+static int failures = 0;
+
+static void check(const char* what, const std::string& text, const std::string& expected) {
+	if (text == expected)
+		return;
+	printf("%s gives '%s', not '%s'\n", what, text.c_str(), expected.c_str());
+	++failures;
+}
+
+int main() {
+	const char* literals[] = {
+		"{\"na\\\"me\":1}",
+		"{\"back\\\\slash\":\"x\\u00e9\"}",
+		"{\"d\":\"a \\\"quoted\\\" $word\",\"tab\":\"\\t\\/\"}",
+		"[\"\\\\\",\"\\\"\"]",
+	};
+	for (size_t i = 0; i < sizeof(literals) / sizeof(literals[0]); ++i) {
+		IOTP_PayloadTemplate payload(literals[i]);
+		if (!payload.valid() || payload.slots() != 0)
+			check(literals[i], "not valid", "valid, no slots");
+		check(literals[i], payload.render(), literals[i]);
+	}
+
+	IOTP_PayloadTemplate status("{\"d\":{\"na\\\"me\":$name,\"x\\u00e9\":$value,\"$text\":\"$\"}}");
+	check("escaped keys between slots", status.valid() ? "valid" : "not valid", "valid");
+	int name = status.slot("name");
+	int value = status.slot("value");
+	int missing = status.slot("missing");
+	check("slot of a missing name", std::to_string(missing), "-1");
+	status.set(name, "a\"b");
+	status.set(value, 21.5);
+	status.set(missing, 1.0);
+	status.set(missing, (long long)1);
+	status.set(missing, true);
+	status.set(missing, "text");
+	status.setNull(missing);
+	status.setTime(missing, 0);
+	check("escaped keys between slots", status.render(),
+			"{\"d\":{\"na\\\"me\":\"a\\\"b\",\"x\\u00e9\":21.5,\"$text\":\"$\"}}");
+
+	printf("%d failures\n", failures);
+	return failures ? 1 : 0;
+}
@@ -0,0 +1,93 @@
+/*******************************************************************************
+ * Copyright (c) 2017 IBM Corp.
+ *
+ * All rights reserved. This program and the accompanying materials
+ * are made available under the terms of the Eclipse Public License v1.0
+ * and Eclipse Distribution License v1.0 which accompany this distribution.
+ *
+ * The Eclipse Public License is available at
+ *    http://www.eclipse.org/legal/epl-v10.html
+ * and the Eclipse Distribution License is available at
+ *   http://www.eclipse.org/org/documents/edl-v10.php.
+ *
+ * Contributors:
+ *    Tests for creating and destroying clients with each persistence type
+ *******************************************************************************/
+
+/*
+ * Creates and destroys an asynchronous client with each type of persistence, twice over the
+ * same store so that the second client opens and restores what the first one closed. Run it
+ * under a memory checker to see that closing a store frees it once and reads nothing freed.
+ *
+ * usage: test_persistence
+ */
+
+#include "MQTTAsync.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define CLIENT_ID "test_persistence"
+#define SERVER_URI "tcp://localhost:1883"
+
+
+static int failures = 0;
+
+
+static void check(const char* label, int rc, const char* what)
+{
+	if (rc != MQTTASYNC_SUCCESS)
+	{
+		printf("%s: %s failed, rc %d\n", label, what, rc);
+		++failures;
+	}
+}
+
+
+static void createDestroy(const char* label, int type, void* context)
+{
+	int i;
+
+	for (i = 0; i < 2; ++i)
+	{
+		MQTTAsync client = NULL;
+
+		check(label, MQTTAsync_create(&client, SERVER_URI, CLIENT_ID, type, context), "create");
+		if (client != NULL)
+			MQTTAsync_destroy(&client);
+		if (client != NULL)
+		{
+			printf("%s: destroy left the handle set\n", label);
+			++failures;
+		}
+	}
+	printf("%s: created and destroyed\n", label);
+}
+
+
+int main(void)
+{
+	char directory[] = "/tmp/test_persistenceXXXXXX";
+	char command[64];
+	MQTTClient_memoryPersistenceOptions memory = MQTTClient_memoryPersistenceOptions_initializer;
+
+	if (mkdtemp(directory) == NULL)
+	{
+		perror("mkdtemp");
+		return 1;
+	}
+
+	createDestroy("none", MQTTCLIENT_PERSISTENCE_NONE, NULL);
+	createDestroy("default", MQTTCLIENT_PERSISTENCE_DEFAULT, directory);
+	createDestroy("log", MQTTCLIENT_PERSISTENCE_LOG, directory);
+	createDestroy("memory", MQTTCLIENT_PERSISTENCE_MEMORY, NULL);
+	memory.directory = directory;
+	createDestroy("memory snapshot", MQTTCLIENT_PERSISTENCE_MEMORY, &memory);
+
+	snprintf(command, sizeof(command), "rm -rf %s", directory);
+	if (system(command) != 0)
+		printf("could not remove %s\n", directory);
+	return failures ? 1 : 0;
+}